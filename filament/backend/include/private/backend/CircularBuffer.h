@@ -20,6 +20,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <utils/Allocator.h>
 #include <utils/compiler.h>
 
 namespace filament {
@@ -36,7 +37,14 @@ public:
     //      This must be at least 2*requiredSize to avoid blocking on flush, however
     //      because sometimes the display can get ahead of the render() thread, it's good
     //      to set it to 3*requiredSize to avoid blocking the render thread (usually the UI thread).
-    explicit CircularBuffer(size_t bufferSize);
+    // backing: huge pages and/or pre-faulting of the buffer's pages, only honored on Linux.
+    explicit CircularBuffer(size_t bufferSize,
+            utils::MemoryBacking backing = utils::MemoryBacking::DEFAULT);
+
+    // Wraps a linear memory area owned by the caller, which must outlive this object.
+    // Such a buffer can't be circularized, it's used to record a segment of commands
+    // (see CommandStream::splice()).
+    CircularBuffer(void* data, size_t size) noexcept;
 
     // can't be moved or copy-constructed
     CircularBuffer(CircularBuffer const& rhs) = delete;
@@ -68,12 +76,13 @@ public:
     void circularize() noexcept;
 
 private:
-    void* alloc(size_t size) noexcept;
+    void* alloc(size_t size, utils::MemoryBacking backing) noexcept;
     void dealloc() noexcept;
 
     // pointer to the beginning of the circular buffer (constant)
     void* mData = nullptr;
     int mUsesAshmem = -1;
+    bool mOwnsData = true;
 
     // size of the circular buffer (constant)
     size_t mSize = 0;
@@ -19,46 +19,63 @@
 
 #include "private/backend/CircularBuffer.h"
 
+#include <utils/architecture.h>
 #include <utils/compiler.h>
 #include <utils/Condition.h>
 #include <utils/Mutex.h>
 
+#include <atomic>
 #include <vector>
 
+#include <stdint.h>
+
 namespace filament {
 namespace backend {
 
 /*
- * A producer-consumer command queue that uses a CircularBuffer as main storage
+ * A producer-consumer command queue that uses a CircularBuffer as main storage.
+ *
+ * There must be a single producer thread (which calls flush()) and a single consumer thread
+ * (which calls waitForCommands() and releaseBuffer()). Command buffers are handed over through
+ * a lock-free ring, a thread that has to wait spins for a little while before parking.
+ *
+ * Other queues can be attached as sources, each one with its own producer thread. Their command
+ * buffers are returned by the consumer of this queue as well, before the command buffers of
+ * this queue that were flushed after them.
  */
 class CommandBufferQueue {
     struct Slice {
         void* begin;
         void* end;
+        // the queue this command buffer must be released to
+        CommandBufferQueue* owner;
     };
 
-    const size_t mRequiredSize;
-
-    CircularBuffer mCircularBuffer;
-
-    // space available in the circular buffer
-
-    mutable utils::Mutex mLock;
-    mutable utils::Condition mCondition;
-    mutable std::vector<Slice> mCommandBuffersToExecute;
-    size_t mFreeSpace = 0;
-    size_t mHighWatermark = 0;
-    bool mExitRequested = false;
-
 public:
+    // Time spent by each side waiting for the other, which can be used to size the command
+    // buffers. Times are in nanoseconds.
+    struct Stats {
+        // flush() waited for space in the circular buffer
+        uint64_t producerStallCount;
+        uint64_t producerStallTime;
+        // waitForCommands() waited for a command buffer
+        uint64_t consumerStallCount;
+        uint64_t consumerStallTime;
+    };
+
     // requiredSize: guaranteed available space after flush()
-    CommandBufferQueue(size_t requiredSize, size_t bufferSize);
+    // backing: how the circular buffer's memory is backed, see CircularBuffer
+    CommandBufferQueue(size_t requiredSize, size_t bufferSize,
+            utils::MemoryBacking backing = utils::MemoryBacking::DEFAULT);
     ~CommandBufferQueue();
 
     CircularBuffer& getCircularBuffer() { return mCircularBuffer; }
 
     size_t getHigWatermark() noexcept { return mHighWatermark; }
 
+    // can be called from any thread
+    Stats getStats() const noexcept;
+
     // wait for commands to be available and returns an array containing these commands
     std::vector<Slice> waitForCommands() const;
 
@@ -73,6 +90,76 @@ public:
 
     // returns from waitForCommands() immediately.
     void requestExit();
+
+    // Adds a queue whose command buffers are returned by waitForCommands(). The source's
+    // consumer becomes this queue's consumer, and it must not be destroyed before it's detached.
+    void attachSource(CommandBufferQueue* source);
+
+    // Removes a source. Its command buffers that are not returned by waitForCommands() yet are
+    // never returned, so it's usually done once isReleased() returns true.
+    void detachSource(CommandBufferQueue* source);
+
+    // true when all command buffers flushed to this queue have been released
+    bool isReleased() const noexcept {
+        return mFreeSpace.load(std::memory_order_acquire) == mCircularBuffer.size();
+    }
+
+private:
+    // maximum number of command buffers in flight, must be a power of two
+    static constexpr uint32_t SLICE_COUNT = 64;
+
+    // number of times a waiting thread checks its condition before parking
+    static constexpr uint32_t SPIN_COUNT = 1024;
+
+    struct StallCounter {
+        std::atomic<uint64_t> count = { 0 };
+        std::atomic<uint64_t> time = { 0 };
+    };
+
+    template<typename PREDICATE>
+    void wait(std::atomic<bool>& parked, utils::Condition& condition,
+            StallCounter& stalls, PREDICATE predicate) const noexcept;
+
+    void wake(std::atomic<bool> const& parked, utils::Condition& condition) const noexcept;
+
+    // wakes the consumer after a command buffer is flushed
+    void notifyConsumer() noexcept;
+
+    // appends the command buffers flushed so far, called by the consumer
+    void drain(std::vector<Slice>& buffers, uint32_t head) const noexcept;
+
+    const size_t mRequiredSize;
+
+    CircularBuffer mCircularBuffer;
+
+    // ring of command buffers to execute, mHead is written by the producer, mTail by the consumer
+    mutable Slice mSlices[SLICE_COUNT];
+    alignas(utils::CACHELINE_SIZE) std::atomic<uint32_t> mHead = { 0 };
+    alignas(utils::CACHELINE_SIZE) mutable std::atomic<uint32_t> mTail = { 0 };
+
+    // space available in the circular buffer
+    alignas(utils::CACHELINE_SIZE) std::atomic<size_t> mFreeSpace;
+    std::atomic<bool> mExitRequested = { false };
+    size_t mHighWatermark = 0;
+
+    // only used when a thread parks
+    mutable utils::Mutex mLock;
+    mutable utils::Condition mProducerCondition;
+    mutable utils::Condition mConsumerCondition;
+    mutable std::atomic<bool> mProducerParked = { false };
+    mutable std::atomic<bool> mConsumerParked = { false };
+
+    mutable StallCounter mProducerStalls;
+    mutable StallCounter mConsumerStalls;
+
+    // the queue this queue is a source of
+    CommandBufferQueue* mSink = nullptr;
+
+    // sources are rarely added or removed, but they're drained each time one of them flushes
+    mutable utils::Mutex mSourcesLock;
+    std::vector<CommandBufferQueue*> mSources;
+    std::atomic<uint32_t> mSourcesFlushCount = { 0 };
+    mutable uint32_t mSourcesDrainedCount = 0;
 };
 
 } // namespace backend
@@ -41,8 +41,10 @@
 #include <utils/compiler.h>
 
 #include <functional>
+#include <limits>
 #include <tuple>
 #include <thread>
+#include <type_traits>
 #include <utility>
 
 #include <cassert>
@@ -57,6 +59,7 @@ namespace backend {
 
 class Driver;
 class CommandBase;
+class CommandStreamCapture;
 
 /*
  * Dispatcher is a data structure containing only function pointers.
@@ -66,27 +69,45 @@ class CommandBase;
  * Dispatcher's function pointers are populated during initialization and no CommandStream calls
  * can be made before that.
  *
- * When a command is inserted into the stream, the corresponding function pointer is copied
- * directly into CommandBase from Dispatcher.
+ * When a command is inserted into the stream, only its Opcode, i.e. the index of its function
+ * pointer in Dispatcher, is stored in CommandBase, which is much smaller than the pointer.
  */
 class Dispatcher {
 public:
     using Execute = void (*)(Driver& driver, CommandBase* self, intptr_t* next);
+
+    enum class Opcode : uint16_t {
+        noop,
+        custom,
+        bindUniformBufferRangeAndDraw,
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
-#define DECL_DRIVER_API(methodName, paramsDecl, params)                     Execute methodName##_;
-#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)     Execute methodName##_;
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                     methodName,
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)     methodName,
 #include "DriverAPI.inc"
+        COUNT
+    };
+
+    Dispatcher() noexcept;
+
+    Execute operator[](Opcode opcode) const noexcept {
+        return mExecute[size_t(opcode)];
+    }
+
+protected:
+    Execute mExecute[size_t(Opcode::COUNT)] = {};
 };
 
 // ------------------------------------------------------------------------------------------------
 
 class CommandBase {
-    static constexpr size_t FILAMENT_OBJECT_ALIGNMENT = alignof(std::max_align_t);
-
 protected:
-    using Execute = Dispatcher::Execute;
+    // the arguments of the commands never need more, and it wastes less space than
+    // alignof(std::max_align_t)
+    static constexpr size_t FILAMENT_OBJECT_ALIGNMENT = alignof(uint64_t);
 
-    constexpr explicit CommandBase(Execute execute) noexcept : mExecute(execute) {}
+    using Opcode = Dispatcher::Opcode;
+
+    constexpr explicit CommandBase(Opcode opcode) noexcept : mOpcode(opcode) {}
 
 public:
     // alignment of all Commands in the CommandStream
@@ -95,18 +116,19 @@ public:
     }
 
     // executes this command and returns the next one
-    inline CommandBase* execute(Driver& driver) {
+    inline CommandBase* execute(Driver& driver, Dispatcher const& dispatcher) {
         // it is important to return the next command offset by output parameter instead
         // of return value -- it allows the compiler to perform the tail call optimization.
         intptr_t next;
-        mExecute(driver, this, &next);
+        dispatcher[mOpcode](driver, this, &next);
         return reinterpret_cast<CommandBase*>(reinterpret_cast<intptr_t>(this) + next);
     }
 
     inline ~CommandBase() noexcept = default;
 
 private:
-    Execute mExecute;
+    friend class CommandStreamCapture;
+    Opcode mOpcode;
 };
 
 // ------------------------------------------------------------------------------------------------
@@ -156,6 +178,11 @@ struct CommandType<void (Driver::*)(ARGS...)> {
         void log() noexcept;
         template<std::size_t... I> void log(std::index_sequence<I...>) noexcept;
 
+        friend class filament::backend::CommandStreamCapture;
+
+        static_assert(alignof(SavedParameters) <= FILAMENT_OBJECT_ALIGNMENT,
+                "the arguments of a command are not aligned in the CommandStream");
+
     public:
         template<typename M, typename D>
         static inline void execute(M&& method, D&& driver, CommandBase* base, intptr_t* next) noexcept {
@@ -173,8 +200,8 @@ struct CommandType<void (Driver::*)(ARGS...)> {
         inline Command(Command&& rhs) noexcept = default;
 
         template<typename... A>
-        inline explicit constexpr Command(Execute execute, A&& ... args)
-                : CommandBase(execute), mArgs(std::move(args)...) {
+        inline explicit constexpr Command(Opcode opcode, A&& ... args)
+                : CommandBase(opcode), mArgs(std::move(args)...) {
         }
 
         // placement new declared as "throw" to avoid the compiler's null-check
@@ -191,26 +218,60 @@ struct CommandType<void (Driver::*)(ARGS...)> {
 // ------------------------------------------------------------------------------------------------
 
 class CustomCommand : public CommandBase {
+    friend class CommandStreamCapture;
+    friend class Dispatcher;
     std::function<void()> mCommand;
     static void execute(Driver&, CommandBase* base, intptr_t* next) noexcept;
 public:
     inline CustomCommand(CustomCommand&& rhs) = default;
     inline explicit CustomCommand(std::function<void()> cmd)
-            : CommandBase(execute), mCommand(std::move(cmd)) { }
+            : CommandBase(Opcode::custom), mCommand(std::move(cmd)) { }
 };
 
 // ------------------------------------------------------------------------------------------------
 
 class NoopCommand : public CommandBase {
+    friend class CommandStreamCapture;
+    friend class Dispatcher;
     intptr_t mNext;
     static void execute(Driver&, CommandBase* self, intptr_t* next) noexcept {
         *next = static_cast<NoopCommand*>(self)->mNext;
     }
 public:
     inline constexpr explicit NoopCommand(void* next) noexcept
-            : CommandBase(execute), mNext(size_t((char *)next - (char *)this)) { }
+            : CommandBase(Opcode::noop), mNext(size_t((char *)next - (char *)this)) { }
+};
+
+// ------------------------------------------------------------------------------------------------
+
+/*
+ * bindUniformBufferRange() followed by draw(), which is how most primitives are drawn, as a
+ * single command. The arguments are packed, so it's about half the size of the two commands,
+ * and the driver's methods are called with a single dispatch.
+ */
+class BindAndDrawCommand : public CommandBase {
+    friend class CommandStreamCapture;
+    template<typename ConcreteDriver>
+    friend class ConcreteDispatcher;
+    uint8_t mIndex;
+    PipelineState mState;
+    Handle<HwRenderPrimitive> mPrimitive;
+    Handle<HwUniformBuffer> mUniformBuffer;
+    uint32_t mOffset;
+    uint32_t mSize;
+public:
+    inline BindAndDrawCommand(size_t index, Handle<HwUniformBuffer> ubh,
+            uint32_t offset, uint32_t size,
+            PipelineState const& state, Handle<HwRenderPrimitive> rph) noexcept
+            : CommandBase(Opcode::bindUniformBufferRangeAndDraw), mIndex(uint8_t(index)),
+              mState(state), mPrimitive(rph), mUniformBuffer(ubh), mOffset(offset), mSize(size) {
+        assert(index <= std::numeric_limits<uint8_t>::max());
+    }
 };
 
+static_assert(std::is_trivially_destructible<BindAndDrawCommand>::value,
+        "BindAndDrawCommand's destructor is never called");
+
 // ------------------------------------------------------------------------------------------------
 
 #if defined(NDEBUG)
@@ -228,7 +289,7 @@ public:
         DEBUG_COMMAND(methodName, params);                                                      \
         using Cmd = COMMAND_TYPE(methodName);                                                   \
         void* const p = allocateCommand(CommandBase::align(sizeof(Cmd)));                       \
-        new(p) Cmd(mDispatcher->methodName##_, params);                                         \
+        new(p) Cmd(Dispatcher::Opcode::methodName, params);                                     \
     }
 
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)                    \
@@ -243,7 +304,7 @@ public:
         RetType result = mDriver->methodName##S();                                              \
         using Cmd = COMMAND_TYPE(methodName##R);                                                \
         void* const p = allocateCommand(CommandBase::align(sizeof(Cmd)));                       \
-        new(p) Cmd(mDispatcher->methodName##_, RetType(result), params);                        \
+        new(p) Cmd(Dispatcher::Opcode::methodName, RetType(result), params);                    \
         return result;                                                                          \
     }
 
@@ -253,6 +314,18 @@ public:
     CommandStream() noexcept = default;
     CommandStream(Driver& driver, CircularBuffer& buffer) noexcept;
 
+    /*
+     * Creates a CommandStream recording into 'segment' instead of rhs's buffer, the commands
+     * recorded can later be appended to rhs with splice(). This allows several threads to
+     * record commands in parallel, each into its own segment.
+     * The CommandStream is bound to the calling thread.
+     *
+     * IMPORTANT: the segment is relocated by splice(), so only commands that can be moved
+     * with a memcpy can be recorded into it, which excludes queueCommand() and all commands
+     * taking a BufferDescriptor. 'segment' must be aligned to CommandBase::align().
+     */
+    CommandStream(CommandStream const& rhs, CircularBuffer& segment) noexcept;
+
     // This is for debugging only. Currently CircularBuffer can only be written from a
     // single thread. In debug builds we assert this condition.
     // Call this first in the render loop.
@@ -264,12 +337,31 @@ public:
 
     void execute(void* buffer);
 
+    /*
+     * Equivalent to bindUniformBufferRange() followed by draw(), recorded as a single command
+     * (see BindAndDrawCommand). 'index' must fit in 8 bits.
+     */
+    inline void bindUniformBufferRangeAndDraw(size_t index, Handle<HwUniformBuffer> ubh,
+            uint32_t offset, uint32_t size,
+            PipelineState const& state, Handle<HwRenderPrimitive> rph) {
+        DEBUG_COMMAND(bindUniformBufferRange, index, ubh, offset, size);
+        DEBUG_COMMAND(draw, state, rph);
+        void* const p = allocateCommand(CommandBase::align(sizeof(BindAndDrawCommand)));
+        new(p) BindAndDrawCommand(index, ubh, offset, size, state, rph);
+    }
+
     /*
      * queueCommand() allows to queue a lambda function as a command.
      * This is much less efficient than using the Driver* API.
      */
     void queueCommand(std::function<void()> command);
 
+    /*
+     * Appends the commands recorded into a segment (see above) to this stream, that is
+     * [segment.getTail(), segment.getHead()) at the end of the recording.
+     */
+    void splice(void const* begin, void const* end) noexcept;
+
     /*
      * Allocates memory associated to the current CommandStreamBuffer.
      * This memory will be automatically freed after this command buffer is processed.
@@ -286,8 +378,7 @@ public:
             size_t count = 1, size_t alignment = alignof(PodType)) noexcept;
 
 private:
-    // Dispatcher could be a value (instead of pointer), which saves a load when writing commands
-    // at the expense of a larger CommandStream object (about ~400 bytes)
+    // only needed to execute the commands, which only store their Opcode
     Dispatcher* mDispatcher = nullptr;
     Driver* mDriver = nullptr;
     CircularBuffer* UTILS_RESTRICT mCurrentBuffer = nullptr;
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_COMMANDSTREAMCAPTURE_H
+#define TNT_FILAMENT_DRIVER_COMMANDSTREAMCAPTURE_H
+
+#include "private/backend/CommandStream.h"
+
+#include <backend/Handle.h>
+
+#include <utils/compiler.h>
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace filament {
+namespace backend {
+
+/*
+ * Records the commands of a CommandStream, with their arguments and the content of their
+ * buffers, into a binary file that CommandStreamReplay can play back into any Driver.
+ *
+ * Only the commands that go through the command buffers are recorded, that is, not the
+ * synchronous driver calls. Custom commands (see CommandStream::queueCommand()) can't be
+ * recorded and are skipped, and pointers to native objects (windows, external images, user
+ * data) are recorded as null.
+ *
+ * The file stores the arguments in the layout of the capturing platform, so it must be played
+ * back on a platform with the same ABI.
+ */
+class CommandStreamCapture {
+public:
+    // Captures into the file at 'path' until 'frameCount' frames have ended (i.e. endFrame()
+    // was executed 'frameCount' times), isValid() returns false if the file couldn't be opened.
+    CommandStreamCapture(const char* path, uint32_t frameCount) noexcept;
+
+    CommandStreamCapture(CommandStreamCapture const& rhs) = delete;
+    CommandStreamCapture& operator=(CommandStreamCapture const& rhs) = delete;
+
+    ~CommandStreamCapture() noexcept;
+
+    bool isValid() const noexcept { return mFile != nullptr; }
+
+    // Records the commands of 'buffer', this must be called before the buffer is executed.
+    // Returns false once all the frames are captured, the capture can then be destroyed.
+    bool capture(void const* buffer) noexcept;
+
+private:
+    class Writer;
+    using CaptureCommand = size_t(*)(Writer& writer, CommandBase const* base);
+
+    struct CommandInfo {
+        uint8_t id = 0;
+        CaptureCommand capture = nullptr;
+    };
+
+    template<typename Cmd>
+    static size_t captureCommand(Writer& writer, CommandBase const* base) noexcept;
+
+    FILE* mFile = nullptr;
+    std::vector<uint8_t> mData;
+    CommandInfo mCommands[size_t(Dispatcher::Opcode::COUNT)];
+    uint32_t mFrameCount;
+    uint32_t mFramesCaptured = 0;
+    uint32_t mSkippedCount = 0;
+};
+
+/*
+ * Plays back a file recorded by CommandStreamCapture into a Driver, through a CommandStream,
+ * i.e. the commands are dispatched exactly like they were when the file was captured.
+ *
+ * The handles created by the played back commands are substituted to the captured ones, and
+ * swap chains are created headless since there is no window to render into.
+ */
+class CommandStreamReplay {
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct FrameStats {
+        clock::duration decode{};       // time spent recording the commands into the stream
+        clock::duration execute{};      // time spent executing the commands
+        size_t commandCount = 0;
+    };
+
+    // Loads the file at 'path', isValid() returns false if it isn't a valid capture.
+    explicit CommandStreamReplay(const char* path) noexcept;
+
+    CommandStreamReplay(CommandStreamReplay const& rhs) = delete;
+    CommandStreamReplay& operator=(CommandStreamReplay const& rhs) = delete;
+
+    ~CommandStreamReplay() noexcept;
+
+    bool isValid() const noexcept { return mValid; }
+
+    // number of frames in the capture, the commands before the first frame are part of it
+    size_t getFrameCount() const noexcept { return mFrameCount; }
+
+    // size of the swap chains created by replay()
+    void setSwapChainSize(uint32_t width, uint32_t height) noexcept {
+        mSwapChainWidth = width;
+        mSwapChainHeight = height;
+    }
+
+    // Plays all the captured commands back into 'driver', from the calling thread, which must
+    // be allowed to call into the driver. Appends the statistics of each frame to 'stats'.
+    // Returns false if the capture is truncated, in which case it's played back partially.
+    bool replay(Driver& driver, std::vector<FrameStats>* stats = nullptr);
+
+private:
+    class Reader;
+
+    // commands are executed at the end of each frame, or when this much of the command buffer
+    // is used, which leaves enough room for any command
+    static constexpr size_t COMMAND_BUFFER_SIZE = 1024 * 1024;
+    static constexpr size_t COMMAND_BUFFER_FLUSH_SIZE = COMMAND_BUFFER_SIZE - 4096;
+
+    // records the next command into 'stream', returns false if the capture is truncated
+    bool replayCommand(Reader& reader, CommandStream& stream, bool& endOfFrame);
+
+    template<typename RetType, typename ... ARGS>
+    void replayCommand(Reader& reader, CommandStream& stream,
+            RetType (CommandStream::*method)(ARGS...));
+
+    template<typename ... ARGS>
+    void replayCommand(Reader& reader, CommandStream& stream,
+            void (CommandStream::*method)(ARGS...));
+
+    // createSwapChain() is played back with createSwapChainHeadless()
+    void replayCommand(Reader& reader, CommandStream& stream,
+            SwapChainHandle (CommandStream::*method)(void*, uint64_t));
+
+    // bindUniformBufferRange() followed by draw() is played back as a single command, like
+    // the engine records them
+    void replayCommand(Reader& reader, CommandStream& stream,
+            void (CommandStream::*method)(size_t, UniformBufferHandle, size_t, size_t));
+
+    std::vector<uint8_t> mData;
+    size_t mFrameCount = 0;
+    bool mValid = false;
+    uint32_t mSwapChainWidth = 1920;
+    uint32_t mSwapChainHeight = 1080;
+
+    // captured handle id to played back handle id
+    std::unordered_map<HandleBase::HandleId, HandleBase::HandleId> mHandles;
+    // strings referenced by the commands, they must outlive them
+    std::deque<std::string> mStrings;
+};
+
+} // namespace backend
+} // namespace filament
+
+#endif // TNT_FILAMENT_DRIVER_COMMANDSTREAMCAPTURE_H
@@ -37,6 +37,10 @@
 
 #include <stdint.h>
 
+namespace utils {
+class MemoryCounter;
+} // namespace utils
+
 namespace filament {
 namespace backend {
 
@@ -58,6 +62,10 @@ public:
 
     virtual Dispatcher& getDispatcher() noexcept = 0;
 
+    // called from the main thread before any handle is created, drivers that allocate their
+    // handles from an arena account them in 'counter'.
+    virtual void setHandleMemoryCounter(utils::MemoryCounter* counter) noexcept { }
+
     // called from CommandStream::execute on the render-thread
     // the fn function will execute a batch of driver commands
     // this gives the driver a chance to wrap their execution in a meaningful manner
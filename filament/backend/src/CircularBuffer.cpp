@@ -35,15 +35,21 @@ using namespace utils;
 namespace filament {
 namespace backend {
 
-CircularBuffer::CircularBuffer(size_t size) {
-    mData = alloc(size);
+CircularBuffer::CircularBuffer(size_t size, MemoryBacking backing) {
+    mData = alloc(size, backing);
     mSize = size;
     mTail = mData;
     mHead = mData;
 }
 
+CircularBuffer::CircularBuffer(void* data, size_t size) noexcept
+        : mData(data), mOwnsData(false), mSize(size), mTail(data), mHead(data) {
+}
+
 CircularBuffer::~CircularBuffer() noexcept {
-    dealloc();
+    if (mOwnsData) {
+        dealloc();
+    }
 }
 
 // If the system support mmap(), use it for creating a "hard circular buffer" where two virtual
@@ -54,8 +60,12 @@ CircularBuffer::~CircularBuffer() noexcept {
 //
 // If the system does not support mmap, emulate soft circular buffer with two buffers next
 // to each others and a special case in circularize()
+//
+// In both mmap modes, huge pages and pre-faulting are applied with madvise() on the existing
+// mappings, so that the address space layout needed by the hard circular buffer is kept.
+// Only the first copy of the hard circular buffer is pre-faulted, because its pages are private.
 
-void* CircularBuffer::alloc(size_t size) noexcept {
+void* CircularBuffer::alloc(size_t size, MemoryBacking backing) noexcept {
 #if HAS_MMAP
     void* data = nullptr;
     void* vaddr = MAP_FAILED;
@@ -82,6 +92,7 @@ void* CircularBuffer::alloc(size_t size) noexcept {
                         // woo-hoo success!
                         mUsesAshmem = fd;
                         data = vaddr;
+                        HeapArea::advise(vaddr, size, backing);
                     }
                 }
             }
@@ -119,6 +130,8 @@ void* CircularBuffer::alloc(size_t size) noexcept {
         // guard page at the end
         void* guard = (void*)(uintptr_t(data) + size * 2);
         mprotect(guard, BLOCK_SIZE, PROT_NONE);
+
+        HeapArea::advise(data, size * 2, backing);
     }
     return data;
 #else
@@ -143,6 +156,7 @@ void CircularBuffer::dealloc() noexcept {
 
 
 void CircularBuffer::circularize() noexcept {
+    assert(mOwnsData);
     if (mUsesAshmem > 0) {
         intptr_t overflow = intptr_t(mHead) - (intptr_t(mData) + ssize_t(mSize));
         if (overflow >= 0) {
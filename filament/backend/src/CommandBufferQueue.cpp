@@ -23,26 +23,118 @@
 
 #include "private/backend/CommandStream.h"
 
+#include <algorithm>
+#include <chrono>
+
 using namespace utils;
 
 namespace filament {
 namespace backend {
 
-CommandBufferQueue::CommandBufferQueue(size_t requiredSize, size_t bufferSize)
+CommandBufferQueue::CommandBufferQueue(size_t requiredSize, size_t bufferSize,
+        MemoryBacking backing)
         : mRequiredSize((requiredSize + CircularBuffer::BLOCK_MASK) & ~CircularBuffer::BLOCK_MASK),
-          mCircularBuffer(bufferSize),
+          mCircularBuffer(bufferSize, backing),
           mFreeSpace(mCircularBuffer.size()) {
     assert(mCircularBuffer.size() > requiredSize);
+    static_assert((SLICE_COUNT & (SLICE_COUNT - 1)) == 0, "SLICE_COUNT must be a power of two");
 }
 
 CommandBufferQueue::~CommandBufferQueue() {
-    assert(mCommandBuffersToExecute.empty());
+    assert(mHead.load(std::memory_order_relaxed) == mTail.load(std::memory_order_relaxed));
+}
+
+template<typename PREDICATE>
+void CommandBufferQueue::wait(std::atomic<bool>& parked, Condition& condition,
+        StallCounter& stalls, PREDICATE predicate) const noexcept {
+    if (UTILS_LIKELY(predicate())) {
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // the other thread is usually about to make progress, so it's cheaper to spin for a while
+    // than to park right away.
+    bool ready = false;
+    for (uint32_t i = 0; i < SPIN_COUNT && !ready; i++) {
+        UTILS_PAUSE();
+        ready = predicate();
+    }
+
+    if (!ready) {
+        std::unique_lock<Mutex> lock(mLock);
+        parked.store(true, std::memory_order_relaxed);
+        // pairs with the fence in wake(): either we see the other thread's progress, or it sees
+        // that we're parked.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!predicate()) {
+            condition.wait(lock);
+        }
+        parked.store(false, std::memory_order_relaxed);
+    }
+
+    const auto duration = std::chrono::steady_clock::now() - start;
+    stalls.count.fetch_add(1, std::memory_order_relaxed);
+    stalls.time.fetch_add(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            duration).count()), std::memory_order_relaxed);
+}
+
+void CommandBufferQueue::wake(std::atomic<bool> const& parked,
+        Condition& condition) const noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (UTILS_UNLIKELY(parked.load(std::memory_order_relaxed))) {
+        // taking the lock guarantees the other thread is waiting on the condition
+        std::lock_guard<Mutex> lock(mLock);
+        condition.notify_one();
+    }
+}
+
+CommandBufferQueue::Stats CommandBufferQueue::getStats() const noexcept {
+    return {
+            mProducerStalls.count.load(std::memory_order_relaxed),
+            mProducerStalls.time.load(std::memory_order_relaxed),
+            mConsumerStalls.count.load(std::memory_order_relaxed),
+            mConsumerStalls.time.load(std::memory_order_relaxed)
+    };
 }
 
 void CommandBufferQueue::requestExit() {
-    std::unique_lock<utils::Mutex> lock(mLock);
-    mExitRequested = true;
-    mCondition.notify_one();
+    mExitRequested.store(true, std::memory_order_release);
+    wake(mConsumerParked, mConsumerCondition);
+}
+
+void CommandBufferQueue::attachSource(CommandBufferQueue* source) {
+    assert(!source->mSink);
+    source->mSink = this;
+    std::lock_guard<Mutex> lock(mSourcesLock);
+    mSources.push_back(source);
+}
+
+void CommandBufferQueue::detachSource(CommandBufferQueue* source) {
+    assert(source->mSink == this);
+    std::lock_guard<Mutex> lock(mSourcesLock);
+    mSources.erase(std::find(mSources.begin(), mSources.end(), source));
+    source->mSink = nullptr;
+}
+
+void CommandBufferQueue::notifyConsumer() noexcept {
+    CommandBufferQueue* const sink = mSink;
+    if (UTILS_LIKELY(!sink)) {
+        wake(mConsumerParked, mConsumerCondition);
+    } else {
+        sink->mSourcesFlushCount.fetch_add(1, std::memory_order_release);
+        sink->wake(sink->mConsumerParked, sink->mConsumerCondition);
+    }
+}
+
+void CommandBufferQueue::drain(std::vector<Slice>& buffers, uint32_t head) const noexcept {
+    uint32_t tail = mTail.load(std::memory_order_relaxed);
+    for ( ; tail != head; tail++) {
+        buffers.push_back(mSlices[tail & (SLICE_COUNT - 1)]);
+    }
+    // the slots can be reused as soon as they're copied
+    mTail.store(tail, std::memory_order_release);
+    wake(mProducerParked, mProducerCondition);
 }
 
 void CommandBufferQueue::flush() noexcept {
@@ -68,18 +160,30 @@ void CommandBufferQueue::flush() noexcept {
 
     circularBuffer.circularize();
 
-    std::unique_lock<utils::Mutex> lock(mLock);
-    mCommandBuffersToExecute.push_back({ tail, head });
+    // the space must be taken before the slice is visible to the consumer, which gives it back
+    UTILS_UNUSED_IN_RELEASE size_t const freeSpace =
+            mFreeSpace.fetch_sub(used, std::memory_order_relaxed);
 
     // circular buffer is too small, we corrupted the stream
-    assert(used <= mFreeSpace);
+    assert(used <= freeSpace);
+
+    const uint32_t index = mHead.load(std::memory_order_relaxed);
+    if (UTILS_UNLIKELY(index - mTail.load(std::memory_order_acquire) == SLICE_COUNT)) {
+        // too many command buffers in flight (that's rare, they're usually large)
+        SYSTRACE_NAME("waiting: CommandBufferQueue::flush()");
+        wait(mProducerParked, mProducerCondition, mProducerStalls, [this, index]() {
+            return index - mTail.load(std::memory_order_acquire) < SLICE_COUNT;
+        });
+    }
+    mSlices[index & (SLICE_COUNT - 1)] = { tail, head, this };
+    mHead.store(index + 1, std::memory_order_release);
+    notifyConsumer();
 
     // wait until there is enough space in the buffer
-    mFreeSpace -= used;
     const size_t requiredSize = mRequiredSize;
 
 #ifndef NDEBUG
-    size_t totalUsed = circularBuffer.size() - mFreeSpace;
+    size_t totalUsed = circularBuffer.size() - mFreeSpace.load(std::memory_order_relaxed);
     mHighWatermark = std::max(mHighWatermark, totalUsed);
     if (UTILS_UNLIKELY(totalUsed > requiredSize)) {
         slog.d << "CommandStream used too much space: " << totalUsed
@@ -87,37 +191,57 @@ void CommandBufferQueue::flush() noexcept {
     }
 #endif
 
-    if (UTILS_LIKELY(mFreeSpace >= requiredSize)) {
-        // ideally (and usually) we don't have to wait, this is the common case, so special case
-        // the unlock-before-notify, optimization.
-        lock.unlock();
-        mCondition.notify_one();
-    } else {
+    if (UTILS_UNLIKELY(mFreeSpace.load(std::memory_order_acquire) < requiredSize)) {
         // unfortunately, there is not enough space left, we'll have to wait.
-        mCondition.notify_one(); // too bad there isn't a notify-and-wait
         SYSTRACE_NAME("waiting: CircularBuffer::flush()");
-        mCondition.wait(lock, [this, requiredSize]() -> bool {
-            return mFreeSpace >= requiredSize;
+        wait(mProducerParked, mProducerCondition, mProducerStalls, [this, requiredSize]() {
+            return mFreeSpace.load(std::memory_order_acquire) >= requiredSize;
         });
     }
 }
 
 std::vector<CommandBufferQueue::Slice> CommandBufferQueue::waitForCommands() const {
-    if (!UTILS_HAS_THREADING) {
-        return std::move(mCommandBuffersToExecute);
-    }
-    std::unique_lock<utils::Mutex> lock(mLock);
-    while (mCommandBuffersToExecute.empty() && !mExitRequested) {
-        mCondition.wait(lock);
-    }
-    return std::move(mCommandBuffersToExecute);
+    std::vector<Slice> buffers;
+    do {
+        const uint32_t tail = mTail.load(std::memory_order_relaxed);
+        const uint32_t drainedCount = mSourcesDrainedCount;
+        if (UTILS_HAS_THREADING) {
+            wait(mConsumerParked, mConsumerCondition, mConsumerStalls,
+                    [this, tail, drainedCount]() {
+                        return mHead.load(std::memory_order_acquire) != tail ||
+                               mSourcesFlushCount.load(std::memory_order_acquire) != drainedCount ||
+                               mExitRequested.load(std::memory_order_acquire);
+                    });
+        }
+
+        // Our head must be read before the sources are drained: a command buffer flushed to a
+        // source before one of ours is then always returned first.
+        const uint32_t head = mHead.load(std::memory_order_acquire);
+
+        const uint32_t flushCount = mSourcesFlushCount.load(std::memory_order_acquire);
+        if (UTILS_UNLIKELY(flushCount != drainedCount)) {
+            mSourcesDrainedCount = flushCount;
+            std::lock_guard<Mutex> lock(mSourcesLock);
+            for (CommandBufferQueue const* source : mSources) {
+                source->drain(buffers, source->mHead.load(std::memory_order_acquire));
+            }
+        }
+
+        buffers.reserve(buffers.size() + head - tail);
+        drain(buffers, head);
+
+        // a source's command buffer may have been returned already, by the previous call
+    } while (UTILS_HAS_THREADING && buffers.empty() &&
+             !mExitRequested.load(std::memory_order_acquire));
+    return buffers;
 }
 
 void CommandBufferQueue::releaseBuffer(CommandBufferQueue::Slice const& buffer) {
-    std::unique_lock<utils::Mutex> lock(mLock);
-    mFreeSpace += uintptr_t(buffer.end) - uintptr_t(buffer.begin);
-    lock.unlock();
-    mCondition.notify_one();
+    // the command buffer may come from one of our sources
+    CommandBufferQueue* const owner = buffer.owner;
+    owner->mFreeSpace.fetch_add(uintptr_t(buffer.end) - uintptr_t(buffer.begin),
+            std::memory_order_release);
+    owner->wake(owner->mProducerParked, owner->mProducerCondition);
 }
 
 } // namespace backend
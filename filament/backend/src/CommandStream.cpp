@@ -23,6 +23,8 @@
 
 #include <functional>
 
+#include <string.h>
+
 using namespace utils;
 
 namespace filament {
@@ -52,6 +54,14 @@ static UTILS_NOINLINE UTILS_UNUSED std::string extractMethodName(std::string& co
 
 // ------------------------------------------------------------------------------------------------
 
+Dispatcher::Dispatcher() noexcept {
+    // the driver's commands are set by ConcreteDispatcher
+    mExecute[size_t(Opcode::noop)] = &NoopCommand::execute;
+    mExecute[size_t(Opcode::custom)] = &CustomCommand::execute;
+}
+
+// ------------------------------------------------------------------------------------------------
+
 CommandStream::CommandStream(Driver& driver, CircularBuffer& buffer) noexcept
         : mDispatcher(&driver.getDispatcher()),
           mDriver(&driver),
@@ -62,6 +72,17 @@ CommandStream::CommandStream(Driver& driver, CircularBuffer& buffer) noexcept
 {
 }
 
+CommandStream::CommandStream(CommandStream const& rhs, CircularBuffer& segment) noexcept
+        : mDispatcher(rhs.mDispatcher),
+          mDriver(rhs.mDriver),
+          mCurrentBuffer(&segment)
+#ifndef NDEBUG
+          , mThreadId(std::this_thread::get_id())
+#endif
+{
+    assert(CommandBase::align(uintptr_t(segment.getHead())) == uintptr_t(segment.getHead()));
+}
+
 void CommandStream::execute(void* buffer) {
     SYSTRACE_CALL();
 
@@ -75,9 +96,10 @@ void CommandStream::execute(void* buffer) {
 
     mDriver->execute([this, buffer]() {
         Driver& UTILS_RESTRICT driver = *mDriver;
+        Dispatcher const& UTILS_RESTRICT dispatcher = *mDispatcher;
         CommandBase* UTILS_RESTRICT base = static_cast<CommandBase*>(buffer);
         while (UTILS_LIKELY(base)) {
-            base = base->execute(driver);
+            base = base->execute(driver, dispatcher);
         }
     });
 
@@ -100,6 +122,16 @@ void CommandStream::queueCommand(std::function<void()> command) {
     new(allocateCommand(CustomCommand::align(sizeof(CustomCommand)))) CustomCommand(std::move(command));
 }
 
+void CommandStream::splice(void const* begin, void const* end) noexcept {
+    // Commands store the offset to the next command, rather than its address, so a segment
+    // can be moved as a whole.
+    const size_t size = uintptr_t(end) - uintptr_t(begin);
+    assert(CommandBase::align(size) == size);
+    if (size) {
+        memcpy(allocateCommand(size), begin, size);
+    }
+}
+
 template<typename... ARGS>
 template<void (Driver::*METHOD)(ARGS...)>
 template<std::size_t... I>
@@ -0,0 +1,612 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/backend/CommandStreamCapture.h"
+
+#include "private/backend/CircularBuffer.h"
+
+#include <utils/CString.h>
+#include <utils/Log.h>
+
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace utils;
+
+namespace filament {
+namespace backend {
+
+namespace {
+
+// the commands are identified by their index in DriverAPI.inc, which doesn't change with the
+// commands that only exist in the CommandStream (see Dispatcher::Opcode)
+enum class CommandId : uint8_t {
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                     methodName,
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)     methodName,
+#include "private/backend/DriverAPI.inc"
+    COUNT
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t frameCount;
+    uint8_t pointerSize;
+    uint8_t commandCount;
+    uint16_t reserved;
+};
+
+constexpr char MAGIC[8] = { 'F', 'C', 'M', 'D', 'S', 'T', 'R', 'M' };
+constexpr uint32_t VERSION = 1;
+
+template<typename T>
+struct Tag { };
+
+// types that are stored as-is
+template<typename T>
+using is_raw = std::integral_constant<bool, std::is_trivially_copyable<T>::value &&
+        !std::is_pointer<T>::value && !std::is_base_of<HandleBase, T>::value>;
+
+} // anonymous namespace
+
+// ------------------------------------------------------------------------------------------------
+
+class CommandStreamCapture::Writer {
+public:
+    explicit Writer(std::vector<uint8_t>& data) noexcept : mData(data) { }
+
+    void write(void const* data, size_t size) {
+        uint8_t const* const p = static_cast<uint8_t const*>(data);
+        mData.insert(mData.end(), p, p + size);
+    }
+
+    template<typename T, typename = std::enable_if_t<is_raw<T>::value>>
+    void operator()(T const& value) {
+        write(&value, sizeof(T));
+    }
+
+    // pointers to native objects or to user data are meaningless in a capture
+    template<typename T>
+    void operator()(T*) { }
+
+    void operator()(const char* string) {
+        const uint32_t length = string ? uint32_t(strlen(string)) : 0;
+        (*this)(length);
+        write(string, length);
+    }
+
+    void operator()(CString const& string) {
+        (*this)(uint32_t(string.size()));
+        write(string.c_str_safe(), string.size());
+    }
+
+    void operator()(HandleBase const& handle) {
+        (*this)(handle.getId());
+    }
+
+    void operator()(BufferDescriptor const& buffer) {
+        const uint64_t size = buffer.buffer ? buffer.size : 0;
+        (*this)(size);
+        write(buffer.buffer, size);
+    }
+
+    void operator()(PixelBufferDescriptor const& buffer) {
+        (*this)(static_cast<BufferDescriptor const&>(buffer));
+        (*this)(buffer.left);
+        (*this)(buffer.top);
+        (*this)(PixelDataType(buffer.type));
+        (*this)(uint8_t(buffer.alignment));
+        if (buffer.type == PixelDataType::COMPRESSED) {
+            (*this)(buffer.imageSize);
+            (*this)(buffer.compressedFormat);
+        } else {
+            (*this)(buffer.stride);
+            (*this)(buffer.format);
+        }
+    }
+
+    void operator()(FaceOffsets const& offsets) {
+        write(offsets.offsets, sizeof(offsets.offsets));
+    }
+
+    void operator()(PipelineState const& state) {
+        (*this)(state.program);
+        (*this)(state.rasterState);
+        (*this)(state.polygonOffset);
+        (*this)(state.scissor);
+    }
+
+    void operator()(TargetBufferInfo const& info) {
+        (*this)(info.handle);
+        (*this)(info.level);
+        (*this)(info.layer);
+    }
+
+    void operator()(SamplerGroup const& group) {
+        (*this)(uint32_t(group.getSize()));
+        for (size_t i = 0, c = group.getSize(); i < c; i++) {
+            (*this)(group.getSamplers()[i].t);
+            (*this)(group.getSamplers()[i].s);
+        }
+    }
+
+    void operator()(Program const& program) {
+        (*this)(program.getName());
+        (*this)(program.getVariant());
+        for (auto const& source : program.getShadersSource()) {
+            (*this)(uint32_t(source.size()));
+            write(source.data(), source.size());
+        }
+        for (CString const& name : program.getUniformBlockInfo()) {
+            (*this)(name);
+        }
+        (*this)(program.hasSamplers());
+        if (program.hasSamplers()) {
+            for (auto const& samplers : program.getSamplerGroupInfo()) {
+                (*this)(uint32_t(samplers.size()));
+                for (Program::Sampler const& sampler : samplers) {
+                    (*this)(sampler.name);
+                    (*this)(uint64_t(sampler.binding));
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<uint8_t>& mData;
+};
+
+template<typename W, typename T, size_t ... I>
+static void writeArguments(W& writer, T const& args, std::index_sequence<I...>) {
+    UTILS_UNUSED int unused[] = { 0, (writer(std::get<I>(args)), 0)... };
+}
+
+template<typename Cmd>
+size_t CommandStreamCapture::captureCommand(Writer& writer, CommandBase const* base) noexcept {
+    auto const& args = static_cast<Cmd const*>(base)->mArgs;
+    writeArguments(writer, args,
+            std::make_index_sequence<std::tuple_size<std::decay_t<decltype(args)>>::value>{});
+    return CommandBase::align(sizeof(Cmd));
+}
+
+CommandStreamCapture::CommandStreamCapture(const char* path, uint32_t frameCount) noexcept
+        : mFrameCount(frameCount) {
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+    mCommands[size_t(Dispatcher::Opcode::methodName)] = { uint8_t(CommandId::methodName),       \
+            &CommandStreamCapture::captureCommand<COMMAND_TYPE(methodName)> };
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+    mCommands[size_t(Dispatcher::Opcode::methodName)] = { uint8_t(CommandId::methodName),       \
+            &CommandStreamCapture::captureCommand<COMMAND_TYPE(methodName##R)> };
+#include "private/backend/DriverAPI.inc"
+
+    mFile = fopen(path, "wb");
+    if (!mFile) {
+        slog.e << "CommandStreamCapture: couldn't open " << path << io::endl;
+        return;
+    }
+
+    FileHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.pointerSize = uint8_t(sizeof(void*));
+    header.commandCount = uint8_t(CommandId::COUNT);
+    fwrite(&header, sizeof(header), 1, mFile);
+    slog.i << "Capturing " << frameCount << " frames of commands into " << path << io::endl;
+}
+
+CommandStreamCapture::~CommandStreamCapture() noexcept {
+    if (mFile) {
+        // the frame count is only known now
+        fseek(mFile, offsetof(FileHeader, frameCount), SEEK_SET);
+        fwrite(&mFramesCaptured, sizeof(mFramesCaptured), 1, mFile);
+        fclose(mFile);
+        slog.i << "Captured " << mFramesCaptured << " frames of commands";
+        if (mSkippedCount) {
+            slog.i << ", " << mSkippedCount << " custom commands were skipped";
+        }
+        slog.i << io::endl;
+    }
+}
+
+bool CommandStreamCapture::capture(void const* buffer) noexcept {
+    if (UTILS_UNLIKELY(!mFile || mFramesCaptured == mFrameCount)) {
+        return false;
+    }
+
+    Writer writer(mData);
+    CommandBase const* base = static_cast<CommandBase const*>(buffer);
+    while (base) {
+        const Dispatcher::Opcode opcode = base->mOpcode;
+        intptr_t next;
+        if (opcode == Dispatcher::Opcode::noop) {
+            next = static_cast<NoopCommand const*>(base)->mNext;
+        } else if (opcode == Dispatcher::Opcode::custom) {
+            next = CommandBase::align(sizeof(CustomCommand));
+            mSkippedCount++;
+        } else if (opcode == Dispatcher::Opcode::bindUniformBufferRangeAndDraw) {
+            // recorded as the two commands it stands for
+            BindAndDrawCommand const* command = static_cast<BindAndDrawCommand const*>(base);
+            writer(uint8_t(CommandId::bindUniformBufferRange));
+            writer(size_t(command->mIndex));
+            writer(command->mUniformBuffer);
+            writer(size_t(command->mOffset));
+            writer(size_t(command->mSize));
+            writer(uint8_t(CommandId::draw));
+            writer(command->mState);
+            writer(command->mPrimitive);
+            next = CommandBase::align(sizeof(BindAndDrawCommand));
+        } else {
+            CommandInfo const& info = mCommands[size_t(opcode)];
+            if (UTILS_UNLIKELY(!info.capture)) {
+                slog.e << "CommandStreamCapture: unknown command, capture stopped" << io::endl;
+                mFrameCount = mFramesCaptured;
+                break;
+            }
+            writer(info.id);
+            next = intptr_t(info.capture(writer, base));
+            if (opcode == Dispatcher::Opcode::endFrame && ++mFramesCaptured == mFrameCount) {
+                break;
+            }
+        }
+        base = reinterpret_cast<CommandBase const*>(intptr_t(base) + next);
+    }
+
+    fwrite(mData.data(), 1, mData.size(), mFile);
+    mData.clear();
+    return mFramesCaptured < mFrameCount;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+class CommandStreamReplay::Reader {
+public:
+    Reader(uint8_t const* data, size_t size, CommandStreamReplay& replay) noexcept
+            : mCurrent(data), mEnd(data + size), mReplay(replay) { }
+
+    bool empty() const noexcept { return mCurrent == mEnd; }
+
+    bool isTruncated() const noexcept { return mTruncated; }
+
+    // returns the next byte without reading it
+    uint8_t peek() const noexcept { return mCurrent != mEnd ? *mCurrent : 0xFF; }
+
+    void read(void* data, size_t size) noexcept {
+        if (UTILS_UNLIKELY(size_t(mEnd - mCurrent) < size)) {
+            memset(data, 0, size);
+            mCurrent = mEnd;
+            mTruncated = true;
+            return;
+        }
+        memcpy(data, mCurrent, size);
+        mCurrent += size;
+    }
+
+    template<typename T>
+    std::enable_if_t<is_raw<T>::value, T> get(Tag<T>) noexcept {
+        T value;
+        read(&value, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    T* get(Tag<T*>) noexcept {
+        return nullptr;
+    }
+
+    const char* get(Tag<const char*>) {
+        mReplay.mStrings.emplace_back(get(Tag<uint32_t>{}), '\0');
+        std::string& string = mReplay.mStrings.back();
+        read(&string[0], string.size());
+        return string.c_str();
+    }
+
+    CString get(Tag<CString>) {
+        const uint32_t length = get(Tag<uint32_t>{});
+        if (UTILS_UNLIKELY(size_t(mEnd - mCurrent) < length)) {
+            mCurrent = mEnd;
+            mTruncated = true;
+            return {};
+        }
+        CString string(reinterpret_cast<const char*>(mCurrent), length);
+        mCurrent += length;
+        return string;
+    }
+
+    // returns the id of the handle created by the played back command
+    HandleBase::HandleId getId() noexcept {
+        return get(Tag<HandleBase::HandleId>{});
+    }
+
+    template<typename T>
+    Handle<T> get(Tag<Handle<T>>) noexcept {
+        const HandleBase::HandleId id = getId();
+        if (id == HandleBase::nullid) {
+            return {};
+        }
+        auto const pos = mReplay.mHandles.find(id);
+        return Handle<T>(pos != mReplay.mHandles.end() ? pos->second : id);
+    }
+
+    BufferDescriptor get(Tag<BufferDescriptor>) {
+        const size_t size = size_t(get(Tag<uint64_t>{}));
+        if (!size) {
+            return {};
+        }
+        void* const data = malloc(size);
+        read(data, size);
+        return { data, size, [](void* buffer, size_t, void*) { free(buffer); }};
+    }
+
+    PixelBufferDescriptor get(Tag<PixelBufferDescriptor>) {
+        BufferDescriptor buffer = get(Tag<BufferDescriptor>{});
+        const uint32_t left = get(Tag<uint32_t>{});
+        const uint32_t top = get(Tag<uint32_t>{});
+        const PixelDataType type = get(Tag<PixelDataType>{});
+        const uint8_t alignment = get(Tag<uint8_t>{});
+        // the descriptor takes over the buffer and its callback
+        void const* const data = buffer.buffer;
+        const size_t size = buffer.size;
+        buffer.buffer = nullptr;
+        if (type == PixelDataType::COMPRESSED) {
+            const uint32_t imageSize = get(Tag<uint32_t>{});
+            const CompressedPixelDataType format = get(Tag<CompressedPixelDataType>{});
+            PixelBufferDescriptor result(data, size, format, imageSize, buffer.getCallback());
+            result.left = left;
+            result.top = top;
+            return result;
+        }
+        const uint32_t stride = get(Tag<uint32_t>{});
+        const PixelDataFormat format = get(Tag<PixelDataFormat>{});
+        return { data, size, format, type, alignment, left, top, stride, buffer.getCallback() };
+    }
+
+    FaceOffsets get(Tag<FaceOffsets>) noexcept {
+        FaceOffsets offsets;
+        read(offsets.offsets, sizeof(offsets.offsets));
+        return offsets;
+    }
+
+    PipelineState get(Tag<PipelineState>) noexcept {
+        PipelineState state;
+        state.program = get(Tag<Handle<HwProgram>>{});
+        state.rasterState = get(Tag<RasterState>{});
+        state.polygonOffset = get(Tag<PolygonOffset>{});
+        state.scissor = get(Tag<Viewport>{});
+        return state;
+    }
+
+    TargetBufferInfo get(Tag<TargetBufferInfo>) noexcept {
+        TargetBufferInfo info(get(Tag<Handle<HwTexture>>{}));
+        info.level = get(Tag<uint8_t>{});
+        info.layer = get(Tag<uint16_t>{});
+        return info;
+    }
+
+    SamplerGroup get(Tag<SamplerGroup>) noexcept {
+        const uint32_t count = get(Tag<uint32_t>{});
+        SamplerGroup group(count);
+        for (uint32_t i = 0; i < count && !mTruncated; i++) {
+            Handle<HwTexture> texture = get(Tag<Handle<HwTexture>>{});
+            group.setSampler(i, { texture, get(Tag<SamplerParams>{}) });
+        }
+        return group;
+    }
+
+    Program get(Tag<Program>) {
+        Program program;
+        CString name = get(Tag<CString>{});
+        program.diagnostics(std::move(name), get(Tag<uint8_t>{}));
+        for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+            const uint32_t size = get(Tag<uint32_t>{});
+            if (UTILS_UNLIKELY(size_t(mEnd - mCurrent) < size)) {
+                mCurrent = mEnd;
+                mTruncated = true;
+                return program;
+            }
+            program.shader(Program::Shader(i), mCurrent, size);
+            mCurrent += size;
+        }
+        for (size_t i = 0; i < Program::UNIFORM_BINDING_COUNT; i++) {
+            program.setUniformBlock(i, get(Tag<CString>{}));
+        }
+        if (get(Tag<bool>{})) {
+            std::vector<Program::Sampler> samplers;
+            for (size_t i = 0; i < Program::SAMPLER_BINDING_COUNT && !mTruncated; i++) {
+                samplers.resize(get(Tag<uint32_t>{}));
+                for (Program::Sampler& sampler : samplers) {
+                    sampler.name = get(Tag<CString>{});
+                    sampler.binding = size_t(get(Tag<uint64_t>{}));
+                }
+                program.setSamplerGroup(i, samplers.data(), samplers.size());
+            }
+        }
+        return program;
+    }
+
+private:
+    uint8_t const* mCurrent;
+    uint8_t const* const mEnd;
+    CommandStreamReplay& mReplay;
+    bool mTruncated = false;
+};
+
+CommandStreamReplay::CommandStreamReplay(const char* path) noexcept {
+    FILE* const file = fopen(path, "rb");
+    if (!file) {
+        slog.e << "CommandStreamReplay: couldn't open " << path << io::endl;
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size >= long(sizeof(FileHeader))) {
+        mData.resize(size_t(size));
+        mData.resize(fread(mData.data(), 1, mData.size(), file));
+    }
+    fclose(file);
+
+    FileHeader header{};
+    if (mData.size() >= sizeof(header)) {
+        memcpy(&header, mData.data(), sizeof(header));
+    }
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+        slog.e << "CommandStreamReplay: " << path << " isn't a command stream capture"
+               << io::endl;
+        return;
+    }
+    if (header.pointerSize != sizeof(void*) || header.commandCount != uint8_t(CommandId::COUNT)) {
+        slog.e << "CommandStreamReplay: " << path
+               << " was captured on a different platform or version" << io::endl;
+        return;
+    }
+    mFrameCount = header.frameCount;
+    mValid = true;
+}
+
+CommandStreamReplay::~CommandStreamReplay() noexcept = default;
+
+template<typename RetType, typename ... ARGS>
+void CommandStreamReplay::replayCommand(Reader& reader, CommandStream& stream,
+        RetType (CommandStream::*method)(ARGS...)) {
+    // the handle created by the captured command comes first
+    const HandleBase::HandleId captured = reader.getId();
+    // the arguments must be read in order, which is only guaranteed in a braced-init-list
+    std::tuple<std::decay_t<ARGS>...> args{ reader.get(Tag<std::decay_t<ARGS>>{})... };
+    if (UTILS_LIKELY(!reader.isTruncated())) {
+        RetType handle = apply(method, stream, std::move(args));
+        mHandles[captured] = handle.getId();
+    }
+}
+
+template<typename ... ARGS>
+void CommandStreamReplay::replayCommand(Reader& reader, CommandStream& stream,
+        void (CommandStream::*method)(ARGS...)) {
+    std::tuple<std::decay_t<ARGS>...> args{ reader.get(Tag<std::decay_t<ARGS>>{})... };
+    if (UTILS_LIKELY(!reader.isTruncated())) {
+        apply(method, stream, std::move(args));
+    }
+}
+
+void CommandStreamReplay::replayCommand(Reader& reader, CommandStream& stream,
+        SwapChainHandle (CommandStream::*)(void*, uint64_t)) {
+    // there is no window to render into
+    const HandleBase::HandleId captured = reader.getId();
+    reader.get(Tag<void*>{});
+    const uint64_t flags = reader.get(Tag<uint64_t>{});
+    if (UTILS_LIKELY(!reader.isTruncated())) {
+        SwapChainHandle sch = stream.createSwapChainHeadless(
+                mSwapChainWidth, mSwapChainHeight, flags);
+        mHandles[captured] = sch.getId();
+    }
+}
+
+void CommandStreamReplay::replayCommand(Reader& reader, CommandStream& stream,
+        void (CommandStream::*)(size_t, UniformBufferHandle, size_t, size_t)) {
+    const size_t index = reader.get(Tag<size_t>{});
+    UniformBufferHandle ubh = reader.get(Tag<UniformBufferHandle>{});
+    const size_t offset = reader.get(Tag<size_t>{});
+    const size_t size = reader.get(Tag<size_t>{});
+    if (UTILS_UNLIKELY(reader.isTruncated())) {
+        return;
+    }
+    if (reader.peek() == uint8_t(CommandId::draw) &&
+            index <= std::numeric_limits<uint8_t>::max() &&
+            offset <= std::numeric_limits<uint32_t>::max() &&
+            size <= std::numeric_limits<uint32_t>::max()) {
+        reader.get(Tag<uint8_t>{});
+        PipelineState state = reader.get(Tag<PipelineState>{});
+        RenderPrimitiveHandle rph = reader.get(Tag<RenderPrimitiveHandle>{});
+        if (UTILS_LIKELY(!reader.isTruncated())) {
+            stream.bindUniformBufferRangeAndDraw(index, ubh, uint32_t(offset), uint32_t(size),
+                    state, rph);
+        }
+        return;
+    }
+    stream.bindUniformBufferRange(index, ubh, offset, size);
+}
+
+bool CommandStreamReplay::replayCommand(Reader& reader, CommandStream& stream, bool& endOfFrame) {
+    const CommandId id = CommandId(reader.get(Tag<uint8_t>{}));
+    switch (id) {
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+        case CommandId::methodName:                                                             \
+            replayCommand(reader, stream, &CommandStream::methodName);                          \
+            break;
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+        case CommandId::methodName:                                                             \
+            replayCommand(reader, stream, &CommandStream::methodName);                          \
+            break;
+#include "private/backend/DriverAPI.inc"
+        default:
+            slog.e << "CommandStreamReplay: unknown command " << uint32_t(id) << io::endl;
+            return false;
+    }
+    endOfFrame = id == CommandId::endFrame;
+    return !reader.isTruncated();
+}
+
+bool CommandStreamReplay::replay(Driver& driver, std::vector<FrameStats>* stats) {
+    if (!mValid) {
+        return false;
+    }
+
+    mHandles.clear();
+    std::vector<std::max_align_t> commands(COMMAND_BUFFER_SIZE / sizeof(std::max_align_t));
+    Reader reader(mData.data() + sizeof(FileHeader), mData.size() - sizeof(FileHeader), *this);
+    FrameStats frame;
+    bool valid = true;
+    while (valid && !reader.empty()) {
+        CircularBuffer buffer(commands.data(), COMMAND_BUFFER_SIZE);
+        CommandStream stream(driver, buffer);
+        bool endOfFrame = false;
+
+        const clock::time_point start = clock::now();
+        while (!endOfFrame && !reader.empty() && size_t(uintptr_t(buffer.getHead()) -
+                uintptr_t(buffer.getTail())) < COMMAND_BUFFER_FLUSH_SIZE) {
+            valid = replayCommand(reader, stream, endOfFrame);
+            if (UTILS_UNLIKELY(!valid)) {
+                break;
+            }
+            frame.commandCount++;
+        }
+        new(buffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+
+        const clock::time_point decoded = clock::now();
+        stream.execute(buffer.getTail());
+        frame.decode += decoded - start;
+        frame.execute += clock::now() - decoded;
+        mStrings.clear();
+
+        if (endOfFrame || reader.empty() || !valid) {
+            if (stats) {
+                stats->push_back(frame);
+            }
+            frame = {};
+        }
+    }
+    return valid;
+}
+
+} // namespace backend
+} // namespace filament
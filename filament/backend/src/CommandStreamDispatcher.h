@@ -52,11 +52,27 @@ public:
     // initialize the dispatch table
     explicit ConcreteDispatcher() noexcept : Dispatcher() {
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
-#define DECL_DRIVER_API(methodName, paramsDecl, params)                 methodName##_ = &ConcreteDispatcher::methodName;
-#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) methodName##_ = &ConcreteDispatcher::methodName;
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                 set(Opcode::methodName, &ConcreteDispatcher::methodName);
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) set(Opcode::methodName, &ConcreteDispatcher::methodName);
 #include "private/backend/DriverAPI.inc"
+        set(Opcode::bindUniformBufferRangeAndDraw,
+                &ConcreteDispatcher::bindUniformBufferRangeAndDraw);
     }
 private:
+    void set(Opcode opcode, Execute execute) noexcept {
+        mExecute[size_t(opcode)] = execute;
+    }
+
+    static void bindUniformBufferRangeAndDraw(Driver& driver, CommandBase* base, intptr_t* next) {
+        SYSTRACE()
+        ConcreteDriver& concreteDriver = static_cast<ConcreteDriver&>(driver);
+        BindAndDrawCommand* self = static_cast<BindAndDrawCommand*>(base);
+        *next = CommandBase::align(sizeof(BindAndDrawCommand));
+        concreteDriver.bindUniformBufferRange(self->mIndex, self->mUniformBuffer,
+                self->mOffset, self->mSize);
+        concreteDriver.draw(self->mState, self->mPrimitive);
+    }
+
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
 #define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
     static void methodName(Driver& driver, CommandBase* base, intptr_t* next) {                 \
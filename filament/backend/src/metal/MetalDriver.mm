@@ -589,6 +589,18 @@ void MetalDriver::loadUniformBuffer(Handle<HwUniformBuffer> ubh,
     scheduleDestroy(std::move(data));
 }
 
+void MetalDriver::updateUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescriptor&& data,
+        uint32_t byteOffset) {
+    if (data.size <= 0) {
+       return;
+    }
+
+    auto buffer = handle_cast<MetalUniformBuffer>(mHandleMap, ubh);
+
+    buffer->updateBuffer(data.buffer, data.size, byteOffset);
+    scheduleDestroy(std::move(data));
+}
+
 void MetalDriver::updateSamplerGroup(Handle<HwSamplerGroup> sbh,
         SamplerGroup&& samplerGroup) {
     auto sb = handle_cast<MetalSamplerGroup>(mHandleMap, sbh);
@@ -1070,6 +1082,14 @@ void MetalDriver::draw(backend::PipelineState ps, Handle<HwRenderPrimitive> rph)
                                        indexBufferOffset:primitive->offset];
 }
 
+void MetalDriver::drawBatch(backend::PipelineState ps, Handle<HwRenderPrimitive> rph,
+        size_t index, Handle<HwUniformBuffer> ubh, size_t offset, size_t size, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, offset += size) {
+        bindUniformBufferRange(index, ubh, offset, size);
+        draw(ps, rph);
+    }
+}
+
 void MetalDriver::enumerateSamplerGroups(
         const MetalProgram* program,
         const std::function<void(const SamplerGroup::Sampler*, size_t)>& f) {
@@ -79,6 +79,12 @@ public:
      */
     void copyIntoBuffer(void* src, size_t size);
 
+    /**
+     * Update the bytes [byteOffset, byteOffset + size) of the uniform with data inside src, the
+     * other bytes are preserved. Like copyIntoBuffer, this potentially allocates a new buffer.
+     */
+    void updateBuffer(void* src, size_t size, size_t byteOffset);
+
     /**
      * Denotes that this uniform is used for a draw call ensuring that its allocation remains valid
      * until the end of the current frame.
@@ -96,6 +102,7 @@ public:
 private:
     size_t uniformSize = 0;
     const MetalBufferPoolEntry* bufferPoolEntry = nullptr;
+    bool bufferPoolEntryUsed = false;   // whether bufferPoolEntry was returned for a draw
     void* cpuBuffer = nullptr;
     MetalContext& context;
 };
@@ -142,9 +142,39 @@ void MetalUniformBuffer::copyIntoBuffer(void* src, size_t size) {
     }
 
     bufferPoolEntry = context.bufferPool->acquireBuffer(this->uniformSize);
+    bufferPoolEntryUsed = false;
     memcpy(static_cast<uint8_t*>(bufferPoolEntry->buffer.contents), src, size);
 }
 
+void MetalUniformBuffer::updateBuffer(void* src, size_t size, size_t byteOffset) {
+    if (size <= 0) {
+        return;
+    }
+    ASSERT_PRECONDITION(byteOffset + size <= this->uniformSize,
+            "Attempting to copy %d bytes at offset %d into a uniform of size %d",
+            size, byteOffset, this->uniformSize);
+
+    if (cpuBuffer) {
+        memcpy(static_cast<uint8_t*>(cpuBuffer) + byteOffset, src, size);
+        return;
+    }
+
+    // The current buffer can be written in place if no draw call used it yet, otherwise the GPU
+    // may still read it, so like copyIntoBuffer we acquire a new one, but its content must be
+    // carried over.
+    if (!bufferPoolEntry || bufferPoolEntryUsed) {
+        const MetalBufferPoolEntry* previous = bufferPoolEntry;
+        bufferPoolEntry = context.bufferPool->acquireBuffer(this->uniformSize);
+        bufferPoolEntryUsed = false;
+        if (previous) {
+            memcpy(static_cast<uint8_t*>(bufferPoolEntry->buffer.contents),
+                    previous->buffer.contents, this->uniformSize);
+            context.bufferPool->releaseBuffer(previous);
+        }
+    }
+    memcpy(static_cast<uint8_t*>(bufferPoolEntry->buffer.contents) + byteOffset, src, size);
+}
+
 id<MTLBuffer> MetalUniformBuffer::getGpuBufferForDraw() {
     if (!bufferPoolEntry) {
         // If there's a CPU buffer, then we return nil here, as the CPU-side buffer will be bound
@@ -157,6 +187,7 @@ id<MTLBuffer> MetalUniformBuffer::getGpuBufferForDraw() {
         // avoid an error, we'll allocate an empty buffer.
         bufferPoolEntry = context.bufferPool->acquireBuffer(this->uniformSize);
     }
+    bufferPoolEntryUsed = true;
 
     // This uniform is being used in a draw call, so we retain it so it's not released back into the
     // buffer pool until the frame has finished.
@@ -188,6 +188,10 @@ ShaderModel OpenGLDriver::getShaderModel() const noexcept {
     return mContext.getShaderModel();
 }
 
+void OpenGLDriver::setHandleMemoryCounter(utils::MemoryCounter* counter) noexcept {
+    mHandleArena.getListener().setCounter(counter);
+}
+
 const float2 OpenGLDriver::mClearTriangle[3] = {{ -1.0f,  3.0f },
                                                 { -1.0f, -1.0f },
                                                 {  3.0f, -1.0f }};
@@ -1443,6 +1447,27 @@ void OpenGLDriver::loadUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescript
     scheduleDestroy(std::move(p));
 }
 
+void OpenGLDriver::updateUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescriptor&& p,
+        uint32_t byteOffset) {
+    DEBUG_MARKER()
+
+    GLUniformBuffer* ub = handle_cast<GLUniformBuffer *>(ubh);
+    assert(ub);
+    assert(ub->gl.ubo.base + byteOffset + p.size <= ub->gl.ubo.capacity);
+
+    auto& gl = mContext;
+    if (p.size > 0) {
+        // the rest of the buffer must be preserved, so unlike updateBuffer() this can't orphan
+        // or map it, this is meant for buffers that aren't STREAM.
+        gl.bindBuffer(GL_UNIFORM_BUFFER, ub->gl.ubo.id);
+        glBufferSubData(GL_UNIFORM_BUFFER, ub->gl.ubo.base + byteOffset, p.size, p.buffer);
+        ub->gl.ubo.size = std::max(ub->gl.ubo.size, uint32_t(byteOffset + p.size));
+    }
+    scheduleDestroy(std::move(p));
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
 void OpenGLDriver::updateBuffer(GLenum target,
         GLBuffer* buffer, BufferDescriptor const& p, uint32_t alignment) noexcept {
     assert(buffer->capacity >= p.size);
@@ -2833,6 +2858,40 @@ void OpenGLDriver::draw(PipelineState state, Handle<HwRenderPrimitive> rph) {
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+void OpenGLDriver::drawBatch(PipelineState state, Handle<HwRenderPrimitive> rph,
+        size_t index, Handle<HwUniformBuffer> ubh, size_t offset, size_t size, uint32_t count) {
+    DEBUG_MARKER()
+    auto& gl = mContext;
+
+    OpenGLProgram* p = handle_cast<OpenGLProgram*>(state.program);
+    if (FILAMENT_ENABLE_MATDBG && UTILS_UNLIKELY(!p->isValid())) {
+        return;
+    }
+
+    useProgram(p);
+
+    const GLRenderPrimitive* rp = handle_cast<const GLRenderPrimitive *>(rph);
+    gl.bindVertexArray(&rp->gl);
+
+    setRasterState(state.rasterState);
+
+    gl.polygonOffset(state.polygonOffset.slope, state.polygonOffset.constant);
+
+    setViewportScissor(state.scissor);
+
+    // only the uniform buffer range changes between draws
+    GLUniformBuffer* ub = handle_cast<GLUniformBuffer*>(ubh);
+    assert(ub->gl.ubo.base + offset + size * count <= ub->gl.ubo.capacity);
+    for (uint32_t i = 0; i < count; i++, offset += size) {
+        gl.bindBufferRange(GL_UNIFORM_BUFFER, GLuint(index), ub->gl.ubo.id,
+                ub->gl.ubo.base + offset, size);
+        glDrawRangeElements(GLenum(rp->type), rp->minIndex, rp->maxIndex, rp->count,
+                rp->gl.indicesType, reinterpret_cast<const void*>(rp->offset));
+    }
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
 // explicit instantiation of the Dispatcher
 template class backend::ConcreteDispatcher<OpenGLDriver>;
 
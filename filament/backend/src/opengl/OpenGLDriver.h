@@ -189,6 +189,8 @@ private:
 
     backend::ShaderModel getShaderModel() const noexcept final;
 
+    void setHandleMemoryCounter(utils::MemoryCounter* counter) noexcept final;
+
     /*
      * Driver interface
      */
@@ -226,10 +228,11 @@ private:
 #ifndef NDEBUG
     using HandleArena = utils::Arena<HandleAllocator,
             utils::LockingPolicy::SpinLock,
-            utils::TrackingPolicy::Debug>;
+            utils::TrackingPolicy::DebugAndTagged>;
 #else
     using HandleArena = utils::Arena<HandleAllocator,
-            utils::LockingPolicy::SpinLock>;
+            utils::LockingPolicy::SpinLock,
+            utils::TrackingPolicy::Tagged>;
 #endif
 
     HandleArena mHandleArena;
@@ -691,7 +691,16 @@ bool VulkanDriver::canGenerateMipmaps() {
 void VulkanDriver::loadUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescriptor&& data) {
     if (data.size > 0) {
         auto* buffer = handle_cast<VulkanUniformBuffer>(mHandleMap, ubh);
-        buffer->loadFromCpu(data.buffer, (uint32_t) data.size);
+        buffer->loadFromCpu(data.buffer, 0, (uint32_t) data.size);
+        scheduleDestroy(std::move(data));
+    }
+}
+
+void VulkanDriver::updateUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescriptor&& data,
+        uint32_t byteOffset) {
+    if (data.size > 0) {
+        auto* buffer = handle_cast<VulkanUniformBuffer>(mHandleMap, ubh);
+        buffer->loadFromCpu(data.buffer, byteOffset, (uint32_t) data.size);
         scheduleDestroy(std::move(data));
     }
 }
@@ -1193,10 +1202,21 @@ void VulkanDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> r
     vkCmdDrawIndexed(cmdbuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstId);
 }
 
+void VulkanDriver::drawBatch(PipelineState pipelineState, Handle<HwRenderPrimitive> rph,
+        size_t index, Handle<HwUniformBuffer> ubh, size_t offset, size_t size, uint32_t count) {
+    // The descriptor sets depend on the uniform buffer ranges, so each draw goes through the
+    // binder anyways.
+    for (uint32_t i = 0; i < count; i++, offset += size) {
+        bindUniformBufferRange(index, ubh, offset, size);
+        draw(pipelineState, rph);
+    }
+}
+
 #ifndef NDEBUG
 void VulkanDriver::debugCommand(const char* methodName) {
     static const std::set<utils::StaticString> OUTSIDE_COMMANDS = {
         "loadUniformBuffer",
+        "updateUniformBuffer",
         "updateVertexBuffer",
         "updateIndexBuffer",
         "update2DImage",
@@ -96,7 +96,7 @@ struct VulkanUniformBuffer : public HwUniformBuffer {
     VulkanUniformBuffer(VulkanContext& context, VulkanStagePool& stagePool, uint32_t numBytes,
             backend::BufferUsage usage);
     ~VulkanUniformBuffer();
-    void loadFromCpu(const void* cpuData, uint32_t numBytes);
+    void loadFromCpu(const void* cpuData, uint32_t byteOffset, uint32_t numBytes);
     VkBuffer getGpuBuffer() const { return mGpuBuffer; }
 private:
     VulkanContext& mContext;
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/CommandStreamCapture.h"
+
+#include "CommandStreamDispatcher.h"
+#include "DriverBase.h"
+#include "noop/NoopDriver.h"
+
+#include <utils/Path.h>
+
+#include <cstddef>
+#include <vector>
+
+using namespace filament;
+using namespace filament::backend;
+
+namespace {
+
+// Creates handles starting at 'firstHandle', so that two drivers hand out different handles for
+// the same commands, and does nothing else.
+class HandleDriver : public DriverBase {
+public:
+    HandleDriver(Dispatcher* dispatcher, HandleBase::HandleId firstHandle) noexcept
+            : DriverBase(dispatcher), mNextHandle(firstHandle) {
+    }
+
+    ShaderModel getShaderModel() const noexcept final { return ShaderModel::GL_CORE_41; }
+
+#define DECL_DRIVER_API(methodName, paramsDecl, params) \
+    void methodName(paramsDecl) { }
+
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params) \
+    RetType methodName(paramsDecl) override { return RetType(true); }
+
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
+    RetType methodName##S() noexcept override { return RetType(mNextHandle++); } \
+    void methodName##R(RetType, paramsDecl) { }
+
+#include "private/backend/DriverAPI.inc"
+
+private:
+    HandleBase::HandleId mNextHandle;
+};
+
+// Records the arguments of the commands the test checks, the other ones are ignored by
+// HandleDriver.
+class RecordingDriver final : public HandleDriver {
+public:
+    explicit RecordingDriver(HandleBase::HandleId firstHandle) noexcept
+            : HandleDriver(new ConcreteDispatcher<RecordingDriver>(), firstHandle) {
+    }
+
+    struct Image {
+        HandleBase::HandleId th;
+        uint32_t width;
+        uint32_t height;
+        PixelDataFormat format;
+        PixelDataType type;
+        std::vector<uint8_t> data;
+    };
+
+    struct Binding {
+        size_t index;
+        HandleBase::HandleId ubh;
+        size_t offset;
+        size_t size;
+    };
+
+    std::vector<Image> images;
+    std::vector<Binding> bindings;
+    std::vector<HandleBase::HandleId> draws;
+
+    void update2DImage(TextureHandle th, uint32_t, uint32_t, uint32_t,
+            uint32_t width, uint32_t height, PixelBufferDescriptor&& data) {
+        uint8_t const* bytes = static_cast<uint8_t const*>(data.buffer);
+        images.push_back({ th.getId(), width, height, data.format, data.type,
+                std::vector<uint8_t>(bytes, bytes + data.size) });
+    }
+
+    void bindUniformBufferRange(size_t index, UniformBufferHandle ubh,
+            size_t offset, size_t size) {
+        bindings.push_back({ index, ubh.getId(), offset, size });
+    }
+
+    void draw(PipelineState, RenderPrimitiveHandle rph) {
+        draws.push_back(rph.getId());
+    }
+};
+
+constexpr size_t COMMAND_BUFFER_SIZE = 64 * 1024;
+
+} // anonymous namespace
+
+TEST(CommandStreamCaptureTest, CaptureAndReplay) {
+    utils::Path path = utils::Path::getTemporaryDirectory() + "command_stream_capture_test.bin";
+    static const uint8_t pixels[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+    // Captures two frames, the third one is executed after the capture is complete
+    RecordingDriver captured(1);
+    std::vector<std::max_align_t> commands(COMMAND_BUFFER_SIZE / sizeof(std::max_align_t));
+    {
+        CommandStreamCapture capture(path.c_str(), 2);
+        ASSERT_TRUE(capture.isValid());
+
+        TextureHandle th;
+        UniformBufferHandle ubh;
+        RenderPrimitiveHandle rph;
+        for (uint32_t frame = 0; frame < 3; frame++) {
+            CircularBuffer buffer(commands.data(), COMMAND_BUFFER_SIZE);
+            CommandStream stream(captured, buffer);
+            if (frame == 0) {
+                th = stream.createTexture(SamplerType::SAMPLER_2D, 1, TextureFormat::RGBA8, 1,
+                        2, 2, 1, TextureUsage::DEFAULT);
+                ubh = stream.createUniformBuffer(64, BufferUsage::DYNAMIC);
+                rph = stream.createRenderPrimitive();
+            }
+            stream.beginFrame(0, frame, nullptr, nullptr);
+            stream.update2DImage(th, 0, 0, 0, 2, 2, PixelBufferDescriptor(pixels, sizeof(pixels),
+                    PixelDataFormat::RGBA, PixelDataType::UBYTE));
+            stream.bindUniformBufferRangeAndDraw(1, ubh, 0, 32, {}, rph);
+            // not followed by a draw, it must not be fused when played back
+            stream.bindUniformBufferRange(2, ubh, 32, 32);
+            stream.endFrame(frame);
+            new(buffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+
+            EXPECT_EQ(frame == 0, capture.capture(buffer.getTail()));
+            stream.execute(buffer.getTail());
+        }
+    }
+
+    ASSERT_EQ(3u, captured.images.size());
+    EXPECT_EQ(1u, captured.images[0].th);
+    ASSERT_EQ(6u, captured.bindings.size());
+    EXPECT_EQ(2u, captured.bindings[0].ubh);
+    ASSERT_EQ(3u, captured.draws.size());
+    EXPECT_EQ(3u, captured.draws[0]);
+
+    CommandStreamReplay replay(path.c_str());
+    ASSERT_TRUE(replay.isValid());
+    EXPECT_EQ(2u, replay.getFrameCount());
+
+    Driver* noopDriver = NoopDriver::create();
+    EXPECT_TRUE(replay.replay(*noopDriver));
+    noopDriver->terminate();
+    delete noopDriver;
+
+    RecordingDriver replayed(1000);
+    std::vector<CommandStreamReplay::FrameStats> stats;
+    EXPECT_TRUE(replay.replay(replayed, &stats));
+
+    // the bindUniformBufferRange() + draw() pair is played back as a single command, the
+    // first frame also contains the three commands that create the handles
+    ASSERT_EQ(2u, stats.size());
+    EXPECT_EQ(8u, stats[0].commandCount);
+    EXPECT_EQ(5u, stats[1].commandCount);
+
+    // the played back commands use the handles created by the replay, and get a copy of the
+    // captured pixels
+    ASSERT_EQ(2u, replayed.images.size());
+    for (auto const& image : replayed.images) {
+        EXPECT_EQ(1000u, image.th);
+        EXPECT_EQ(2u, image.width);
+        EXPECT_EQ(2u, image.height);
+        EXPECT_EQ(PixelDataFormat::RGBA, image.format);
+        EXPECT_EQ(PixelDataType::UBYTE, image.type);
+        EXPECT_EQ(std::vector<uint8_t>(pixels, pixels + sizeof(pixels)), image.data);
+    }
+
+    ASSERT_EQ(4u, replayed.bindings.size());
+    for (size_t i = 0; i < replayed.bindings.size(); i++) {
+        EXPECT_EQ(captured.bindings[i].index, replayed.bindings[i].index);
+        EXPECT_EQ(1001u, replayed.bindings[i].ubh);
+        EXPECT_EQ(captured.bindings[i].offset, replayed.bindings[i].offset);
+        EXPECT_EQ(captured.bindings[i].size, replayed.bindings[i].size);
+    }
+
+    ASSERT_EQ(2u, replayed.draws.size());
+    for (auto rph : replayed.draws) {
+        EXPECT_EQ(1002u, rph);
+    }
+
+    path.unlinkFile();
+}
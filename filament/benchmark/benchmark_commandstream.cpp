@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <backend/Platform.h>
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+
+#include <vector>
+
+using namespace filament;
+using namespace filament::backend;
+
+/*
+ * Records draws into a CommandStream and executes them with the NOOP backend, which measures
+ * the cost of the CommandStream itself. Reports the size of the commands recorded per draw.
+ */
+class CommandStreamFixture : public benchmark::Fixture {
+protected:
+    static constexpr size_t DRAW_COUNT = 10000;
+    static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+    static constexpr uint32_t UBO_SIZE = 256;
+
+    DefaultPlatform* platform = nullptr;
+    Driver* driver = nullptr;
+    std::vector<std::max_align_t> storage;
+
+public:
+    void SetUp(const benchmark::State& state) override {
+        Backend backend = Backend::NOOP;
+        platform = DefaultPlatform::create(&backend);
+        driver = platform->createDriver(nullptr);
+        storage.resize(BUFFER_SIZE / sizeof(std::max_align_t));
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        driver->terminate();
+        delete driver;
+        DefaultPlatform::destroy(&platform);
+    }
+
+    template<typename Record>
+    void run(benchmark::State& state, Record record) {
+        PipelineState pipeline;
+        Handle<HwRenderPrimitive> rph(1);
+        Handle<HwUniformBuffer> ubh(2);
+        size_t bytes = 0;
+        for (auto _ : state) {
+            CircularBuffer buffer(storage.data(), BUFFER_SIZE);
+            CommandStream stream(*driver, buffer);
+            for (size_t i = 0; i < DRAW_COUNT; i++) {
+                record(stream, ubh, uint32_t(i * UBO_SIZE), pipeline, rph);
+            }
+            bytes = uintptr_t(buffer.getHead()) - uintptr_t(buffer.getTail());
+            new(buffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+            stream.execute(buffer.getTail());
+        }
+        state.counters["bytes/draw"] = double(bytes) / DRAW_COUNT;
+        state.SetItemsProcessed(state.iterations() * DRAW_COUNT);
+    }
+};
+
+BENCHMARK_F(CommandStreamFixture, bindThenDraw)(benchmark::State& state) {
+    run(state, [](CommandStream& stream, Handle<HwUniformBuffer> ubh, uint32_t offset,
+            PipelineState const& pipeline, Handle<HwRenderPrimitive> rph) {
+        stream.bindUniformBufferRange(0, ubh, offset, UBO_SIZE);
+        stream.draw(pipeline, rph);
+    });
+}
+
+BENCHMARK_F(CommandStreamFixture, bindAndDraw)(benchmark::State& state) {
+    run(state, [](CommandStream& stream, Handle<HwUniformBuffer> ubh, uint32_t offset,
+            PipelineState const& pipeline, Handle<HwRenderPrimitive> rph) {
+        stream.bindUniformBufferRangeAndDraw(0, ubh, offset, UBO_SIZE, pipeline, rph);
+    });
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerformanceCounters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <filament/Frustum.h>
+#include "details/Culler.h"
+#include "details/CullingBvh.h"
+
+#include <utils/Allocator.h>
+#include <utils/JobSystem.h>
+
+#include <functional>
+#include <vector>
+#include <random>
+
+using namespace filament;
+using namespace filament::details;
+using namespace filament::math;
+using namespace utils;
+
+/*
+ * Compares the flat culling path used by FView::cullRenderables() with CullingBvh, on a scene
+ * made of small boxes scattered in a volume much larger than the view frustum.
+ */
+class CullingFixture : public benchmark::Fixture {
+protected:
+    Frustum frustum{};
+    std::vector<float3> boxesCenter;
+    std::vector<float3> boxesExtent;
+    std::vector<Culler::result_type> visibles;
+    JobSystem* js = nullptr;
+
+public:
+    void SetUp(const benchmark::State& state) override {
+        const size_t count = size_t(state.range(0));
+
+        std::default_random_engine gen; // NOLINT
+        std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+        std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+        frustum = Frustum{ mat4f::perspective(45.0f, 1.0f, 0.1f, 500.0f) };
+
+        // the flat culler needs arrays with a size multiple of Culler::MODULO
+        boxesCenter.resize(Culler::round(count));
+        boxesExtent.resize(Culler::round(count));
+        visibles.resize(Culler::round(count));
+        for (size_t i = 0; i < count; i++) {
+            boxesCenter[i] = { position(gen), position(gen), position(gen) };
+            boxesExtent[i] = { size(gen), size(gen), size(gen) };
+        }
+
+        js = new JobSystem();
+        js->adopt();
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        js->emancipate();
+        delete js;
+        js = nullptr;
+    }
+};
+
+BENCHMARK_DEFINE_F(CullingFixture, flat)(benchmark::State& state) {
+    const uint32_t count = uint32_t(state.range(0));
+    float3 const* center = boxesCenter.data();
+    float3 const* extent = boxesExtent.data();
+    Culler::result_type* results = visibles.data();
+    auto functor = [this, center, extent, results](uint32_t index, uint32_t c) {
+        Culler::Test::intersects(results + index, frustum, center + index, extent + index, c);
+    };
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            auto job = jobs::parallel_for(*js, nullptr, 0, count, std::cref(functor),
+                    jobs::CountSplitter<Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT, 8>());
+            js->runAndWait(job);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+}
+
+BENCHMARK_DEFINE_F(CullingFixture, bvh)(benchmark::State& state) {
+    const uint32_t count = uint32_t(state.range(0));
+    CullingBvh bvh;
+    bvh.build(boxesCenter.data(), boxesExtent.data(), count);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            bvh.intersects(*js, visibles.data(), frustum, 0);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+}
+
+BENCHMARK_DEFINE_F(CullingFixture, bvhRefit)(benchmark::State& state) {
+    const uint32_t count = uint32_t(state.range(0));
+    CullingBvh bvh;
+    bvh.build(boxesCenter.data(), boxesExtent.data(), count);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            bvh.refit(boxesCenter.data(), boxesExtent.data());
+            bvh.intersects(*js, visibles.data(), frustum, 0);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+}
+
+BENCHMARK_REGISTER_F(CullingFixture, flat)->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK_REGISTER_F(CullingFixture, bvh)->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK_REGISTER_F(CullingFixture, bvhRefit)->Arg(10000)->Arg(100000)->Arg(1000000);
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <filament/Box.h>
+#include <filament/Camera.h>
+#include <filament/Engine.h>
+#include <filament/IndexBuffer.h>
+#include <filament/LightManager.h>
+#include <filament/Material.h>
+#include <filament/MaterialInstance.h>
+#include <filament/RenderableManager.h>
+#include <filament/Renderer.h>
+#include <filament/Scene.h>
+#include <filament/TransformManager.h>
+#include <filament/VertexBuffer.h>
+#include <filament/View.h>
+#include <filament/Viewport.h>
+
+#include "details/Engine.h"
+#include "details/View.h"
+
+#include <utils/Entity.h>
+#include <utils/EntityManager.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace filament;
+using namespace filament::details;
+using namespace filament::math;
+using namespace utils;
+
+/*
+ * Renders whole frames with the NOOP backend, so it runs without a GPU, and reports the CPU
+ * time spent in each stage of the frame (see details::FrameTimings), as well as the time the
+ * driver thread spent executing the commands.
+ *
+ * The synthetic scene is made of:
+ *   range(0) renderables, each a cube, grouped in transform hierarchies range(3) levels deep
+ *   range(1) point lights, plus a directional light casting shadows
+ *   range(2) material instances of the default material, shared by the renderables
+ * The root of each hierarchy rotates every frame, so the transforms and the commands of all
+ * renderables change from one frame to the next.
+ */
+class FrameFixture : public benchmark::Fixture {
+protected:
+    static constexpr uint32_t WIDTH = 1280;
+    static constexpr uint32_t HEIGHT = 720;
+
+    Engine* engine = nullptr;
+    SwapChain* swapChain = nullptr;
+    Renderer* renderer = nullptr;
+    Scene* scene = nullptr;
+    View* view = nullptr;
+    Camera* camera = nullptr;
+    VertexBuffer* vertexBuffer = nullptr;
+    IndexBuffer* indexBuffer = nullptr;
+    std::vector<MaterialInstance*> materialInstances;
+    std::vector<Entity> renderables;
+    std::vector<Entity> roots;
+    std::vector<Entity> lights;
+
+public:
+    void SetUp(const benchmark::State& state) override {
+        const size_t renderableCount = size_t(state.range(0));
+        const size_t lightCount = size_t(state.range(1));
+        const size_t materialCount = std::max(size_t(1), size_t(state.range(2)));
+        const size_t depth = std::max(size_t(1), size_t(state.range(3)));
+
+        engine = Engine::create(Engine::Backend::NOOP);
+        swapChain = engine->createSwapChain(WIDTH, HEIGHT);
+        renderer = engine->createRenderer();
+        scene = engine->createScene();
+        view = engine->createView();
+        camera = engine->createCamera();
+        camera->setProjection(45.0, double(WIDTH) / HEIGHT, 0.1, 500.0);
+        view->setCamera(camera);
+        view->setScene(scene);
+        view->setViewport({ 0, 0, WIDTH, HEIGHT });
+
+        static const float3 vertices[8] = {
+                { -1, -1, -1 }, {  1, -1, -1 }, { -1,  1, -1 }, {  1,  1, -1 },
+                { -1, -1,  1 }, {  1, -1,  1 }, { -1,  1,  1 }, {  1,  1,  1 },
+        };
+        static const uint16_t indices[36] = {
+                0, 2, 1,  1, 2, 3,  4, 5, 6,  5, 7, 6,  0, 1, 4,  1, 5, 4,
+                2, 6, 3,  3, 6, 7,  0, 4, 2,  2, 4, 6,  1, 3, 5,  3, 7, 5,
+        };
+        vertexBuffer = VertexBuffer::Builder()
+                .vertexCount(8)
+                .bufferCount(1)
+                .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+                .build(*engine);
+        vertexBuffer->setBufferAt(*engine, 0, { vertices, sizeof(vertices) });
+        indexBuffer = IndexBuffer::Builder()
+                .indexCount(36)
+                .bufferType(IndexBuffer::IndexType::USHORT)
+                .build(*engine);
+        indexBuffer->setBuffer(*engine, { indices, sizeof(indices) });
+
+        Material const* material = engine->getDefaultMaterial();
+        for (size_t i = 0; i < materialCount; i++) {
+            materialInstances.push_back(material->createInstance());
+        }
+
+        std::default_random_engine gen; // NOLINT
+        std::uniform_real_distribution<float> spread(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> distance(-200.0f, -10.0f);
+
+        EntityManager& em = EntityManager::get();
+        TransformManager& tcm = engine->getTransformManager();
+        renderables.resize(renderableCount);
+        em.create(renderableCount, renderables.data());
+        for (size_t i = 0; i < renderableCount; i++) {
+            // each level of the hierarchy is offset from its parent
+            TransformManager::Instance parent{};
+            mat4f transform = mat4f::translation(float3{ 0, 0, -2.5f });
+            if (i % depth == 0) {
+                transform = mat4f::translation(float3{ spread(gen), spread(gen), distance(gen) });
+                roots.push_back(renderables[i]);
+            } else {
+                parent = tcm.getInstance(renderables[i - 1]);
+            }
+            tcm.create(renderables[i], parent, transform);
+
+            RenderableManager::Builder(1)
+                    .boundingBox({{ -1, -1, -1 }, { 1, 1, 1 }})
+                    .geometry(0, RenderableManager::PrimitiveType::TRIANGLES,
+                            vertexBuffer, indexBuffer)
+                    .material(0, materialInstances[i % materialCount])
+                    .castShadows(true)
+                    .receiveShadows(true)
+                    .build(*engine, renderables[i]);
+            scene->addEntity(renderables[i]);
+        }
+
+        lights.resize(lightCount + 1);
+        em.create(lightCount + 1, lights.data());
+        LightManager::Builder(LightManager::Type::SUN)
+                .direction({ 0.3f, -1.0f, -0.5f })
+                .castShadows(true)
+                .build(*engine, lights[0]);
+        scene->addEntity(lights[0]);
+        for (size_t i = 1; i <= lightCount; i++) {
+            LightManager::Builder(LightManager::Type::POINT)
+                    .position({ spread(gen), spread(gen), distance(gen) })
+                    .falloff(20.0f)
+                    .build(*engine, lights[i]);
+            scene->addEntity(lights[i]);
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        EntityManager& em = EntityManager::get();
+        for (Entity e : renderables) {
+            engine->destroy(e);
+        }
+        for (Entity e : lights) {
+            engine->destroy(e);
+        }
+        em.destroy(renderables.size(), renderables.data());
+        em.destroy(lights.size(), lights.data());
+        renderables.clear();
+        roots.clear();
+        lights.clear();
+        for (MaterialInstance* mi : materialInstances) {
+            engine->destroy(mi);
+        }
+        materialInstances.clear();
+        engine->destroy(indexBuffer);
+        engine->destroy(vertexBuffer);
+        engine->destroy(camera);
+        engine->destroy(view);
+        engine->destroy(scene);
+        engine->destroy(renderer);
+        engine->destroy(swapChain);
+        Engine::destroy(&engine);
+    }
+
+    void animate(float angle) noexcept {
+        TransformManager& tcm = engine->getTransformManager();
+        const mat4f rotation = mat4f::rotation(angle, float3{ 0, 1, 0 });
+        for (Entity e : roots) {
+            TransformManager::Instance const ti = tcm.getInstance(e);
+            const float3 position = tcm.getTransform(ti)[3].xyz;
+            tcm.setTransform(ti, mat4f::translation(position) * rotation);
+        }
+    }
+};
+
+BENCHMARK_DEFINE_F(FrameFixture, frame)(benchmark::State& state) {
+    using seconds = std::chrono::duration<double>;
+    FEngine const& fengine = upcast(*engine);
+    FrameTimings const& timings = upcast(view)->getFrameTimings();
+    FrameTimings total;
+    FEngine::duration driver{};
+    uint32_t frame = 0;
+
+    // the first frame creates the programs and the render targets
+    renderer->beginFrame(swapChain);
+    renderer->render(view);
+    renderer->endFrame();
+    engine->flushAndWait();
+
+    for (auto _ : state) {
+        animate(float(++frame) * 0.01f);
+        const FEngine::duration driverStart = fengine.getDriverExecutionTime();
+        if (renderer->beginFrame(swapChain)) {
+            renderer->render(view);
+            renderer->endFrame();
+        }
+        // waits for the driver thread, so that it's accounted in this frame
+        engine->flushAndWait();
+        driver += fengine.getDriverExecutionTime() - driverStart;
+        total.prepare   += timings.prepare;
+        total.culling   += timings.culling;
+        total.froxelize += timings.froxelize;
+        total.commands  += timings.commands;
+        total.sort      += timings.sort;
+        total.recording += timings.recording;
+    }
+
+    auto counter = [](FrameTimings::duration d) {
+        return benchmark::Counter(seconds(d).count(), benchmark::Counter::kAvgIterations);
+    };
+    state.counters.insert({
+            { "prepare",   counter(total.prepare) },
+            { "culling",   counter(total.culling) },
+            { "froxelize", counter(total.froxelize) },
+            { "commands",  counter(total.commands) },
+            { "sort",      counter(total.sort) },
+            { "recording", counter(total.recording) },
+            { "driver",    counter(driver) },
+    });
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// renderables, point lights, material instances, hierarchy depth
+BENCHMARK_REGISTER_F(FrameFixture, frame)
+        ->ArgNames({ "renderables", "lights", "materials", "depth" })
+        ->Args({ 1000, 16, 8, 1 })
+        ->Args({ 1000, 16, 8, 8 })
+        ->Args({ 10000, 16, 8, 1 })
+        ->Args({ 10000, 256, 64, 4 })
+        ->Args({ 50000, 256, 64, 4 })
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
@@ -26,6 +26,10 @@
 #include <utils/compiler.h>
 #include <utils/EntityManager.h>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace filament {
 
 class Camera;
@@ -146,6 +150,37 @@ public:
     using Platform = backend::Platform;
     using Backend = backend::Backend;
 
+    /**
+     * Categories of memory accounted by the Engine, see getMemoryStats().
+     *
+     * The sizes of GPU resources are estimated from their description, the actual memory used
+     * by the GPU driver may differ.
+     *
+     * The small objects the backend allocates to represent the GPU resources (their handles)
+     * are only accounted by the OpenGL backend, which allocates them from a fixed-size arena.
+     */
+    enum class MemoryTag : uint8_t {
+        PER_FRAME_ARENAS,   //!< CPU arenas used to prepare the frames
+        RESOURCE_CACHE,     //!< render targets allocated by the renderer, including its cache
+        COMMAND_BUFFERS,    //!< command stream buffer
+        OBJECTS,            //!< Engine objects (View, Scene, MaterialInstance, ...)
+        PROGRAMS,           //!< shaders of the material variants in use
+        VERTEX_BUFFERS,     //!< VertexBuffer
+        INDEX_BUFFERS,      //!< IndexBuffer
+        UNIFORM_BUFFERS,    //!< uniform buffers of materials, views and skinned renderables
+        TEXTURES,           //!< Texture
+        HANDLES,            //!< backend objects representing the GPU resources
+        COUNT
+    };
+
+    /**
+     * Memory usage of a MemoryTag, in bytes.
+     */
+    struct MemoryStats {
+        size_t current; //!< bytes currently used
+        size_t peak;    //!< largest number of bytes used since creation or resetMemoryPeaks()
+    };
+
     /**
      * Creates an instance of Engine
      *
@@ -365,6 +400,40 @@ public:
      */
     void flushAndWait();
 
+    /**
+     * Allows the calling thread to create VertexBuffer, IndexBuffer, Texture and Material
+     * objects, and to set their content, concurrently with the Engine's thread. This is meant
+     * for asset loading threads. Other Engine APIs must still be called from the Engine's thread.
+     *
+     * The calling thread gets its own command stream, the commands it issues are executed by
+     * the driver in the following order:
+     *  - commands issued by the same thread are executed in the order they were issued
+     *  - commands issued by this thread before a call to flushProducerThread() that returned
+     *    before the Engine's thread issues a command (e.g. signaled with a fence or a future),
+     *    are executed before that command.
+     *
+     * An object created by this thread can therefore be used from the Engine's thread once
+     * flushProducerThread() has returned. Objects must be destroyed from the Engine's thread.
+     *
+     * The commands are executed as soon as they're flushed, but a thread issuing a lot of
+     * commands can block in flushProducerThread() until the Engine's thread executes its own.
+     *
+     * @see flushProducerThread(), detachProducerThread()
+     */
+    void attachProducerThread();
+
+    /**
+     * Submits the commands issued so far by the calling thread, which must have been attached
+     * with attachProducerThread().
+     */
+    void flushProducerThread() noexcept;
+
+    /**
+     * Submits the commands issued so far by the calling thread, and releases its command
+     * stream. This must be called before the thread exits, and before the Engine is destroyed.
+     */
+    void detachProducerThread() noexcept;
+
     /**
      * Returns the default Material.
      *
@@ -422,6 +491,30 @@ public:
 
     DebugRegistry& getDebugRegistry() noexcept;
 
+    /**
+     * Returns the JobSystem used by this Engine, e.g. to read its per-thread statistics with
+     * utils::JobSystem::getThreadStats(), or to record and export a trace of its jobs with
+     * utils::JobSystem::startProfiling() and utils::JobSystem::exportTrace().
+     *
+     * @return The JobSystem shared by all the views and renderers of this Engine.
+     */
+    utils::JobSystem& getJobSystem() noexcept;
+
+    /**
+     * Returns the current and peak memory usage of a category of memory. This accounting is
+     * always enabled and cheap to query, e.g. to enforce memory budgets every frame.
+     *
+     * @param tag   Category of memory to query, must not be MemoryTag::COUNT.
+     * @return      Current and peak number of bytes of this category.
+     */
+    MemoryStats getMemoryStats(MemoryTag tag) const noexcept;
+
+    /**
+     * Starts a new measurement of the peak memory usage of all categories, from their current
+     * usage.
+     */
+    void resetMemoryPeaks() noexcept;
+
 protected:
     //! \privatesection
     Engine() noexcept = default;
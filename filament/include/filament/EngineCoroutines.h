@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! \file
+
+#ifndef TNT_FILAMENT_ENGINECOROUTINES_H
+#define TNT_FILAMENT_ENGINECOROUTINES_H
+
+#include <filament/Engine.h>
+#include <filament/Fence.h>
+
+#include <utils/compiler.h>
+#include <utils/JobCoroutine.h>
+#include <utils/JobSystem.h>
+
+namespace filament {
+
+/**
+ * Kicks the hardware thread like Engine::flushAndWait(), but doesn't block. Instead, this
+ * returns a job of the Engine's JobSystem, which finishes when all commands to this point are
+ * executed. This is meant to be waited on without blocking a thread, see the awaitables below.
+ *
+ * @param engine    the Engine to flush
+ * @param finish    if true, the job finishes only after the driver's finish() command,
+ *                  like Engine::flushAndWait().
+ * @return A job obtained with utils::JobSystem::runAndRetain(), which must be waited on with
+ *         utils::JobSystem::waitAndRelease() or released with utils::JobSystem::release().
+ *         nullptr if no job could be created.
+ *
+ * @note unlike Engine::flushAndWait(), this doesn't execute the callbacks scheduled by the
+ *       driver, they're executed with the next frame.
+ */
+UTILS_PUBLIC
+utils::JobSystem::Job* flushAsync(Engine& engine, bool finish = true) noexcept;
+
+} // namespace filament
+
+#if UTILS_HAS_COROUTINES
+
+namespace filament {
+
+/**
+ * Awaitables for the coroutines of utils/JobCoroutine.h, which let a coroutine wait for the
+ * Engine without blocking a thread.
+ *
+ * Like all Engine APIs, they must be awaited from the thread that owns the Engine, but the
+ * coroutine is resumed by a thread of the Engine's JobSystem. The Engine's threading rules
+ * still apply after co_await: the coroutine must not use the Engine (or any of its objects)
+ * until it's back on the Engine's thread, which it has to arrange by other means.
+ *
+ * ~~~~~~~~~~~{.cpp}
+ *  utils::jobs::Task<> upload(Engine& engine, Texture* texture, ...) {
+ *      texture->setImage(engine, 0, std::move(buffer));    // on the Engine's thread
+ *      co_await filament::flushAndWait(engine);
+ *      // on a JobSystem thread: the texture is uploaded, but the Engine can't be used here
+ *      notifyUploadDone(texture);
+ *  }
+ * ~~~~~~~~~~~
+ */
+
+/**
+ * Awaitable for the commands issued so far to be executed, see Engine::flushAndWait() and
+ * flushAsync().
+ */
+class FlushAwaiter {
+public:
+    FlushAwaiter(Engine& engine, bool finish) noexcept : mEngine(engine), mFinish(finish) { }
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) noexcept {
+        utils::JobSystem::Job* job = flushAsync(mEngine, mFinish);
+        if (UTILS_UNLIKELY(!job)) {
+            mEngine.flushAndWait();
+            return false;
+        }
+        return utils::jobs::completion(mEngine.getJobSystem(), job).await_suspend(h);
+    }
+
+    void await_resume() const noexcept { }
+
+private:
+    Engine& mEngine;
+    bool mFinish;
+};
+
+inline FlushAwaiter flushAndWait(Engine& engine) noexcept {
+    return { engine, true };
+}
+
+/**
+ * Awaitable for a Fence to be signaled. The command stream is flushed, and the result of the
+ * Fence (which can be destroyed afterwards) is returned by co_await.
+ *
+ * Only the Fence's position in the command stream is awaited, which is sufficient for the
+ * fences created with Engine::createFence().
+ */
+class FenceAwaiter {
+public:
+    FenceAwaiter(Engine& engine, Fence* fence) noexcept : mFlush(engine, false), mFence(fence) { }
+
+    bool await_ready() const noexcept {
+        return mFence->wait(Fence::Mode::FLUSH, 0) != Fence::FenceStatus::TIMEOUT_EXPIRED;
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) noexcept {
+        return mFlush.await_suspend(h);
+    }
+
+    Fence::FenceStatus await_resume() const noexcept {
+        return mFence->wait(Fence::Mode::DONT_FLUSH, 0);
+    }
+
+private:
+    FlushAwaiter mFlush;
+    Fence* mFence;
+};
+
+inline FenceAwaiter wait(Engine& engine, Fence* fence) noexcept {
+    return { engine, fence };
+}
+
+} // namespace filament
+
+#endif // UTILS_HAS_COROUTINES
+
+#endif // TNT_FILAMENT_ENGINECOROUTINES_H
@@ -153,6 +153,28 @@ public:
         float intensity = 1.0;  //!< Strength of the Ambient Occlusion effect.
     };
 
+    /**
+     * Statistics about the draw commands recorded for a render pass of this view.
+     * @see getRenderStats()
+     */
+    struct RenderPassStats {
+        uint32_t drawCount = 0;         //!< number of draw calls, a batch counts as one
+        uint32_t primitiveCount = 0;    //!< number of primitives drawn
+        uint32_t bindCount = 0;         //!< number of uniform buffer and sampler binds issued
+        uint32_t skippedBindCount = 0;  //!< number of redundant binds that were skipped
+    };
+
+    /**
+     * Statistics about the last frame rendered with this view, per render pass.
+     * The statistics of a pass that wasn't rendered are all zero.
+     * @see getRenderStats()
+     */
+    struct RenderStats {
+        RenderPassStats shadow;         //!< shadow map pass
+        RenderPassStats depth;          //!< depth pass used by ambient occlusion
+        RenderPassStats color;          //!< color pass, including the depth prepass
+    };
+
     /**
      * List of available ambient occlusion techniques
     */
@@ -591,6 +613,13 @@ public:
      */
     bool isFrontFaceWindingInverted() const noexcept;
 
+    /**
+     * Returns statistics about the draw commands recorded the last time this view was rendered.
+     *
+     * @return the statistics of each render pass of the last frame rendered with this view.
+     */
+    RenderStats getRenderStats() const noexcept;
+
     // for debugging...
 
     //! debugging: allows to entirely disable frustum culling. (culling enabled by default).
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/CullingBvh.h"
+
+#include <utils/JobSystem.h>
+#include <utils/Systrace.h>
+
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <limits>
+
+using namespace filament::math;
+using namespace utils;
+
+namespace filament {
+namespace details {
+
+// Fully visible subtrees are split in ranges of at most this many boxes, so they can be
+// distributed over several jobs.
+static constexpr uint32_t ACCEPTED_RANGE_MAX_COUNT = 1024;
+
+CullingBvh::CullingBvh() noexcept = default;
+
+CullingBvh::~CullingBvh() noexcept = default;
+
+void CullingBvh::clear() noexcept {
+    mNodes.clear();
+    mIndices.clear();
+    mCenters.clear();
+    mExtents.clear();
+}
+
+void CullingBvh::build(float3 const* center, float3 const* extent, size_t count) {
+    SYSTRACE_CALL();
+
+    clear();
+    if (!count) {
+        return;
+    }
+
+    mIndices.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        mIndices[i] = i;
+    }
+
+    // leaves hold at least LEAF_SIZE/2 boxes and there are less than twice as many nodes
+    mNodes.reserve(4 * ((count + LEAF_SIZE - 1) / LEAF_SIZE));
+    mNodes.push_back({ {}, {}, 0, uint32_t(count), 0 });
+    buildRecursive(0, center);
+
+    // the flat culler processes boxes by multiple of Culler::MODULO, but leaves don't start on
+    // such a boundary, so we need some padding.
+    mCenters.resize(Culler::round(count) + Culler::MODULO);
+    mExtents.resize(Culler::round(count) + Culler::MODULO);
+
+    refit(center, extent);
+}
+
+void CullingBvh::buildRecursive(uint32_t index, float3 const* center) noexcept {
+    uint32_t const first = mNodes[index].first;
+    uint32_t const count = mNodes[index].count;
+    if (count <= LEAF_SIZE) {
+        return;
+    }
+
+    // we split along the largest axis of the centers' bounds, at the median, which guarantees
+    // a balanced tree.
+    uint32_t* const indices = mIndices.data() + first;
+    float3 lo{ std::numeric_limits<float>::max() };
+    float3 hi{ std::numeric_limits<float>::lowest() };
+    for (uint32_t i = 0; i < count; i++) {
+        lo = min(lo, center[indices[i]]);
+        hi = max(hi, center[indices[i]]);
+    }
+    float3 const size = hi - lo;
+    size_t const axis = (size.x >= size.y && size.x >= size.z) ? 0 : (size.y >= size.z ? 1 : 2);
+
+    uint32_t const half = count / 2;
+    std::nth_element(indices, indices + half, indices + count,
+            [center, axis](uint32_t lhs, uint32_t rhs) {
+                return center[lhs][axis] < center[rhs][axis];
+            });
+
+    // note: this invalidates references to mNodes
+    uint32_t const child = uint32_t(mNodes.size());
+    mNodes.push_back({ {}, {}, first, half, 0 });
+    mNodes.push_back({ {}, {}, first + half, count - half, 0 });
+    mNodes[index].child = child;
+
+    buildRecursive(child, center);
+    buildRecursive(child + 1, center);
+}
+
+void CullingBvh::refit(float3 const* center, float3 const* extent) noexcept {
+    SYSTRACE_CALL();
+
+    // gather the boxes in leaf order, so that the leaves can be processed by the flat culler
+    uint32_t const* const UTILS_RESTRICT indices = mIndices.data();
+    float3* const UTILS_RESTRICT centers = mCenters.data();
+    float3* const UTILS_RESTRICT extents = mExtents.data();
+    for (size_t i = 0, c = mIndices.size(); i < c; i++) {
+        centers[i] = center[indices[i]];
+        extents[i] = extent[indices[i]];
+    }
+
+    // children are always stored after their parent, so we can update the bounds bottom-up
+    // by walking the nodes backward.
+    Node* const nodes = mNodes.data();
+    for (size_t n = mNodes.size(); n-- > 0;) {
+        Node& node = nodes[n];
+        float3 lo;
+        float3 hi;
+        if (node.child) {
+            Node const& l = nodes[node.child];
+            Node const& r = nodes[node.child + 1];
+            lo = min(l.center - l.extent, r.center - r.extent);
+            hi = max(l.center + l.extent, r.center + r.extent);
+        } else {
+            lo = float3{ std::numeric_limits<float>::max() };
+            hi = float3{ std::numeric_limits<float>::lowest() };
+            for (size_t i = node.first, e = node.first + node.count; i < e; i++) {
+                lo = min(lo, centers[i] - extents[i]);
+                hi = max(hi, centers[i] + extents[i]);
+            }
+        }
+        node.center = (hi + lo) * 0.5f;
+        node.extent = (hi - lo) * 0.5f;
+    }
+}
+
+CullingBvh::Classification CullingBvh::classify(
+        float4 const* planes, Node const& node) noexcept {
+    // This uses the same plane/box test as Culler::intersects(), plus a test for boxes that
+    // are entirely on the inner side of all planes.
+    bool inside = true;
+    for (size_t j = 0; j < 6; j++) {
+        const float d = dot(planes[j].xyz, node.center) + planes[j].w;
+        const float r = dot(abs(planes[j].xyz), node.extent);
+        if (d - r >= 0.0f) {
+            return Classification::OUTSIDE;
+        }
+        inside &= (d + r < 0.0f);
+    }
+    return inside ? Classification::INSIDE : Classification::INTERSECTS;
+}
+
+void CullingBvh::intersects(JobSystem& js, Culler::result_type* results,
+        Frustum const& frustum, size_t bit) const noexcept {
+    SYSTRACE_CALL();
+
+    if (UTILS_UNLIKELY(mNodes.empty())) {
+        return;
+    }
+
+    // First, walk the hierarchy and collect the ranges of boxes that are either fully inside
+    // the frustum, or need to be tested individually. This is cheap compared to
+    // processing the ranges themselves, which we do in parallel below.
+
+    float4 const* const planes = frustum.getNormalizedPlanes();
+    std::vector<Range>& work = mWorkList;
+    work.clear();
+
+    uint32_t stack[64];
+    size_t sp = 0;
+    stack[sp++] = 0;
+    while (sp) {
+        Node const& node = mNodes[stack[--sp]];
+        switch (classify(planes, node)) {
+            case Classification::OUTSIDE:
+                break;
+            case Classification::INSIDE:
+                for (uint32_t i = 0; i < node.count; i += ACCEPTED_RANGE_MAX_COUNT) {
+                    work.push_back({ node.first + i,
+                            std::min(node.count - i, ACCEPTED_RANGE_MAX_COUNT), true });
+                }
+                break;
+            case Classification::INTERSECTS:
+                if (node.child) {
+                    // the tree is balanced, so its depth is at most log2(2^32 / LEAF_SIZE)
+                    assert(sp + 2 <= sizeof(stack) / sizeof(*stack));
+                    stack[sp++] = node.child + 1;
+                    stack[sp++] = node.child;
+                } else {
+                    work.push_back({ node.first, node.count, false });
+                }
+                break;
+        }
+    }
+
+    if (work.empty()) {
+        return;
+    }
+
+    uint32_t const* const indices = mIndices.data();
+    float3 const* const centers = mCenters.data();
+    float3 const* const extents = mExtents.data();
+    Range const* const ranges = work.data();
+    auto functor = [&frustum, results, indices, centers, extents, ranges, bit]
+            (uint32_t index, uint32_t c) {
+        for (Range const* range = ranges + index, *end = range + c; range != end; ++range) {
+            uint32_t const* const rows = indices + range->first;
+            if (range->accepted) {
+                const Culler::result_type visible = Culler::result_type(1u << bit);
+                for (uint32_t i = 0; i < range->count; i++) {
+                    results[rows[i]] |= visible;
+                }
+            } else {
+                // the leaf kernel is the regular SIMD culler, which works on contiguous arrays
+                alignas(16) Culler::result_type visibles[LEAF_SIZE] = {};
+                Culler::intersects(visibles, frustum,
+                        centers + range->first, extents + range->first, range->count, bit);
+                for (uint32_t i = 0; i < range->count; i++) {
+                    results[rows[i]] |= visibles[i];
+                }
+            }
+        }
+    };
+
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(work.size()),
+            std::cref(functor), jobs::CountSplitter<4, 8>());
+    js.runAndWait(job);
+}
+
+} // namespace details
+} // namespace filament
@@ -36,9 +36,12 @@
 
 #include "fg/ResourceAllocator.h"
 
+#include "private/backend/CommandStreamCapture.h"
 
 #include <private/filament/SibGenerator.h>
+#include <private/filament/Variant.h>
 
+#include <filament/EngineCoroutines.h>
 #include <filament/MaterialEnums.h>
 
 #include <utils/compiler.h>
@@ -46,6 +49,7 @@
 #include <utils/Panic.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
 #include <memory>
 
 #include "generated/resources/materials.h"
@@ -171,8 +175,11 @@ FEngine::FEngine(Backend backend, Platform* platform, void* sharedGLContext) :
         mTransformManager(),
         mLightManager(*this),
         mCameraManager(*this),
-        mCommandBufferQueue(CONFIG_MIN_COMMAND_BUFFERS_SIZE, CONFIG_COMMAND_BUFFERS_SIZE),
-        mPerRenderPassAllocator("per-renderpass allocator", CONFIG_PER_RENDER_PASS_ARENA_SIZE),
+        mCommandBufferQueue(CONFIG_MIN_COMMAND_BUFFERS_SIZE, CONFIG_COMMAND_BUFFERS_SIZE,
+                CONFIG_PER_FRAME_MEMORY_BACKING),
+        mPerRenderPassAllocator("per-renderpass allocator", CONFIG_PER_RENDER_PASS_ARENA_SIZE,
+                CONFIG_PER_FRAME_MEMORY_BACKING,
+                CONFIG_PER_RENDER_PASS_ARENA_BLOCK_SIZE, CONFIG_PER_FRAME_MEMORY_BACKING),
         mEngineEpoch(std::chrono::steady_clock::now()),
         mDriverBarrier(1)
 {
@@ -181,6 +188,12 @@ FEngine::FEngine(Backend backend, Platform* platform, void* sharedGLContext) :
     // we're assuming we're on the main thread here.
     // (it may not be the case)
     mJobSystem.adopt();
+
+    mHeapAllocator.getListener().setCounter(&getMemoryCounter(MemoryTag::OBJECTS));
+    mPerRenderPassAllocator.getAllocator().setMemoryCounter(
+            &getMemoryCounter(MemoryTag::PER_FRAME_ARENAS));
+    getMemoryCounter(MemoryTag::COMMAND_BUFFERS).add(
+            mCommandBufferQueue.getCircularBuffer().size());
 }
 
 /*
@@ -193,7 +206,11 @@ void FEngine::init() {
     mCommandStream = CommandStream(*mDriver, mCommandBufferQueue.getCircularBuffer());
     DriverApi& driverApi = getDriverApi();
 
-    mResourceAllocator = new fg::ResourceAllocator(driverApi);
+    // no handles have been created yet
+    mDriver->setHandleMemoryCounter(&getMemoryCounter(MemoryTag::HANDLES));
+
+    mResourceAllocator = new fg::ResourceAllocator(driverApi,
+            getMemoryCounter(MemoryTag::RESOURCE_CACHE));
 
     mFullScreenTriangleVb = upcast(VertexBuffer::Builder()
             .vertexCount(3)
@@ -245,6 +262,14 @@ void FEngine::init() {
                     .package(MATERIALS_DEFAULTMATERIAL_DATA, MATERIALS_DEFAULTMATERIAL_SIZE)
                     .build(*const_cast<FEngine*>(this)));
 
+    // Create its depth programs right away, rather than when the first material is created.
+    // This way, materials can be created from producer threads (see attachProducerThread()).
+    for (uint8_t i = 0; i < VARIANT_COUNT; i++) {
+        if (Variant(i).isDepthPass()) {
+            mDefaultMaterial->getProgram(i);
+        }
+    }
+
     mPostProcessManager.init();
     mLightManager.init(*this);
     mDFG = std::make_unique<DFG>(*this);
@@ -266,6 +291,16 @@ void FEngine::shutdown() {
     size_t wmpct = wm / (CONFIG_COMMAND_BUFFERS_SIZE / 100);
     slog.d << "CircularBuffer: High watermark "
            << wm / 1024 << " KiB (" << wmpct << "%)" << io::endl;
+    auto const stats = mCommandBufferQueue.getStats();
+    slog.d << "CommandBufferQueue: main thread stalled " << stats.producerStallCount
+           << " times (" << stats.producerStallTime / 1000000 << " ms), driver thread stalled "
+           << stats.consumerStallCount << " times ("
+           << stats.consumerStallTime / 1000000 << " ms)" << io::endl;
+    auto const& perRenderPassAllocator = mPerRenderPassAllocator.getAllocator();
+    slog.d << "Per render pass arena: High watermark "
+           << perRenderPassAllocator.getHighWatermark() / 1024 << " KiB, capacity "
+           << perRenderPassAllocator.getCapacity() / 1024 << " KiB in "
+           << perRenderPassAllocator.getBlockCount() << " blocks" << io::endl;
 #endif
 
     DriverApi& driver = getDriverApi();
@@ -334,6 +369,21 @@ void FEngine::shutdown() {
 
     }
 
+    // all commands have been executed, so all the producers can be destroyed now. Producer
+    // threads should all be detached at this point.
+    collectProducers();
+    assert(mDetachedProducers.empty());
+    if (UTILS_UNLIKELY(!mProducers.empty())) {
+        slog.w << mProducers.size() << " producer threads were not detached" << io::endl;
+        for (auto& producer : mProducers) {
+            mCommandBufferQueue.detachSource(&producer->queue);
+            getMemoryCounter(MemoryTag::COMMAND_BUFFERS).remove(
+                    producer->queue.getCircularBuffer().size());
+        }
+        mProducers.clear();
+        mHasProducers.store(false, std::memory_order_relaxed);
+    }
+
     // Finally, call user callbacks that might have been scheduled.
     // These callbacks CANNOT call driver APIs.
     getDriver().purge();
@@ -361,9 +411,28 @@ void FEngine::prepare() {
     }
 
     // Commit default material instances.
-    for (auto& material : mMaterials) {
+    mMaterials.forEach([&driver](FMaterial* material) {
         material->getDefaultInstance()->commit(driver);
+    });
+
+    // forget the components' changes all the scenes have already seen
+    ChangeJournal& transformJournal = mTransformManager.getChangeJournal();
+    ChangeJournal& renderableJournal = mRenderableManager.getChangeJournal();
+    ChangeJournal& lightJournal = mLightManager.getChangeJournal();
+    ChangeJournal::Position transforms = transformJournal.tell();
+    ChangeJournal::Position renderables = renderableJournal.tell();
+    ChangeJournal::Position lights = lightJournal.tell();
+    for (FScene const* scene : mScenes) {
+        FScene::JournalPositions const* positions = scene->getJournalPositions();
+        if (positions) {
+            transforms = std::min(transforms, positions->transforms);
+            renderables = std::min(renderables, positions->renderables);
+            lights = std::min(lights, positions->lights);
+        }
     }
+    transformJournal.trim(transforms);
+    renderableJournal.trim(renderables);
+    lightJournal.trim(lights);
 }
 
 void FEngine::gc() {
@@ -402,6 +471,127 @@ void FEngine::flushAndWait() {
     getDriver().purge();
 }
 
+Engine::MemoryStats FEngine::getMemoryStats(MemoryTag tag) const noexcept {
+    assert(tag < MemoryTag::COUNT);
+    MemoryCounter const& counter = mMemoryCounters[size_t(tag)];
+    return { counter.getCurrent(), counter.getPeak() };
+}
+
+void FEngine::resetMemoryPeaks() noexcept {
+    for (MemoryCounter& counter : mMemoryCounters) {
+        counter.resetPeak();
+    }
+}
+
+utils::JobSystem::Job* FEngine::flushAsync(bool finish) noexcept {
+    JobSystem& js = mJobSystem;
+
+    // 'done' can't finish before its child 'latch', which is finished by the driver thread when
+    // it reaches the command below, i.e. after executing all the commands issued so far.
+    JobSystem::Job* done = js.createJob();
+    if (UTILS_UNLIKELY(!done)) {
+        return nullptr;
+    }
+    JobSystem::Job* latch = js.createJob(done);
+    if (UTILS_UNLIKELY(!latch)) {
+        js.cancel(done);
+        return nullptr;
+    }
+    done = js.runAndRetain(done);
+
+    DriverApi& driver = getDriverApi();
+    if (finish) {
+        driver.finish();
+    }
+    driver.queueCommand([&js, latch]() mutable {
+        js.cancel(latch);
+    });
+    flush();
+    return done;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+UTILS_DEFINE_TLS(FEngine::Producer*) FEngine::sProducer(nullptr);
+
+FEngine::Producer::Producer(FEngine& engine, Driver& driver) noexcept
+        : engine(engine),
+          queue(CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE, CONFIG_PRODUCER_COMMAND_BUFFERS_SIZE),
+          stream(driver, queue.getCircularBuffer()) {
+}
+
+void FEngine::attachProducerThread() {
+    Producer* const current = sProducer;
+    ASSERT_PRECONDITION(!current, "This thread is already a producer thread");
+
+    std::unique_ptr<Producer> producer(new Producer(*this, getDriver()));
+    getMemoryCounter(MemoryTag::COMMAND_BUFFERS).add(producer->queue.getCircularBuffer().size());
+    mCommandBufferQueue.attachSource(&producer->queue);
+    sProducer = producer.get();
+
+    std::lock_guard<Mutex> lock(mProducersLock);
+    mProducers.push_back(std::move(producer));
+    mHasProducers.store(true, std::memory_order_relaxed);
+}
+
+void FEngine::flushProducerThread() noexcept {
+    Producer* const producer = sProducer;
+    assert(producer && &producer->engine == this);
+    producer->queue.flush();
+}
+
+void FEngine::detachProducerThread() noexcept {
+    Producer* const producer = sProducer;
+    assert(producer && &producer->engine == this);
+    producer->queue.flush();
+    sProducer = nullptr;
+
+    // the producer is destroyed by the driver thread, once all its commands are executed
+    std::lock_guard<Mutex> lock(mProducersLock);
+    mDetachedProducers.push_back(producer);
+    mHasDetachedProducers.store(true, std::memory_order_release);
+}
+
+FEngine::DriverApi& FEngine::getProducerDriverApi() noexcept {
+    Producer* const producer = sProducer;
+    if (!producer || &producer->engine != this) {
+        return mCommandStream;
+    }
+
+    // Only CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE bytes of commands are guaranteed to fit
+    // between two flushes, producer threads don't have a frame to flush them regularly, so we
+    // flush when we're halfway there.
+    CircularBuffer const& buffer = producer->queue.getCircularBuffer();
+    const size_t used = uintptr_t(buffer.getHead()) - uintptr_t(buffer.getTail());
+    if (UTILS_UNLIKELY(used > CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE / 2)) {
+        producer->queue.flush();
+    }
+    return producer->stream;
+}
+
+void FEngine::collectProducers() noexcept {
+    // this runs on the driver thread, which is the only one releasing command buffers, so a
+    // producer that's released can't be accessed by anyone anymore.
+    std::lock_guard<Mutex> lock(mProducersLock);
+    auto& detached = mDetachedProducers;
+    detached.erase(std::remove_if(detached.begin(), detached.end(), [this](Producer* producer) {
+        if (!producer->queue.isReleased()) {
+            return false;
+        }
+        mCommandBufferQueue.detachSource(&producer->queue);
+        getMemoryCounter(MemoryTag::COMMAND_BUFFERS).remove(
+                producer->queue.getCircularBuffer().size());
+        mProducers.erase(std::find_if(mProducers.begin(), mProducers.end(),
+                [producer](std::unique_ptr<Producer> const& p) { return p.get() == producer; }));
+        return true;
+    }), detached.end());
+    mHasDetachedProducers.store(!detached.empty(), std::memory_order_relaxed);
+
+    // Without producers, getDriverApi() can skip the thread-local lookup again. This can't race
+    // with attachProducerThread(), which sets it under the same lock.
+    mHasProducers.store(!mProducers.empty(), std::memory_order_relaxed);
+}
+
 // -----------------------------------------------------------------------------------------------
 // Render thread / command queue
 // -----------------------------------------------------------------------------------------------
@@ -469,6 +659,21 @@ int FEngine::loop() {
         return 0;
     }
 
+#if FILAMENT_ENABLE_COMMAND_CAPTURE
+    // Records the commands executed during the first frames, they can be played back with the
+    // cmdreplay tool.
+    const char* capturePath = getenv("FILAMENT_CAPTURE_COMMANDS");
+    if (capturePath != nullptr) {
+        const char* framesString = getenv("FILAMENT_CAPTURE_FRAMES");
+        const int frames = framesString ? atoi(framesString) : 1;
+        mCommandStreamCapture = std::make_unique<CommandStreamCapture>(
+                capturePath, uint32_t(std::max(frames, 1)));
+        if (!mCommandStreamCapture->isValid()) {
+            mCommandStreamCapture.reset();
+        }
+    }
+#endif
+
     // We use the highest affinity bit, assuming this is a Big core in a  big.little
     // configuration. This is also a core not used by the JobSystem.
     // Either way the main reason to do this is to avoid this thread jumping from core to core
@@ -483,6 +688,11 @@ int FEngine::loop() {
         }
     }
 
+#if FILAMENT_ENABLE_COMMAND_CAPTURE
+    // completes the capture if the engine is destroyed before the last captured frame
+    mCommandStreamCapture.reset();
+#endif
+
     // terminate() is a synchronous API
     getDriverApi().terminate();
     return 0;
@@ -510,8 +720,8 @@ const FMaterial* FEngine::getSkyboxMaterial() const noexcept {
  * Object created from a Builder
  */
 
-template <typename T>
-inline T* FEngine::create(ResourceList<T>& list, typename T::Builder const& builder) noexcept {
+template <typename T, typename L>
+inline T* FEngine::create(ResourceList<T, L>& list, typename T::Builder const& builder) noexcept {
     T* p = mHeapAllocator.make<T>(*this, builder);
     list.insert(p);
     return p;
@@ -788,12 +998,24 @@ bool FEngine::execute() {
     }
 
     // execute all command buffers
+    const clock::time_point start = clock::now();
     for (auto& item : buffers) {
         if (UTILS_LIKELY(item.begin)) {
+#if FILAMENT_ENABLE_COMMAND_CAPTURE
+            if (UTILS_UNLIKELY(mCommandStreamCapture) &&
+                    !mCommandStreamCapture->capture(item.begin)) {
+                mCommandStreamCapture.reset();
+            }
+#endif
             mCommandStream.execute(item.begin);
             mCommandBufferQueue.releaseBuffer(item);
         }
     }
+    mDriverExecutionTime.fetch_add((clock::now() - start).count(), std::memory_order_relaxed);
+
+    if (UTILS_UNLIKELY(mHasDetachedProducers.load(std::memory_order_acquire))) {
+        collectProducers();
+    }
 
     return true;
 }
@@ -943,6 +1165,22 @@ void Engine::flushAndWait() {
     upcast(this)->flushAndWait();
 }
 
+utils::JobSystem::Job* flushAsync(Engine& engine, bool finish) noexcept {
+    return upcast(&engine)->flushAsync(finish);
+}
+
+void Engine::attachProducerThread() {
+    upcast(this)->attachProducerThread();
+}
+
+void Engine::flushProducerThread() noexcept {
+    upcast(this)->flushProducerThread();
+}
+
+void Engine::detachProducerThread() noexcept {
+    upcast(this)->detachProducerThread();
+}
+
 RenderableManager& Engine::getRenderableManager() noexcept {
     return upcast(this)->getRenderableManager();
 }
@@ -971,5 +1209,17 @@ DebugRegistry& Engine::getDebugRegistry() noexcept {
     return upcast(this)->getDebugRegistry();
 }
 
+utils::JobSystem& Engine::getJobSystem() noexcept {
+    return upcast(this)->getJobSystem();
+}
+
+Engine::MemoryStats Engine::getMemoryStats(MemoryTag tag) const noexcept {
+    return upcast(this)->getMemoryStats(tag);
+}
+
+void Engine::resetMemoryPeaks() noexcept {
+    upcast(this)->resetMemoryPeaks();
+}
+
 
 } // namespace filament
@@ -57,17 +57,22 @@ IndexBuffer* IndexBuffer::Builder::build(Engine& engine) {
 namespace details {
 
 FIndexBuffer::FIndexBuffer(FEngine& engine, const IndexBuffer::Builder& builder)
-        : mIndexCount(builder->mIndexCount) {
+        : mIndexCount(builder->mIndexCount),
+          mIndexSize(builder->mIndexType == IndexType::USHORT ? 2 : 4) {
     FEngine::DriverApi& driver = engine.getDriverApi();
     mHandle = driver.createIndexBuffer(
             (backend::ElementType)builder->mIndexType,
             uint32_t(builder->mIndexCount),
             backend::BufferUsage::STATIC);
+    engine.getMemoryCounter(Engine::MemoryTag::INDEX_BUFFERS).add(
+            size_t(mIndexCount) * mIndexSize);
 }
 
 void FIndexBuffer::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
     driver.destroyIndexBuffer(mHandle);
+    engine.getMemoryCounter(Engine::MemoryTag::INDEX_BUFFERS).remove(
+            size_t(mIndexCount) * mIndexSize);
 }
 
 void FIndexBuffer::setBuffer(FEngine& engine, BufferDescriptor&& buffer, uint32_t byteOffset) {
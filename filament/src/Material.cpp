@@ -390,10 +390,17 @@ Program FMaterial::getProgramBuilderWithVariants(
 
 backend::Handle<backend::HwProgram> FMaterial::createAndCacheProgram(Program&& p,
         uint8_t variantKey) const noexcept {
+    size_t size = 0;
+    for (auto const& source : p.getShadersSource()) {
+        size += source.size();
+    }
+
     auto program = mEngine.getDriverApi().createProgram(std::move(p));
     assert(program);
 
     mCachedPrograms[variantKey] = program;
+    mCachedProgramSizes[variantKey] = uint32_t(size);
+    mEngine.getMemoryCounter(Engine::MemoryTag::PROGRAMS).add(size);
     return program;
 }
 
@@ -506,6 +513,8 @@ void FMaterial::destroyPrograms(FEngine& engine) {
             }
         }
         driverApi.destroyProgram(cachedPrograms[i]);
+        engine.getMemoryCounter(Engine::MemoryTag::PROGRAMS).remove(mCachedProgramSizes[i]);
+        mCachedProgramSizes[i] = 0;
     }
 }
 
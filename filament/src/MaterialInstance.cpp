@@ -56,6 +56,7 @@ FMaterialInstance::FMaterialInstance(FEngine& engine, FMaterial const* material)
     if (!material->getUniformInterfaceBlock().isEmpty()) {
         mUniforms.setUniforms(material->getDefaultInstance()->getUniformBuffer());
         mUbHandle = driver.createUniformBuffer(mUniforms.getSize(), backend::BufferUsage::DYNAMIC);
+        engine.getMemoryCounter(Engine::MemoryTag::UNIFORM_BUFFERS).add(mUniforms.getSize());
     }
 
     if (!material->getSamplerInterfaceBlock().isEmpty()) {
@@ -82,6 +83,7 @@ void FMaterialInstance::initDefaultInstance(FEngine& engine, FMaterial const* ma
     if (!material->getUniformInterfaceBlock().isEmpty()) {
         mUniforms = UniformBuffer(material->getUniformInterfaceBlock().getSize());
         mUbHandle = driver.createUniformBuffer(mUniforms.getSize(), backend::BufferUsage::STATIC);
+        engine.getMemoryCounter(Engine::MemoryTag::UNIFORM_BUFFERS).add(mUniforms.getSize());
     }
 
     if (!material->getSamplerInterfaceBlock().isEmpty()) {
@@ -98,6 +100,7 @@ void FMaterialInstance::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
     driver.destroyUniformBuffer(mUbHandle);
     driver.destroySamplerGroup(mSbHandle);
+    engine.getMemoryCounter(Engine::MemoryTag::UNIFORM_BUFFERS).remove(mUniforms.getSize());
 }
 
 void FMaterialInstance::initParameters(FMaterial const* material) {
@@ -123,7 +126,7 @@ void FMaterialInstance::initParameters(FMaterial const* material) {
 void FMaterialInstance::commitSlow(DriverApi& driver) const {
     // update uniforms if needed
     if (mUniforms.isDirty()) {
-        driver.loadUniformBuffer(mUbHandle, mUniforms.toBufferDescriptor(driver));
+        mUniforms.commit(driver, mUbHandle);
     }
     if (mSamplers.isDirty()) {
         driver.updateSamplerGroup(mSbHandle, std::move(mSamplers.toCommandStream()));
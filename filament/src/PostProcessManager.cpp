@@ -366,7 +366,8 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::dynamicScaling(FrameGraph& f
 
 FrameGraphId<FrameGraphTexture> PostProcessManager::ssao(FrameGraph& fg, RenderPass& pass,
         filament::Viewport const& svp, CameraInfo const& cameraInfo,
-        View::AmbientOcclusionOptions const& options) noexcept {
+        View::AmbientOcclusionOptions const& options,
+        View::RenderPassStats* depthPassStats) noexcept {
 
     FEngine& engine = mEngine;
     Handle<HwRenderPrimitive> fullScreenRenderPrimitive = engine.getFullScreenRenderPrimitive();
@@ -375,7 +376,8 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::ssao(FrameGraph& fg, RenderP
      * SSAO depth pass -- automatically culled if not used
      */
 
-    FrameGraphId<FrameGraphTexture> depth = depthPass(fg, pass, svp.width, svp.height, options);
+    FrameGraphId<FrameGraphTexture> depth = depthPass(fg, pass, svp.width, svp.height, options,
+            depthPassStats);
 
     /*
      * create depth mipmap chain
@@ -475,7 +477,8 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::ssao(FrameGraph& fg, RenderP
 
 FrameGraphId<FrameGraphTexture> PostProcessManager::depthPass(FrameGraph& fg, RenderPass& pass,
         uint32_t width, uint32_t height,
-        View::AmbientOcclusionOptions const& options) noexcept {
+        View::AmbientOcclusionOptions const& options,
+        View::RenderPassStats* stats) noexcept {
 
     // SSAO depth pass -- automatically culled if not used
     struct DepthPassData {
@@ -513,7 +516,8 @@ FrameGraphId<FrameGraphTexture> PostProcessManager::depthPass(FrameGraph& fg, Re
             [=, &pass](FrameGraphPassResources const& resources,
                     DepthPassData const& data, DriverApi& driver) {
                 auto out = resources.getRenderTarget(data.rt);
-                pass.execute(resources.getPassName(), out.target, out.params, first, last);
+                pass.execute(resources.getPassName(), out.target, out.params, first, last,
+                        stats);
             });
 
     return ssaoDepthPass.getData().depth;
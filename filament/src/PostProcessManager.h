@@ -60,7 +60,8 @@ public:
     FrameGraphId<FrameGraphTexture> ssao(FrameGraph& fg, details::RenderPass& pass,
             filament::Viewport const& svp,
             details::CameraInfo const& cameraInfo,
-            View::AmbientOcclusionOptions const& options) noexcept;
+            View::AmbientOcclusionOptions const& options,
+            View::RenderPassStats* depthPassStats = nullptr) noexcept;
 
     backend::Handle<backend::HwTexture> getNoSSAOTexture() const {
         return mNoSSAOTexture;
@@ -70,7 +71,8 @@ private:
     details::FEngine& mEngine;
 
     FrameGraphId<FrameGraphTexture> depthPass(FrameGraph& fg, details::RenderPass& pass,
-            uint32_t width, uint32_t height, View::AmbientOcclusionOptions const& options) noexcept;
+            uint32_t width, uint32_t height, View::AmbientOcclusionOptions const& options,
+            View::RenderPassStats* stats) noexcept;
 
     FrameGraphId<FrameGraphTexture> mipmapPass(FrameGraph& fg,
             FrameGraphId<FrameGraphTexture> input, size_t level) noexcept;
@@ -28,8 +28,11 @@
 #include <private/filament/UibGenerator.h>
 
 #include <utils/JobSystem.h>
+#include <utils/RadixSort.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 using namespace utils;
@@ -56,13 +59,22 @@ void RenderPass::setGeometry(FScene::RenderableSoa const& soa, Range<uint32_t> v
 }
 
 void RenderPass::setCamera(const CameraInfo& camera) noexcept {
-    mCamera = camera;
+    // the world origin is applied by the vertex shader, the renderables' world-space data
+    // (used for sorting) doesn't include it, so we bring the camera back in that space.
+    const mat4f model{ FCamera::rigidTransformInverse(camera.worldOrigin) * camera.model };
+    mCameraPosition = model[3].xyz;
+    mCameraForwardVector = normalize(-model[2].xyz);
+    mWorldOriginReversed = det(camera.worldOrigin.upperLeft()) < 0;
 }
 
 void RenderPass::setRenderFlags(RenderPass::RenderFlags flags) noexcept {
     mFlags = flags;
 }
 
+void RenderPass::setFrameTimings(FrameTimings* timings) noexcept {
+    mFrameTimings = timings;
+}
+
 void RenderPass::overridePolygonOffset(backend::PolygonOffset* polygonOffset) noexcept {
     if ((mPolygonOffsetOverride = (polygonOffset != nullptr))) {
         mPolygonOffset = *polygonOffset;
@@ -76,12 +88,12 @@ void RenderPass::overrideMaterial(FMaterial const* material, FMaterialInstance c
 
 RenderPass::Command* RenderPass::appendCommands(CommandTypeFlags const commandTypeFlags) noexcept {
     SYSTRACE_CONTEXT();
+    FrameTimings::Scope timer(mFrameTimings, &FrameTimings::commands);
 
     FEngine& engine = mEngine;
     JobSystem& js = engine.getJobSystem();
     GrowingSlice<Command>& commands = mCommands;
-    const RenderFlags renderFlags = mFlags;
-    CameraInfo const& camera = mCamera;
+    const RenderFlags renderFlags = getEffectiveRenderFlags();
     utils::Range<uint32_t> vr = mVisibleRenderables;
     if (UTILS_UNLIKELY(vr.empty())) {
         return commands.end();
@@ -96,19 +108,17 @@ RenderPass::Command* RenderPass::appendCommands(CommandTypeFlags const commandTy
     updateSummedPrimitiveCounts(const_cast<FScene::RenderableSoa&>(soa), vr);
 
     // compute how much maximum storage we need for this pass
-    uint32_t growBy = FScene::getPrimitiveCount(soa, vr.last);
-    // double the color pass for transparent objects that need to render twice
-    const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
-    const bool depthPass  = bool(commandTypeFlags & CommandTypeFlags::DEPTH);
-    growBy *= uint32_t(colorPass * 2 + depthPass);
+    const uint32_t commandsPerPrimitive = getCommandsPerPrimitive(commandTypeFlags);
+    uint32_t growBy = FScene::getPrimitiveCount(soa, vr.last) * commandsPerPrimitive;
     Command* const curr = commands.grow(growBy);
 
-    // we extract camera position/forward outside of the loop, because these are not cheap.
-    const float3 cameraPosition(camera.getPosition());
-    const float3 cameraForwardVector(camera.getForwardVector());
-    auto work = [commandTypeFlags, curr, &soa, renderFlags, cameraPosition, cameraForwardVector]
-            (uint32_t startIndex, uint32_t indexCount) {
-        RenderPass::generateCommands(commandTypeFlags, curr,
+    const float3 cameraPosition(mCameraPosition);
+    const float3 cameraForwardVector(mCameraForwardVector);
+    auto work = [commandTypeFlags, commandsPerPrimitive, curr, &soa, renderFlags,
+            cameraPosition, cameraForwardVector](uint32_t startIndex, uint32_t indexCount) {
+        // each job writes its commands at the offset given by the summed primitive counts
+        uint32_t offset = FScene::getPrimitiveCount(soa, startIndex) * commandsPerPrimitive;
+        RenderPass::generateCommands(commandTypeFlags, curr + offset,
                 soa, { startIndex, startIndex + indexCount }, renderFlags,
                 cameraPosition, cameraForwardVector);
     };
@@ -151,10 +161,20 @@ RenderPass::Command* RenderPass::appendCustomCommand(Pass pass, CustomCommand cu
 
 RenderPass::Command* RenderPass::sortCommands(Command* curr) noexcept {
     SYSTRACE_NAME("sort and trim commands");
+    FrameTimings::Scope timer(mFrameTimings, &FrameTimings::sort);
 
     GrowingSlice<Command>& commands = mCommands;
 
-    std::sort(curr, commands.end());
+    // Command keys are 64-bit integers which use only a few of their bits in a given pass, so a
+    // radix sort is faster than a comparison sort. It needs a scratch area as large as the
+    // commands to sort, for which we use the unused tail of the command buffer if possible.
+    const size_t count = size_t(commands.end() - curr);
+    if (UTILS_LIKELY(commands.remain() >= count)) {
+        jobs::parallel_radix_sort(mEngine.getJobSystem(), curr, commands.end(), commands.end(),
+                [](Command const& c) { return c.key; });
+    } else {
+        std::sort(curr, commands.end());
+    }
 
     // find the last command
     Command const* const last = std::partition_point(curr, commands.end(),
@@ -167,10 +187,179 @@ RenderPass::Command* RenderPass::sortCommands(Command* curr) noexcept {
     return commands.end();
 }
 
+// mixes 'v' into the hash 'h'
+static inline uint64_t hashCombine(uint64_t h, uint64_t v) noexcept {
+    v *= 0xff51afd7ed558ccdllu;
+    v ^= v >> 33u;
+    return h ^ (v + 0x9e3779b97f4a7c15llu + (h << 6u) + (h >> 2u));
+}
+
+// hashes everything generateCommands() reads for a given renderable
+static uint64_t hashCommandInputs(FScene::RenderableSoa const& soa, uint32_t i) noexcept {
+    float3 const& center = soa.data<FScene::WORLD_AABB_CENTER>()[i];
+    FRenderableManager::Visibility const visibility = soa.data<FScene::VISIBILITY_STATE>()[i];
+    uint64_t state = visibility.priority;
+    state |= uint64_t(visibility.castShadows) << 3u;
+    state |= uint64_t(visibility.receiveShadows) << 4u;
+    state |= uint64_t(visibility.skinning) << 5u;
+    state |= uint64_t(visibility.morphing) << 6u;
+    state |= uint64_t(soa.data<FScene::REVERSED_WINDING_ORDER>()[i]) << 7u;
+    state |= uint64_t(soa.data<FScene::BONES_UBH>()[i].getId()) << 32u;
+
+    uint64_t h = hashCombine(0, state);
+    h = hashCombine(h, soa.data<FScene::UBO_SLOT>()[i]);
+    h = hashCombine(h, reinterpret_cast<uint32_t const&>(center.x));
+    h = hashCombine(h, reinterpret_cast<uint32_t const&>(center.y));
+    h = hashCombine(h, reinterpret_cast<uint32_t const&>(center.z));
+    for (FRenderPrimitive const& primitive : soa.data<FScene::PRIMITIVES>()[i]) {
+        // the material's state is immutable, but the instance's culling mode isn't
+        FMaterialInstance const* const mi = primitive.getMaterialInstance();
+        uint64_t primitiveState = primitive.getHwHandle().getId();
+        primitiveState |= uint64_t(primitive.getBlendOrder()) << 32u;
+        primitiveState |= uint64_t(primitive.getPrimitiveType()) << 48u;
+        primitiveState |= uint64_t(mi->getCullingMode()) << 56u;
+        // the instance's address can be recycled, its material's id can't
+        h = hashCombine(h, uintptr_t(mi));
+        h = hashCombine(h, mi->getMaterial()->getId());
+        h = hashCombine(h, mi->getSortingKey());
+        h = hashCombine(h, primitiveState);
+    }
+    return h;
+}
+
+RenderPass::Command* RenderPass::appendSortedCommands(CommandTypeFlags const commandTypeFlags,
+        CommandCache& cache) noexcept {
+    SYSTRACE_CALL();
+
+    FEngine& engine = mEngine;
+    GrowingSlice<Command>& commands = mCommands;
+    Command* const curr = commands.end();
+    utils::Range<uint32_t> vr = mVisibleRenderables;
+    if (!engine.debug.renderer.command_cache || UTILS_UNLIKELY(vr.empty())) {
+        cache.invalidate();
+        appendCommands(commandTypeFlags);
+        return sortCommands(curr);
+    }
+    assert(mRenderableSoa);
+
+    JobSystem& js = engine.getJobSystem();
+    FScene::RenderableSoa const& soa = *mRenderableSoa;
+    const RenderFlags renderFlags = getEffectiveRenderFlags();
+    const float3 cameraPosition(mCameraPosition);
+    const float3 cameraForwardVector(mCameraForwardVector);
+
+    // hash the inputs common to all renderables...
+    uint64_t passKey = hashCombine(commandTypeFlags, renderFlags);
+    passKey = hashCombine(passKey, uintptr_t(&soa));
+    passKey = hashCombine(passKey, uint64_t(vr.first) | (uint64_t(vr.last) << 32u));
+    for (size_t i = 0; i < 3; i++) {
+        passKey = hashCombine(passKey, reinterpret_cast<uint32_t const&>(cameraPosition[i]));
+        passKey = hashCombine(passKey, reinterpret_cast<uint32_t const&>(cameraForwardVector[i]));
+    }
+
+    // ...and those of each renderable
+    std::vector<uint64_t>& rowHashes = cache.mNextRowHashes;
+    rowHashes.resize(vr.size());
+    auto work = [&soa, &rowHashes, first = vr.first](uint32_t startIndex, uint32_t indexCount) {
+        for (uint32_t i = startIndex, e = startIndex + indexCount; i < e; i++) {
+            rowHashes[i - first] = hashCommandInputs(soa, i);
+        }
+    };
+    auto jobHashParallel = jobs::parallel_for(js, nullptr, vr.first, (uint32_t)vr.size(),
+            std::cref(work), jobs::CountSplitter<JOBS_PARALLEL_FOR_COMMANDS_COUNT, 8>());
+    { // scope for the timer, hashing is accounted as commands generation
+        FrameTimings::Scope timer(mFrameTimings, &FrameTimings::commands);
+        js.runAndWait(jobHashParallel);
+    }
+
+    // the commands are identified by the UBO slot of their renderable
+    std::vector<uint32_t>& rowSlots = cache.mNextRowSlots;
+    rowSlots.assign(soa.data<FScene::UBO_SLOT>() + vr.first,
+            soa.data<FScene::UBO_SLOT>() + vr.last);
+
+    // The pass key includes the visible range, so both frames have the same number of rows.
+    // A row that changed can hold a different renderable than in the last frame, so the
+    // commands of both the previous and the current renderable must be replaced.
+    const bool reusable = cache.mValid && cache.mPassKey == passKey;
+    std::vector<uint32_t>& changedRows = cache.mChangedRows;
+    std::vector<uint32_t>& changedSlots = cache.mChangedSlots;
+    changedRows.clear();
+    changedSlots.clear();
+    if (reusable) {
+        for (uint32_t i = 0, c = uint32_t(vr.size()); i < c; i++) {
+            if (rowHashes[i] != cache.mRowHashes[i]) {
+                changedRows.push_back(vr.first + i);
+                changedSlots.push_back(cache.mRowSlots[i]);
+                changedSlots.push_back(rowSlots[i]);
+            }
+        }
+    }
+
+    std::swap(cache.mRowHashes, rowHashes);
+    std::swap(cache.mRowSlots, rowSlots);
+    cache.mPassKey = passKey;
+    cache.mValid = true;
+
+    if (!reusable || changedRows.size() * COMMAND_CACHE_PARTIAL_UPDATE_RATIO > vr.size()) {
+        appendCommands(commandTypeFlags);
+        Command* const last = sortCommands(curr);
+        cache.mCommands.assign(curr, last);
+        return last;
+    }
+
+    std::vector<Command>& cached = cache.mCommands;
+    std::vector<Command>& changed = cache.mChangedCommands;
+    changed.clear();
+    if (UTILS_UNLIKELY(!changedRows.empty())) {
+        SYSTRACE_NAME("update cached commands");
+        FrameTimings::Scope timer(mFrameTimings, &FrameTimings::commands);
+
+        // generate and sort the commands of the renderables that changed...
+        auto const* const primitives = soa.data<FScene::PRIMITIVES>();
+        const uint32_t commandsPerPrimitive = getCommandsPerPrimitive(commandTypeFlags);
+        size_t count = 0;
+        for (uint32_t i : changedRows) {
+            count += primitives[i].size() * commandsPerPrimitive;
+        }
+        changed.resize(count);
+        Command* p = changed.data();
+        for (uint32_t i : changedRows) {
+            generateCommands(commandTypeFlags, p, soa, { i, i + 1 }, renderFlags,
+                    cameraPosition, cameraForwardVector);
+            p += primitives[i].size() * commandsPerPrimitive;
+        }
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::partition_point(changed.begin(), changed.end(),
+                [](Command const& c) {
+                    return c.key != uint64_t(Pass::SENTINEL);
+                }), changed.end());
+
+        // ...and remove the previous commands of these rows
+        std::sort(changedSlots.begin(), changedSlots.end());
+        cached.erase(std::remove_if(cached.begin(), cached.end(),
+                [&changedSlots](Command const& c) {
+                    return std::binary_search(changedSlots.begin(), changedSlots.end(),
+                            uint32_t(c.primitive.index));
+                }), cached.end());
+    }
+
+    Command* const first = commands.grow(uint32_t(cached.size() + changed.size()));
+    Command* const last = std::merge(cached.begin(), cached.end(),
+            changed.begin(), changed.end(), first);
+    if (!changed.empty()) {
+        cached.assign(first, last);
+    }
+
+    mCommandsHighWatermark = std::max(mCommandsHighWatermark, size_t(commands.size()));
+
+    return last;
+}
+
 void RenderPass::execute(const char* name,
         backend::Handle<backend::HwRenderTarget> renderTarget,
         backend::RenderPassParams params,
-        Command const* first, Command const* last) const noexcept {
+        Command const* first, Command const* last,
+        View::RenderPassStats* stats) const noexcept {
 
     FEngine& engine = mEngine;
 
@@ -178,77 +367,305 @@ void RenderPass::execute(const char* name,
     DriverApi& driver = engine.getDriverApi();
 
     // Now, execute all commands
+    View::RenderPassStats passStats;
+    FrameTimings::Scope timer(mFrameTimings, &FrameTimings::recording);
     driver.pushGroupMarker(name);
     driver.beginRenderPass(renderTarget, params);
-    RenderPass::recordDriverCommands(driver, first, last);
+    RenderPass::recordDriverCommands(driver, first, last, passStats);
     driver.endRenderPass();
     driver.popGroupMarker();
+
+    if (stats) {
+        *stats = passStats;
+    }
 }
 
 UTILS_NOINLINE // no need to be inlined
 void RenderPass::recordDriverCommands(FEngine::DriverApi& driver, const Command* first,
-        const Command* last) const noexcept {
+        const Command* last, View::RenderPassStats& stats) const noexcept {
     SYSTRACE_CALL();
 
     if (first != last) {
         SYSTRACE_VALUE32("commandCount", last - first);
 
-        PolygonOffset dummyPolyOffset;
-        PipelineState pipeline{ .polygonOffset = mPolygonOffset };
-        PolygonOffset* const pPipelinePolygonOffset =
-                mPolygonOffsetOverride ? &dummyPolyOffset : &pipeline.polygonOffset;
-
-        Handle<HwUniformBuffer> uboHandle = mUboHandle;
-        FMaterialInstance const* UTILS_RESTRICT mi = nullptr;
-        FMaterial const* UTILS_RESTRICT ma = nullptr;
-        auto const& customCommands = mCustomCommands;
-
-        auto updateMaterial = [&](FMaterialInstance const* materialInstance) {
-            mi = materialInstance;
-            ma = mi->getMaterial();
-            pipeline.scissor = mi->getScissor();
-            pipeline.rasterState.culling = mi->getCullingMode();
-            *pPipelinePolygonOffset = mi->getPolygonOffset();
-            mi->use(driver);
-        };
-
-        FMaterialInstance const * const materialInstanceOverride = mMaterialInstanceOverride;
-        if (UTILS_UNLIKELY(materialInstanceOverride)) {
-            updateMaterial(materialInstanceOverride);
+        if (!recordDriverCommandsParallel(driver, first, last, stats)) {
+            recordDriverCommandsImpl<false>(driver, first, last, stats);
         }
+        mCustomCommands.clear();
+    }
+}
 
-        first--;
-        while (++first != last) {
-            /*
-             * Be careful when changing code below, this is the hot inner-loop
-             */
+void RenderPass::addStats(View::RenderPassStats& stats,
+        View::RenderPassStats const& rhs) noexcept {
+    stats.drawCount += rhs.drawCount;
+    stats.primitiveCount += rhs.primitiveCount;
+    stats.bindCount += rhs.bindCount;
+    stats.skippedBindCount += rhs.skippedBindCount;
+}
 
-            if (UTILS_UNLIKELY((first->key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS))) {
-                uint32_t index = (first->key & CUSTOM_INDEX_MASK) >> CUSTOM_INDEX_SHIFT;
-                customCommands[index]();
-                continue;
-            }
+UTILS_ALWAYS_INLINE
+inline RenderPass::Command const* RenderPass::findBatchEnd(
+        Command const* first, Command const* last) noexcept {
+    // Commands can be drawn in a batch if they only differ by their per-renderable data, and
+    // that data is stored in consecutive slots of the per-renderable UBO. Sorting keeps the
+    // commands of a renderable's copies together when they use the same material instance, and
+    // the copies of a mesh usually end-up in consecutive rows of the scene.
+    PrimitiveInfo const& info = first->primitive;
+    if (info.perRenderableBones) {
+        return first + 1;
+    }
+    Command const* curr = first + 1;
+    for (uint32_t index = info.index + 1u; curr != last; ++curr, ++index) {
+        PrimitiveInfo const& other = curr->primitive;
+        if (other.index != index ||
+                other.primitiveHandle != info.primitiveHandle ||
+                other.mi != info.mi ||
+                other.rasterState != info.rasterState ||
+                other.materialVariant.key != info.materialVariant.key ||
+                other.perRenderableBones ||
+                (curr->key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS)) {
+            break;
+        }
+    }
+    return curr;
+}
 
-            // per-renderable uniform
-            const PrimitiveInfo info = first->primitive;
-            pipeline.rasterState = info.rasterState;
-            if (UTILS_UNLIKELY(!materialInstanceOverride && mi != info.mi)) {
-                // this is always taken the first time
-                updateMaterial(info.mi);
+template<bool PARALLEL>
+UTILS_ALWAYS_INLINE
+inline bool RenderPass::recordDriverCommandsImpl(FEngine::DriverApi& driver,
+        const Command* first, const Command* last,
+        View::RenderPassStats& stats) const noexcept {
+    PolygonOffset dummyPolyOffset;
+    PipelineState pipeline{ .polygonOffset = mPolygonOffset };
+    PolygonOffset* const pPipelinePolygonOffset =
+            mPolygonOffsetOverride ? &dummyPolyOffset : &pipeline.polygonOffset;
+
+    Handle<HwUniformBuffer> uboHandle = mUboHandle;
+    FMaterialInstance const* UTILS_RESTRICT mi = nullptr;
+    FMaterial const* UTILS_RESTRICT ma = nullptr;
+    auto const& customCommands = mCustomCommands;
+
+    // The buffers bound by the commands recorded so far, used to skip redundant binds. The
+    // program, raster state and primitive are part of each draw, the backends only apply the
+    // ones that changed.
+    struct BoundState {
+        Handle<HwUniformBuffer> materialUbo;
+        Handle<HwSamplerGroup> materialSamplers;
+        Handle<HwUniformBuffer> bones;
+        size_t offset = std::numeric_limits<size_t>::max();
+    } bound;
+
+    auto bindMaterial = [&]() {
+        Handle<HwUniformBuffer> const ubh = mi->getUniformBufferHandle();
+        if (ubh) {
+            if (ubh != bound.materialUbo) {
+                driver.bindUniformBuffer(BindingPoints::PER_MATERIAL_INSTANCE, ubh);
+                bound.materialUbo = ubh;
+                stats.bindCount++;
+            } else {
+                stats.skippedBindCount++;
+            }
+        }
+        Handle<HwSamplerGroup> const sbh = mi->getSamplerGroupHandle();
+        if (sbh) {
+            if (sbh != bound.materialSamplers) {
+                driver.bindSamplers(BindingPoints::PER_MATERIAL_INSTANCE, sbh);
+                bound.materialSamplers = sbh;
+                stats.bindCount++;
+            } else {
+                stats.skippedBindCount++;
             }
+        }
+    };
+
+    auto updateMaterial = [&](FMaterialInstance const* materialInstance) {
+        mi = materialInstance;
+        ma = mi->getMaterial();
+        pipeline.scissor = mi->getScissor();
+        pipeline.rasterState.culling = mi->getCullingMode();
+        *pPipelinePolygonOffset = mi->getPolygonOffset();
+        bindMaterial();
+    };
+
+    FMaterialInstance const * const materialInstanceOverride = mMaterialInstanceOverride;
+    if (UTILS_UNLIKELY(materialInstanceOverride)) {
+        updateMaterial(materialInstanceOverride);
+    }
 
+    const bool drawBatching = mEngine.debug.renderer.draw_batching;
+
+    first--;
+    while (++first != last) {
+        /*
+         * Be careful when changing code below, this is the hot inner-loop
+         */
+
+        if (UTILS_UNLIKELY((first->key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS))) {
+            // custom commands use the engine's DriverApi, they're never recorded in parallel
+            assert(!PARALLEL);
+            uint32_t index = (first->key & CUSTOM_INDEX_MASK) >> CUSTOM_INDEX_SHIFT;
+            customCommands[index]();
+            // we don't know what the custom command bound
+            bound = {};
+            continue;
+        }
+
+        // per-renderable uniform
+        const PrimitiveInfo info = first->primitive;
+        pipeline.rasterState = info.rasterState;
+        if (UTILS_UNLIKELY(!materialInstanceOverride && mi != info.mi)) {
+            // this is always taken the first time
+            updateMaterial(info.mi);
+        }
+
+        if (PARALLEL) {
+            // programs can only be created from the engine's DriverApi
+            pipeline.program = ma->getCachedProgram(info.materialVariant.key);
+            if (UTILS_UNLIKELY(!pipeline.program)) {
+                return false;
+            }
+        } else {
             pipeline.program = ma->getProgram(info.materialVariant.key);
-            size_t offset = info.index * sizeof(PerRenderableUib);
+        }
+
+        size_t offset = info.index * sizeof(PerRenderableUib);
+
+        if (drawBatching) {
+            Command const* const batchLast = findBatchEnd(first, last);
+            if (UTILS_UNLIKELY(batchLast - first > 1)) {
+                const uint32_t count = uint32_t(batchLast - first);
+                driver.drawBatch(pipeline, info.primitiveHandle,
+                        BindingPoints::PER_RENDERABLE, uboHandle, offset, sizeof(PerRenderableUib),
+                        count);
+                bound.offset = offset + (count - 1) * sizeof(PerRenderableUib);
+                stats.bindCount += count;
+                stats.drawCount++;
+                stats.primitiveCount += count;
+                first = batchLast - 1;
+                continue;
+            }
+        }
+
+        // all the primitives of a renderable use the same per-renderable data
+        if (offset != bound.offset) {
+            bound.offset = offset;
+            stats.bindCount++;
+            if (UTILS_LIKELY(!info.perRenderableBones)) {
+                // the most common case is recorded as a single command
+                driver.bindUniformBufferRangeAndDraw(BindingPoints::PER_RENDERABLE,
+                        uboHandle, uint32_t(offset), uint32_t(sizeof(PerRenderableUib)),
+                        pipeline, info.primitiveHandle);
+                stats.drawCount++;
+                stats.primitiveCount++;
+                continue;
+            }
             driver.bindUniformBufferRange(BindingPoints::PER_RENDERABLE,
                     uboHandle, offset, sizeof(PerRenderableUib));
-            if (UTILS_UNLIKELY(info.perRenderableBones)) {
+        } else {
+            stats.skippedBindCount++;
+        }
+        if (UTILS_UNLIKELY(info.perRenderableBones)) {
+            if (info.perRenderableBones != bound.bones) {
                 driver.bindUniformBuffer(BindingPoints::PER_RENDERABLE_BONES,
                         info.perRenderableBones);
+                bound.bones = info.perRenderableBones;
+                stats.bindCount++;
+            } else {
+                stats.skippedBindCount++;
             }
-            driver.draw(pipeline, info.primitiveHandle);
         }
-        mCustomCommands.clear();
+        driver.draw(pipeline, info.primitiveHandle);
+        stats.drawCount++;
+        stats.primitiveCount++;
     }
+    return true;
+}
+
+bool RenderPass::recordDriverCommandsParallel(FEngine::DriverApi& driver, const Command* first,
+        const Command* last, View::RenderPassStats& stats) const noexcept {
+    FEngine& engine = mEngine;
+
+    // Custom commands record directly into the engine's DriverApi, so they have to run in order
+    // on this thread.
+    const size_t count = size_t(last - first);
+    if (!engine.debug.renderer.parallel_recording || !mCustomCommands.empty() ||
+            count < 2 * JOBS_PARALLEL_RECORD_COMMANDS_COUNT) {
+        return false;
+    }
+
+    // Upper bound of the size of the driver commands recorded for a draw command, assuming it
+    // also switches the material instance.
+    constexpr size_t MATERIAL_COMMANDS_MAX_SIZE =
+            CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer))) +
+            CommandBase::align(sizeof(COMMAND_TYPE(bindSamplers)));
+    constexpr size_t DRAW_COMMANDS_MAX_SIZE = MATERIAL_COMMANDS_MAX_SIZE +
+            CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBufferRange))) +
+            CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer))) +
+            CommandBase::align(sizeof(COMMAND_TYPE(draw)));
+    static_assert(CommandBase::align(sizeof(BindAndDrawCommand)) <=
+            CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBufferRange))) +
+            CommandBase::align(sizeof(COMMAND_TYPE(draw))),
+            "a fused command must not be larger than the commands it replaces");
+    static_assert(CommandBase::align(sizeof(COMMAND_TYPE(drawBatch))) <=
+            2 * (DRAW_COMMANDS_MAX_SIZE - MATERIAL_COMMANDS_MAX_SIZE),
+            "a batch of two draws must not be larger than two draws");
+
+    // The commands are split in segments, each recorded by a job into its own memory area.
+    // Each segment starts with no state, so it'll bind its first material instance.
+    const size_t segmentCount = std::min(
+            count / JOBS_PARALLEL_RECORD_COMMANDS_COUNT, MAX_RECORDING_SEGMENT_COUNT);
+    const size_t segmentCommandCount = (count + segmentCount - 1) / segmentCount;
+    const size_t segmentCapacity =
+            segmentCommandCount * DRAW_COMMANDS_MAX_SIZE + MATERIAL_COMMANDS_MAX_SIZE;
+
+    // The segments are only needed until they're spliced into the command stream below.
+    LinearAllocatorArena& arena = engine.getPerRenderPassAllocator();
+    void* const rewindTo = arena.getCurrent();
+    char* const storage = (char*)arena.alloc(segmentCount * segmentCapacity);
+    if (UTILS_UNLIKELY(!storage)) {
+        return false;
+    }
+
+    struct Segment {
+        char const* end;
+        View::RenderPassStats stats;
+        bool recorded;
+    };
+    Segment segments[MAX_RECORDING_SEGMENT_COUNT];
+
+    auto work = [&](uint32_t index, uint32_t c) {
+        for (size_t i = index; i < index + c; i++) {
+            char* const begin = storage + i * segmentCapacity;
+            CircularBuffer buffer(begin, segmentCapacity);
+            CommandStream stream(driver, buffer);
+            Command const* const b = first + i * segmentCommandCount;
+            Command const* const e = std::min(b + segmentCommandCount, last);
+            segments[i].stats = {};
+            segments[i].recorded = recordDriverCommandsImpl<true>(stream, b, e, segments[i].stats);
+            segments[i].end = static_cast<char const*>(buffer.getHead());
+            assert(size_t(segments[i].end - begin) <= segmentCapacity);
+        }
+    };
+
+    JobSystem& js = engine.getJobSystem();
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(segmentCount),
+            std::cref(work), jobs::CountSplitter<1, 8>());
+    js.runAndWait(job);
+
+    // If a program wasn't created yet, we need to record on this thread, this only happens the
+    // first time a material variant is used.
+    bool recorded = std::all_of(segments, segments + segmentCount,
+            [](Segment const& segment) { return segment.recorded; });
+    if (UTILS_LIKELY(recorded)) {
+        SYSTRACE_NAME("splice segments");
+        for (size_t i = 0; i < segmentCount; i++) {
+            driver.splice(storage + i * segmentCapacity, segments[i].end);
+            addStats(stats, segments[i].stats);
+        }
+    }
+
+    arena.rewind(rewindTo);
+    return recorded;
 }
 
 /* static */
@@ -304,7 +721,7 @@ void RenderPass::setupColorCommand(Command& cmdDraw, bool hasDepthPass,
 
 /* static */
 UTILS_NOINLINE
-void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const commands,
+void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const curr,
         FScene::RenderableSoa const& soa, Range<uint32_t> range, RenderFlags renderFlags,
         float3 cameraPosition, float3 cameraForward) noexcept {
 
@@ -313,14 +730,6 @@ void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const comm
     // (in principle, we could have split this method into two, at the cost of going through
     // the list twice)
 
-    // compute how much maximum storage we need
-    uint32_t offset = FScene::getPrimitiveCount(soa, range.first);
-    // double the color pass for transparents that need to render twice
-    const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
-    const bool depthPass  = bool(commandTypeFlags & CommandTypeFlags::DEPTH);
-    offset *= uint32_t(colorPass * 2 + depthPass);
-    Command* const curr = commands + offset;
-
     /*
      * The switch {} below is to coerce the compiler into generating different versions of
      * "generateCommandsImpl" based on which pass we're processing.
@@ -371,6 +780,7 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
     auto const* const UTILS_RESTRICT soaVisibility      = soa.data<FScene::VISIBILITY_STATE>();
     auto const* const UTILS_RESTRICT soaPrimitives      = soa.data<FScene::PRIMITIVES>();
     auto const* const UTILS_RESTRICT soaBonesUbh        = soa.data<FScene::BONES_UBH>();
+    auto const* const UTILS_RESTRICT soaUboSlot         = soa.data<FScene::UBO_SLOT>();
 
     const bool hasShadowing = renderFlags & HAS_SHADOWING;
     const bool viewInverseFrontFaces = renderFlags & HAS_INVERSE_FRONT_FACES;
@@ -425,7 +835,7 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
         const bool inverseFrontFaces = viewInverseFrontFaces ^ soaReversedWinding[i];
 
         cmdColor.key = makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
-        cmdColor.primitive.index = (uint16_t)i;
+        cmdColor.primitive.index = soaUboSlot[i];
         cmdColor.primitive.perRenderableBones = soaBonesUbh[i];
         materialVariant.setShadowReceiver(soaVisibility[i].receiveShadows & hasShadowing);
         materialVariant.setSkinning(soaVisibility[i].skinning || soaVisibility[i].morphing);
@@ -436,7 +846,7 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
         cmdDepth.key |= uint64_t(CustomCommand::PASS);
         cmdDepth.key |= makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
         cmdDepth.key |= makeField(distanceBits, DISTANCE_BITS_MASK, DISTANCE_BITS_SHIFT);
-        cmdDepth.primitive.index = (uint16_t)i;
+        cmdDepth.primitive.index = soaUboSlot[i];
         cmdDepth.primitive.perRenderableBones = soaBonesUbh[i];
         cmdDepth.primitive.materialVariant.setSkinning(soaVisibility[i].skinning || soaVisibility[i].morphing);
         cmdDepth.primitive.rasterState.inverseFrontFaces = inverseFrontFaces;
@@ -17,6 +17,7 @@
 #ifndef TNT_UTILS_RENDERPASS_H
 #define TNT_UTILS_RENDERPASS_H
 
+#include <filament/View.h>
 #include <filament/Viewport.h>
 
 #include "details/Camera.h"
@@ -30,6 +31,9 @@
 #include <utils/compiler.h>
 #include <utils/Slice.h>
 
+#include <chrono>
+#include <vector>
+
 namespace utils {
 class JobSystem;
 }
@@ -37,6 +41,43 @@ class JobSystem;
 namespace filament {
 namespace details {
 
+/*
+ * CPU time spent in each stage of a View's frame, see FView::getFrameTimings(). Some stages
+ * run in parallel, so their sum can be larger than the frame time.
+ */
+struct FrameTimings {
+    using clock = std::chrono::steady_clock;
+    using duration = clock::duration;
+
+    // adds the time spent in this scope to 'stage', nothing is measured if 'timings' is null
+    class Scope {
+    public:
+        Scope(FrameTimings* timings, duration FrameTimings::*stage) noexcept
+                : mStage(timings ? &(timings->*stage) : nullptr) {
+            if (mStage) {
+                mStart = clock::now();
+            }
+        }
+        ~Scope() noexcept {
+            if (mStage) {
+                *mStage += clock::now() - mStart;
+            }
+        }
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+    private:
+        duration* const mStage;
+        clock::time_point mStart;
+    };
+
+    duration prepare{};     // FScene::prepare() and per-renderable UBOs
+    duration culling{};     // renderables, lights and shadow casters culling
+    duration froxelize{};   // lights froxelization
+    duration commands{};    // commands generation, all passes
+    duration sort{};        // commands sorting, all passes
+    duration recording{};   // driver commands recording, all passes
+};
+
 class RenderPass {
 public:
     static constexpr uint64_t DISTANCE_BITS_MASK            = 0xFFFFFFFFllu;
@@ -216,19 +257,22 @@ public:
         return boolish ? -1llu : 0llu;
     }
 
-    struct PrimitiveInfo { // 24 bytes
+    // 'index' is the slot of the renderable in the per-renderable UBO (see FScene::UBO_SLOT),
+    // slots are allocated for the whole scene, so it needs the full 32 bits
+    struct PrimitiveInfo { // 32 bytes (24)
         FMaterialInstance const* mi = nullptr;                          // 8 bytes (4)
         backend::Handle<backend::HwRenderPrimitive> primitiveHandle;    // 4 bytes
         backend::Handle<backend::HwUniformBuffer> perRenderableBones;   // 4 bytes
         backend::RasterState rasterState;                               // 4 bytes
-        uint16_t index = 0;                                             // 2 bytes
+        uint32_t index = 0;                                             // 4 bytes
         Variant materialVariant;                                        // 1 byte
-        uint8_t reserved = {};                                          // 1 byte
+        uint8_t reserved[3] = {};                                       // 3 bytes
+                                                                        // 4 bytes padding (0)
     };
 
-    struct alignas(8) Command {     // 32 bytes
+    struct alignas(8) Command {     // 40 bytes (32)
         CommandKey key = 0;         //  8 bytes
-        PrimitiveInfo primitive;    // 24 bytes
+        PrimitiveInfo primitive;    // 32 bytes (24)
         bool operator < (Command const& rhs) const noexcept { return key < rhs.key; }
         // placement new declared as "throw" to avoid the compiler's null-check
         inline void* operator new (std::size_t size, void* ptr) {
@@ -239,6 +283,30 @@ public:
     static_assert(std::is_trivially_destructible<Command>::value,
             "Command isn't trivially destructible");
 
+    /*
+     * Keeps the sorted commands of a pass from one frame to the next, see
+     * appendSortedCommands(). There is typically one per pass and per View.
+     */
+    class CommandCache {
+    public:
+        void invalidate() noexcept { mValid = false; }
+
+    private:
+        friend class RenderPass;
+        bool mValid = false;
+        uint64_t mPassKey = 0;              // hash of the inputs common to all renderables
+        std::vector<uint64_t> mRowHashes;   // hash of the inputs of each visible renderable
+        std::vector<uint32_t> mRowSlots;    // UBO slot of each visible renderable
+        std::vector<Command> mCommands;     // sorted commands, without sentinels
+
+        // scratch buffers, kept here to avoid reallocations
+        std::vector<uint64_t> mNextRowHashes;
+        std::vector<uint32_t> mNextRowSlots;
+        std::vector<uint32_t> mChangedRows;
+        std::vector<uint32_t> mChangedSlots;
+        std::vector<Command> mChangedCommands;
+    };
+
     using RenderFlags = uint8_t;
     static constexpr RenderFlags HAS_SHADOWING           = 0x01;
     static constexpr RenderFlags HAS_DIRECTIONAL_LIGHT   = 0x02;
@@ -254,6 +322,9 @@ public:
     void setCamera(const CameraInfo& camera) noexcept;
     void setRenderFlags(RenderFlags flags) noexcept;
 
+    // the time spent generating, sorting and recording commands is added to 'timings'
+    void setFrameTimings(FrameTimings* timings) noexcept;
+
     // returns mCommands.end()
     Command* appendCommands(CommandTypeFlags commandTypeFlags) noexcept;
 
@@ -265,10 +336,17 @@ public:
     // the new mCommands.end()
     Command* sortCommands(Command* curr) noexcept;
 
+    // Same as appendCommands() followed by sortCommands(), but reuses last frame's commands
+    // stored in 'cache' when the inputs of the pass didn't change. When only a few renderables
+    // changed, only their commands are regenerated. Returns the new mCommands.end().
+    Command* appendSortedCommands(CommandTypeFlags commandTypeFlags,
+            CommandCache& cache) noexcept;
+
     void execute(const char* name,
             backend::Handle<backend::HwRenderTarget> renderTarget,
             backend::RenderPassParams params,
-            Command const* first, Command const* last) const noexcept;
+            Command const* first, Command const* last,
+            View::RenderPassStats* stats = nullptr) const noexcept;
 
     utils::GrowingSlice<Command>& getCommands() { return mCommands; }
     utils::Slice<Command> const& getCommands() const { return mCommands; }
@@ -289,6 +367,22 @@ private:
     static_assert(JOBS_PARALLEL_FOR_COMMANDS_SIZE % utils::CACHELINE_SIZE == 0,
             "Size of Commands jobs must be multiple of a cache-line size");
 
+    // CommandCache only regenerates the commands of the renderables that changed when they're
+    // at most 1/COMMAND_CACHE_PARTIAL_UPDATE_RATIO of the visible renderables.
+    static constexpr size_t COMMAND_CACHE_PARTIAL_UPDATE_RATIO = 8;
+
+    // Driver commands are recorded in parallel by segments of at least this many commands
+    static constexpr size_t JOBS_PARALLEL_RECORD_COMMANDS_COUNT = 256;
+    static constexpr size_t MAX_RECORDING_SEGMENT_COUNT = 32;
+
+    // number of commands generated for each primitive, some are sentinels
+    static constexpr uint32_t getCommandsPerPrimitive(uint32_t commandTypeFlags) noexcept {
+        // double the color pass for transparent objects that need to render twice
+        return uint32_t(bool(commandTypeFlags & CommandTypeFlags::COLOR)) * 2 +
+                uint32_t(bool(commandTypeFlags & CommandTypeFlags::DEPTH));
+    }
+
+    // writes the commands of the primitives of 'range' to 'commands'
     static inline void generateCommands(uint32_t commandTypeFlags, Command* commands,
             FScene::RenderableSoa const& soa, utils::Range<uint32_t> range, RenderFlags renderFlags,
             math::float3 cameraPosition, math::float3 cameraForward) noexcept;
@@ -303,11 +397,33 @@ private:
             FMaterialInstance const* mi, bool inverseFrontFaces) noexcept;
 
     void recordDriverCommands(FEngine::DriverApi& driver, const Command* first,
-            const Command* last) const noexcept;
+            const Command* last, View::RenderPassStats& stats) const noexcept;
+
+    static void addStats(View::RenderPassStats& stats, View::RenderPassStats const& rhs) noexcept;
+
+    // returns the end of the run of commands starting at 'first' that can be drawn with a
+    // single drawBatch(), this is first + 1 if 'first' can't be batched.
+    static inline Command const* findBatchEnd(Command const* first, Command const* last) noexcept;
+
+    // returns false if the commands couldn't be recorded in parallel, in which case nothing
+    // was recorded.
+    bool recordDriverCommandsParallel(FEngine::DriverApi& driver, const Command* first,
+            const Command* last, View::RenderPassStats& stats) const noexcept;
+
+    // returns false if PARALLEL and a program needs to be created, in which case the
+    // commands recorded so far must be discarded.
+    template<bool PARALLEL>
+    bool recordDriverCommandsImpl(FEngine::DriverApi& driver, const Command* first,
+            const Command* last, View::RenderPassStats& stats) const noexcept;
 
     static void updateSummedPrimitiveCounts(
             FScene::RenderableSoa& renderableData, utils::Range<uint32_t> vr) noexcept;
 
+    // the render flags, with the front faces inverted if the world origin flips them
+    RenderFlags getEffectiveRenderFlags() const noexcept {
+        return mFlags ^ (mWorldOriginReversed ? HAS_INVERSE_FRONT_FACES : RenderFlags(0));
+    }
+
     using CustomCommandFn = std::function<void()>;
     using CustomCommandVector = std::vector<CustomCommandFn,
             utils::STLAllocator<CustomCommandFn, LinearAllocatorArena>>;
@@ -325,8 +441,12 @@ private:
     // the UBO containing the data for the renderables
     backend::Handle<backend::HwUniformBuffer> mUboHandle;
 
-    // info about the camera
-    CameraInfo mCamera;
+    // camera position and forward vector in the renderables' world space, i.e. without the
+    // world origin
+    math::float3 mCameraPosition{};
+    math::float3 mCameraForwardVector{};
+    // whether the world origin transform flips the winding order
+    bool mWorldOriginReversed = false;
     // info about the scene features (e.g.: has shadows, lighting, etc...)
     RenderFlags mFlags{};
     // whether to override the polygon offset setting
@@ -334,6 +454,8 @@ private:
     // value of the override
     backend::PolygonOffset mPolygonOffset{};
     FMaterialInstance const* mMaterialInstanceOverride = nullptr;
+    // where to account the time spent in each stage, can be null
+    FrameTimings* mFrameTimings = nullptr;
 
     // a vector for our custom commands
     mutable CustomCommandVector mCustomCommands;
@@ -36,6 +36,7 @@
 
 #include <utils/Panic.h>
 #include <utils/Systrace.h>
+#include <utils/TaskGraph.h>
 #include <utils/vector.h>
 
 #include <assert.h>
@@ -59,6 +60,12 @@ FRenderer::FRenderer(FEngine& engine) :
 {
     FDebugRegistry& debugRegistry = engine.getDebugRegistry();
     debugRegistry.registerProperty("d.ssao.enabled", &engine.debug.ssao.enabled);
+    debugRegistry.registerProperty("d.renderer.parallel_recording",
+            &engine.debug.renderer.parallel_recording);
+    debugRegistry.registerProperty("d.renderer.command_cache",
+            &engine.debug.renderer.command_cache);
+    debugRegistry.registerProperty("d.renderer.draw_batching",
+            &engine.debug.renderer.draw_batching);
 }
 
 void FRenderer::init() noexcept {
@@ -105,9 +112,8 @@ FRenderer::~FRenderer() noexcept {
     // to free what we can (it would probably mean something when wrong).
 #ifndef NDEBUG
     size_t wm = getCommandsHighWatermark();
-    size_t wmpct = wm / (CONFIG_PER_FRAME_COMMANDS_SIZE / 100);
     slog.d << "Renderer: Commands High watermark "
-    << wm / 1024 << " KiB (" << wmpct << "%), "
+    << wm / 1024 << " KiB, "
     << wm / sizeof(Command) << " commands, " << sizeof(Command) << " bytes/command"
     << io::endl;
 #endif
@@ -212,11 +218,11 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
         return;
     }
 
-    view.prepare(engine, driver, arena, svp, getShaderUserTime());
+    // all the CPU work of this frame that can run in parallel, this waits for it on exit.
+    TaskGraph tasks(js);
 
-    // start froxelization immediately, it has no dependencies
-    JobSystem::Job* jobFroxelize = js.runAndRetain(js.createJob(nullptr,
-            [&engine, &view](JobSystem&, JobSystem::Job*) { view.froxelize(engine); }));
+    TaskGraph::Task froxelize = view.prepare(engine, driver, arena, svp, getShaderUserTime(),
+            tasks);
 
     /*
      * Allocate command buffer.
@@ -224,13 +230,20 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
 
     FScene& scene = *view.getScene();
 
-    const size_t commandsSize = FEngine::CONFIG_PER_FRAME_COMMANDS_SIZE;
-    const size_t commandsCount = commandsSize / sizeof(Command);
+    // The buffer must hold the commands of the largest pass (the shadow pass is cleared before
+    // the depth and color passes), plus a few sentinels and custom commands, and the same
+    // amount again, which sortCommands() uses as scratch memory.
+    // The per-render pass arena grows as needed, so this works for scenes of any size.
+    const size_t commandsCount = 2 * (getCommandsCountPerFrame(scene.getRenderableData(),
+            view.getVisibleRenderables(), view.getVisibleShadowCasters()) +
+            CONFIG_COMMANDS_MARGIN);
     GrowingSlice<Command> commands(
             arena.allocate<Command>(commandsCount, CACHELINE_SIZE), commandsCount);
 
 
     RenderPass pass(engine, commands);
+    pass.setFrameTimings(&view.getFrameTimings());
+    view.getRenderStats() = {};
     RenderPass::RenderFlags renderFlags = 0;
     if (view.hasShadowing())               renderFlags |= RenderPass::HAS_SHADOWING;
     if (view.hasDirectionalLight())        renderFlags |= RenderPass::HAS_DIRECTIONAL_LIGHT;
@@ -296,20 +309,20 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
 
     // SSAO pass -- automatically culled if not used
     if (useSSAO) {
-        auto curr = pass.getCommands().end();
-        pass.appendCommands(RenderPass::CommandTypeFlags::DEPTH);
-        pass.sortCommands(curr);
+        pass.appendSortedCommands(RenderPass::CommandTypeFlags::DEPTH,
+                view.getDepthPassCommandCache());
     }
 
-    FrameGraphId<FrameGraphTexture> ssao = ppm.ssao(fg, pass, svp, cameraInfo, view.getAmbientOcclusionOptions());
+    FrameGraphId<FrameGraphTexture> ssao = ppm.ssao(fg, pass, svp, cameraInfo,
+            view.getAmbientOcclusionOptions(), &view.getRenderStats().depth);
 
     // --------------------------------------------------------------------------------------------
 
     // generate the normal commands
     RenderPass::CommandTypeFlags commandType = getCommandType(view.getDepthPrepass());
     Command* colorPassBegin = pass.getCommands().end();
-    pass.appendCommands(commandType);
-    Command const* colorPassEnd = pass.sortCommands(colorPassBegin);
+    Command const* colorPassEnd = pass.appendSortedCommands(commandType,
+            view.getColorPassCommandCache());
 
     // We only honor the view's color buffer clear flags, depth/stencil are handled by the framefraph
     uint8_t viewClearFlags = view.getClearFlags() & (uint8_t)TargetBufferFlags::ALL;
@@ -349,7 +362,7 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
                         .samples = msaa,
                 }, clearFlags);
             },
-            [&pass, &ppm, colorPassBegin, colorPassEnd, jobFroxelize, &js, &view]
+            [&pass, &ppm, colorPassBegin, colorPassEnd, &tasks, froxelize, &view]
                     (FrameGraphPassResources const& resources,
                             ColorPassData const& data, DriverApi& driver) {
                 auto out = resources.getRenderTarget(data.rt);
@@ -364,21 +377,17 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
 
                 out.params.clearColor = view.getClearColor();
 
-                if (jobFroxelize) {
-                    auto sync = jobFroxelize;
-                    js.waitAndRelease(sync);
-                    view.commitFroxels(driver);
-                }
+                tasks.wait(froxelize);
+                view.commitFroxels(driver);
 
                 pass.execute(resources.getPassName(), out.target, out.params,
-                        colorPassBegin, colorPassEnd);
+                        colorPassBegin, colorPassEnd, &view.getRenderStats().color);
 
                 // Unbind the SSAO sampler, as the frame graph will delete the texture at the end of
                 // the pass.
                 view.cleanupSSAO();
             });
 
-    jobFroxelize = nullptr;
     FrameGraphId<FrameGraphTexture> input = colorPass.getData().color;
 
     /*
@@ -645,6 +654,28 @@ Handle<HwRenderTarget> FRenderer::getRenderTarget(FView& view) const noexcept {
     return viewRenderTarget ? viewRenderTarget : mRenderTarget;
 }
 
+size_t FRenderer::getCommandsCountPerFrame(FScene::RenderableSoa const& soa,
+        Range<uint32_t> visibleRenderables, Range<uint32_t> visibleShadowCasters) noexcept {
+    auto const* const primitives = soa.data<FScene::PRIMITIVES>();
+    auto primitiveCount = [primitives](Range<uint32_t> range) {
+        size_t count = 0;
+        for (uint32_t i : range) {
+            count += primitives[i].size();
+        }
+        return count;
+    };
+    // the color pass has up to 3 commands per primitive (see getCommandsPerPrimitive()), and is
+    // preceded by the depth pass of SSAO.
+    constexpr size_t colorPassCommandsPerPrimitive =
+            RenderPass::getCommandsPerPrimitive(RenderPass::COLOR_AND_DEPTH) +
+            RenderPass::getCommandsPerPrimitive(RenderPass::DEPTH);
+    constexpr size_t shadowPassCommandsPerPrimitive =
+            RenderPass::getCommandsPerPrimitive(RenderPass::SHADOW);
+    return std::max(
+            primitiveCount(visibleRenderables) * colorPassCommandsPerPrimitive,
+            primitiveCount(visibleShadowCasters) * shadowPassCommandsPerPrimitive);
+}
+
 RenderPass::CommandTypeFlags FRenderer::getCommandType(View::DepthPrepass prepass) const noexcept {
     RenderPass::CommandTypeFlags commandType;
     switch (prepass) {
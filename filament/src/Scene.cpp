@@ -29,9 +29,12 @@
 #include <utils/compiler.h>
 #include <utils/EntityManager.h>
 #include <utils/Range.h>
+#include <utils/Systrace.h>
 #include <utils/Zip2Iterator.h>
 
 #include <algorithm>
+#include <memory>
+#include <numeric>
 
 using namespace filament::math;
 using namespace utils;
@@ -41,33 +44,50 @@ namespace details {
 
 // ------------------------------------------------------------------------------------------------
 
+
 FScene::FScene(FEngine& engine) :
         mEngine(engine),
         mIndirectLight(engine.getDefaultIndirectLight()) {
+    FDebugRegistry& debugRegistry = engine.getDebugRegistry();
+    debugRegistry.registerProperty("d.scene.culling_bvh", &engine.debug.scene.culling_bvh);
 }
 
 FScene::~FScene() noexcept = default;
 
 
-void FScene::prepare(const mat4f& worldOriginTransform) {
-    // TODO: can we skip this in most cases? Since we rely on indices staying the same,
-    //       we could only skip, if nothing changed in the RCM.
+void FScene::prepare(const mat4f& worldOriginTransform, ArenaScope& arena) {
+    SYSTRACE_CALL();
 
     FEngine& engine = mEngine;
-    EntityManager& em = engine.getEntityManager();
-    FRenderableManager& rcm = engine.getRenderableManager();
-    FTransformManager& tcm = engine.getTransformManager();
-    FLightManager& lcm = engine.getLightManager();
-    // go through the list of entities, and gather the data of those that are renderables
-    auto& sceneData = mRenderableData;
-    auto& lightData = mLightData;
-    auto const& entities = mEntities;
 
+    // bring the world-space data up-to-date, this only processes the entities that changed
+    const bool renderablesChanged = updateRenderableCache();
 
-    // NOTE: we can't know in advance how many entities are renderable or lights because the corresponding
-    // component can be added after the entity is added to the scene.
+    prepareRenderableData();
 
-    size_t renderableDataCapacity = entities.size();
+    prepareLightData(worldOriginTransform, arena);
+
+    // keep the culling hierarchy in sync with the world AABBs, which don't depend on the
+    // world origin
+    if (engine.debug.scene.culling_bvh) {
+        if (renderablesChanged || mCullingBvhInvalid) {
+            updateCullingBvh();
+        }
+    } else if (UTILS_UNLIKELY(!mCullingBvh.empty())) {
+        mCullingBvh.clear();
+        mCullingBvhInvalid = true;
+    }
+}
+
+void FScene::prepareRenderableData() noexcept {
+    SYSTRACE_CALL();
+
+    JobSystem& js = mEngine.getJobSystem();
+    auto& sceneData = mRenderableData;
+    auto const& cache = mRenderableCache;
+    const size_t renderableCount = cache.size();
+
+    size_t renderableDataCapacity = renderableCount;
     // we need the capacity to be multiple of 16 for SIMD loops
     renderableDataCapacity = (renderableDataCapacity + 0xFu) & ~0xFu;
     // we need 1 extra entry at the end for the summed primitive count
@@ -77,10 +97,57 @@ void FScene::prepare(const mat4f& worldOriginTransform) {
     if (sceneData.capacity() < renderableDataCapacity) {
         sceneData.setCapacity(renderableDataCapacity);
     }
+    sceneData.resize(renderableCount);
+
+    // The per-view data is copied from the cache every time, because FView reorders it. The
+    // world-space data doesn't include the world origin, which is applied where it's needed
+    // (i.e. by the culling frustums, the shadow map and the vertex shader), so this is a
+    // straight copy and only the cache rows that changed were computed again.
+
+    auto functor = [&sceneData, &cache](uint32_t first, uint32_t c) {
+        std::copy_n(cache.data<CACHE_RENDERABLE_INSTANCE>() + first, c,
+                sceneData.data<RENDERABLE_INSTANCE>() + first);
+        std::copy_n(cache.data<CACHE_REVERSED_WINDING_ORDER>() + first, c,
+                sceneData.data<REVERSED_WINDING_ORDER>() + first);
+        std::copy_n(cache.data<CACHE_VISIBILITY_STATE>() + first, c,
+                sceneData.data<VISIBILITY_STATE>() + first);
+        std::copy_n(cache.data<CACHE_BONES_UBH>() + first, c,
+                sceneData.data<BONES_UBH>() + first);
+        std::copy_n(cache.data<CACHE_WORLD_AABB_CENTER>() + first, c,
+                sceneData.data<WORLD_AABB_CENTER>() + first);
+        std::copy_n(cache.data<CACHE_MORPH_WEIGHTS>() + first, c,
+                sceneData.data<MORPH_WEIGHTS>() + first);
+        std::copy_n(cache.data<CACHE_LAYERS>() + first, c,
+                sceneData.data<LAYERS>() + first);
+        std::copy_n(cache.data<CACHE_WORLD_AABB_EXTENT>() + first, c,
+                sceneData.data<WORLD_AABB_EXTENT>() + first);
+        std::iota(sceneData.data<UBO_SLOT>() + first, sceneData.data<UBO_SLOT>() + first + c,
+                first);
+    };
+
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(renderableCount),
+            std::cref(functor), jobs::CountSplitter<RENDERABLE_CHUNK_SIZE, 8>());
+    js.runAndWait(job);
+}
+
+void FScene::prepareLightData(const mat4f& worldOriginTransform, ArenaScope& rootArena) noexcept {
+    SYSTRACE_CALL();
+
+    FEngine& engine = mEngine;
+    JobSystem& js = engine.getJobSystem();
+    FTransformManager& tcm = engine.getTransformManager();
+    FLightManager& lcm = engine.getLightManager();
+    auto& lightData = mLightData;
+
+    // the list of lights is maintained by updateRenderableCache(), only the lights are visited
+    ArenaScope arena(rootArena.getAllocator());
+    Entity const* const lights = mLights.data();
+    const size_t count = mLights.size();
+    const size_t chunkCount = (count + LIGHT_CHUNK_SIZE - 1) / LIGHT_CHUNK_SIZE;
 
     // The light data list will always contain at least one entry for the
     // dominating directional light, even if there are no entities.
-    size_t lightDataCapacity = std::max<size_t>(1, entities.size());
+    size_t lightDataCapacity = DIRECTIONAL_LIGHTS_COUNT + count;
     // we need the capacity to be multiple of 16 for SIMD loops
     lightDataCapacity = (lightDataCapacity + 0xFu) & ~0xFu;
 
@@ -89,100 +156,429 @@ void FScene::prepare(const mat4f& worldOriginTransform) {
         lightData.setCapacity(lightDataCapacity);
     }
     // the first entries are reserved for the directional lights (currently only one)
-    lightData.resize(DIRECTIONAL_LIGHTS_COUNT);
+    lightData.resize(DIRECTIONAL_LIGHTS_COUNT + count);
+
+    // Lights are processed in parallel by chunks of LIGHT_CHUNK_SIZE, like renderables in
+    // rebuildRenderableCache(). Each chunk also finds its dominant directional light.
+    struct ChunkResult {
+        uint32_t count = 0;
+        float maxIntensity = 0.0f;
+        FLightManager::Instance directional = {};
+        float3 direction = {};
+    };
+    ChunkResult* const results = arena.allocate<ChunkResult>(chunkCount);
+    std::uninitialized_fill_n(results, chunkCount, ChunkResult{});
+
+    auto functor = [&](uint32_t first, uint32_t c) {
+        for (size_t chunk = first; chunk < first + c; chunk++) {
+            const size_t begin = chunk * LIGHT_CHUNK_SIZE;
+            const size_t end = std::min(begin + LIGHT_CHUNK_SIZE, count);
+            ChunkResult& result = results[chunk];
+            size_t index = DIRECTIONAL_LIGHTS_COUNT + begin;
+            for (size_t i = begin; i < end; i++) {
+                // the lights are alive and have a Light component, see updateRenderableCache()
+                auto li = lcm.getInstance(lights[i]);
+                assert(li);
+
+                // get the world transform
+                auto ti = tcm.getInstance(lights[i]);
+                const mat4f worldTransform = worldOriginTransform * tcm.getWorldTransform(ti);
+
+                // find the dominant directional light
+                if (UTILS_UNLIKELY(lcm.isDirectionalLight(li))) {
+                    // we don't store the directional lights, because we only have a single one
+                    if (lcm.getIntensity(li) >= result.maxIntensity) {
+                        result.maxIntensity = lcm.getIntensity(li);
+                        float3 d = lcm.getLocalDirection(li);
+                        // using mat3f::getTransformForNormals handles non-uniform scaling
+                        d = normalize(mat3f::getTransformForNormals(worldTransform.upperLeft()) * d);
+                        result.directional = li;
+                        result.direction = d;
+                    }
+                } else {
+                    const float4 p = worldTransform * float4{ lcm.getLocalPosition(li), 1 };
+                    float3 d = 0;
+                    if (!lcm.isPointLight(li) || lcm.isIESLight(li)) {
+                        d = lcm.getLocalDirection(li);
+                        // using mat3f::getTransformForNormals handles non-uniform scaling
+                        d = normalize(mat3f::getTransformForNormals(worldTransform.upperLeft()) * d);
+                    }
+                    lightData.elementAt<POSITION_RADIUS>(index) = { p.xyz, lcm.getRadius(li) };
+                    lightData.elementAt<DIRECTION>(index) = d;
+                    lightData.elementAt<LIGHT_INSTANCE>(index) = li;
+                    index++;
+                }
+            }
+            result.count = uint32_t(index - (DIRECTIONAL_LIGHTS_COUNT + begin));
+        }
+    };
 
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(chunkCount),
+            std::cref(functor), jobs::CountSplitter<1, 8>());
+    js.runAndWait(job);
 
-    // find the max intensity directional light index in our local array
+    // compaction and reduction, processing the chunks in order gives the same result as
+    // processing all the lights serially.
     float maxIntensity = 0.0f;
-
-    for (Entity e : entities) {
-        if (!em.isAlive(e)) {
-            continue;
+    size_t size = DIRECTIONAL_LIGHTS_COUNT;
+    for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+        ChunkResult const& result = results[chunk];
+        if (result.directional && result.maxIntensity >= maxIntensity) {
+            maxIntensity = result.maxIntensity;
+            lightData.elementAt<FScene::POSITION_RADIUS>(0) =
+                    float4{ 0, 0, 0, std::numeric_limits<float>::infinity() };
+            lightData.elementAt<FScene::DIRECTION>(0)       = result.direction;
+            lightData.elementAt<FScene::LIGHT_INSTANCE>(0)  = result.directional;
+        }
+        const size_t begin = DIRECTIONAL_LIGHTS_COUNT + chunk * LIGHT_CHUNK_SIZE;
+        const size_t n = result.count;
+        if (size != begin) {
+            lightData.forEach([begin, n, size](auto* p) {
+                std::move(p + begin, p + begin + n, p + size);
+            });
         }
+        size += n;
+    }
+    lightData.resize(size);
+
+    // some elements past the end of the array will be accessed by SIMD code, we need to make
+    // sure the data is valid enough as not to produce errors such as divide-by-zero
+    // (e.g. in computeLightRanges())
+    for (size_t i = lightData.size(), e = (lightData.size() + 3u) & ~3u; i < e; i++) {
+        new(lightData.data<POSITION_RADIUS>() + i) float4{ 0, 0, 0, 1 };
+    }
+}
 
-        // getInstance() always returns null if the entity is the Null entity
-        // so we don't need to check for that, but we need to check it's alive
-        auto ri = rcm.getInstance(e);
-        auto li = lcm.getInstance(e);
-        if (!ri & !li) {
-            continue;
+bool FScene::updateRenderableCache() noexcept {
+    SYSTRACE_CALL();
+
+    FEngine& engine = mEngine;
+    EntityManager& em = engine.getEntityManager();
+    ChangeJournal const& transformJournal = engine.getTransformManager().getChangeJournal();
+    ChangeJournal const& renderableJournal = engine.getRenderableManager().getChangeJournal();
+    ChangeJournal const& lightJournal = engine.getLightManager().getChangeJournal();
+    JournalPositions& positions = mJournalPositions;
+
+    // the rows updated below are stamped with this generation
+    mGeneration++;
+
+    Slice<const Entity> transformChanges;
+    Slice<const Entity> renderableChanges;
+    Slice<const Entity> lightChanges;
+    const bool incremental = !mRenderableCacheInvalid &&
+            transformJournal.getChanges(positions.transforms, &transformChanges) &&
+            renderableJournal.getChanges(positions.renderables, &renderableChanges) &&
+            lightJournal.getChanges(positions.lights, &lightChanges);
+
+    bool changed;
+    if (UTILS_LIKELY(incremental)) {
+        // note: an entity can appear several times, updating it is idempotent
+        changed = !mDirtyEntities.empty() || !transformChanges.empty() ||
+                !renderableChanges.empty() || !lightChanges.empty();
+        for (Entity e : mDirtyEntities) {
+            updateEntity(e);
         }
+        for (Entity e : transformChanges) {
+            updateEntity(e);
+        }
+        for (Entity e : renderableChanges) {
+            updateEntity(e);
+        }
+        for (Entity e : lightChanges) {
+            updateEntity(e);
+        }
+    } else {
+        // we don't know what changed, rebuild everything
+        changed = true;
+        rebuildRenderableCache();
+        mRenderableCacheInvalid = false;
+        mCullingBvhInvalid = true;
+    }
 
-        // get the world transform
-        auto ti = tcm.getInstance(e);
-        const mat4f worldTransform = worldOriginTransform * tcm.getWorldTransform(ti);
-        const bool reversedWindingOrder = det(worldTransform.upperLeft()) < 0;
-
-        // don't even draw this object if it doesn't have a transform (which shouldn't happen
-        // because one is always created when creating a Renderable component).
-        if (ri && ti) {
-            // compute the world AABB so we can perform culling
-            const Box worldAABB = rigidTransform(rcm.getAABB(ri), worldTransform);
-
-            // we know there is enough space in the array
-            sceneData.push_back_unsafe(
-                    ri,                       // RENDERABLE_INSTANCE
-                    worldTransform,           // WORLD_TRANSFORM
-                    reversedWindingOrder,     // REVERSED_WINDING_ORDER
-                    rcm.getVisibility(ri),    // VISIBILITY_STATE
-                    rcm.getBonesUbh(ri),      // BONES_UBH
-                    worldAABB.center,         // WORLD_AABB_CENTER
-                    0,                        // VISIBLE_MASK
-                    rcm.getMorphWeights(ri),  // MORPH_WEIGHTS
-                    rcm.getLayerMask(ri),     // LAYERS
-                    worldAABB.halfExtent,     // WORLD_AABB_EXTENT
-                    {},                       // PRIMITIVES
-                    0                         // SUMMED_PRIMITIVE_COUNT
-            );
+    mDirtyEntities.clear();
+    positions.transforms = transformJournal.tell();
+    positions.renderables = renderableJournal.tell();
+    positions.lights = lightJournal.tell();
+
+    // Entities can be destroyed without their components being destroyed (yet), in which case
+    // the component managers can't tell us. This only needs to check a byte per renderable.
+    auto& cache = mRenderableCache;
+    for (size_t i = cache.size(); i-- > 0;) {
+        if (UTILS_UNLIKELY(!em.isAlive(cache.elementAt<CACHE_ENTITY>(i)))) {
+            removeRenderableCacheRow(i);
+            changed = true;
         }
+    }
+    for (Entity e : mLights) {
+        if (UTILS_UNLIKELY(e && !em.isAlive(e))) {
+            removeLight(e);
+        }
+    }
+    if (UTILS_UNLIKELY(mLightsNeedCompaction)) {
+        compactLights();
+    }
+    return changed;
+}
 
-        if (li) {
-            // find the dominant directional light
-            if (UTILS_UNLIKELY(lcm.isDirectionalLight(li))) {
-                // we don't store the directional lights, because we only have a single one
-                if (lcm.getIntensity(li) >= maxIntensity) {
-                    maxIntensity = lcm.getIntensity(li);
-                    float3 d = lcm.getLocalDirection(li);
-                    // using mat3f::getTransformForNormals handles non-uniform scaling
-                    d = normalize(mat3f::getTransformForNormals(worldTransform.upperLeft()) * d);
-                    lightData.elementAt<FScene::POSITION_RADIUS>(0) =
-                            float4{ 0, 0, 0, std::numeric_limits<float>::infinity() };
-                    lightData.elementAt<FScene::DIRECTION>(0)       = d;
-                    lightData.elementAt<FScene::LIGHT_INSTANCE>(0)  = li;
-                }
-            } else {
-                const float4 p = worldTransform * float4{ lcm.getLocalPosition(li), 1 };
-                float3 d = 0;
-                if (!lcm.isPointLight(li) || lcm.isIESLight(li)) {
-                    d = lcm.getLocalDirection(li);
-                    // using mat3f::getTransformForNormals handles non-uniform scaling
-                    d = normalize(mat3f::getTransformForNormals(worldTransform.upperLeft()) * d);
+void FScene::rebuildRenderableCache() noexcept {
+    SYSTRACE_CALL();
+
+    FEngine& engine = mEngine;
+    JobSystem& js = engine.getJobSystem();
+    EntityManager& em = engine.getEntityManager();
+    FLightManager& lcm = engine.getLightManager();
+    auto& cache = mRenderableCache;
+
+    // Entities are processed in parallel, by chunks of ENTITY_CHUNK_SIZE. Each chunk packs its
+    // renderables (and lights) at the beginning of its range of rows, the chunks are then
+    // compacted, so that rows end-up in the same order as mEntities.
+
+    std::vector<Entity> entities(mEntities.begin(), mEntities.end());
+    const size_t count = entities.size();
+    const size_t chunkCount = (count + ENTITY_CHUNK_SIZE - 1) / ENTITY_CHUNK_SIZE;
+
+    cache.clear();
+    cache.resize(count);
+    mLights.resize(count);
+    std::vector<uint32_t> renderableCounts(chunkCount);
+    std::vector<uint32_t> lightCounts(chunkCount);
+
+    auto functor = [&](uint32_t first, uint32_t c) {
+        for (size_t chunk = first; chunk < first + c; chunk++) {
+            const size_t begin = chunk * ENTITY_CHUNK_SIZE;
+            const size_t end = std::min(begin + ENTITY_CHUNK_SIZE, count);
+            size_t renderableCount = begin;
+            size_t lightCount = begin;
+            for (size_t i = begin; i < end; i++) {
+                Entity const e = entities[i];
+                renderableCount += updateRenderableCacheRow(e, renderableCount) ? 1 : 0;
+                if (em.isAlive(e) && lcm.getInstance(e)) {
+                    mLights[lightCount++] = e;
                 }
-                lightData.push_back_unsafe(
-                        float4{ p.xyz, lcm.getRadius(li) }, d, li, {}, {});
             }
+            renderableCounts[chunk] = uint32_t(renderableCount - begin);
+            lightCounts[chunk] = uint32_t(lightCount - begin);
         }
+    };
+
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(chunkCount),
+            std::cref(functor), jobs::CountSplitter<1, 8>());
+    js.runAndWait(job);
+
+    // compaction, rows only ever move toward the beginning of the arrays
+    size_t renderableCount = 0;
+    size_t lightCount = 0;
+    for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+        const size_t begin = chunk * ENTITY_CHUNK_SIZE;
+        const size_t n = renderableCounts[chunk];
+        if (renderableCount != begin) {
+            cache.forEach([begin, n, renderableCount](auto* p) {
+                std::move(p + begin, p + begin + n, p + renderableCount);
+            });
+        }
+        renderableCount += n;
+        std::move(mLights.begin() + begin, mLights.begin() + begin + lightCounts[chunk],
+                mLights.begin() + lightCount);
+        lightCount += lightCounts[chunk];
+    }
+    cache.resize(renderableCount);
+    mLights.resize(lightCount);
+    mLightsNeedCompaction = false;
+
+    mRenderableCacheRows.clear();
+    mRenderableCacheRows.reserve(renderableCount);
+    Entity const* const rowEntities = cache.data<CACHE_ENTITY>();
+    for (size_t i = 0; i < renderableCount; i++) {
+        mRenderableCacheRows[rowEntities[i]] = uint32_t(i);
     }
 
-    // some elements past the end of the array will be accessed by SIMD code, we need to make
-    // sure the data is valid enough as not to produce errors such as divide-by-zero
-    // (e.g. in computeLightRanges())
-    for (size_t i = lightData.size(), e = (lightData.size() + 3u) & ~3u; i < e; i++) {
-        new(lightData.data<POSITION_RADIUS>() + i) float4{ 0, 0, 0, 1 };
+    mLightRows.clear();
+    mLightRows.reserve(lightCount);
+    for (size_t i = 0; i < lightCount; i++) {
+        mLightRows[mLights[i]] = uint32_t(i);
     }
 }
 
-void FScene::updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Handle<backend::HwUniformBuffer> renderableUbh) noexcept {
-    FEngine::DriverApi& driver = mEngine.getDriverApi();
-    const size_t size = visibleRenderables.size() * sizeof(PerRenderableUib);
+void FScene::updateEntity(Entity e) noexcept {
+    FEngine& engine = mEngine;
+    EntityManager& em = engine.getEntityManager();
+    FLightManager& lcm = engine.getLightManager();
 
-    // allocate space into the command stream directly
-    void* const buffer = driver.allocate(size);
+    const bool inScene = mEntities.find(e) != mEntities.end();
+
+    auto& cache = mRenderableCache;
+    auto pos = mRenderableCacheRows.find(e);
+    if (pos == mRenderableCacheRows.end()) {
+        // tentatively add a row for this entity
+        const size_t row = cache.size();
+        cache.push_back();
+        if (inScene && updateRenderableCacheRow(e, row)) {
+            mRenderableCacheRows[e] = uint32_t(row);
+            mCullingBvhInvalid = true;
+        } else {
+            cache.pop_back();
+        }
+    } else if (!inScene || !updateRenderableCacheRow(e, pos->second)) {
+        removeRenderableCacheRow(pos->second);
+    }
 
-    auto& sceneData = mRenderableData;
-    for (uint32_t i : visibleRenderables) {
-        mat4f const& model = sceneData.elementAt<WORLD_TRANSFORM>(i);
-        const size_t offset = i * sizeof(PerRenderableUib);
+    if (inScene && em.isAlive(e) && lcm.getInstance(e)) {
+        if (mLightRows.find(e) == mLightRows.end()) {
+            mLightRows[e] = uint32_t(mLights.size());
+            mLights.push_back(e);
+        }
+    } else {
+        removeLight(e);
+    }
+}
+
+void FScene::removeLight(Entity e) noexcept {
+    auto pos = mLightRows.find(e);
+    if (pos != mLightRows.end()) {
+        // leave a hole, so that the other lights keep their order, see compactLights()
+        mLights[pos->second] = {};
+        mLightRows.erase(pos);
+        mLightsNeedCompaction = true;
+    }
+}
+
+void FScene::compactLights() noexcept {
+    mLights.erase(std::remove(mLights.begin(), mLights.end(), Entity{}), mLights.end());
+    for (size_t i = 0, c = mLights.size(); i < c; i++) {
+        mLightRows[mLights[i]] = uint32_t(i);
+    }
+    mLightsNeedCompaction = false;
+}
+
+bool FScene::updateRenderableCacheRow(Entity e, size_t row) noexcept {
+    FEngine& engine = mEngine;
+    EntityManager& em = engine.getEntityManager();
+    FRenderableManager& rcm = engine.getRenderableManager();
+    FTransformManager& tcm = engine.getTransformManager();
+
+    // getInstance() always returns null if the entity is the Null entity
+    // so we don't need to check for that, but we need to check it's alive
+    if (!em.isAlive(e)) {
+        return false;
+    }
+
+    // don't even draw this object if it doesn't have a transform (which shouldn't happen
+    // because one is always created when creating a Renderable component).
+    auto ri = rcm.getInstance(e);
+    auto ti = tcm.getInstance(e);
+    if (!ri || !ti) {
+        return false;
+    }
+
+    // compute the world AABB so we can perform culling
+    const mat4f& worldTransform = tcm.getWorldTransform(ti);
+    const Box& aabb = rcm.getAABB(ri);
+    const Box worldAABB = rigidTransform(aabb, worldTransform);
+
+    auto& cache = mRenderableCache;
+    cache.elementAt<CACHE_ENTITY>(row)                  = e;
+    cache.elementAt<CACHE_RENDERABLE_INSTANCE>(row)     = ri;
+    cache.elementAt<CACHE_WORLD_TRANSFORM>(row)         = worldTransform;
+    cache.elementAt<CACHE_REVERSED_WINDING_ORDER>(row)  = det(worldTransform.upperLeft()) < 0;
+    cache.elementAt<CACHE_VISIBILITY_STATE>(row)        = rcm.getVisibility(ri);
+    cache.elementAt<CACHE_BONES_UBH>(row)               = rcm.getBonesUbh(ri);
+    cache.elementAt<CACHE_AABB>(row)                    = aabb;
+    cache.elementAt<CACHE_WORLD_AABB_CENTER>(row)       = worldAABB.center;
+    cache.elementAt<CACHE_WORLD_AABB_EXTENT>(row)       = worldAABB.halfExtent;
+    cache.elementAt<CACHE_MORPH_WEIGHTS>(row)           = rcm.getMorphWeights(ri);
+    cache.elementAt<CACHE_LAYERS>(row)                  = rcm.getLayerMask(ri);
+    cache.elementAt<CACHE_GENERATION>(row)              = mGeneration;
+    return true;
+}
+
+void FScene::removeRenderableCacheRow(size_t row) noexcept {
+    auto& cache = mRenderableCache;
+    const size_t last = cache.size() - 1;
+    mRenderableCacheRows.erase(cache.elementAt<CACHE_ENTITY>(row));
+    if (row != last) {
+        // move the last row into the removed one's slot, all other rows are unchanged
+        cache.swap(row, last);
+        mRenderableCacheRows[cache.elementAt<CACHE_ENTITY>(row)] = uint32_t(row);
+        // the moved renderable's UBO slot changed
+        cache.elementAt<CACHE_GENERATION>(row) = mGeneration;
+    }
+    cache.pop_back();
+    mCullingBvhInvalid = true;
+}
+
+void FScene::updateCullingBvh() noexcept {
+    SYSTRACE_CALL();
+
+    auto const& sceneData = mRenderableData;
+    float3 const* const center = sceneData.data<WORLD_AABB_CENTER>();
+    float3 const* const extent = sceneData.data<WORLD_AABB_EXTENT>();
+
+    // Rows of the renderable cache only move when renderables are added or removed, otherwise
+    // refitting the hierarchy is enough. Refitting is always correct
+    // (it recomputes all the bounds), but the hierarchy becomes less efficient as renderables
+    // move and we need to rebuild it from time to time.
+    if (mCullingBvhInvalid) {
+        mCullingBvh.build(center, extent, sceneData.size());
+        mCullingBvhInvalid = false;
+    } else {
+        mCullingBvh.refit(center, extent);
+    }
+}
+
+void FScene::getDirtyUBOs(utils::Range<uint32_t> visibleRenderables, RenderableUboState& ubo,
+        std::vector<uint32_t>& dirty) const noexcept {
+    SYSTRACE_CALL();
+
+    uint32_t const* const UTILS_RESTRICT slots = mRenderableData.data<UBO_SLOT>();
+    uint32_t const* const UTILS_RESTRICT generations = mRenderableCache.data<CACHE_GENERATION>();
+    const size_t slotCount = mRenderableCache.size();
+
+    // the slots don't depend on the world origin, it's applied with the per-view uniforms
+    const bool invalid = ubo.scene != this;
+    ubo.scene = this;
+    ubo.generations.resize(slotCount);
+    uint32_t* const UTILS_RESTRICT uboGenerations = ubo.generations.data();
+
+    dirty.clear();
+    if (!invalid) {
+        for (uint32_t i : visibleRenderables) {
+            const uint32_t slot = slots[i];
+            if (uboGenerations[slot] != generations[slot]) {
+                uboGenerations[slot] = generations[slot];
+                dirty.push_back(i);
+            }
+        }
+    }
+
+    // When most slots are dirty, it's cheaper to write all of them in a single range, this also
+    // spares sorting them.
+    if (invalid || dirty.size() * 2 > slotCount) {
+        dirty.resize(slotCount);
+        for (uint32_t i = 0; i < slotCount; i++) {
+            dirty[slots[i]] = i;
+        }
+        std::copy_n(generations, slotCount, uboGenerations);
+    }
+}
+
+void FScene::updateUBOs(utils::Slice<uint32_t> dirty, void* buffer) const noexcept {
+    SYSTRACE_CALL();
+
+    auto const& sceneData = mRenderableData;
+    uint32_t const* const slots = sceneData.data<UBO_SLOT>();
+    mat4f const* const transforms = mRenderableCache.data<CACHE_WORLD_TRANSFORM>();
+    auto bySlot = [slots](uint32_t lhs, uint32_t rhs) { return slots[lhs] < slots[rhs]; };
+    if (!std::is_sorted(dirty.begin(), dirty.end(), bySlot)) {
+        std::sort(dirty.begin(), dirty.end(), bySlot);
+    }
+
+    // the PerRenderableUib are packed in 'buffer', in the order of their slots
+    for (size_t k = 0, c = dirty.size(); k < c; k++) {
+        const uint32_t i = dirty[k];
+        // the slot is the renderable's row in the cache, which has the transform without the
+        // world origin
+        mat4f const& model = transforms[slots[i]];
+        const size_t offset = k * sizeof(PerRenderableUib);
 
         UniformBuffer::setUniform(buffer,
                 offset + offsetof(PerRenderableUib, worldFromModelMatrix),
@@ -218,9 +614,26 @@ void FScene::updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Hand
                 offset + offsetof(PerRenderableUib, morphWeights), sceneData.elementAt<MORPH_WEIGHTS>(i));
     }
 
-    // TODO: handle static objects separately
+}
+
+void FScene::commitUBOs(backend::DriverApi& driver, utils::Slice<const uint32_t> dirty,
+        backend::Handle<backend::HwUniformBuffer> renderableUbh, void* buffer) noexcept {
     mRenderableViewUbh = renderableUbh;
-    driver.loadUniformBuffer(renderableUbh, { buffer, size });
+
+    uint32_t const* const slots = mRenderableData.data<UBO_SLOT>();
+    char* const data = static_cast<char*>(buffer);
+    for (size_t first = 0, c = dirty.size(); first < c;) {
+        const uint32_t slot = slots[dirty[first]];
+        size_t last = first + 1;
+        while (last < c && slots[dirty[last]] == slot + (last - first)) {
+            last++;
+        }
+        driver.updateUniformBuffer(renderableUbh, {
+                        data + first * sizeof(PerRenderableUib),
+                        (last - first) * sizeof(PerRenderableUib) },
+                uint32_t(slot * sizeof(PerRenderableUib)));
+        first = last;
+    }
 }
 
 void FScene::terminate(FEngine& engine) {
@@ -339,14 +752,17 @@ inline void FScene::computeLightRanges(
 
 void FScene::addEntity(Entity entity) {
     mEntities.insert(entity);
+    mDirtyEntities.push_back(entity);
 }
 
 void FScene::addEntities(const Entity* entities, size_t count) {
     mEntities.insert(entities, entities + count);
+    mDirtyEntities.insert(mDirtyEntities.end(), entities, entities + count);
 }
 
 void FScene::remove(Entity entity) {
     mEntities.erase(entity);
+    mDirtyEntities.push_back(entity);
 }
 
 size_t FScene::getRenderableCount() const noexcept {
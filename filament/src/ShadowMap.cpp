@@ -167,15 +167,7 @@ void ShadowMap::render(DriverApi& driver, RenderPass& pass, FView& view) noexcep
     // the inset-by-1 rectangle.
     params.flags.ignoreScissor = true;
 
-    FCamera const& camera = getCamera();
-    details::CameraInfo cameraInfo = {
-            .projection         = mat4f{ camera.getProjectionMatrix() },
-            .cullingProjection  = mat4f{ camera.getCullingProjectionMatrix() },
-            .model              = camera.getModelMatrix(),
-            .view               = camera.getViewMatrix(),
-            .zn                 = camera.getNear(),
-            .zf                 = camera.getCullingFar(),
-    };
+    details::CameraInfo const cameraInfo = getCameraInfo(view.getCameraInfo());
     pass.setCamera(cameraInfo);
 
     FView::Range visibleRenderables = view.getVisibleShadowCasters();
@@ -187,15 +179,31 @@ void ShadowMap::render(DriverApi& driver, RenderPass& pass, FView& view) noexcep
 
     pass.overridePolygonOffset(&mPolygonOffset);
 
-    auto curr = pass.getCommands().end();
-    pass.appendCommands(RenderPass::SHADOW);
-    pass.sortCommands(curr);
+    pass.appendSortedCommands(RenderPass::SHADOW, mCommandCache);
 
     pass.execute("Shadow map Pass", getRenderTarget(), params,
-            pass.getCommands().begin(), pass.getCommands().end());
+            pass.getCommands().begin(), pass.getCommands().end(), &view.getRenderStats().shadow);
     pass.overridePolygonOffset(nullptr);
 }
 
+details::CameraInfo ShadowMap::getCameraInfo(
+        details::CameraInfo const& viewCamera) const noexcept {
+    // The light's camera is computed relative to the world origin of the view's camera, which
+    // is applied in the vertex shader (see FView::prepareCamera()), so the casters must be
+    // rendered with the same world origin (and world offset).
+    FCamera const& camera = getCamera();
+    return details::CameraInfo{
+            .projection         = mat4f{ camera.getProjectionMatrix() },
+            .cullingProjection  = mat4f{ camera.getCullingProjectionMatrix() },
+            .model              = camera.getModelMatrix(),
+            .view               = camera.getViewMatrix(),
+            .zn                 = camera.getNear(),
+            .zf                 = camera.getCullingFar(),
+            .worldOffset        = viewCamera.worldOffset,
+            .worldOrigin        = viewCamera.worldOrigin
+    };
+}
+
 void ShadowMap::terminate(DriverApi& driverApi) noexcept {
     if (mShadowMapRenderTarget) {
         driverApi.destroyRenderTarget(mShadowMapRenderTarget);
@@ -293,7 +301,7 @@ void ShadowMap::computeShadowCameraDirectional(
     // Compute scene bounds in world space, as well as the light-space near/far planes
     float2 nearFar = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max() };
     Aabb wsShadowCastersVolume, wsShadowReceiversVolume;
-    visitScene(*scene, visibleLayers,
+    visitScene(*scene, visibleLayers, camera.worldOrigin,
             [&wsShadowCastersVolume, &Mv, &nearFar](Aabb caster) {
                 wsShadowCastersVolume.min = min(wsShadowCastersVolume.min, caster.min);
                 wsShadowCastersVolume.max = max(wsShadowCastersVolume.max, caster.max);
@@ -1029,7 +1037,7 @@ float ShadowMap::texelSizeWorldSpace(const mat4f& Wp, const mat4f& MbMtF) const
 
 template<typename Casters, typename Receivers>
 void ShadowMap::visitScene(const FScene& scene, uint32_t visibleLayers,
-        Casters casters, Receivers receivers) noexcept {
+        mat4f const& worldOrigin, Casters casters, Receivers receivers) noexcept {
     using State = FRenderableManager::Visibility;
     FScene::RenderableSoa const& UTILS_RESTRICT soa = scene.getRenderableData();
     float3 const* const UTILS_RESTRICT worldAABBCenter = soa.data<FScene::WORLD_AABB_CENTER>();
@@ -1039,8 +1047,10 @@ void ShadowMap::visitScene(const FScene& scene, uint32_t visibleLayers,
     size_t c = soa.size();
     for (size_t i = 0; i < c; i++) {
         if (layers[i] & visibleLayers) {
-            const Aabb aabb{ worldAABBCenter[i] - worldAABBExtent[i],
-                             worldAABBCenter[i] + worldAABBExtent[i] };
+            // the scene's bounding boxes don't include the world origin, the camera does
+            const Box box = rigidTransform(Box{ worldAABBCenter[i], worldAABBExtent[i] },
+                    worldOrigin);
+            const Aabb aabb{ box.getMin(), box.getMax() };
             if (visibility[i].castShadows) {
                 casters(aabb);
             }
@@ -117,12 +117,32 @@ FTexture::FTexture(FEngine& engine, const Builder& builder) {
     FEngine::DriverApi& driver = engine.getDriverApi();
     mHandle = driver.createTexture(
             mTarget, mLevelCount, mFormat, mSampleCount, mWidth, mHeight, mDepth, mUsage);
+    engine.getMemoryCounter(Engine::MemoryTag::TEXTURES).add(getByteSize());
 }
 
 // frees driver resources, object becomes invalid
 void FTexture::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
     driver.destroyTexture(mHandle);
+    engine.getMemoryCounter(Engine::MemoryTag::TEXTURES).remove(getByteSize());
+}
+
+size_t FTexture::getByteSize() const noexcept {
+    size_t size;
+    if (isCompressed()) {
+        // we assume blocks of 4x4 texels, getFormatSize() is the size of a block
+        size = ((mWidth + 3) / 4) * ((mHeight + 3) / 4) * size_t(mDepth) * getFormatSize(mFormat);
+    } else {
+        size = size_t(mWidth) * mHeight * mDepth * getFormatSize(mFormat);
+    }
+    if (mTarget == Sampler::SAMPLER_CUBEMAP) {
+        size *= 6;
+    }
+    if (mLevelCount > 1) {
+        // we assume the full pyramid
+        size += size / 3;
+    }
+    return size * mSampleCount;
 }
 
 size_t FTexture::getWidth(size_t level) const noexcept {
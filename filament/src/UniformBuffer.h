@@ -30,6 +30,8 @@
 #include <math/mat3.h>
 #include <math/mat4.h>
 
+#include <limits>
+
 #include <stddef.h>
 #include <assert.h>
 
@@ -69,7 +71,8 @@ public:
     // invalidate a range of uniforms and return a pointer to it. offset and size given in bytes
     void* invalidateUniforms(size_t offset, size_t size) {
         assert(offset + size <= mSize);
-        mSomethingDirty = true;
+        mDirtyBegin = std::min(mDirtyBegin, uint32_t(offset));
+        mDirtyEnd = std::max(mDirtyEnd, uint32_t(offset + size));
         return static_cast<char*>(mBuffer) + offset;
     }
 
@@ -84,10 +87,17 @@ public:
     size_t getSize() const noexcept { return mSize; }
 
     // return if any uniform has been changed
-    bool isDirty() const noexcept { return mSomethingDirty; }
+    bool isDirty() const noexcept { return mDirtyBegin < mDirtyEnd; }
+
+    // offset and size in bytes of the range spanning all the changed uniforms
+    size_t getDirtyOffset() const noexcept { return isDirty() ? mDirtyBegin : 0; }
+    size_t getDirtySize() const noexcept { return isDirty() ? mDirtyEnd - mDirtyBegin : 0; }
 
     // mark the whole buffer as clean (no modified uniforms)
-    void clean() const noexcept { mSomethingDirty = false; }
+    void clean() const noexcept {
+        mDirtyBegin = std::numeric_limits<uint32_t>::max();
+        mDirtyEnd = 0;
+    }
 
     /*
      * -----------------------------------------------
@@ -183,6 +193,22 @@ public:
         return p;
     }
 
+    // Uploads the range spanning all the changed uniforms to 'ubh', which must otherwise be
+    // up-to-date, and cleans the dirty bits.
+    void commit(backend::DriverApi& driver,
+            backend::Handle<backend::HwUniformBuffer> ubh) const noexcept {
+        assert(isDirty());
+        const size_t offset = getDirtyOffset();
+        const size_t size = getDirtySize();
+        if (size == getSize()) {
+            // the backend doesn't need to preserve anything, which can be cheaper
+            driver.loadUniformBuffer(ubh, toBufferDescriptor(driver));
+        } else {
+            driver.updateUniformBuffer(ubh, toBufferDescriptor(driver, offset, size),
+                    uint32_t(offset));
+        }
+    }
+
 private:
 #if !defined(NDEBUG)
     friend utils::io::ostream& operator<<(utils::io::ostream& out, const UniformBuffer& rhs);
@@ -198,7 +224,9 @@ private:
     char mStorage[96];
     void *mBuffer = nullptr;
     uint32_t mSize = 0;
-    mutable bool mSomethingDirty = false;
+    // range of the changed uniforms, it's empty when mDirtyBegin >= mDirtyEnd
+    mutable uint32_t mDirtyBegin = std::numeric_limits<uint32_t>::max();
+    mutable uint32_t mDirtyEnd = 0;
 };
 
 // specialization for mat3f (which has a different alignment, see std140 layout rules)
@@ -166,11 +166,24 @@ FVertexBuffer::FVertexBuffer(FEngine& engine, const VertexBuffer::Builder& build
     FEngine::DriverApi& driver = engine.getDriverApi();
     mHandle = driver.createVertexBuffer(
             mBufferCount, attributeCount, mVertexCount, attributeArray, backend::BufferUsage::STATIC);
+
+    // each buffer is as large as needed by the attributes it contains
+    for (size_t i = 0; i < mBufferCount; ++i) {
+        size_t size = 0;
+        for (auto const& attribute : attributeArray) {
+            if (attribute.buffer == i) {
+                size = std::max(size, attribute.offset + size_t(mVertexCount) * attribute.stride);
+            }
+        }
+        mByteSize += size;
+    }
+    engine.getMemoryCounter(Engine::MemoryTag::VERTEX_BUFFERS).add(mByteSize);
 }
 
 void FVertexBuffer::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
     driver.destroyVertexBuffer(mHandle);
+    engine.getMemoryCounter(Engine::MemoryTag::VERTEX_BUFFERS).remove(mByteSize);
 }
 
 size_t FVertexBuffer::getVertexCount() const noexcept {
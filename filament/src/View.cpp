@@ -18,6 +18,7 @@
 
 #include "details/Engine.h"
 #include "details/Culler.h"
+#include "details/CullingBvh.h"
 #include "details/DFG.h"
 #include "details/Froxelizer.h"
 #include "details/IndirectLight.h"
@@ -36,6 +37,7 @@
 #include <utils/Profiler.h>
 #include <utils/Slice.h>
 #include <utils/Systrace.h>
+#include <utils/TaskGraph.h>
 
 #include <math/scalar.h>
 #include <math/fast.h>
@@ -83,6 +85,8 @@ FView::FView(FEngine& engine)
     // allocate ubos
     mPerViewUbh = driver.createUniformBuffer(mPerViewUb.getSize(), backend::BufferUsage::DYNAMIC);
     mLightUbh = driver.createUniformBuffer(CONFIG_MAX_LIGHT_COUNT * sizeof(LightsUib), backend::BufferUsage::DYNAMIC);
+    engine.getMemoryCounter(Engine::MemoryTag::UNIFORM_BUFFERS).add(
+            mPerViewUb.getSize() + CONFIG_MAX_LIGHT_COUNT * sizeof(LightsUib));
 
     mIsDynamicResolutionSupported = driver.isFrameTimeSupported();
 }
@@ -96,6 +100,9 @@ void FView::terminate(FEngine& engine) {
     driver.destroyUniformBuffer(mLightUbh);
     driver.destroySamplerGroup(mPerViewSbh);
     driver.destroyUniformBuffer(mRenderableUbh);
+    engine.getMemoryCounter(Engine::MemoryTag::UNIFORM_BUFFERS).remove(
+            mPerViewUb.getSize() + CONFIG_MAX_LIGHT_COUNT * sizeof(LightsUib) +
+            mRenderableUBOSize);
     mDirectionalShadowMap.terminate(driver);
     mFroxelizer.terminate(driver);
 }
@@ -296,10 +303,15 @@ void FView::prepareShadowing(FEngine& engine, backend::DriverApi& driver,
         ShadowMap& shadowMap = mDirectionalShadowMap;
         shadowMap.update(lightData, 0, mScene, mViewingCameraInfo, mVisibleLayers);
         if (shadowMap.hasVisibleShadows()) {
-            // Cull shadow casters
+            // Cull shadow casters, the shadow camera includes the world origin, which isn't
+            // applied to the renderables' world-space data
             UniformBuffer& u = mPerViewUb;
-            Frustum const& frustum = shadowMap.getCamera().getFrustum();
-            FView::prepareVisibleShadowCasters(engine.getJobSystem(), frustum, renderableData);
+            FCamera const& shadowCamera = shadowMap.getCamera();
+            const Frustum frustum = FCamera::getFrustum(
+                    shadowCamera.getCullingProjectionMatrix(),
+                    shadowCamera.getViewMatrix() * mViewingCameraInfo.worldOrigin);
+            FView::prepareVisibleShadowCasters(engine.getJobSystem(), frustum, renderableData,
+                    mScene->getCullingBvh());
 
             // allocates shadowmap driver resources
             shadowMap.prepare(driver, mPerViewSb);
@@ -400,9 +412,11 @@ void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaSc
     }
 }
 
-void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& arena,
-        filament::Viewport const& viewport, float4 const& userTime) noexcept {
+TaskGraph::Task FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& arena,
+        filament::Viewport const& viewport, float4 const& userTime, TaskGraph& tasks) noexcept {
     JobSystem& js = engine.getJobSystem();
+    FrameTimings& timings = mFrameTimings;
+    timings = {};
 
     /*
      * Prepare the scene -- this is where we gather all the objects added to the scene,
@@ -462,51 +476,76 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
             .ev100              = Exposure::ev100(*camera),
             // world offset to allow users to determine the API-level camera position
             .worldOffset        = camera->getPosition(),
-            // world origin transform, use only for debugging
+            // world origin transform, the vertex shader applies it to the renderables
             .worldOrigin        = worldOriginCamera
     };
+    // lights are prepared relative to the world origin, renderables are not
     mCullingFrustum = FCamera::getFrustum(
             mCullingCamera->getCullingProjectionMatrix(),
             FCamera::getViewMatrix(worldOriginScene * mCullingCamera->getModelMatrix()));
+    mRenderableCullingFrustum = FCamera::getFrustum(
+            mCullingCamera->getCullingProjectionMatrix(),
+            mCullingCamera->getViewMatrix());
 
     /*
-     * Gather all information needed to render this scene. Apply the world origin to all
-     * objects in the scene.
+     * Gather all information needed to render this scene. Apply the world origin to the
+     * lights; the renderables' world-space data doesn't include it.
      */
-    scene->prepare(worldOriginScene);
+    {
+        FrameTimings::Scope timer(&timings, &FrameTimings::prepare);
+        scene->prepare(worldOriginScene, arena);
+    }
+
+    Range merged;
+    FScene::RenderableSoa& renderableData = scene->getRenderableData();
 
     /*
-     * Light culling: runs in parallel with Renderable culling (below)
+     * Light culling and Renderable culling run in parallel. The tasks below only depend on
+     * FScene::prepare().
      */
 
-    auto prepareVisibleLightsJob = js.runAndRetain(js.createJob(nullptr,
-            [&frustum = mCullingFrustum, &engine, scene](JobSystem& js, JobSystem::Job*) {
-                FView::prepareVisibleLights(
-                        engine.getLightManager(), js, frustum, scene->getLightData());
-            }));
-
-    Range merged;
-    FScene::RenderableSoa& renderableData = scene->getRenderableData();
+    // both culling tasks run concurrently, so lights culling is timed separately
+    FrameTimings lightsTimings;
+    TaskGraph::Task cullLights = tasks.add([this, &engine, &js, scene, &lightsTimings]() {
+        FrameTimings::Scope timer(&lightsTimings, &FrameTimings::culling);
+        FView::prepareVisibleLights(
+                engine.getLightManager(), js, mCullingFrustum, scene->getLightData());
+    });
+    tasks.setName(cullLights, "cullLights");
 
-    { // all the operations in this scope must happen sequentially
+    /*
+     * Culling: as soon as possible we perform our camera-culling
+     * (this will set the VISIBLE_RENDERABLE bit)
+     */
 
+    TaskGraph::Task cullRenderables = tasks.add([this, &js, &renderableData, &timings]() {
+        FrameTimings::Scope timer(&timings, &FrameTimings::culling);
         Slice<Culler::result_type> cullingMask = renderableData.slice<FScene::VISIBLE_MASK>();
         std::uninitialized_fill(cullingMask.begin(), cullingMask.end(), 0);
+        prepareVisibleRenderables(js, mRenderableCullingFrustum, renderableData);
+    });
+    tasks.setName(cullRenderables, "cullRenderables");
 
-        /*
-         * Culling: as soon as possible we perform our camera-culling
-         * (this will set the VISIBLE_RENDERABLE bit)
-         */
+    tasks.run();
 
-        prepareVisibleRenderables(js, mCullingFrustum, renderableData);
+    void* renderableUboBuffer;
+    TaskGraph::Task updateUBOs;
 
+    { // all the operations in this scope must happen sequentially
+
+        tasks.wait(cullRenderables);
+
+        Slice<Culler::result_type> cullingMask = renderableData.slice<FScene::VISIBLE_MASK>();
 
         /*
          * Shadowing: compute the shadow camera and cull shadow casters
          * (this will set the VISIBLE_SHADOW_CASTER bit)
          */
 
-        prepareShadowing(engine, driver, renderableData, scene->getLightData());
+        {
+            FrameTimings::Scope timer(&timings, &FrameTimings::culling);
+            prepareShadowing(engine, driver, renderableData, scene->getLightData());
+        }
 
         /*
          * partition the array of renderable w.r.t their visibility:
@@ -535,19 +574,37 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
         mVisibleShadowCasters = Range{ uint32_t(beginCasters - beginRenderables), iEnd };
         merged = Range{ 0, iEnd };
 
-        // update those UBOs
-        const size_t size = merged.size() * sizeof(PerRenderableUib);
-        if (mRenderableUBOSize < size) {
+        // update the UBO slots of the renderables that changed since they were last written
+        // The UBO has a slot for each renderable of the scene, it grows when the scene doesn't
+        // fit anymore and shrinks when the scene uses less than a quarter of it. Reallocating
+        // means uploading all the slots again, the gap between the two thresholds ensures it
+        // doesn't happen every frame when the scene size oscillates.
+        const size_t slotCount = scene->getRenderableSlotCount();
+        const size_t capacity = mRenderableUBOSize / sizeof(PerRenderableUib);
+        if (slotCount > capacity || (capacity > 16u && 4u * slotCount < capacity)) {
             // allocate 1/3 extra, with a minimum of 16 objects
-            const size_t count = std::max(size_t(16u), (4u * merged.size() + 2u) / 3u);
+            const size_t count = std::max(size_t(16u), (4u * slotCount + 2u) / 3u);
+            MemoryCounter& counter = engine.getMemoryCounter(Engine::MemoryTag::UNIFORM_BUFFERS);
+            counter.remove(mRenderableUBOSize);
             mRenderableUBOSize = uint32_t(count * sizeof(PerRenderableUib));
+            counter.add(mRenderableUBOSize);
             driver.destroyUniformBuffer(mRenderableUbh);
             mRenderableUbh = driver.createUniformBuffer(mRenderableUBOSize,
-                    backend::BufferUsage::STREAM);
-        } else {
-            // TODO: should we shrink the underlying UBO at some point?
+                    backend::BufferUsage::DYNAMIC);
+            mRenderableUboState.invalidate();
         }
-        scene->updateUBOs(merged, mRenderableUbh);
+        scene->getDirtyUBOs(merged, mRenderableUboState, mDirtyRenderables);
+
+        // the UBOs are filled in parallel with the rest of the preparation, directly into the
+        // command stream (which must happen on this thread), the upload is issued at the end.
+        Slice<uint32_t> dirty(mDirtyRenderables.data(), mDirtyRenderables.size());
+        renderableUboBuffer = driver.allocate(dirty.size() * sizeof(PerRenderableUib));
+        updateUBOs = tasks.add([scene, dirty, renderableUboBuffer, &timings]() {
+            FrameTimings::Scope timer(&timings, &FrameTimings::prepare);
+            scene->updateUBOs(dirty, renderableUboBuffer);
+        });
+        tasks.setName(updateUBOs, "updateUBOs");
+        tasks.run(updateUBOs);
     }
 
     /*
@@ -556,9 +613,22 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
      * Relies on FScene::prepare() and prepareVisibleLights()
      */
 
-    js.waitAndRelease(prepareVisibleLightsJob);
+    tasks.wait(cullLights);
+    timings.culling += lightsTimings.culling;
     prepareLighting(engine, driver, arena, viewport);
 
+    /*
+     * Froxelization: it only depends on prepareLighting(), and it's not needed until the
+     * color pass.
+     */
+
+    TaskGraph::Task froxelize = tasks.then(cullLights, [this, &engine]() {
+        FrameTimings::Scope timer(&mFrameTimings, &FrameTimings::froxelize);
+        FView::froxelize(engine);
+    });
+    tasks.setName(froxelize, "froxelize");
+    tasks.run(froxelize);
+
     /*
      * Update driver state
      */
@@ -574,6 +644,12 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
 
     // set uniforms and samplers
     bindPerViewUniformsAndSamplers(driver);
+
+    tasks.wait(updateUBOs);
+    scene->commitUBOs(driver, { mDirtyRenderables.data(), mDirtyRenderables.size() },
+            mRenderableUbh, renderableUboBuffer);
+
+    return froxelize;
 }
 
 void FView::computeVisibilityMasks(
@@ -633,6 +709,7 @@ void FView::prepareCamera(const CameraInfo& camera, const filament::Viewport& vi
 
     u.setUniform(offsetof(PerViewUib, cameraPosition), float3{camera.getPosition()});
     u.setUniform(offsetof(PerViewUib, worldOffset), camera.worldOffset);
+    u.setUniform(offsetof(PerViewUib, worldFromUserWorldMatrix), camera.worldOrigin);
 }
 
 void FView::prepareSSAO(Handle<HwTexture> ssao) const noexcept {
@@ -656,7 +733,7 @@ void FView::froxelize(FEngine& engine) const noexcept {
 
 void FView::commitUniforms(backend::DriverApi& driver) const noexcept {
     if (mPerViewUb.isDirty()) {
-        driver.loadUniformBuffer(mPerViewUbh, mPerViewUb.toBufferDescriptor(driver));
+        mPerViewUb.commit(driver, mPerViewUbh);
     }
 
     if (mPerViewSb.isDirty()) {
@@ -675,7 +752,8 @@ void FView::prepareVisibleRenderables(JobSystem& js,
         Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept {
     SYSTRACE_CALL();
     if (UTILS_LIKELY(isFrustumCullingEnabled())) {
-        FView::cullRenderables(js, renderableData, frustum, VISIBLE_RENDERABLE_BIT);
+        FView::cullRenderables(js, renderableData, mScene->getCullingBvh(),
+                frustum, VISIBLE_RENDERABLE_BIT);
     } else {
         std::uninitialized_fill(renderableData.begin<FScene::VISIBLE_MASK>(),
                   renderableData.end<FScene::VISIBLE_MASK>(), VISIBLE_RENDERABLE);
@@ -684,13 +762,23 @@ void FView::prepareVisibleRenderables(JobSystem& js,
 
 UTILS_NOINLINE
 void FView::prepareVisibleShadowCasters(JobSystem& js,
-        Frustum const& lightFrustum, FScene::RenderableSoa& renderableData) noexcept {
+        Frustum const& lightFrustum, FScene::RenderableSoa& renderableData,
+        CullingBvh const* bvh) noexcept {
     SYSTRACE_CALL();
-    FView::cullRenderables(js, renderableData, lightFrustum, VISIBLE_SHADOW_CASTER_BIT);
+    FView::cullRenderables(js, renderableData, bvh, lightFrustum, VISIBLE_SHADOW_CASTER_BIT);
 }
 
 void FView::cullRenderables(JobSystem& js,
-        FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept {
+        FScene::RenderableSoa& renderableData, CullingBvh const* bvh,
+        Frustum const& frustum, size_t bit) noexcept {
+
+    if (bvh) {
+        // the scene keeps a hierarchy in sync with the world AABBs, which allows us to
+        // reject (or accept) large groups of renderables at once.
+        assert(bvh->size() == renderableData.size());
+        bvh->intersects(js, renderableData.data<FScene::VISIBLE_MASK>(), frustum, bit);
+        return;
+    }
 
     float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
     float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
@@ -910,6 +998,10 @@ View::DynamicResolutionOptions View::getDynamicResolutionOptions() const noexcep
     return upcast(this)->getDynamicResolutionOptions();
 }
 
+View::RenderStats View::getRenderStats() const noexcept {
+    return upcast(this)->getRenderStats();
+}
+
 void View::setRenderQuality(const RenderQuality& renderQuality) noexcept {
     upcast(this)->setRenderQuality(renderQuality);
 }
@@ -158,6 +158,7 @@ void FLightManager::create(const FLightManager::Builder& builder, utils::Entity
     }
     Instance i = manager.addComponent(entity);
     assert(i);
+    mChangeJournal.record(entity);
 
     if (i) {
         // This needs to happen before we call the set() methods below
@@ -198,10 +199,17 @@ void FLightManager::destroy(utils::Entity e) noexcept {
     Instance i = getInstance(e);
     if (i) {
         auto& manager = mManager;
+        mChangeJournal.record(e);
         manager.removeComponent(e);
     }
 }
 
+void FLightManager::gc(utils::EntityManager& em) noexcept {
+    mManager.gc(em, 4, [this](Entity e) {
+        destroy(e);
+    });
+}
+
 void FLightManager::terminate() noexcept {
     auto& manager = mManager;
     if (!manager.empty()) {
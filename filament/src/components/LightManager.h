@@ -19,6 +19,8 @@
 
 #include "upcast.h"
 
+#include "details/ChangeJournal.h"
+
 #include "private/backend/DriverApiForward.h"
 
 #include <filament/LightManager.h>
@@ -59,9 +61,11 @@ public:
 
     void prepare(backend::DriverApi& driver) const noexcept;
 
-    void gc(utils::EntityManager& em) noexcept {
-        mManager.gc(em);
-    }
+    void gc(utils::EntityManager& em) noexcept;
+
+    // records the entities whose component was created or destroyed
+    ChangeJournal const& getChangeJournal() const noexcept { return mChangeJournal; }
+    ChangeJournal& getChangeJournal() noexcept { return mChangeJournal; }
 
     struct LightType {
         Type type : 3;
@@ -272,6 +276,7 @@ private:
     };
 
     Sim mManager;
+    ChangeJournal mChangeJournal;
     FEngine& mEngine;
 };
 
@@ -306,6 +306,8 @@ void FRenderableManager::create(
                     UniformBuffer{ count * sizeof(PerRenderableUibBone) },
                     count
             });
+            engine.getMemoryCounter(Engine::MemoryTag::UNIFORM_BUFFERS).add(
+                    CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone));
             assert(bones);
             if (bones) {
                 setSkinning(ci, count > 0);
@@ -320,6 +322,9 @@ void FRenderableManager::create(
                 }
             }
         }
+
+        // the bones' handle is only known now
+        mChangeJournal.record(entity);
     }
 }
 
@@ -328,10 +333,24 @@ void FRenderableManager::destroy(utils::Entity e) noexcept {
     Instance ci = getInstance(e);
     if (ci) {
         destroyComponent(ci);
-        mManager.removeComponent(e);
+        removeComponent(e);
     }
 }
 
+void FRenderableManager::removeComponent(utils::Entity e) noexcept {
+    auto& manager = mManager;
+    // the last component is moved into the removed one's slot, so its Instance changes
+    mChangeJournal.record(e);
+    mChangeJournal.record(manager.getEntity(manager.end() - 1));
+    manager.removeComponent(e);
+}
+
+void FRenderableManager::gc(utils::EntityManager& em) noexcept {
+    mManager.gc(em, 4, [this](Entity e) {
+        removeComponent(e);
+    });
+}
+
 // this destroys all components in this manager
 void FRenderableManager::terminate() noexcept {
     auto& manager = mManager;
@@ -362,6 +381,8 @@ void FRenderableManager::destroyComponent(Instance ci) noexcept {
     std::unique_ptr<Bones> const& bones = manager[ci].bones;
     if (bones) {
         driver.destroyUniformBuffer(bones->handle);
+        engine.getMemoryCounter(Engine::MemoryTag::UNIFORM_BUFFERS).remove(
+                CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone));
     }
 }
 
@@ -386,7 +407,7 @@ void FRenderableManager::prepare(
         assert(i);  // we should never get the null instance here
         if (UTILS_UNLIKELY(bones[i])) {
             if (bones[i]->bones.isDirty()) {
-                driver.loadUniformBuffer(bones[i]->handle, bones[i]->bones.toBufferDescriptor(driver));
+                bones[i]->bones.commit(driver, bones[i]->handle);
             }
         }
     }
@@ -504,6 +525,7 @@ void FRenderableManager::setBones(Instance ci,
 void FRenderableManager::setMorphWeights(Instance ci, const float4& weights) noexcept {
     if (ci) {
         mManager[ci].morphWeights = weights;
+        mChangeJournal.record(mManager.getEntity(ci));
     }
 }
 
@@ -21,6 +21,8 @@
 
 #include "UniformBuffer.h"
 
+#include "details/ChangeJournal.h"
+
 #include "private/backend/DriverApiForward.h"
 
 #include <backend/Handle.h>
@@ -86,9 +88,12 @@ public:
             RenderableManager::Instance const* instances,
             utils::Range<uint32_t> list) const noexcept;
 
-    void gc(utils::EntityManager& em) noexcept {
-        mManager.gc(em);
-    }
+    void gc(utils::EntityManager& em) noexcept;
+
+    // records the entities whose component was created, destroyed or moved, or whose data
+    // used by FScene changed.
+    ChangeJournal const& getChangeJournal() const noexcept { return mChangeJournal; }
+    ChangeJournal& getChangeJournal() noexcept { return mChangeJournal; }
 
     inline void setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept;
 
@@ -143,6 +148,7 @@ public:
 
 private:
     void destroyComponent(Instance ci) noexcept;
+    void removeComponent(utils::Entity e) noexcept;
     static void destroyComponentPrimitives(FEngine& engine,
             utils::Slice<FRenderPrimitive>& primitives) noexcept;
 
@@ -204,6 +210,7 @@ private:
     };
 
     Sim mManager;
+    ChangeJournal mChangeJournal;
     FEngine& mEngine;
 };
 
@@ -212,6 +219,7 @@ FILAMENT_UPCAST(RenderableManager)
 void FRenderableManager::setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept {
     if (instance) {
         mManager[instance].aabb = aabb;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -220,12 +228,14 @@ void FRenderableManager::setLayerMask(Instance instance,
     if (instance) {
         uint8_t& layers = mManager[instance].layers;
         layers = (layers & ~select) | (values & select);
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
 void FRenderableManager::setLayerMask(Instance instance, uint8_t layerMask) noexcept {
     if (instance) {
         mManager[instance].layers = layerMask;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -233,6 +243,7 @@ void FRenderableManager::setPriority(Instance instance, uint8_t priority) noexce
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.priority = priority;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -240,6 +251,7 @@ void FRenderableManager::setCastShadows(Instance instance, bool enable) noexcept
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.castShadows = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -247,6 +259,7 @@ void FRenderableManager::setReceiveShadows(Instance instance, bool enable) noexc
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.receiveShadows = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -254,6 +267,7 @@ void FRenderableManager::setCulling(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.culling = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -261,6 +275,7 @@ void FRenderableManager::setSkinning(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.skinning = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -268,6 +283,7 @@ void FRenderableManager::setMorphing(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.morphing = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
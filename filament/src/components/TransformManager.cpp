@@ -117,6 +117,7 @@ void FTransformManager::destroy(Entity e) noexcept {
         }
 
         // 2) remove the component
+        mChangeJournal.record(e);
         Instance moved = manager.removeComponent(e);
 
         // 3) update the references to the entry now with Instance i
@@ -152,11 +153,12 @@ void FTransformManager::updateNodeTransform(Instance i) noexcept {
 
     // compute our world transform
     manager[i].world = pt * static_cast<mat4f const&>(manager[i].local);
+    mChangeJournal.record(manager.getEntity(i));
 
     // update our children's world transforms
     Instance child = manager[i].firstChild;
     if (UTILS_UNLIKELY(child)) { // assume we don't have a hierarchy in the common case
-        transformChildren(manager, child);
+        transformChildren(manager, mChangeJournal, child);
     }
 }
 
@@ -183,6 +185,9 @@ void FTransformManager::commitLocalTransformTransaction() noexcept {
             assert(parent < i);
             manager[i].world = world[parent] * static_cast<mat4f const&>(manager[i].local);
         }
+
+        // all world transforms were recomputed, it's not worth tracking them individually
+        mChangeJournal.invalidate();
     }
 }
 
@@ -305,18 +310,20 @@ void FTransformManager::updateNode(Instance i) noexcept {
     validateNode(next);
 }
 
-void FTransformManager::transformChildren(Sim& manager, Instance ci) noexcept {
+void FTransformManager::transformChildren(Sim& manager, ChangeJournal& journal,
+        Instance ci) noexcept {
     while (ci) {
         // update child's world transform
         Instance parent = manager[ci].parent;
         mat4f const& pt = manager[parent].world;
         mat4f const& local = manager[ci].local;
         manager[ci].world = pt * local;
+        journal.record(manager.getEntity(ci));
 
         // assume we don't have a deep hierarchy
         Instance child = manager[ci].firstChild;
         if (UTILS_UNLIKELY(child)) {
-            transformChildren(manager, child);
+            transformChildren(manager, journal, child);
         }
 
         // process our next child
@@ -19,6 +19,8 @@
 
 #include "upcast.h"
 
+#include "details/ChangeJournal.h"
+
 #include <filament/TransformManager.h>
 
 #include <utils/compiler.h>
@@ -92,6 +94,10 @@ public:
         return mManager[ci].world;
     }
 
+    // records the entities whose world transform changed, or whose component was destroyed
+    ChangeJournal const& getChangeJournal() const noexcept { return mChangeJournal; }
+    ChangeJournal& getChangeJournal() noexcept { return mChangeJournal; }
+
 private:
     struct Sim;
 
@@ -101,7 +107,8 @@ private:
     void updateNodeTransform(Instance i) noexcept;
     void insertNode(Instance i, Instance p) noexcept;
     void swapNode(Instance i, Instance j) noexcept;
-    static void transformChildren(Sim& manager, Instance firstChild) noexcept;
+    static void transformChildren(Sim& manager, ChangeJournal& journal,
+            Instance firstChild) noexcept;
 
     friend class TransformManager::children_iterator;
 
@@ -155,6 +162,7 @@ private:
     };
 
     Sim mManager;
+    ChangeJournal mChangeJournal;
     bool mLocalTransformTransactionOpen = false;
 };
 
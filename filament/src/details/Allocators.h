@@ -23,40 +23,59 @@ namespace filament {
 namespace details {
 
 // per render pass allocations
-// Froxelization needs about 1 MiB. Command buffer needs about 1 MiB.
-static constexpr size_t CONFIG_PER_RENDER_PASS_ARENA_SIZE    = 2 * 1024 * 1024;
-
-// size of the high-level draw commands buffer (comes from the per-render pass allocator)
-static constexpr size_t CONFIG_PER_FRAME_COMMANDS_SIZE = 1 * 1024 * 1024;
+// This is the initial size of the arena, which grows by blocks of at least
+// CONFIG_PER_RENDER_PASS_ARENA_BLOCK_SIZE when needed (e.g. for large scenes).
+// Froxelization needs about 1 MiB. Command buffer needs about 64 bytes per primitive.
+static constexpr size_t CONFIG_PER_RENDER_PASS_ARENA_SIZE       = 2 * 1024 * 1024;
+static constexpr size_t CONFIG_PER_RENDER_PASS_ARENA_BLOCK_SIZE = 4 * 1024 * 1024;
 
 // size of a command-stream buffer (comes from mmap -- not the per-engine arena)
 static constexpr size_t CONFIG_MIN_COMMAND_BUFFERS_SIZE = 1 * 1024 * 1024;
 static constexpr size_t CONFIG_COMMAND_BUFFERS_SIZE     = 3 * CONFIG_MIN_COMMAND_BUFFERS_SIZE;
 
+// size of the command-stream buffer of each producer thread (see Engine::attachProducerThread),
+// which mostly records resource creations and uploads.
+static constexpr size_t CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE = 256 * 1024;
+static constexpr size_t CONFIG_PRODUCER_COMMAND_BUFFERS_SIZE =
+        4 * CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE;
+
+// backing of the per render pass arena and of the command-stream buffer, which are written
+// every frame: huge pages avoid TLB misses, and pre-faulting avoids page faults on first touch.
+#if FILAMENT_ENABLE_HUGE_PAGES
+static constexpr utils::MemoryBacking CONFIG_PER_FRAME_MEMORY_BACKING =
+        utils::MemoryBacking::HUGE_PAGES | utils::MemoryBacking::PREFAULT;
+#else
+static constexpr utils::MemoryBacking CONFIG_PER_FRAME_MEMORY_BACKING =
+        utils::MemoryBacking::DEFAULT;
+#endif
+
 #ifndef NDEBUG
 
-// on Debug builds, HeapAllocatorArena needs LockingPolicy::Mutex because it uses a
-// TrackingPolicy, which needs to be synchronized.
+// HeapAllocatorArena needs LockingPolicy::Mutex because it uses a TrackingPolicy, which needs
+// to be synchronized. Its allocations are accounted in the Engine's memory statistics.
 using HeapAllocatorArena = utils::Arena<
         utils::HeapAllocator,
         utils::LockingPolicy::Mutex,
-        utils::TrackingPolicy::DebugAndHighWatermark>;
+        utils::TrackingPolicy::DebugAndTagged>;
 
+// ChainedLinearAllocator tracks its own high watermark, the TrackingPolicies can't be used
+// because they assume a single contiguous memory area.
 using LinearAllocatorArena = utils::Arena<
-        utils::LinearAllocator,
-        utils::LockingPolicy::NoLock,
-        utils::TrackingPolicy::DebugAndHighWatermark>;
+        utils::ChainedLinearAllocator,
+        utils::LockingPolicy::NoLock>;
 
 #else
 
 // on Release builds, HeapAllocatorArena doesn't need a LockingPolicy because HeapAllocator is
-// intrinsically synchronized as it relies on heap allocations (i.e.: malloc/free)
+// intrinsically synchronized as it relies on heap allocations (i.e.: malloc/free). Its
+// allocations are still accounted in the Engine's memory statistics, the counters are atomic.
 using HeapAllocatorArena = utils::Arena<
         utils::HeapAllocator,
-        utils::LockingPolicy::NoLock>;
+        utils::LockingPolicy::NoLock,
+        utils::TrackingPolicy::Tagged>;
 
 using LinearAllocatorArena = utils::Arena<
-        utils::LinearAllocator,
+        utils::ChainedLinearAllocator,
         utils::LockingPolicy::NoLock>;
 
 #endif
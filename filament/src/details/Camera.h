@@ -166,8 +166,8 @@ struct CameraInfo {
     math::float3 const& getPosition() const noexcept { return model[3].xyz; }
     math::float3 getForwardVector() const noexcept { return normalize(-model[2].xyz); }
 
-    // for debugging:
-    math::mat4f worldOrigin; // this is already applied to model and view
+    // this is already applied to model and view, the vertex shader applies it to the renderables
+    math::mat4f worldOrigin;
 };
 
 FILAMENT_UPCAST(Camera)
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_CHANGEJOURNAL_H
+#define TNT_FILAMENT_DETAILS_CHANGEJOURNAL_H
+
+#include <utils/compiler.h>
+#include <utils/Entity.h>
+#include <utils/Slice.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace details {
+
+/*
+ * A log of the entities whose component changed, kept by a component manager.
+ *
+ * Consumers (e.g. FScene) remember the position of the journal they're synchronized with and
+ * ask for the changes recorded since then. An entity can appear several times.
+ *
+ * When the journal can't tell what changed since a given position -- because it was trimmed,
+ * overflowed or invalidated -- getChanges() fails and the consumer must resynchronize
+ * completely.
+ */
+class ChangeJournal {
+public:
+    using Position = uint64_t;
+
+    // Past this many entries, we drop the whole journal. Consumers lagging behind will need
+    // to resynchronize, which is about the same cost as processing that many changes anyways.
+    static constexpr size_t CAPACITY = 65536;
+
+    void record(utils::Entity e) noexcept {
+        if (UTILS_UNLIKELY(mEntries.size() >= CAPACITY)) {
+            invalidate();
+        }
+        mEntries.push_back(e);
+    }
+
+    // Use this when the changes can't be tracked per entity, all consumers will resynchronize.
+    void invalidate() noexcept {
+        // make sure that consumers that were up-to-date are now behind our first entry
+        mFirst += mEntries.size() + 1;
+        mEntries.clear();
+    }
+
+    // returns the position past the last change recorded
+    Position tell() const noexcept {
+        return mFirst + mEntries.size();
+    }
+
+    // Returns the entities that changed since position 'from', or false if this information
+    // is not available anymore.
+    bool getChanges(Position from, utils::Slice<const utils::Entity>* changes) const noexcept {
+        if (UTILS_UNLIKELY(from < mFirst || from > tell())) {
+            return false;
+        }
+        utils::Entity const* const begin = mEntries.data() + (from - mFirst);
+        *changes = { begin, mEntries.data() + mEntries.size() };
+        return true;
+    }
+
+    // forget the changes recorded before position 'upTo'
+    void trim(Position upTo) noexcept {
+        if (upTo > mFirst) {
+            size_t const count = size_t(std::min(upTo, tell()) - mFirst);
+            mEntries.erase(mEntries.begin(), mEntries.begin() + count);
+            mFirst += count;
+        }
+    }
+
+private:
+    std::vector<utils::Entity> mEntries;
+    Position mFirst = 0;    // position of mEntries[0]
+};
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_CHANGEJOURNAL_H
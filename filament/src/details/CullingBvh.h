@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_CULLINGBVH_H
+#define TNT_FILAMENT_DETAILS_CULLINGBVH_H
+
+#include "details/Culler.h"
+
+#include <filament/Frustum.h>
+
+#include <utils/compiler.h>
+
+#include <math/vec3.h>
+
+#include <vector>
+
+namespace utils {
+class JobSystem;
+} // namespace utils
+
+namespace filament {
+namespace details {
+
+/*
+ * A bounding volume hierarchy over an array of world-space AABBs (stored as center/half-extent
+ * columns, e.g. FScene's WORLD_AABB_CENTER / WORLD_AABB_EXTENT).
+ *
+ * The hierarchy only stores a permutation of the input rows and the bounds of its nodes, the
+ * boxes themselves are gathered in leaf order by refit(). Whole subtrees are rejected or
+ * accepted at once during culling, leaves that straddle the frustum are processed with the
+ * flat SIMD Culler.
+ *
+ * The topology is computed by build() (O(N.log(N))) and the bounds are updated by refit() (O(N)),
+ * which is always correct, but the culling efficiency degrades as the boxes move away from where
+ * they were when the hierarchy was built.
+ */
+class CullingBvh {
+public:
+    // Maximum number of boxes in a leaf, this must be a multiple of Culler::MODULO
+    static constexpr size_t LEAF_SIZE = Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT;
+    static_assert(LEAF_SIZE % Culler::MODULO == 0, "LEAF_SIZE must be multiple of MODULO");
+
+    CullingBvh() noexcept;
+    ~CullingBvh() noexcept;
+
+    CullingBvh(CullingBvh const& rhs) = delete;
+    CullingBvh& operator=(CullingBvh const& rhs) = delete;
+
+    // (re)creates the hierarchy for the given boxes, this calls refit().
+    void build(math::float3 const* center, math::float3 const* extent, size_t count);
+
+    // updates the bounds of all nodes, the number of boxes must not have changed since build().
+    void refit(math::float3 const* center, math::float3 const* extent) noexcept;
+
+    // Equivalent to Culler::intersects(results, frustum, center, extent, size(), bit), that is,
+    // the 'bit' of each entry of 'results' is set if the corresponding box intersects the
+    // frustum. 'results' is indexed like the arrays given to build() / refit().
+    void intersects(utils::JobSystem& js, Culler::result_type* results,
+            Frustum const& frustum, size_t bit) const noexcept;
+
+    void clear() noexcept;
+
+    size_t size() const noexcept { return mIndices.size(); }
+    bool empty() const noexcept { return mIndices.empty(); }
+
+private:
+    struct Node {               // 36 bytes
+        math::float3 center;    // 12 | center of the node's bounds
+        math::float3 extent;    // 12 | half-extent of the node's bounds
+        uint32_t first;         //  4 | first box of this subtree, in leaf order
+        uint32_t count;         //  4 | number of boxes in this subtree
+        uint32_t child;         //  4 | index of the left child (right is child + 1), 0 for leaves
+    };
+
+    // a range of boxes in leaf order, either fully visible or needing a per-box test
+    struct Range {
+        uint32_t first;
+        uint32_t count;
+        bool accepted;
+    };
+
+    enum class Classification { OUTSIDE, INSIDE, INTERSECTS };
+
+    static Classification classify(math::float4 const* planes, Node const& node) noexcept;
+
+    void buildRecursive(uint32_t index, math::float3 const* center) noexcept;
+
+    std::vector<Node> mNodes;
+    std::vector<uint32_t> mIndices;         // leaf order -> row
+    std::vector<math::float3> mCenters;     // boxes in leaf order
+    std::vector<math::float3> mExtents;     // boxes in leaf order
+    mutable std::vector<Range> mWorkList;   // scratch buffer for intersects()
+};
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_CULLINGBVH_H
@@ -66,7 +66,10 @@ class DebugServer;
 #include <utils/Allocator.h>
 #include <utils/JobSystem.h>
 #include <utils/CountDownLatch.h>
+#include <utils/Mutex.h>
+#include <utils/ThreadLocal.h>
 
+#include <array>
 #include <chrono>
 #include <memory>
 #include <unordered_map>
@@ -77,6 +80,7 @@ class Renderer;
 class MaterialParser;
 
 namespace backend {
+class CommandStreamCapture;
 class Driver;
 class Program;
 } // namespace driver
@@ -124,9 +128,12 @@ public:
     static constexpr bool   CONFIG_IBL_USE_IRRADIANCE_MAP  = false;
 
     static constexpr size_t CONFIG_PER_RENDER_PASS_ARENA_SIZE   = details::CONFIG_PER_RENDER_PASS_ARENA_SIZE;
-    static constexpr size_t CONFIG_PER_FRAME_COMMANDS_SIZE      = details::CONFIG_PER_FRAME_COMMANDS_SIZE;
+    static constexpr size_t CONFIG_PER_RENDER_PASS_ARENA_BLOCK_SIZE = details::CONFIG_PER_RENDER_PASS_ARENA_BLOCK_SIZE;
     static constexpr size_t CONFIG_MIN_COMMAND_BUFFERS_SIZE     = details::CONFIG_MIN_COMMAND_BUFFERS_SIZE;
     static constexpr size_t CONFIG_COMMAND_BUFFERS_SIZE         = details::CONFIG_COMMAND_BUFFERS_SIZE;
+    static constexpr size_t CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE = details::CONFIG_MIN_PRODUCER_COMMAND_BUFFERS_SIZE;
+    static constexpr size_t CONFIG_PRODUCER_COMMAND_BUFFERS_SIZE = details::CONFIG_PRODUCER_COMMAND_BUFFERS_SIZE;
+    static constexpr utils::MemoryBacking CONFIG_PER_FRAME_MEMORY_BACKING = details::CONFIG_PER_FRAME_MEMORY_BACKING;
 
 public:
     static FEngine* create(Backend backend = Backend::DEFAULT,
@@ -139,7 +146,12 @@ public:
     ~FEngine() noexcept;
 
     backend::Driver& getDriver() const noexcept { return *mDriver; }
-    DriverApi& getDriverApi() noexcept { return mCommandStream; }
+
+    // returns the command stream of the calling thread, see attachProducerThread()
+    DriverApi& getDriverApi() noexcept {
+        return UTILS_LIKELY(!mHasProducers.load(std::memory_order_relaxed)) ?
+                mCommandStream : getProducerDriverApi();
+    }
     DFG* getDFG() const noexcept { return mDFG.get(); }
 
     // the per-frame Area is used by all Renderer, so they must run in sequence and
@@ -148,7 +160,9 @@ public:
     LinearAllocatorArena& getPerRenderPassAllocator() noexcept { return mPerRenderPassAllocator; }
 
     // Material IDs...
-    uint32_t getMaterialId() const noexcept { return mMaterialId++; }
+    uint32_t getMaterialId() const noexcept {
+        return mMaterialId.fetch_add(1, std::memory_order_relaxed);
+    }
 
     const FMaterial* getDefaultMaterial() const noexcept { return mDefaultMaterial; }
     const FMaterial* getSkyboxMaterial() const noexcept;
@@ -211,14 +225,28 @@ public:
 
     utils::JobSystem& getJobSystem() noexcept { return mJobSystem; }
 
+    utils::MemoryCounter& getMemoryCounter(MemoryTag tag) noexcept {
+        assert(tag < MemoryTag::COUNT);
+        return mMemoryCounters[size_t(tag)];
+    }
+
+    MemoryStats getMemoryStats(MemoryTag tag) const noexcept;
+
+    void resetMemoryPeaks() noexcept;
+
 
     Epoch getEngineEpoch() const { return mEngineEpoch; }
     duration getEngineTime() const noexcept {
         return clock::now() - getEngineEpoch();
     }
 
-    template <typename T>
-    T* create(ResourceList<T>& list, typename T::Builder const& builder) noexcept;
+    // time the driver thread spent executing commands since the engine was created
+    duration getDriverExecutionTime() const noexcept {
+        return duration(mDriverExecutionTime.load(std::memory_order_relaxed));
+    }
+
+    template <typename T, typename L>
+    T* create(ResourceList<T, L>& list, typename T::Builder const& builder) noexcept;
 
     FVertexBuffer* createVertexBuffer(const VertexBuffer::Builder& builder) noexcept;
     FIndexBuffer* createIndexBuffer(const IndexBuffer::Builder& builder) noexcept;
@@ -264,6 +292,17 @@ public:
 
     void flushAndWait();
 
+    utils::JobSystem::Job* flushAsync(bool finish) noexcept;
+
+    void attachProducerThread();
+    void flushProducerThread() noexcept;
+    void detachProducerThread() noexcept;
+
+    // true while producer threads are attached, or detached but not destroyed yet
+    bool hasProducerThreads() const noexcept {
+        return mHasProducers.load(std::memory_order_relaxed);
+    }
+
     // flush the current buffer
     void flush();
 
@@ -292,12 +331,28 @@ private:
     int loop();
     void flushCommandBuffer(backend::CommandBufferQueue& commandBufferQueue);
 
+    // A thread, other than the Engine's thread, issuing driver commands.
+    struct Producer {
+        Producer(FEngine& engine, backend::Driver& driver) noexcept;
+        FEngine& engine;
+        backend::CommandBufferQueue queue;
+        DriverApi stream;
+    };
+
+    UTILS_NOINLINE DriverApi& getProducerDriverApi() noexcept;
+
+    // destroys the producers that are detached, once their commands are executed
+    void collectProducers() noexcept;
+
     template<typename T, typename L>
     void terminateAndDestroy(const T* p, ResourceList<T, L>& list);
 
     template<typename T, typename L>
     void cleanupResourceList(ResourceList<T, L>& list);
 
+    // these must outlive all the objects and arenas they account for
+    std::array<utils::MemoryCounter, size_t(MemoryTag::COUNT)> mMemoryCounters;
+
     backend::Driver* mDriver = nullptr;
 
     Backend mBackend;
@@ -324,15 +379,16 @@ private:
     ResourceList<FFence, utils::LockingPolicy::SpinLock> mFences{"Fence"};
     ResourceList<FSwapChain> mSwapChains{ "SwapChain" };
     ResourceList<FStream> mStreams{ "Stream" };
-    ResourceList<FIndexBuffer> mIndexBuffers{ "IndexBuffer" };
-    ResourceList<FVertexBuffer> mVertexBuffers{ "VertexBuffer" };
+    // these can be created from producer threads, see attachProducerThread()
+    ResourceList<FIndexBuffer, utils::LockingPolicy::SpinLock> mIndexBuffers{ "IndexBuffer" };
+    ResourceList<FVertexBuffer, utils::LockingPolicy::SpinLock> mVertexBuffers{ "VertexBuffer" };
+    ResourceList<FMaterial, utils::LockingPolicy::SpinLock> mMaterials{ "Material" };
+    ResourceList<FTexture, utils::LockingPolicy::SpinLock> mTextures{ "Texture" };
     ResourceList<FIndirectLight> mIndirectLights{ "IndirectLight" };
-    ResourceList<FMaterial> mMaterials{ "Material" };
-    ResourceList<FTexture> mTextures{ "Texture" };
     ResourceList<FSkybox> mSkyboxes{ "Skybox" };
     ResourceList<FRenderTarget> mRenderTargets{ "RenderTarget" };
 
-    mutable uint32_t mMaterialId = 0;
+    mutable std::atomic<uint32_t> mMaterialId = { 0 };
 
     // FMaterialInstance are handled directly by FMaterial
     std::unordered_map<const FMaterial*, ResourceList<FMaterialInstance>> mMaterialInstances;
@@ -342,6 +398,17 @@ private:
     std::thread mDriverThread;
     backend::CommandBufferQueue mCommandBufferQueue;
     DriverApi mCommandStream;
+    std::atomic<duration::rep> mDriverExecutionTime = { 0 };
+    // only accessed from the driver thread, see FILAMENT_CAPTURE_COMMANDS, always declared so
+    // that FEngine has the same layout whether the capture is enabled or not
+    std::unique_ptr<backend::CommandStreamCapture> mCommandStreamCapture;
+
+    static UTILS_DECLARE_TLS(Producer*) sProducer;
+    std::atomic<bool> mHasProducers = { false };
+    std::atomic<bool> mHasDetachedProducers = { false };
+    utils::Mutex mProducersLock;
+    std::vector<std::unique_ptr<Producer>> mProducers;
+    std::vector<Producer*> mDetachedProducers;
 
     LinearAllocatorArena mPerRenderPassAllocator;
     HeapAllocatorArena mHeapAllocator;
@@ -379,6 +446,14 @@ public:
         struct {
             bool camera_at_origin = true;
         } view;
+        struct {
+            bool culling_bvh = false;
+        } scene;
+        struct {
+            bool parallel_recording = true;
+            bool command_cache = true;
+            bool draw_batching = true;
+        } renderer;
          matdbg::DebugServer* server = nullptr;
     } debug;
 };
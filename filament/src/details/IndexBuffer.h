@@ -47,6 +47,7 @@ private:
     friend class IndexBuffer;
     backend::Handle<backend::HwIndexBuffer> mHandle;
     uint32_t mIndexCount;
+    uint32_t mIndexSize;
 };
 
 FILAMENT_UPCAST(IndexBuffer)
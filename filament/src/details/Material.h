@@ -86,6 +86,16 @@ public:
         backend::Handle<backend::HwProgram> const entry = mCachedPrograms[variantKey];
         return UTILS_LIKELY(entry) ? entry : getProgramSlow(variantKey);
     }
+    // Same as getProgram() but returns a null handle instead of creating the program, this can
+    // be called from any thread.
+    backend::Handle<backend::HwProgram> getCachedProgram(uint8_t variantKey) const noexcept {
+#if FILAMENT_ENABLE_MATDBG
+        if (UTILS_UNLIKELY(mPendingEdits.load())) {
+            return {};
+        }
+#endif
+        return mCachedPrograms[variantKey];
+    }
     backend::Program getProgramBuilderWithVariants(uint8_t variantKey, uint8_t vertexVariantKey,
             uint8_t fragmentVariantKey) const noexcept;
     backend::Handle<backend::HwProgram> createAndCacheProgram(backend::Program&& p,
@@ -158,6 +168,9 @@ private:
     // try to order by frequency of use
     mutable std::array<backend::Handle<backend::HwProgram>, VARIANT_COUNT> mCachedPrograms;
 
+    // size of the shaders of each program we own, for the Engine's memory accounting
+    mutable std::array<uint32_t, VARIANT_COUNT> mCachedProgramSizes = {};
+
     backend::RasterState mRasterState;
     BlendingMode mRenderBlendingMode = BlendingMode::OPAQUE;
     TransparencyMode mTransparencyMode = TransparencyMode::DEFAULT;
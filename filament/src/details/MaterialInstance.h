@@ -80,6 +80,14 @@ public:
     UniformBuffer const& getUniformBuffer() const noexcept { return mUniforms; }
     backend::SamplerGroup const& getSamplerGroup() const noexcept { return mSamplers; }
 
+    backend::Handle<backend::HwUniformBuffer> getUniformBufferHandle() const noexcept {
+        return mUbHandle;
+    }
+
+    backend::Handle<backend::HwSamplerGroup> getSamplerGroupHandle() const noexcept {
+        return mSbHandle;
+    }
+
     void setScissor(int32_t left, int32_t bottom, uint32_t width, uint32_t height) noexcept {
         mScissorRect = { left, bottom,
                 std::min(width, (uint32_t)std::numeric_limits<int32_t>::max()),
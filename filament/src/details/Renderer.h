@@ -102,6 +102,14 @@ private:
 
     RenderPass::CommandTypeFlags getCommandType(View::DepthPrepass prepass) const noexcept;
 
+    // number of commands needed in addition to the primitives' (sentinels, custom commands)
+    static constexpr size_t CONFIG_COMMANDS_MARGIN = 64;
+
+    // number of commands needed by the largest pass of a frame, without the margin
+    static size_t getCommandsCountPerFrame(FScene::RenderableSoa const& soa,
+            utils::Range<uint32_t> visibleRenderables,
+            utils::Range<uint32_t> visibleShadowCasters) noexcept;
+
     void recordHighWatermark(size_t watermark) noexcept {
         mCommandsHighWatermark = std::max(mCommandsHighWatermark, watermark);
     }
@@ -126,6 +126,15 @@ public:
         return std::move(reinterpret_cast<tsl::robin_set<T*>&>(list));
     }
 
+    // calls func for each item, the list is locked in the meantime
+    template<typename F>
+    void forEach(F func) const noexcept {
+        std::lock_guard<LockingPolicy> guard(mLock);
+        for (void* item : mList) {
+            func(static_cast<T*>(item));
+        }
+    }
+
     /*
      * the methods below are only safe when LockingPolicy is NoLock, so disable them
      * otherwise
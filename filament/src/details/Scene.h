@@ -22,7 +22,9 @@
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
 
+#include "details/ChangeJournal.h"
 #include "details/Culler.h"
+#include "details/CullingBvh.h"
 
 #include "Allocators.h"
 
@@ -36,8 +38,11 @@
 #include <utils/Range.h>
 
 #include <cstddef>
+#include <tsl/robin_map.h>
 #include <tsl/robin_set.h>
 
+#include <vector>
+
 namespace filament {
 namespace details {
 
@@ -78,11 +83,16 @@ public:
     // for that in a few places.
     static constexpr size_t DIRECTIONAL_LIGHTS_COUNT = 1;
 
+    // number of entities, renderables and lights processed by a single job in prepare()
+    static constexpr size_t ENTITY_CHUNK_SIZE = 1024;
+    static constexpr size_t RENDERABLE_CHUNK_SIZE = 1024;
+    static constexpr size_t LIGHT_CHUNK_SIZE = 128;
+
     explicit FScene(FEngine& engine);
     ~FScene() noexcept;
     void terminate(FEngine& engine);
 
-    void prepare(const math::mat4f& worldOriginTransform);
+    void prepare(const math::mat4f& worldOriginTransform, ArenaScope& arena);
     void prepareDynamicLights(const CameraInfo& camera, ArenaScope& arena, backend::Handle<backend::HwUniformBuffer> lightUbh) noexcept;
 
 
@@ -96,13 +106,13 @@ public:
 
     enum {
         RENDERABLE_INSTANCE,    //  4 | instance of the Renderable component
-        WORLD_TRANSFORM,        // 16 | instance of the Transform component
-        REVERSED_WINDING_ORDER, //  1 | det(WORLD_TRANSFORM)<0
+        REVERSED_WINDING_ORDER, //  1 | det(world transform)<0
         VISIBILITY_STATE,       //  1 | visibility data of the component
         BONES_UBH,              //  4 | bones uniform buffer handle
         WORLD_AABB_CENTER,      // 12 | world-space bounding box center of the renderable
         VISIBLE_MASK,           //  1 | each bit represents a visibility in a pass
         MORPH_WEIGHTS,          //  4 | floats for morphing
+        UBO_SLOT,               //  4 | slot of the renderable in the per-renderable UBO
 
         // These are not needed anymore after culling
         LAYERS,                 //  1 | layers
@@ -115,13 +125,13 @@ public:
 
     using RenderableSoa = utils::StructureOfArrays<
             utils::EntityInstance<RenderableManager>,   // RENDERABLE_INSTANCE
-            math::mat4f,                                // WORLD_TRANSFORM
             bool,                                       // REVERSED_WINDING_ORDER
             FRenderableManager::Visibility,             // VISIBILITY_STATE
             backend::Handle<backend::HwUniformBuffer>,  // BONES_UBH
             math::float3,                               // WORLD_AABB_CENTER
             Culler::result_type,                        // VISIBLE_MASK
             math::float4,                               // MORPH_WEIGHTS
+            uint32_t,                                   // UBO_SLOT
             uint8_t,                                    // LAYERS
             math::float3,                               // WORLD_AABB_EXTENT
             utils::Slice<FRenderPrimitive>,             // PRIMITIVES
@@ -166,9 +176,70 @@ public:
     LightSoa const& getLightData() const noexcept { return mLightData; }
     LightSoa& getLightData() noexcept { return mLightData; }
 
-    void updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Handle<backend::HwUniformBuffer> renderableUbh) noexcept;
+    /*
+     * The per-renderable UBO is persistent: each renderable has a slot (UBO_SLOT), which is its
+     * row in the renderable cache, so it only changes when renderables are removed. A slot is
+     * only written again when its renderable changed since, which is tracked with the
+     * generation of the cache rows.
+     */
+
+    // What a per-renderable UBO contains, this is owned by the UBO's owner (i.e. the view).
+    struct RenderableUboState {
+        std::vector<uint32_t> generations;  // generation of each slot's content, 0 if undefined
+        FScene const* scene = nullptr;      // scene the slots were written for
+        void invalidate() noexcept { scene = nullptr; }
+    };
+
+    // number of slots the per-renderable UBO needs
+    size_t getRenderableSlotCount() const noexcept { return mRenderableCache.size(); }
+
+    // Fills 'dirty' with the renderables whose PerRenderableUib must be written in 'ubo' and
+    // updates 'ubo' accordingly. Only visible renderables are written, unless most of the slots
+    // are dirty (or 'ubo' is invalid), then they're all written.
+    void getDirtyUBOs(utils::Range<uint32_t> visibleRenderables, RenderableUboState& ubo,
+            std::vector<uint32_t>& dirty) const noexcept;
+
+    // Sorts 'dirty' by slot and fills 'buffer' with their PerRenderableUib, this can be called
+    // from any thread.
+    void updateUBOs(utils::Slice<uint32_t> dirty, void* buffer) const noexcept;
+
+    // Uploads the 'buffer' filled by updateUBOs(), which must be allocated from the driver,
+    // with one update per range of consecutive slots.
+    void commitUBOs(backend::DriverApi& driver, utils::Slice<const uint32_t> dirty,
+            backend::Handle<backend::HwUniformBuffer> renderableUbh, void* buffer) noexcept;
+
+    // Returns the hierarchy built over the renderables' world AABBs, or nullptr if it's disabled.
+    // When valid, it's indexed like the RenderableSoa, until the latter is reordered.
+    CullingBvh const* getCullingBvh() const noexcept {
+        return mCullingBvh.empty() ? nullptr : &mCullingBvh;
+    }
+
+    // Positions of the component managers' change journals this scene is synchronized with.
+    // Changes before these can be forgotten (see FEngine::prepare()).
+    struct JournalPositions {
+        ChangeJournal::Position transforms = 0;
+        ChangeJournal::Position renderables = 0;
+        ChangeJournal::Position lights = 0;
+    };
+
+    // Returns nullptr if the scene doesn't need any of the journals' content, i.e. it will be
+    // rebuilt entirely by the next prepare().
+    JournalPositions const* getJournalPositions() const noexcept {
+        return mRenderableCacheInvalid ? nullptr : &mJournalPositions;
+    }
 
 private:
+    bool updateRenderableCache() noexcept;
+    void rebuildRenderableCache() noexcept;
+    void updateEntity(utils::Entity e) noexcept;
+    bool updateRenderableCacheRow(utils::Entity e, size_t row) noexcept;
+    void removeRenderableCacheRow(size_t row) noexcept;
+    void removeLight(utils::Entity e) noexcept;
+    void compactLights() noexcept;
+    void prepareRenderableData() noexcept;
+    void prepareLightData(const math::mat4f& worldOriginTransform, ArenaScope& arena) noexcept;
+    void updateCullingBvh() noexcept;
+
     static inline void computeLightRanges(math::float2* zrange,
             CameraInfo const& camera, const math::float4* spheres, size_t count) noexcept;
 
@@ -196,6 +267,61 @@ private:
     RenderableSoa mRenderableData;
     LightSoa mLightData;
     backend::Handle<backend::HwUniformBuffer> mRenderableViewUbh; // This is actually owned by the view.
+
+    /*
+     * Persistent world-space data of the renderables, without the world origin transform.
+     * Only the rows of the entities that changed since the last prepare() are updated, as
+     * reported by the component managers' ChangeJournal. Rows are only moved when renderables
+     * are removed.
+     * mRenderableData is then built from this, every time prepare() is called.
+     */
+    enum {
+        CACHE_ENTITY,                   // entity owning the renderable
+        CACHE_RENDERABLE_INSTANCE,      // instance of the Renderable component
+        CACHE_WORLD_TRANSFORM,          // world transform of the entity
+        CACHE_REVERSED_WINDING_ORDER,   // det(CACHE_WORLD_TRANSFORM)<0
+        CACHE_VISIBILITY_STATE,         // visibility data of the component
+        CACHE_BONES_UBH,                // bones uniform buffer handle
+        CACHE_AABB,                     // object-space bounding box of the renderable
+        CACHE_WORLD_AABB_CENTER,        // world-space bounding box center of the renderable
+        CACHE_WORLD_AABB_EXTENT,        // world-space bounding box half-extent of the renderable
+        CACHE_MORPH_WEIGHTS,            // floats for morphing
+        CACHE_LAYERS,                   // layers
+        CACHE_GENERATION,               // value of mGeneration when the row last changed
+    };
+
+    using RenderableCache = utils::StructureOfArrays<
+            utils::Entity,                              // CACHE_ENTITY
+            utils::EntityInstance<RenderableManager>,   // CACHE_RENDERABLE_INSTANCE
+            math::mat4f,                                // CACHE_WORLD_TRANSFORM
+            bool,                                       // CACHE_REVERSED_WINDING_ORDER
+            FRenderableManager::Visibility,             // CACHE_VISIBILITY_STATE
+            backend::Handle<backend::HwUniformBuffer>,  // CACHE_BONES_UBH
+            Box,                                        // CACHE_AABB
+            math::float3,                               // CACHE_WORLD_AABB_CENTER
+            math::float3,                               // CACHE_WORLD_AABB_EXTENT
+            math::float4,                               // CACHE_MORPH_WEIGHTS
+            uint8_t,                                    // CACHE_LAYERS
+            uint32_t                                    // CACHE_GENERATION
+    >;
+
+    RenderableCache mRenderableCache;
+    tsl::robin_map<utils::Entity, uint32_t> mRenderableCacheRows; // entity -> row in the cache
+    std::vector<utils::Entity> mDirtyEntities;      // entities added or removed from the scene
+
+    // Entities of the scene that are lights, maintained like the renderable cache. They're in
+    // the order of mEntities after a rebuild, then new lights are appended. Removed lights
+    // leave a null entity, until compactLights() which preserves the order.
+    std::vector<utils::Entity> mLights;
+    tsl::robin_map<utils::Entity, uint32_t> mLightRows;  // entity -> index in mLights
+    bool mLightsNeedCompaction = false;
+    JournalPositions mJournalPositions;
+    uint32_t mGeneration = 0;                       // incremented by each prepare()
+    bool mRenderableCacheInvalid = true;
+
+    // optional hierarchy over the WORLD_AABB_CENTER / WORLD_AABB_EXTENT columns
+    CullingBvh mCullingBvh;
+    bool mCullingBvhInvalid = true;
 };
 
 FILAMENT_UPCAST(Scene)
@@ -17,6 +17,8 @@
 #ifndef TNT_FILAMENT_DETAILS_SHADOWMAP_H
 #define TNT_FILAMENT_DETAILS_SHADOWMAP_H
 
+#include "RenderPass.h"
+
 #include "components/LightManager.h"
 
 #include "details/Camera.h"
@@ -34,7 +36,6 @@ namespace filament {
 namespace details {
 
 class FView;
-class RenderPass;
 
 class ShadowMap {
 public:
@@ -71,6 +72,10 @@ public:
     // Returns the light's projection. Valid after calling update().
     FCamera const& getCamera() const noexcept { return *mCamera; }
 
+    // Returns the camera used to render the shadow map. It has the world origin of the view's
+    // camera, like the light's projection. Valid after calling update().
+    details::CameraInfo getCameraInfo(details::CameraInfo const& viewCamera) const noexcept;
+
     // use only for debugging
     FCamera const& getDebugCamera() const noexcept { return *mDebugCamera; }
 
@@ -130,7 +135,7 @@ private:
 
     template<typename Casters, typename Receivers>
     static void visitScene(FScene const& scene, uint32_t visibleLayers,
-            Casters casters, Receivers receivers) noexcept;
+            math::mat4f const& worldOrigin, Casters casters, Receivers receivers) noexcept;
 
     static inline Aabb compute2DBounds(const math::mat4f& lightView,
             math::float3 const* wsVertices, size_t count) noexcept;
@@ -208,6 +213,9 @@ private:
     // initialization of the float3 each time
     FrustumBoxIntersection mWsClippedShadowReceiverVolume;
 
+    // sorted commands of the last frame
+    RenderPass::CommandCache mCommandCache;
+
     FEngine& mEngine;
     const bool mClipSpaceFlipped;
 };
@@ -87,6 +87,10 @@ public:
 
 private:
     friend class Texture;
+
+    // estimated size of the texture in GPU memory, for the Engine's memory accounting
+    size_t getByteSize() const noexcept;
+
     backend::Handle<backend::HwTexture> mHandle;
     uint32_t mWidth = 1;
     uint32_t mHeight = 1;
@@ -64,6 +64,7 @@ private:
     backend::Handle<backend::HwVertexBuffer> mHandle;
     std::array<AttributeData, backend::MAX_VERTEX_ATTRIBUTE_COUNT> mAttributes;
     AttributeBitset mDeclaredAttributes;
+    size_t mByteSize = 0;   // size of all the buffers, for the Engine's memory accounting
     uint32_t mVertexCount = 0;
     uint8_t mBufferCount = 0;
 };
@@ -21,6 +21,7 @@
 
 #include "upcast.h"
 
+#include "RenderPass.h"
 #include "UniformBuffer.h"
 
 #include "details/Allocators.h"
@@ -39,6 +40,7 @@
 #include <utils/StructureOfArrays.h>
 #include <utils/Slice.h>
 #include <utils/Range.h>
+#include <utils/TaskGraph.h>
 
 #include <math/scalar.h>
 
@@ -65,10 +67,16 @@ public:
 
     void terminate(FEngine& engine);
 
-    void prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& arena,
-            Viewport const& viewport, math::float4 const& userTime) noexcept;
+    // Schedules this frame's culling, froxelization and UBO updates in 'tasks'. Returns the
+    // froxelization task, which must be waited on before calling commitFroxels().
+    utils::TaskGraph::Task prepare(FEngine& engine, backend::DriverApi& driver,
+            ArenaScope& arena, Viewport const& viewport, math::float4 const& userTime,
+            utils::TaskGraph& tasks) noexcept;
 
-    void setScene(FScene* scene) { mScene = scene; }
+    void setScene(FScene* scene) {
+        mScene = scene;
+        mRenderableUboState.invalidate();
+    }
     FScene const* getScene() const noexcept { return mScene; }
     FScene* getScene() noexcept { return mScene; }
 
@@ -145,6 +153,17 @@ public:
     ShadowMap const& getShadowMap() const { return mDirectionalShadowMap; }
     ShadowMap& getShadowMap() { return mDirectionalShadowMap; }
 
+    RenderPass::CommandCache& getColorPassCommandCache() noexcept { return mColorPassCommandCache; }
+    RenderPass::CommandCache& getDepthPassCommandCache() noexcept { return mDepthPassCommandCache; }
+
+    // written by the render passes while this view is rendered
+    RenderStats& getRenderStats() noexcept { return mRenderStats; }
+    RenderStats const& getRenderStats() const noexcept { return mRenderStats; }
+
+    // reset by prepare(), written by prepare() and the render passes while this view is rendered
+    FrameTimings& getFrameTimings() noexcept { return mFrameTimings; }
+    FrameTimings const& getFrameTimings() const noexcept { return mFrameTimings; }
+
     FCamera const* getDirectionalLightCamera() const noexcept {
         return &mDirectionalShadowMap.getDebugCamera();
     }
@@ -288,14 +307,16 @@ private:
             Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept;
 
     static void prepareVisibleShadowCasters(utils::JobSystem& js,
-            Frustum const& lightFrustum, FScene::RenderableSoa& renderableData) noexcept;
+            Frustum const& lightFrustum, FScene::RenderableSoa& renderableData,
+            CullingBvh const* bvh) noexcept;
 
     static void prepareVisibleLights(
             FLightManager const& lcm, utils::JobSystem& js, Frustum const& frustum,
             FScene::LightSoa& lightData) noexcept;
 
     static void cullRenderables(utils::JobSystem& js,
-            FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept;
+            FScene::RenderableSoa& renderableData, CullingBvh const* bvh,
+            Frustum const& frustum, size_t bit) noexcept;
 
     void computeVisibilityMasks(
             uint8_t visibleLayers, uint8_t const* layers,
@@ -328,7 +349,8 @@ private:
     FCamera* mViewingCamera = nullptr;
 
     CameraInfo mViewingCameraInfo;
-    Frustum mCullingFrustum;
+    Frustum mCullingFrustum;            // relative to the world origin, used for lights
+    Frustum mRenderableCullingFrustum;  // used for renderables
 
     mutable Froxelizer mFroxelizer;
 
@@ -374,10 +396,22 @@ private:
     Range mVisibleRenderables;
     Range mVisibleShadowCasters;
     uint32_t mRenderableUBOSize = 0;
+    FScene::RenderableUboState mRenderableUboState; // what mRenderableUbh contains
+    std::vector<uint32_t> mDirtyRenderables;        // renderables updated in mRenderableUbh
     mutable bool mHasDirectionalLight = false;
     mutable bool mHasDynamicLighting = false;
     mutable bool mHasShadowing = false;
     mutable ShadowMap mDirectionalShadowMap;
+
+    // sorted commands of the last frame
+    RenderPass::CommandCache mColorPassCommandCache;
+    RenderPass::CommandCache mDepthPassCommandCache;
+
+    // draw statistics of the last frame
+    RenderStats mRenderStats;
+
+    // CPU time spent in each stage of the last frame
+    FrameTimings mFrameTimings;
 };
 
 FILAMENT_UPCAST(View)
@@ -79,8 +79,8 @@ size_t ResourceAllocator::TextureKey::getSize() const noexcept {
     return size;
 }
 
-ResourceAllocator::ResourceAllocator(DriverApi& driverApi) noexcept
-        : mBackend(driverApi) {
+ResourceAllocator::ResourceAllocator(DriverApi& driverApi, MemoryCounter& counter) noexcept
+        : mBackend(driverApi), mCounter(counter) {
 }
 
 ResourceAllocator::~ResourceAllocator() noexcept {
@@ -93,6 +93,7 @@ void ResourceAllocator::terminate() noexcept {
     auto& textureCache = mTextureCache;
     for (auto it = textureCache.begin(); it != textureCache.end();) {
         mBackend.destroyTexture(it->second.handle);
+        mCounter.remove(it->second.size);
         it = textureCache.erase(it);
     }
 }
@@ -128,6 +129,7 @@ backend::TextureHandle ResourceAllocator::createTexture(const char* name,
             // we don't, allocate a new texture and populate the in-use list
             handle = mBackend.createTexture(
                     target, levels, format, samples, width, height, depth, usage);
+            mCounter.add(key.getSize());
         }
         mInUseTextures.emplace(handle, key);
     } else {
@@ -172,6 +174,7 @@ void ResourceAllocator::gc() noexcept {
         const size_t ageDiff = age - it->second.age;
         if (ageDiff >= CACHE_MAX_AGE) {
             mBackend.destroyTexture(it->second.handle);
+            mCounter.remove(it->second.size);
             mCacheSize -= it->second.size;
             //slog.d << "purging " << it->second.handle.getId() << io::endl;
             it = textureCache.erase(it);
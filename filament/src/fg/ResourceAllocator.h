@@ -23,6 +23,7 @@
 
 #include "private/backend/DriverApiForward.h"
 
+#include <utils/Allocator.h>
 #include <utils/Hash.h>
 
 #include <vector>
@@ -34,7 +35,8 @@ namespace fg {
 
 class ResourceAllocator {
 public:
-    explicit ResourceAllocator(backend::DriverApi& driverApi) noexcept;
+    // the size of all the textures allocated, cached or in use, is accounted in 'counter'
+    ResourceAllocator(backend::DriverApi& driverApi, utils::MemoryCounter& counter) noexcept;
     ~ResourceAllocator() noexcept;
 
     void terminate() noexcept;
@@ -151,6 +153,7 @@ private:
     };
 
     backend::DriverApi& mBackend;
+    utils::MemoryCounter& mCounter;
     AssociativeContainer<TextureKey, TextureCachePayload> mTextureCache;
     AssociativeContainer<backend::TextureHandle, TextureKey> mInUseTextures;
     size_t mAge = 0;
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <backend/Platform.h>
+
+#include "private/backend/CommandBufferQueue.h"
+#include "private/backend/CommandStream.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace filament;
+using namespace backend;
+
+static Backend gQueueBackend = Backend::NOOP;
+static DefaultPlatform* gQueuePlatform = DefaultPlatform::create(&gQueueBackend);
+static Driver* gQueueDriver = gQueuePlatform->createDriver(nullptr);
+
+// Flushes 'count' command buffers from a producer thread, each one records its index and
+// allocates 'payload' bytes. The consumer starts after 'consumerDelay', so that the producer
+// has to wait for it, and checks the command buffers are executed in order.
+static void produceAndConsume(CommandBufferQueue& queue, uint32_t count, size_t payload,
+        std::chrono::milliseconds consumerDelay) {
+    CommandStream stream(*gQueueDriver, queue.getCircularBuffer());
+    std::vector<uint32_t> executed;
+
+    std::thread producer([&]() {
+        stream.debugThreading();
+        for (uint32_t i = 0; i < count; i++) {
+            stream.queueCommand([&executed, i]() { executed.push_back(i); });
+            if (payload) {
+                stream.allocate(payload);
+            }
+            queue.flush();
+        }
+    });
+
+    std::this_thread::sleep_for(consumerDelay);
+    while (executed.size() < count) {
+        auto buffers = queue.waitForCommands();
+        for (auto& item : buffers) {
+            stream.execute(item.begin);
+            queue.releaseBuffer(item);
+        }
+    }
+    producer.join();
+
+    ASSERT_EQ(count, executed.size());
+    for (uint32_t i = 0; i < count; i++) {
+        EXPECT_EQ(i, executed[i]);
+    }
+    EXPECT_TRUE(queue.isReleased());
+}
+
+TEST(CommandBufferQueueTest, RingWrap) {
+    // The circular buffer is large enough for all the commands, but the ring only holds 64
+    // command buffers in flight, so the producer stalls until the consumer starts, and the
+    // ring wraps around several times.
+    CommandBufferQueue queue(CircularBuffer::BLOCK_SIZE, 1024 * 1024);
+    produceAndConsume(queue, 1000, 0, std::chrono::milliseconds(50));
+    EXPECT_GT(queue.getStats().producerStallCount, 0u);
+}
+
+TEST(CommandBufferQueueTest, ProducerStall) {
+    // Each command buffer uses a quarter of the required space, so the producer stalls
+    // waiting for the consumer to release space in the circular buffer.
+    const size_t requiredSize = 4 * CircularBuffer::BLOCK_SIZE;
+    CommandBufferQueue queue(requiredSize, 3 * requiredSize);
+    produceAndConsume(queue, 100, requiredSize / 4, std::chrono::milliseconds(50));
+    EXPECT_GT(queue.getStats().producerStallCount, 0u);
+}
+
+TEST(CommandBufferQueueTest, RequestExit) {
+    CommandBufferQueue queue(CircularBuffer::BLOCK_SIZE, 4 * CircularBuffer::BLOCK_SIZE);
+
+    // the consumer waits for commands that never come
+    size_t bufferCount = 1;
+    std::thread consumer([&]() {
+        bufferCount = queue.waitForCommands().size();
+    });
+
+    // make sure it's parked, and not still spinning
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    queue.requestExit();
+    consumer.join();
+
+    EXPECT_EQ(0u, bufferCount);
+    EXPECT_GT(queue.getStats().consumerStallCount, 0u);
+
+    // once exit is requested, waitForCommands() never blocks
+    EXPECT_TRUE(queue.waitForCommands().empty());
+}
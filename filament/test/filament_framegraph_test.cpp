@@ -31,10 +31,11 @@ static CircularBuffer buffer(8192);
 static Backend gBackend = Backend::NOOP;
 static DefaultPlatform* platform = DefaultPlatform::create(&gBackend);
 static CommandStream driverApi(*platform->createDriver(nullptr), buffer);
+static utils::MemoryCounter memoryCounter;
 
 TEST(FrameGraphTest, SimpleRenderPass) {
 
-    fg::ResourceAllocator resourceAllocator(driverApi);
+    fg::ResourceAllocator resourceAllocator(driverApi, memoryCounter);
     FrameGraph fg(resourceAllocator);
 
     bool renderPassExecuted = false;
@@ -76,7 +77,7 @@ TEST(FrameGraphTest, SimpleRenderPass) {
 
 TEST(FrameGraphTest, SimpleRenderPass2) {
 
-    fg::ResourceAllocator resourceAllocator(driverApi);
+    fg::ResourceAllocator resourceAllocator(driverApi, memoryCounter);
     FrameGraph fg(resourceAllocator);
 
     bool renderPassExecuted = false;
@@ -129,7 +130,7 @@ TEST(FrameGraphTest, SimpleRenderPass2) {
 
 TEST(FrameGraphTest, ScenarioDepthPrePass) {
 
-    fg::ResourceAllocator resourceAllocator(driverApi);
+    fg::ResourceAllocator resourceAllocator(driverApi, memoryCounter);
     FrameGraph fg(resourceAllocator);
 
     bool depthPrepassExecuted = false;
@@ -211,7 +212,7 @@ TEST(FrameGraphTest, ScenarioDepthPrePass) {
 
 TEST(FrameGraphTest, SimplePassCulling) {
 
-    fg::ResourceAllocator resourceAllocator(driverApi);
+    fg::ResourceAllocator resourceAllocator(driverApi, memoryCounter);
     FrameGraph fg(resourceAllocator);
 
     bool renderPassExecuted = false;
@@ -304,7 +305,7 @@ TEST(FrameGraphTest, SimplePassCulling) {
 
 TEST(FrameGraphTest, RenderTargetLifetime) {
 
-    fg::ResourceAllocator resourceAllocator(driverApi);
+    fg::ResourceAllocator resourceAllocator(driverApi, memoryCounter);
     FrameGraph fg(resourceAllocator);
 
     bool renderPassExecuted1 = false;
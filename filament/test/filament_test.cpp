@@ -14,8 +14,10 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <iostream>
 #include <random>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -31,15 +33,29 @@
 #include <filament/Frustum.h>
 #include <filament/Material.h>
 #include <filament/Engine.h>
+#include <filament/IndexBuffer.h>
+#include <filament/LightManager.h>
+#include <filament/RenderableManager.h>
+#include <filament/Renderer.h>
+#include <filament/Scene.h>
+#include <filament/VertexBuffer.h>
+#include <filament/View.h>
 
 #include <private/filament/UniformInterfaceBlock.h>
 #include <private/filament/UibGenerator.h>
 
+#include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
+
 #include "details/Allocators.h"
+#include "details/ChangeJournal.h"
 #include "details/Material.h"
 #include "details/Camera.h"
+#include "details/Culler.h"
+#include "details/CullingBvh.h"
 #include "details/Froxelizer.h"
 #include "details/Engine.h"
+#include "details/View.h"
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
 #include "UniformBuffer.h"
@@ -276,6 +292,58 @@ TEST(FilamentTest, TransformManager) {
     EXPECT_EQ(c, tcm.getChildCount(newParent));
 }
 
+TEST(FilamentTest, TransformManagerChangeJournal) {
+    using filament::details::ChangeJournal;
+    filament::details::FTransformManager tcm;
+    ChangeJournal const& journal = tcm.getChangeJournal();
+    EntityManager& em = EntityManager::get();
+    std::array<Entity, 3> entities;
+    em.create(entities.size(), entities.data());
+
+    tcm.create(entities[0]);
+    tcm.create(entities[1], tcm.getInstance(entities[0]), mat4f{});
+    tcm.create(entities[2]);
+
+    // changing a parent's transform reports its children as well
+    ChangeJournal::Position position = journal.tell();
+    tcm.setTransform(tcm.getInstance(entities[0]), mat4f{ float4{ 2 }});
+
+    Slice<const Entity> changes;
+    ASSERT_TRUE(journal.getChanges(position, &changes));
+    std::vector<Entity> changed(changes.begin(), changes.end());
+    EXPECT_EQ(changed.size(), 2);
+    EXPECT_NE(std::find(changed.begin(), changed.end(), entities[0]), changed.end());
+    EXPECT_NE(std::find(changed.begin(), changed.end(), entities[1]), changed.end());
+
+    // nothing changed since then
+    position = journal.tell();
+    ASSERT_TRUE(journal.getChanges(position, &changes));
+    EXPECT_TRUE(changes.empty());
+
+    // once trimmed, the changes can't be retrieved anymore
+    tcm.setTransform(tcm.getInstance(entities[2]), mat4f{ float4{ 2 }});
+    tcm.getChangeJournal().trim(journal.tell());
+    EXPECT_FALSE(journal.getChanges(position, &changes));
+
+    // transactions can't be tracked per entity
+    position = journal.tell();
+    tcm.openLocalTransformTransaction();
+    tcm.setTransform(tcm.getInstance(entities[2]), mat4f{ float4{ 4 }});
+    tcm.commitLocalTransformTransaction();
+    EXPECT_FALSE(journal.getChanges(position, &changes));
+
+    // destroying a component is a change
+    position = journal.tell();
+    tcm.destroy(entities[2]);
+    ASSERT_TRUE(journal.getChanges(position, &changes));
+    ASSERT_EQ(changes.size(), 1);
+    EXPECT_EQ(changes[0], entities[2]);
+
+    tcm.destroy(entities[1]);
+    tcm.destroy(entities[0]);
+    em.destroy(entities.size(), entities.data());
+}
+
 TEST(FilamentTest, UniformInterfaceBlock) {
 
     UniformInterfaceBlock::Builder b;
@@ -500,6 +568,49 @@ TEST(FilamentTest, UniformBufferSize2) {
     buffer.invalidate();
 }
 
+TEST(FilamentTest, UniformBufferDirtyRange) {
+    UniformInterfaceBlock::Builder b;
+    b.name("UniformBufferDirtyRange");
+    b.add("f4a", 1, UniformInterfaceBlock::Type::FLOAT4); // offset = 0
+    b.add("f4b", 1, UniformInterfaceBlock::Type::FLOAT4); // offset = 16
+    b.add("f1a", 1, UniformInterfaceBlock::Type::FLOAT);  // offset = 32
+    b.add("f1b", 1, UniformInterfaceBlock::Type::FLOAT);  // offset = 36
+    UniformInterfaceBlock uib(b.build());
+    UniformBuffer buffer(uib.getSize());
+
+    // a new buffer is entirely dirty
+    EXPECT_TRUE(buffer.isDirty());
+    EXPECT_EQ(0, buffer.getDirtyOffset());
+    EXPECT_EQ(buffer.getSize(), buffer.getDirtySize());
+
+    buffer.clean();
+    EXPECT_FALSE(buffer.isDirty());
+    EXPECT_EQ(0, buffer.getDirtySize());
+
+    buffer.setUniform(uib.getUniformOffset("f1a", 0), 1.0f);
+    EXPECT_TRUE(buffer.isDirty());
+    EXPECT_EQ(32, buffer.getDirtyOffset());
+    EXPECT_EQ(4, buffer.getDirtySize());
+
+    // the range spans all the changed uniforms
+    buffer.setUniform(uib.getUniformOffset("f4b", 0), float4(1.0f));
+    EXPECT_EQ(16, buffer.getDirtyOffset());
+    EXPECT_EQ(20, buffer.getDirtySize());
+
+    buffer.setUniform(uib.getUniformOffset("f1b", 0), 1.0f);
+    EXPECT_EQ(16, buffer.getDirtyOffset());
+    EXPECT_EQ(24, buffer.getDirtySize());
+
+    // moving keeps the range
+    UniformBuffer move(std::move(buffer));
+    EXPECT_EQ(16, move.getDirtyOffset());
+    EXPECT_EQ(24, move.getDirtySize());
+
+    move.invalidate();
+    EXPECT_EQ(0, move.getDirtyOffset());
+    EXPECT_EQ(move.getSize(), move.getDirtySize());
+}
+
 TEST(FilamentTest, BoxCulling) {
     Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
 
@@ -543,6 +654,58 @@ TEST(FilamentTest, BoxCulling) {
     EXPECT_TRUE( frustum.intersects( { 0, 200 }) );
 }
 
+TEST(FilamentTest, CullingBvh) {
+    using filament::details::Culler;
+    using filament::details::CullingBvh;
+
+    JobSystem js;
+    js.adopt();
+
+    Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
+
+    std::default_random_engine gen; // NOLINT
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+    // not a multiple of the leaf size, to exercise partial leaves
+    const size_t count = 10 * CullingBvh::LEAF_SIZE + 3;
+    std::vector<float3> centers(Culler::round(count));
+    std::vector<float3> extents(Culler::round(count));
+    for (size_t i = 0; i < count; i++) {
+        centers[i] = { position(gen), position(gen), -std::abs(position(gen)) };
+        extents[i] = { size(gen), size(gen), size(gen) };
+    }
+
+    std::vector<Culler::result_type> expected(Culler::round(count));
+    Culler::Test::intersects(expected.data(), frustum, centers.data(), extents.data(), count);
+
+    CullingBvh bvh;
+    bvh.build(centers.data(), extents.data(), count);
+    EXPECT_EQ(count, bvh.size());
+
+    std::vector<Culler::result_type> results(Culler::round(count));
+    bvh.intersects(js, results.data(), frustum, 0);
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(bool(expected[i]), bool(results[i]));
+    }
+
+    // move all the boxes, refitting must keep the results correct
+    for (size_t i = 0; i < count; i++) {
+        centers[i] = { position(gen), position(gen), -std::abs(position(gen)) };
+    }
+    std::fill(expected.begin(), expected.end(), 0);
+    Culler::Test::intersects(expected.data(), frustum, centers.data(), extents.data(), count);
+
+    bvh.refit(centers.data(), extents.data());
+    std::fill(results.begin(), results.end(), 0);
+    bvh.intersects(js, results.data(), frustum, 0);
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(bool(expected[i]), bool(results[i]));
+    }
+
+    js.emancipate();
+}
+
 TEST(FilamentTest, SphereCulling) {
     Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
 
@@ -863,6 +1026,231 @@ TEST(FilamentTest, Bones) {
     }
 }
 
+TEST(FilamentTest, RenderPassCommandCache) {
+    using namespace filament;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    SwapChain* swapChain = engine->createSwapChain(64, 64);
+    Renderer* renderer = engine->createRenderer();
+    Scene* scene = engine->createScene();
+    View* view = engine->createView();
+    Camera* camera = engine->createCamera();
+    camera->setProjection(45.0, 1.0, 0.1, 100.0);
+    view->setCamera(camera);
+    view->setScene(scene);
+    view->setViewport({ 0, 0, 64, 64 });
+    view->setPostProcessingEnabled(false);
+    view->setShadowsEnabled(false);
+
+    static const float3 vertices[3] = {{ -1, -1, -5 }, { 1, -1, -5 }, { 0, 1, -5 }};
+    static const uint16_t indices[3] = { 0, 1, 2 };
+    VertexBuffer* vb = VertexBuffer::Builder()
+            .vertexCount(3)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .build(*engine);
+    vb->setBufferAt(*engine, 0, { vertices, sizeof(vertices) });
+    IndexBuffer* ib = IndexBuffer::Builder()
+            .indexCount(3)
+            .bufferType(IndexBuffer::IndexType::USHORT)
+            .build(*engine);
+    ib->setBuffer(*engine, { indices, sizeof(indices) });
+
+    // four renderables, of which only the first three are visible
+    utils::Entity renderables[4];
+    utils::EntityManager::get().create(4, renderables);
+    for (size_t i = 0; i < 4; i++) {
+        RenderableManager::Builder(1)
+                .boundingBox({{ -1, -1, -5 }, { 1, 1, -5 }})
+                .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib)
+                .material(0, engine->getDefaultMaterial()->getDefaultInstance())
+                .culling(false)
+                .castShadows(false)
+                .layerMask(0xFF, i < 3 ? 0x1 : 0x2)
+                .build(*engine, renderables[i]);
+        scene->addEntity(renderables[i]);
+    }
+    view->setVisibleLayers(0xFF, 0x1);
+
+    auto render = [&]() -> View::RenderPassStats {
+        if (renderer->beginFrame(swapChain)) {
+            renderer->render(view);
+            renderer->endFrame();
+        }
+        engine->flushAndWait();
+        return view->getRenderStats().color;
+    };
+
+    // the first frame populates the command cache, the second one reuses it
+    render();
+    const View::RenderPassStats before = render();
+    EXPECT_GT(before.primitiveCount, 0u);
+
+    // swap the third renderable for the fourth, the number of visible renderables is unchanged
+    RenderableManager& rcm = engine->getRenderableManager();
+    rcm.setLayerMask(rcm.getInstance(renderables[2]), 0xFF, 0x2);
+    rcm.setLayerMask(rcm.getInstance(renderables[3]), 0xFF, 0x1);
+
+    // the commands of the renderable that went away must not be drawn anymore
+    const View::RenderPassStats after = render();
+    EXPECT_EQ(before.primitiveCount, after.primitiveCount);
+    EXPECT_EQ(before.drawCount, after.drawCount);
+
+    for (utils::Entity e : renderables) {
+        engine->destroy(e);
+    }
+    utils::EntityManager::get().destroy(4, renderables);
+    engine->destroy(ib);
+    engine->destroy(vb);
+    engine->destroy(camera);
+    engine->destroy(view);
+    engine->destroy(scene);
+    engine->destroy(renderer);
+    engine->destroy(swapChain);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, ShadowMapWorldOrigin) {
+    using namespace filament;
+    using namespace filament::details;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    SwapChain* swapChain = engine->createSwapChain(64, 64);
+    Renderer* renderer = engine->createRenderer();
+    Scene* scene = engine->createScene();
+    View* view = engine->createView();
+    Camera* camera = engine->createCamera();
+    view->setCamera(camera);
+    view->setScene(scene);
+    view->setViewport({ 0, 0, 64, 64 });
+    view->setPostProcessingEnabled(false);
+
+    // the camera is far from the origin, so that the world origin isn't the identity
+    ASSERT_TRUE(fengine.debug.view.camera_at_origin);
+    const float3 center{ 100, 0, -5 };
+    camera->setProjection(45.0, 1.0, 0.1, 100.0);
+    camera->lookAt({ 100, 0, 0 }, center);
+
+    utils::Entity light = utils::EntityManager::get().create();
+    LightManager::Builder(LightManager::Type::DIRECTIONAL)
+            .direction({ 0, -1, 0 })
+            .castShadows(true)
+            .build(*engine, light);
+    scene->addEntity(light);
+
+    static const float3 vertices[3] = {{ 99, -1, -5 }, { 101, -1, -5 }, { 100, 1, -5 }};
+    static const uint16_t indices[3] = { 0, 1, 2 };
+    VertexBuffer* vb = VertexBuffer::Builder()
+            .vertexCount(3)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .build(*engine);
+    vb->setBufferAt(*engine, 0, { vertices, sizeof(vertices) });
+    IndexBuffer* ib = IndexBuffer::Builder()
+            .indexCount(3)
+            .bufferType(IndexBuffer::IndexType::USHORT)
+            .build(*engine);
+    ib->setBuffer(*engine, { indices, sizeof(indices) });
+
+    utils::Entity renderable = utils::EntityManager::get().create();
+    RenderableManager::Builder(1)
+            .boundingBox({ center, { 1, 1, 0.1f }})
+            .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib)
+            .material(0, engine->getDefaultMaterial()->getDefaultInstance())
+            .castShadows(true)
+            .receiveShadows(true)
+            .build(*engine, renderable);
+    scene->addEntity(renderable);
+
+    if (renderer->beginFrame(swapChain)) {
+        renderer->render(view);
+        renderer->endFrame();
+    }
+    engine->flushAndWait();
+
+    FView const& fview = upcast(*view);
+    ShadowMap const& shadowMap = fview.getShadowMap();
+    ASSERT_TRUE(shadowMap.hasVisibleShadows());
+
+    CameraInfo const& viewCamera = fview.getCameraInfo();
+    EXPECT_EQ(float3(-100, 0, 0), viewCamera.worldOrigin[3].xyz);
+
+    // the shadow pass must apply the same world origin as the view, like the vertex shader
+    // does, for the caster to land in the shadow map
+    CameraInfo const shadowCamera = shadowMap.getCameraInfo(viewCamera);
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_EQ(viewCamera.worldOrigin[i], shadowCamera.worldOrigin[i]);
+    }
+    const mat4f clipFromWorld = shadowCamera.projection * shadowCamera.view;
+    const float3 p = mat4f::project(clipFromWorld * shadowCamera.worldOrigin, center);
+    EXPECT_LE(std::abs(p.x), 1.0f);
+    EXPECT_LE(std::abs(p.y), 1.0f);
+    EXPECT_LE(std::abs(p.z), 1.0f);
+
+    // without the world origin, the caster would be outside of the shadow map
+    const float3 q = mat4f::project(clipFromWorld, center);
+    EXPECT_GT(std::max(std::abs(q.x), std::abs(q.y)), 1.0f);
+
+    engine->destroy(renderable);
+    engine->destroy(light);
+    utils::EntityManager::get().destroy(renderable);
+    utils::EntityManager::get().destroy(light);
+    engine->destroy(ib);
+    engine->destroy(vb);
+    engine->destroy(camera);
+    engine->destroy(view);
+    engine->destroy(scene);
+    engine->destroy(renderer);
+    engine->destroy(swapChain);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, ProducerThread) {
+    using namespace filament;
+    using namespace filament::details;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    EXPECT_FALSE(fengine.hasProducerThreads());
+
+    static const float3 vertices[3] = {{ -1, -1, 0 }, { 1, -1, 0 }, { 0, 1, 0 }};
+    std::atomic_int uploads = { 0 };
+    auto uploaded = [](void*, size_t, void* user) {
+        static_cast<std::atomic_int*>(user)->fetch_add(1);
+    };
+
+    // the vertex buffer is created and filled by a producer thread
+    VertexBuffer* vb = nullptr;
+    std::thread producer([&]() {
+        engine->attachProducerThread();
+        EXPECT_TRUE(fengine.hasProducerThreads());
+        vb = VertexBuffer::Builder()
+                .vertexCount(3)
+                .bufferCount(1)
+                .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+                .build(*engine);
+        vb->setBufferAt(*engine, 0, { vertices, sizeof(vertices), uploaded, &uploads });
+        engine->flushProducerThread();
+        engine->detachProducerThread();
+    });
+    producer.join();
+
+    // once flushed, it can be used from the engine's thread
+    ASSERT_NE(nullptr, vb);
+    vb->setBufferAt(*engine, 0, { vertices, sizeof(vertices), uploaded, &uploads });
+    engine->flushAndWait();
+    EXPECT_EQ(2, uploads.load());
+
+    // the driver thread destroys the producer after executing its commands, which is done
+    // by the time the commands flushed after that are executed
+    engine->flushAndWait();
+    EXPECT_FALSE(fengine.hasProducerThreads());
+
+    engine->destroy(vb);
+    Engine::destroy(&engine);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
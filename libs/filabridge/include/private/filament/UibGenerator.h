@@ -86,8 +86,11 @@ struct PerViewUib { // NOLINT(cppcoreguidelines-pro-type-member-init)
     filament::math::float3 worldOffset; // this is (0,0,0) when camera_at_origin is disabled
     float padding1;
 
+    // transform applied to the per-renderable transforms, see View::prepare()
+    filament::math::mat4f worldFromUserWorldMatrix;
+
     // bring PerViewUib to 1 KiB
-    filament::math::float4 padding2[15];
+    filament::math::float4 padding2[11];
 };
 
 
@@ -78,9 +78,10 @@ UniformInterfaceBlock const& UibGenerator::getPerViewUib() noexcept  {
             .add("padding0",                1, UniformInterfaceBlock::Type::FLOAT2)
             // view
             .add("worldOffset",             1, UniformInterfaceBlock::Type::FLOAT3)
-            // bring size to 1 KiB
             .add("padding1",                1, UniformInterfaceBlock::Type::FLOAT)
-            .add("padding2",                15, UniformInterfaceBlock::Type::FLOAT4)
+            .add("worldFromUserWorldMatrix",1, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
+            // bring size to 1 KiB
+            .add("padding2",                11, UniformInterfaceBlock::Type::FLOAT4)
             .build();
     return uib;
 }
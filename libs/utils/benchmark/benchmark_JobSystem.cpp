@@ -21,6 +21,10 @@
 
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 using namespace utils;
 
 
@@ -78,7 +82,56 @@ static void BM_JobSystemParallelFor(benchmark::State& state) {
     js.emancipate();
 }
 
+// Latency of a frame-critical parallel_for while the pool is kept loaded with other jobs, which
+// run in the CRITICAL lane with range(0) == 0, or in the BACKGROUND lane with range(0) == 1.
+static void BM_JobSystemCriticalLatencyUnderLoad(benchmark::State& state) {
+    JobSystem js;
+    js.adopt();
+
+    const uint32_t flags = state.range(0) ? JobSystem::BACKGROUND : 0;
+    const uint32_t loadCount = 2 * std::max(std::thread::hardware_concurrency(), 1u);
+    std::atomic<uint32_t> loaded = { 0 };
+
+    // a job spinning for a few microseconds, e.g. one of a stream of texture decoding jobs
+    auto load = [&loaded](JobSystem&, JobSystem::Job*) {
+        uint32_t sink = 0;
+        for (uint32_t i = 0; i < 10000; i++) {
+            benchmark::DoNotOptimize(sink += i);
+        }
+        loaded.fetch_sub(1, std::memory_order_relaxed);
+    };
+
+    // the load jobs are children of this job, so we can wait for them at the end
+    JobSystem::Job* loadRoot = js.createJob();
+
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            state.PauseTiming();
+            while (loaded.load(std::memory_order_relaxed) < loadCount) {
+                JobSystem::Job* job = js.createJob(loadRoot, load);
+                if (!job) {
+                    break;
+                }
+                loaded++;
+                js.run(job, flags);
+            }
+            state.ResumeTiming();
+
+            auto job = jobs::parallel_for(js, nullptr, 0, 4096,
+                    [](uint32_t start, uint32_t count) { }, jobs::CountSplitter<64>());
+            js.runAndWait(job);
+        }
+    }
+    state.SetItemsProcessed((int64_t)state.iterations());
+
+    js.runAndWait(loadRoot);
+
+    js.emancipate();
+}
+
 
 BENCHMARK(BM_JobSystem);
 BENCHMARK(BM_JobSystemAsChildren4k);
 BENCHMARK(BM_JobSystemParallelFor);
+BENCHMARK(BM_JobSystemCriticalLatencyUnderLoad)->Arg(0)->Arg(1);
@@ -114,3 +114,28 @@ BENCHMARK_REGISTER_F(Allocators, poolAllocator_spinlock)
 BENCHMARK_REGISTER_F(Allocators, poolAllocator_atomic)
         ->ThreadRange(1, 4)
         ->Threads(benchmark::CPUInfo::Get().num_cpus * 2);
+
+// allocates a frame's worth of scattered data from a per-frame arena, which grows from 1 MiB to
+// the size given by the first argument; the second argument is the MemoryBacking of the arena.
+static void BM_perFrameArena(benchmark::State& state) {
+    const size_t frameSize = size_t(state.range(0));
+    const MemoryBacking backing = MemoryBacking(state.range(1));
+    Arena<ChainedLinearAllocator, LockingPolicy::NoLock> arena("per-frame", 1u << 20u,
+            backing, 1u << 20u, backing);
+    PerformanceCounters pc(state);
+    for (auto _ : state) {
+        for (size_t allocated = 0; allocated < frameSize; allocated += 4096) {
+            char* p = static_cast<char*>(arena.alloc(4096, 64));
+            p[0] = p[1024] = p[2048] = p[3072] = 0;
+            benchmark::DoNotOptimize(p);
+        }
+        arena.reset();
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(frameSize));
+}
+
+BENCHMARK(BM_perFrameArena)
+        ->Args({ 16 << 20, int(MemoryBacking::DEFAULT) })
+        ->Args({ 16 << 20, int(MemoryBacking::HUGE_PAGES) })
+        ->Args({ 16 << 20, int(MemoryBacking::PREFAULT) })
+        ->Args({ 16 << 20, int(MemoryBacking::HUGE_PAGES | MemoryBacking::PREFAULT) });
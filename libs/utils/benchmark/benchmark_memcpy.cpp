@@ -16,8 +16,13 @@
 
 #include "PerformanceCounters.h"
 
+#include <utils/Allocator.h>
+
 #include <benchmark/benchmark.h>
 
+#include <memory>
+
+using namespace utils;
 
 static void BM_memcpy(benchmark::State& state) {
     char* src = new char[state.range(0)];
@@ -40,3 +45,29 @@ static void BM_memcpy(benchmark::State& state) {
 }
 
 BENCHMARK(BM_memcpy)->Range(8, 8192<<10)->Threads(1)->Threads(8);
+
+// copy to a newly allocated area, which includes the cost of the first touch of its pages
+// the argument is the MemoryBacking of the area
+static void BM_memcpy_first_touch(benchmark::State& state) {
+    constexpr size_t size = 8u << 20u;
+    const MemoryBacking backing = MemoryBacking(state.range(0));
+    std::unique_ptr<char[]> src(new char[size]);
+    memset(src.get(), 'x', size);
+
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            HeapArea area(size, backing);
+            memcpy(area.data(), src.get(), size);
+            benchmark::DoNotOptimize(area.data());
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+
+BENCHMARK(BM_memcpy_first_touch)
+        ->Arg(int(MemoryBacking::DEFAULT))
+        ->Arg(int(MemoryBacking::HUGE_PAGES))
+        ->Arg(int(MemoryBacking::PREFAULT))
+        ->Arg(int(MemoryBacking::HUGE_PAGES | MemoryBacking::PREFAULT));
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerformanceCounters.h"
+
+#include <utils/JobSystem.h>
+#include <utils/ParallelAlgorithms.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace utils;
+
+/*
+ * Compares the algorithms of ParallelAlgorithms.h with their serial equivalent from the
+ * standard library, on arrays of random floats.
+ *
+ * The sort and partition benchmarks work on a fresh copy of the input at each iteration, so
+ * the cost of that copy is included in their results.
+ */
+class ParallelAlgorithms : public benchmark::Fixture {
+protected:
+    std::vector<float> values;
+    std::vector<float> result;
+    std::vector<float> scratch;
+    JobSystem* js = nullptr;
+
+public:
+    void SetUp(const benchmark::State& state) override {
+        const size_t count = size_t(state.range(0));
+        std::default_random_engine gen{123};
+        std::uniform_real_distribution<float> nd(-1.0f, 1.0f);
+        values.resize(count);
+        std::generate(values.begin(), values.end(), [&]() { return nd(gen); });
+        result.resize(count);
+        scratch.resize(count);
+        js = new JobSystem();
+        js->adopt();
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        js->emancipate();
+        delete js;
+        js = nullptr;
+        values = {};
+        result = {};
+        scratch = {};
+    }
+};
+
+BENCHMARK_DEFINE_F(ParallelAlgorithms, stdReduce)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(std::accumulate(values.begin(), values.end(), 0.0f));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_DEFINE_F(ParallelAlgorithms, parallelReduce)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(
+                    jobs::parallel_reduce(*js, values.begin(), values.end(), 0.0f));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_DEFINE_F(ParallelAlgorithms, stdExclusiveScan)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            float sum = 0.0f;
+            for (size_t i = 0, c = values.size(); i < c; i++) {
+                result[i] = sum;
+                sum += values[i];
+            }
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_DEFINE_F(ParallelAlgorithms, parallelExclusiveScan)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            jobs::parallel_exclusive_scan(*js,
+                    values.begin(), values.end(), result.begin(), 0.0f);
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_DEFINE_F(ParallelAlgorithms, stdStablePartition)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            std::copy(values.begin(), values.end(), result.begin());
+            std::stable_partition(result.begin(), result.end(), [](float v) { return v < 0; });
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_DEFINE_F(ParallelAlgorithms, parallelPartition)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            std::copy(values.begin(), values.end(), result.begin());
+            jobs::parallel_partition(*js, result.data(), result.data() + result.size(),
+                    scratch.data(), [](float v) { return v < 0; });
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_DEFINE_F(ParallelAlgorithms, stdSort)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            std::copy(values.begin(), values.end(), result.begin());
+            std::sort(result.begin(), result.end());
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_DEFINE_F(ParallelAlgorithms, parallelSort)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            std::copy(values.begin(), values.end(), result.begin());
+            jobs::parallel_sort(*js, result.begin(), result.end());
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_REGISTER_F(ParallelAlgorithms, stdReduce)
+        ->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK_REGISTER_F(ParallelAlgorithms, parallelReduce)
+        ->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK_REGISTER_F(ParallelAlgorithms, stdExclusiveScan)
+        ->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK_REGISTER_F(ParallelAlgorithms, parallelExclusiveScan)
+        ->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK_REGISTER_F(ParallelAlgorithms, stdStablePartition)
+        ->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK_REGISTER_F(ParallelAlgorithms, parallelPartition)
+        ->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK_REGISTER_F(ParallelAlgorithms, stdSort)
+        ->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK_REGISTER_F(ParallelAlgorithms, parallelSort)
+        ->Arg(10000)->Arg(100000)->Arg(1000000);
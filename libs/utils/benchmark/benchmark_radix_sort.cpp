@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerformanceCounters.h"
+
+#include <utils/JobSystem.h>
+#include <utils/RadixSort.h>
+#include <utils/compiler.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace utils;
+
+/*
+ * Sorts items shaped like filament's RenderPass::Command: a 64-bit key followed by a 24 bytes
+ * payload. Like render commands, the keys only use some of their bits.
+ *
+ * Each iteration sorts a fresh copy of the unsorted items, so the cost of that copy is
+ * included in all results.
+ */
+class RadixSort : public benchmark::Fixture {
+protected:
+    struct Item {
+        uint64_t key;
+        uint64_t payload[3];
+        bool operator < (Item const& rhs) const noexcept { return key < rhs.key; }
+    };
+
+    std::vector<Item> items;
+    std::vector<Item> sorted;
+    std::vector<Item> scratch;
+
+public:
+    void SetUp(const benchmark::State& state) override {
+        const size_t count = size_t(state.range(0));
+        std::default_random_engine gen{123};
+        std::uniform_int_distribution<uint64_t> nd;
+        items.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            // the top bits (pass) and low bits (flags) are constant
+            items[i] = { (nd(gen) & 0x00FF'FFFF'FFFF'FF00u) | 0x4000'0000'0000'0000u, { i } };
+        }
+        sorted.resize(count);
+        scratch.resize(count);
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        items = {};
+        sorted = {};
+        scratch = {};
+    }
+};
+
+BENCHMARK_DEFINE_F(RadixSort, stdSort)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            std::copy(items.begin(), items.end(), sorted.begin());
+            std::sort(sorted.begin(), sorted.end());
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_DEFINE_F(RadixSort, radixSort)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            std::copy(items.begin(), items.end(), sorted.begin());
+            radix_sort(sorted.data(), sorted.data() + sorted.size(), scratch.data(),
+                    [](Item const& item) { return item.key; });
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_DEFINE_F(RadixSort, parallelRadixSort)(benchmark::State& state) {
+    JobSystem js;
+    js.adopt();
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            std::copy(items.begin(), items.end(), sorted.begin());
+            jobs::parallel_radix_sort(js,
+                    sorted.data(), sorted.data() + sorted.size(), scratch.data(),
+                    [](Item const& item) { return item.key; });
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    js.emancipate();
+}
+
+BENCHMARK_REGISTER_F(RadixSort, stdSort)
+        ->Arg(10000)->Arg(50000)->Arg(100000)->Arg(500000);
+BENCHMARK_REGISTER_F(RadixSort, radixSort)
+        ->Arg(10000)->Arg(50000)->Arg(100000)->Arg(500000);
+BENCHMARK_REGISTER_F(RadixSort, parallelRadixSort)
+        ->Arg(10000)->Arg(50000)->Arg(100000)->Arg(500000);
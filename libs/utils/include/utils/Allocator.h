@@ -18,6 +18,7 @@
 #define TNT_UTILS_ALLOCATOR_H
 
 
+#include <utils/BitmaskEnum.h>
 #include <utils/compiler.h>
 #include <utils/memalign.h>
 #include <utils/Mutex.h>
@@ -26,6 +27,7 @@
 #include <atomic>
 #include <mutex>
 #include <type_traits>
+#include <vector>
 
 #include <assert.h>
 #include <stddef.h>
@@ -56,6 +58,65 @@ static inline P* align(P* p, size_t alignment, size_t offset) noexcept {
 
 }
 
+// ------------------------------------------------------------------------------------------------
+// MemoryCounter
+// ------------------------------------------------------------------------------------------------
+
+/*
+ * Current and peak number of bytes of a category of memory, typically shared by several arenas
+ * (see TrackingPolicy::Tagged) or objects. It can be updated from any thread, and is cheap
+ * enough to be used in release builds.
+ */
+class MemoryCounter {
+public:
+    MemoryCounter() noexcept = default;
+    MemoryCounter(const MemoryCounter& rhs) = delete;
+    MemoryCounter& operator=(const MemoryCounter& rhs) = delete;
+
+    void add(size_t size) noexcept {
+        const size_t current = mCurrent.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t peak = mPeak.load(std::memory_order_relaxed);
+        while (current > peak &&
+               !mPeak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        }
+    }
+
+    void remove(size_t size) noexcept {
+        UTILS_UNUSED_IN_RELEASE size_t const current =
+                mCurrent.fetch_sub(size, std::memory_order_relaxed);
+        assert(current >= size);
+    }
+
+    size_t getCurrent() const noexcept { return mCurrent.load(std::memory_order_relaxed); }
+
+    size_t getPeak() const noexcept { return mPeak.load(std::memory_order_relaxed); }
+
+    // starts a new measurement of the peak, from the current value
+    void resetPeak() noexcept {
+        mPeak.store(mCurrent.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> mCurrent{ 0 };
+    std::atomic<size_t> mPeak{ 0 };
+};
+
+/* ------------------------------------------------------------------------------------------------
+ * MemoryBacking
+ *
+ * How the memory of large, long-lived areas is obtained from the system. The options other
+ * than DEFAULT are hints, which are only honored on Linux.
+ * ------------------------------------------------------------------------------------------------
+ */
+
+enum class MemoryBacking : uint8_t {
+    DEFAULT     = 0x0,  // regular heap allocation
+    HUGE_PAGES  = 0x1,  // use huge pages (MAP_HUGETLB, or transparent huge pages as a fallback)
+    PREFAULT    = 0x2,  // fault all the pages in upfront, instead of on first touch
+};
+
+template<> struct EnableBitMaskOperators<MemoryBacking> : public std::true_type {};
+
 /* ------------------------------------------------------------------------------------------------
  * LinearAllocator
  *
@@ -133,6 +194,121 @@ private:
     void* mCurrent = nullptr;
 };
 
+/* ------------------------------------------------------------------------------------------------
+ * ChainedLinearAllocator
+ *
+ * + Like LinearAllocator, but never runs out of memory: when the current block is full, a new
+ *   block is allocated from the heap and chained to it
+ * + The first block is the memory area provided, which is never freed
+ * + Blocks freed by rewind() or reset() are kept and reused by the next allocations, but the
+ *   spare blocks exceeding the recent peak usage are returned to the heap each time the
+ *   allocator is emptied (e.g. at the end of each frame), so that its capacity follows the
+ *   actual needs
+ * + Keeps track of its high watermark
+ * ------------------------------------------------------------------------------------------------
+ */
+class ChainedLinearAllocator {
+public:
+    // use memory area provided as the first block, additional blocks are at least 'blockSize'
+    // bytes, or the size of the first block if 0, and are allocated with the given backing.
+    ChainedLinearAllocator(void* begin, void* end, size_t blockSize = 0,
+            MemoryBacking backing = MemoryBacking::DEFAULT) noexcept;
+
+    template <typename AREA>
+    explicit ChainedLinearAllocator(const AREA& area, size_t blockSize = 0,
+            MemoryBacking backing = MemoryBacking::DEFAULT)
+            : ChainedLinearAllocator(area.begin(), area.end(), blockSize, backing) { }
+
+    // Allocators can't be copied
+    ChainedLinearAllocator(const ChainedLinearAllocator& rhs) = delete;
+    ChainedLinearAllocator& operator=(const ChainedLinearAllocator& rhs) = delete;
+
+    // Allocators can be moved
+    ChainedLinearAllocator(ChainedLinearAllocator&& rhs) noexcept;
+    ChainedLinearAllocator& operator=(ChainedLinearAllocator&& rhs) noexcept;
+
+    ~ChainedLinearAllocator() noexcept;
+
+    // our allocator concept
+    void* alloc(size_t size, size_t alignment = alignof(std::max_align_t), size_t extra = 0) UTILS_RESTRICT {
+        void* const p = pointermath::align(mCurrent, alignment, extra);
+        void* const c = pointermath::add(p, size);
+        if (UTILS_LIKELY(c <= mEnd)) {
+            mCurrent = c;
+            return p;
+        }
+        return allocFromNextBlock(size, alignment, extra);
+    }
+
+    // API specific to this allocator
+
+    void *getCurrent() UTILS_RESTRICT noexcept {
+        return mCurrent;
+    }
+
+    // free memory back to the specified point, which must have been returned by getCurrent()
+    void rewind(void* p) UTILS_RESTRICT noexcept;
+
+    // frees all allocated blocks
+    void reset() UTILS_RESTRICT noexcept {
+        rewind(mBlocks[0].begin);
+    }
+
+    // number of bytes in use, including the unused ends of the blocks that are full
+    size_t allocated() const UTILS_RESTRICT noexcept {
+        return mBase + (uintptr_t(mCurrent) - uintptr_t(mBlocks[mIndex].begin));
+    }
+
+    // total size of all the blocks, including the spare ones
+    size_t getCapacity() const noexcept { return mCapacity; }
+
+    // number of blocks, including the spare ones
+    size_t getBlockCount() const noexcept { return mBlocks.size(); }
+
+    // largest number of bytes in use since this allocator was created
+    size_t getHighWatermark() const noexcept {
+        return mHighWatermark > allocated() ? mHighWatermark : allocated();
+    }
+
+    // accounts the capacity of this allocator in 'counter', which can be nullptr
+    void setMemoryCounter(MemoryCounter* counter) noexcept;
+
+    void swap(ChainedLinearAllocator& rhs) noexcept;
+
+    // ChainedLinearAllocator shouldn't have a free() method
+    // it's only needed to be compatible with STLAllocator<> below
+    void free(void*, size_t) UTILS_RESTRICT noexcept { }
+
+private:
+    // the spare blocks are freed when they exceed the peak usage of the last TRIM_PERIOD to
+    // 2 * TRIM_PERIOD cycles, a cycle ends each time the allocator is emptied.
+    static constexpr uint32_t TRIM_PERIOD = 64;
+
+    struct Block {
+        void* begin;
+        void* end;
+        size_t size() const noexcept { return uintptr_t(end) - uintptr_t(begin); }
+    };
+
+    void* allocFromNextBlock(size_t size, size_t alignment, size_t extra) noexcept;
+    void setBlock(size_t index, size_t base) noexcept;
+    void trim() noexcept;
+
+    void* mCurrent = nullptr;
+    void* mEnd = nullptr;               // end of the current block
+    size_t mIndex = 0;                  // index of the current block
+    size_t mBase = 0;                   // size of the blocks before the current one
+    size_t mCapacity = 0;
+    size_t mBlockSize = 0;
+    size_t mHighWatermark = 0;
+    size_t mPeak = 0;                   // peak usage of the current trim period
+    size_t mPreviousPeak = 0;           // peak usage of the previous trim period
+    uint32_t mCycleCount = 0;
+    MemoryBacking mBacking = MemoryBacking::DEFAULT;
+    MemoryCounter* mCounter = nullptr;
+    std::vector<Block> mBlocks;         // the first block is never freed
+};
+
 /* ------------------------------------------------------------------------------------------------
  * HeapAllocator
  *
@@ -399,9 +575,16 @@ public:
         }
     }
 
+    HeapArea(size_t size, MemoryBacking backing) : mBacking(backing) {
+        if (size) {
+            mBegin = allocate(size, backing);
+            mEnd = mBegin ? pointermath::add(mBegin, size) : nullptr;
+        }
+    }
+
     ~HeapArea() noexcept {
         // TODO: policy for returning memory to system
-        free(mBegin);
+        deallocate(mBegin, getSize(), mBacking);
     }
 
     HeapArea(const HeapArea& rhs) = delete;
@@ -414,9 +597,20 @@ public:
     void* end() const noexcept { return mEnd; }
     size_t getSize() const noexcept { return uintptr_t(mEnd) - uintptr_t(mBegin); }
 
+    // allocates memory with the given backing, returns nullptr on failure
+    static void* allocate(size_t size, MemoryBacking backing) noexcept;
+
+    // frees memory returned by allocate(), with the same size and backing
+    static void deallocate(void* p, size_t size, MemoryBacking backing) noexcept;
+
+    // applies a backing to memory mapped by other means, i.e. requests transparent huge pages
+    // and/or faults the pages in, this is a no-op for MemoryBacking::DEFAULT.
+    static void advise(void* p, size_t size, MemoryBacking backing) noexcept;
+
 private:
     void* mBegin = nullptr;
     void* mEnd = nullptr;
+    MemoryBacking mBacking = MemoryBacking::DEFAULT;
 };
 
 
@@ -488,6 +682,34 @@ protected:
     uint32_t mSize = 0;
 };
 
+// Accounts the allocations of its arena in a MemoryCounter, shared by all the arenas with the
+// same tag. Tagged doesn't keep a count of its own, so it can be used without a LockingPolicy,
+// since MemoryCounter is atomic. The counter must be set with setCounter() before the first
+// allocation, and the arena must free everything it allocated before it's destroyed.
+// Only arenas that can't be reset or rewound (e.g. HeapAllocator) can be Tagged.
+struct Tagged {
+    Tagged() noexcept = default;
+    Tagged(const char* name, void* base, size_t size) noexcept { }
+    Tagged(const Tagged& rhs) = delete;
+    Tagged& operator=(const Tagged& rhs) = delete;
+
+    void setCounter(MemoryCounter* counter) noexcept { mCounter = counter; }
+    MemoryCounter* getCounter() const noexcept { return mCounter; }
+
+    void onAlloc(void* p, size_t size, size_t alignment, size_t extra) noexcept {
+        if (mCounter) {
+            mCounter->add(size);
+        }
+    }
+    void onFree(void* p, size_t size) noexcept {
+        if (mCounter) {
+            mCounter->remove(size);
+        }
+    }
+private:
+    MemoryCounter* mCounter = nullptr;
+};
+
 struct DebugAndHighWatermark : protected HighWatermark, protected Debug {
     DebugAndHighWatermark() noexcept = default;
     DebugAndHighWatermark(const char* name, void* base, size_t size) noexcept
@@ -510,6 +732,27 @@ struct DebugAndHighWatermark : protected HighWatermark, protected Debug {
     }
 };
 
+struct DebugAndTagged : public Tagged, protected HighWatermark, protected Debug {
+    DebugAndTagged() noexcept = default;
+    DebugAndTagged(const char* name, void* base, size_t size) noexcept
+            : Tagged(name, base, size), HighWatermark(name, base, size), Debug(name, base, size) { }
+    void setCounter(MemoryCounter* counter) noexcept {
+        // the allocations made before the counter is set wouldn't be accounted
+        assert(!HighWatermark::mCurrent);
+        Tagged::setCounter(counter);
+    }
+    void onAlloc(void* p, size_t size, size_t alignment, size_t extra) noexcept {
+        Tagged::onAlloc(p, size, alignment, extra);
+        HighWatermark::onAlloc(p, size, alignment, extra);
+        Debug::onAlloc(p, size, alignment, extra);
+    }
+    void onFree(void* p, size_t size) noexcept {
+        Tagged::onFree(p, size);
+        HighWatermark::onFree(p, size);
+        Debug::onFree(p, size);
+    }
+};
+
 } // namespace TrackingPolicy
 
 // ------------------------------------------------------------------------------------------------
@@ -532,6 +775,15 @@ public:
               mArenaName(name) {
     }
 
+    // construct an arena whose memory area is allocated with the given backing
+    template<typename ... ARGS>
+    Arena(const char* name, size_t size, MemoryBacking backing, ARGS&& ... args)
+            : mArea(size, backing),
+              mAllocator(mArea, std::forward<ARGS>(args) ... ),
+              mListener(name, mArea.data(), size),
+              mArenaName(name) {
+    }
+
     // allocate memory from arena with given size and alignment
     // (acceptable size/alignment may depend on the allocator provided)
     void* alloc(size_t size, size_t alignment = alignof(std::max_align_t), size_t extra = 0) noexcept {
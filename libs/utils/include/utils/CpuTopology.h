@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_UTILS_CPUTOPOLOGY_H
+#define TNT_UTILS_CPUTOPOLOGY_H
+
+#include <utils/compiler.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace utils {
+
+/*
+ * Describes the logical CPUs of the system and how they share resources, JobSystem uses this
+ * to place its threads.
+ *
+ * On Linux, this is read from sysfs. On other systems, all CPUs are assumed to be identical
+ * and to share their caches.
+ */
+class CpuTopology {
+public:
+    struct Cpu {
+        uint32_t id;            // logical CPU number, as used by sched_setaffinity()
+        uint32_t core;          // lowest logical CPU of this CPU's physical core
+        uint32_t cacheDomain;   // lowest logical CPU sharing this CPU's last level cache
+        uint32_t node;          // NUMA node
+        uint32_t capacity;      // relative performance, 1024 for the fastest CPUs
+    };
+
+    enum class AffinityPolicy : uint8_t {
+        NONE,           // threads are not pinned to CPUs
+        COMPACT,        // threads use as few cache domains (e.g. L3) and NUMA nodes as possible
+        SPREAD,         // threads are distributed evenly across cache domains and NUMA nodes
+        PERFORMANCE,    // like COMPACT, but only on the CPUs with the highest capacity
+    };
+
+    CpuTopology() noexcept = default;
+
+    // the CPUs can be in any order
+    explicit CpuTopology(std::vector<Cpu> cpus) noexcept;
+
+    // Reads the topology of the online CPUs, 'root' is sysfs' cpu directory.
+    static CpuTopology load(const char* root = "/sys/devices/system/cpu") noexcept;
+
+    // sorted by id
+    std::vector<Cpu> const& getCpus() const noexcept { return mCpus; }
+
+    size_t getCpuCount() const noexcept { return mCpus.size(); }
+
+    // number of CPUs with the highest capacity
+    size_t getPerformanceCpuCount() const noexcept;
+
+    /*
+     * Returns the CPUs 'count' threads should be pinned to with the given policy. Physical
+     * cores are used before their SMT siblings. CPUs sharing a cache domain are contiguous in
+     * the returned list, which has less than 'count' entries if there are not enough CPUs,
+     * and none with AffinityPolicy::NONE.
+     */
+    std::vector<Cpu> selectCpus(AffinityPolicy policy, size_t count) const noexcept;
+
+private:
+    std::vector<Cpu> mCpus;
+};
+
+} // namespace utils
+
+#endif // TNT_UTILS_CPUTOPOLOGY_H
@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_UTILS_JOBCOROUTINE_H
+#define TNT_UTILS_JOBCOROUTINE_H
+
+#include <utils/compiler.h>
+#include <utils/JobSystem.h>
+#include <utils/Panic.h>
+
+// C++20 coroutines are only available with a recent enough compiler and standard library
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#   if __has_include(<coroutine>)
+#       define UTILS_HAS_COROUTINES 1
+#   endif
+#endif
+#ifndef UTILS_HAS_COROUTINES
+#   define UTILS_HAS_COROUTINES 0
+#endif
+
+#if UTILS_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace utils {
+namespace jobs {
+
+/*
+ * Coroutines running on a JobSystem.
+ *
+ *  jobs::Task<Image*> decode(JobSystem& js, Blob blob) {
+ *      co_await jobs::schedule(js);        // continue on a worker thread
+ *      Image* image = ...;
+ *      co_return image;
+ *  }
+ *
+ *  jobs::Task<> load(JobSystem& js, Blob a, Blob b) {
+ *      Task<Image*> ta = decode(js, a);
+ *      Task<Image*> tb = decode(js, b);
+ *      Image* ia = co_await ta;            // a Task starts when it's awaited
+ *      Image* ib = co_await tb;
+ *      co_await jobs::completion(js, js.runAndRetain(js.createJob(...)));
+ *  }
+ *
+ *  jobs::sync_wait(js, load(js, a, b));    // the calling thread executes jobs until it's done
+ *
+ * A coroutine is resumed by the thread that completes what it awaits, which is always a thread
+ * owned by the JobSystem, so coroutines must not assume they stay on a given thread.
+ * Exceptions are not supported, an exception escaping a Task terminates the program.
+ */
+
+template<typename T = void>
+class Task;
+
+namespace details {
+
+struct PromiseBase {
+    // when the task finishes, it either resumes the coroutine that awaited it, or finishes the
+    // latch job of sync_wait().
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template<typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            PromiseBase& promise = h.promise();
+            if (promise.latch) {
+                // this must be the last access to the coroutine, which can be destroyed as soon
+                // as the latch is finished.
+                JobSystem::Job* latch = promise.latch;
+                promise.js->cancel(latch);
+                return std::noop_coroutine();
+            }
+            return promise.continuation ? promise.continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() const noexcept { std::terminate(); }
+
+    std::coroutine_handle<> continuation;
+    JobSystem* js = nullptr;
+    JobSystem::Job* latch = nullptr;
+};
+
+template<typename T>
+struct Promise : public PromiseBase {
+    template<typename V>
+    void return_value(V&& value) noexcept(std::is_nothrow_constructible<T, V&&>::value) {
+        result.emplace(std::forward<V>(value));
+    }
+    T take() noexcept { return std::move(*result); }
+    std::optional<T> result;
+};
+
+template<>
+struct Promise<void> : public PromiseBase {
+    void return_void() const noexcept { }
+    void take() const noexcept { }
+};
+
+} // namespace details
+
+/*
+ * The return type of coroutines. A Task is lazy: it only starts when it's awaited or passed to
+ * sync_wait(), and it owns the coroutine's frame.
+ */
+template<typename T>
+class Task {
+public:
+    struct promise_type : public details::Promise<T> {
+        Task get_return_object() noexcept {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    Task() noexcept = default;
+
+    Task(Task&& rhs) noexcept : mHandle(std::exchange(rhs.mHandle, nullptr)) { }
+
+    Task& operator=(Task&& rhs) noexcept {
+        if (this != &rhs) {
+            destroy();
+            mHandle = std::exchange(rhs.mHandle, nullptr);
+        }
+        return *this;
+    }
+
+    Task(Task const&) = delete;
+    Task& operator=(Task const&) = delete;
+
+    ~Task() noexcept { destroy(); }
+
+    bool isDone() const noexcept { return !mHandle || mHandle.done(); }
+
+    bool await_ready() const noexcept { return isDone(); }
+
+    // starts the task on this thread, the awaiting coroutine is resumed when it finishes
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        mHandle.promise().continuation = awaiter;
+        return mHandle;
+    }
+
+    T await_resume() noexcept { return mHandle.promise().take(); }
+
+private:
+    template<typename U>
+    friend U sync_wait(JobSystem& js, Task<U>&& task) noexcept;
+
+    explicit Task(std::coroutine_handle<promise_type> h) noexcept : mHandle(h) { }
+
+    void destroy() noexcept {
+        if (mHandle) {
+            mHandle.destroy();
+            mHandle = nullptr;
+        }
+    }
+
+    std::coroutine_handle<promise_type> mHandle;
+};
+
+/*
+ * Suspends the coroutine and resumes it in a new job, i.e. potentially on another thread.
+ * Like JobSystem::run(), this must be awaited from a thread owned by the JobSystem. If no job
+ * can be created, the coroutine just continues on the current thread.
+ */
+class ScheduleAwaiter {
+public:
+    ScheduleAwaiter(JobSystem& js, JobSystem::Job* parent, uint32_t flags) noexcept
+            : mJobSystem(js), mParent(parent), mFlags(flags) { }
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) noexcept {
+        JobSystem::Job* job = mJobSystem.createJob(mParent, [h](JobSystem&, JobSystem::Job*) {
+            h.resume();
+        });
+        if (UTILS_UNLIKELY(!job)) {
+            return false;
+        }
+        mJobSystem.run(job, mFlags);
+        return true;
+    }
+
+    void await_resume() const noexcept { }
+
+private:
+    JobSystem& mJobSystem;
+    JobSystem::Job* mParent;
+    uint32_t mFlags;
+};
+
+inline ScheduleAwaiter schedule(JobSystem& js,
+        JobSystem::Job* parent = nullptr, uint32_t flags = 0) noexcept {
+    return { js, parent, flags };
+}
+
+/*
+ * Suspends the coroutine until a job (and all its children) has finished. The job must have
+ * been obtained with JobSystem::runAndRetain() or JobSystem::retain(), it's released here.
+ *
+ * No thread waits on the job, the coroutine is resumed by a continuation job that runs when
+ * it finishes (see JobSystem::runOnCompletion()). If the job has already finished, the
+ * coroutine just continues on the current thread.
+ */
+class CompletionAwaiter {
+public:
+    CompletionAwaiter(JobSystem& js, JobSystem::Job* job) noexcept
+            : mJobSystem(js), mJob(job) { }
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) noexcept {
+        // the coroutine (and this awaiter) can be destroyed as soon as the continuation is
+        // registered, so we can't access our members after that.
+        JobSystem& js = mJobSystem;
+        JobSystem::Job* awaited = mJob;
+        JobSystem::Job* continuation = js.createJob(nullptr, [h](JobSystem&, JobSystem::Job*) {
+            h.resume();
+        });
+        if (UTILS_UNLIKELY(!continuation)) {
+            js.waitAndRelease(awaited);
+            return false;
+        }
+        const bool suspended = js.runOnCompletion(awaited, continuation);
+        js.release(awaited);
+        if (!suspended) {
+            js.cancel(continuation);
+        }
+        return suspended;
+    }
+
+    void await_resume() const noexcept { }
+
+private:
+    JobSystem& mJobSystem;
+    JobSystem::Job* mJob;
+};
+
+inline CompletionAwaiter completion(JobSystem& js, JobSystem::Job* job) noexcept {
+    return { js, job };
+}
+
+/*
+ * Runs a task and waits for its result, the calling thread, which must be owned by the
+ * JobSystem, executes jobs while it waits.
+ */
+template<typename T>
+T sync_wait(JobSystem& js, Task<T>&& task) noexcept {
+    Task<T> t(std::move(task));
+    if (t.isDone()) {
+        return t.await_resume();
+    }
+
+    // 'done' can't finish before its child 'latch', which is finished by the task's final
+    // suspend point, see PromiseBase::FinalAwaiter.
+    JobSystem::Job* done = js.createJob();
+    ASSERT_POSTCONDITION(done, "sync_wait: couldn't create a job");
+    JobSystem::Job* latch = js.createJob(done);
+    ASSERT_POSTCONDITION(latch, "sync_wait: couldn't create a job");
+    done = js.runAndRetain(done);
+
+    auto& promise = t.mHandle.promise();
+    promise.js = &js;
+    promise.latch = latch;
+    t.mHandle.resume();
+
+    js.waitAndRelease(done);
+    return t.await_resume();
+}
+
+} // namespace jobs
+} // namespace utils
+
+#endif // UTILS_HAS_COROUTINES
+
+#endif // TNT_UTILS_JOBCOROUTINE_H
@@ -20,16 +20,20 @@
 #include <assert.h>
 
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <thread>
 #include <vector>
 
 #include <utils/Allocator.h>
 #include <utils/architecture.h>
 #include <utils/Condition.h>
+#include <utils/CpuTopology.h>
 #include <utils/Log.h>
 #include <utils/memalign.h>
 #include <utils/Mutex.h>
+#include <utils/ostream.h>
 #include <utils/Slice.h>
 #include <utils/ThreadLocal.h>
 #include <utils/WorkStealingDequeue.h>
@@ -37,15 +41,48 @@
 namespace utils {
 
 class JobSystem {
-    static constexpr size_t MAX_JOB_COUNT = 4096;
-    static_assert(MAX_JOB_COUNT <= 0x7FFE, "MAX_JOB_COUNT must be <= 0x7FFE");
-    using WorkQueue = WorkStealingDequeue<uint16_t, MAX_JOB_COUNT>;
+    // Jobs are allocated in pages of JOB_PAGE_SIZE jobs, which are added as needed. Jobs are
+    // identified by a 32-bits index made of the page and the job's slot in the page.
+    // Pages are aligned to their size, and their first slot holds a JobPageHeader, so that we
+    // can find the index of a job from its address (and 0 is never a valid index). The parent
+    // of each job is stored after the jobs of the page, so that a Job fits in a cache-line.
+    static constexpr size_t JOB_PAGE_SHIFT = 12;
+    static constexpr size_t JOB_PAGE_SIZE = 1u << JOB_PAGE_SHIFT;
+    // This only sizes the table of pages (32 KiB on 64-bits systems), which allows 16M jobs,
+    // i.e. 1 GiB of jobs.
+    static constexpr size_t MAX_JOB_PAGE_COUNT = 1u << 12u;
+    static constexpr size_t MAX_JOB_COUNT = (JOB_PAGE_SIZE - 1) * MAX_JOB_PAGE_COUNT;
+    static_assert(uint64_t(JOB_PAGE_SIZE) * MAX_JOB_PAGE_COUNT <= 0x100000000u,
+            "job indices must fit in 32 bits");
+    // a job can't have more children than there are jobs, so this guarantees that
+    // Job::runningJobCount doesn't overflow.
+    static_assert(MAX_JOB_COUNT < 0xFFFFFFFF, "MAX_JOB_COUNT must be < 0xFFFFFFFF");
+
+    // Size of each thread's work queues, run() spills the jobs that don't fit to a shared
+    // (and slower) queue.
+    static constexpr size_t WORK_QUEUE_SIZE = 4096;
+    using WorkQueue = WorkStealingDequeue<uint32_t, WORK_QUEUE_SIZE>;
 
 public:
     class Job;
 
     using JobFunc = void(*)(void*, JobSystem&, Job*);
 
+    /*
+     * Jobs are scheduled in priority lanes. Threads always pick CRITICAL jobs (e.g. the work
+     * needed to produce the current frame) before BACKGROUND jobs (e.g. texture decoding), and
+     * threads waiting on a CRITICAL job never execute BACKGROUND jobs while they wait.
+     *
+     * A job is in the lane of its parent, or CRITICAL if it doesn't have one, unless it's run
+     * with the BACKGROUND flag. Jobs inherit the lane when they're created, so the children of
+     * a BACKGROUND job should be created after it's run, typically by the job itself.
+     */
+    enum class Lane : uint8_t {
+        CRITICAL,
+        BACKGROUND
+    };
+    static constexpr size_t LANE_COUNT = 2;
+
     class alignas(CACHELINE_SIZE) Job {
     public:
         Job() noexcept {} /* = default; */ /* clang bug */ // NOLINT(modernize-use-equals-default,cppcoreguidelines-pro-type-member-init)
@@ -67,14 +104,23 @@ public:
                                                                 // v7 | v8
         void* storage[JOB_STORAGE_SIZE_WORDS];                  // 48 | 48
         JobFunc function;                                       //  4 |  8
-        uint16_t parent;                                        //  2 |  2
-        std::atomic<uint16_t> runningJobCount = { 1 };          //  2 |  2
+        std::atomic<uint32_t> runningJobCount = { 1 };          //  4 |  4
         mutable std::atomic<uint16_t> refCount = { 1 };         //  2 |  2
-                                                                //  6 |  2 (padding)
+        Lane lane = Lane::CRITICAL;                             //  1 |  1
+        uint8_t name = 0;                                       //  1 |  1 (0 if none)
+                                                                //  4 |  0 (padding)
                                                                 // 64 | 64
     };
 
-    explicit JobSystem(size_t threadCount = 0, size_t adoptableThreadsCount = 1) noexcept;
+    /*
+     * How the worker threads are pinned to CPUs, see CpuTopology::AffinityPolicy.
+     * Workers try to steal jobs from the workers sharing their last level cache first.
+     * With PERFORMANCE, the default thread count is limited to the number of fastest CPUs.
+     */
+    using AffinityPolicy = CpuTopology::AffinityPolicy;
+
+    explicit JobSystem(size_t threadCount = 0, size_t adoptableThreadsCount = 1,
+            AffinityPolicy affinityPolicy = AffinityPolicy::COMPACT) noexcept;
 
     ~JobSystem();
 
@@ -249,8 +295,11 @@ public:
      * Current thread must be owned by JobSystem's thread pool. See adopt().
      *
      * The job can't be used after this call.
+     *
+     * DONT_SIGNAL: don't wake-up other threads, the job will likely run on this thread
+     * BACKGROUND:  run the job (and the children it creates) in the BACKGROUND lane
      */
-    enum runFlags { DONT_SIGNAL = 0x1 };
+    enum runFlags { DONT_SIGNAL = 0x1, BACKGROUND = 0x2 };
     void run(Job*& job, uint32_t flags = 0) noexcept;
     void run(Job*&& job, uint32_t flags = 0) noexcept { // allows run(createJob(...));
         Job* p = job;
@@ -289,6 +338,16 @@ public:
         runAndWait(p);
     }
 
+    /*
+     * Runs 'continuation' when 'job' (and all its children) has finished, from the thread that
+     * finishes it, instead of waiting on 'job'. A job can have only one continuation.
+     *
+     * 'job' must be retained (see runAndRetain() or retain()) and 'continuation' must not have
+     * been run yet. Returns false if 'job' has already finished, in which case 'continuation'
+     * is left untouched, and must be run or cancelled by the caller.
+     */
+    bool runOnCompletion(Job* job, Job*& continuation) noexcept;
+
     // for debugging
     friend utils::io::ostream& operator << (utils::io::ostream& out, JobSystem const& js);
 
@@ -311,6 +370,72 @@ public:
         return mParallelSplitCount;
     }
 
+    // Instrumentation
+
+    // number of jobs that can currently exist without allocating more storage
+    size_t getJobCapacity() const noexcept {
+        return mJobPageCount.load(std::memory_order_relaxed) * (JOB_PAGE_SIZE - 1);
+    }
+
+    // number of times a job couldn't be created because the maximum number of jobs was reached
+    uint32_t getJobExhaustedCount() const noexcept {
+        return mJobExhaustedCount.load(std::memory_order_relaxed);
+    }
+
+    // number of times run() spilled a job to the shared queue because the work queue was full
+    uint32_t getWorkQueueFullCount() const noexcept {
+        return mWorkQueueFullCount.load(std::memory_order_relaxed);
+    }
+
+    /*
+     * Statistics of a thread of the pool. They're always collected, each thread only updates
+     * its own counters, which are never contended. Times are in nanoseconds.
+     */
+    struct ThreadStats {
+        uint32_t jobCount;              // number of jobs executed
+        uint32_t stealAttemptCount;     // number of attempts at stealing a job
+        uint32_t stealCount;            // number of jobs stolen from another thread
+        uint32_t wakeUpCount;           // number of times the thread waited for work
+        uint64_t idleTime;              // time spent waiting for work
+        uint64_t longestJobTime;        // duration of the longest job, only set while profiling
+    };
+
+    // Number of threads statistics are kept for: the worker threads, then the adoptable threads.
+    size_t getThreadCount() const noexcept { return mThreadStates.size(); }
+
+    ThreadStats getThreadStats(size_t thread) const noexcept;
+
+    void resetThreadStats() noexcept;
+
+    /*
+     * Names a job (and its children that are created afterwards) in traces. 'name' must
+     * outlive the JobSystem, typically it's a string literal. Up to MAX_JOB_NAME_COUNT - 1
+     * distinct names can be used, other names are ignored.
+     */
+    static constexpr size_t MAX_JOB_NAME_COUNT = 256;
+    void setJobName(Job* job, const char* name) noexcept;
+
+    /*
+     * While profiling, jobs are timed and the last 'eventCapacity' jobs executed by each
+     * thread are recorded, see exportTrace().
+     * This can be called while jobs are running, previously recorded events are discarded (each
+     * thread does it before it records its next job).
+     */
+    void startProfiling(size_t eventCapacity = 4096) noexcept;
+
+    void stopProfiling() noexcept;
+
+    bool isProfiling() const noexcept {
+        return mProfiling.load(std::memory_order_relaxed);
+    }
+
+    /*
+     * Writes the recorded jobs in the Chrome trace event format (JSON), which can be opened
+     * with chrome://tracing or Perfetto. Jobs that finish while this is called may be missing,
+     * and so may the oldest events of a thread, if it records new ones in the meantime.
+     */
+    void exportTrace(io::ostream& out) const noexcept;
+
 private:
     // this is just to avoid using std::default_random_engine, since we're in a public header.
     class default_random_engine {
@@ -325,9 +450,17 @@ private:
         }
     };
 
+    // events are written by the thread that executed the job while exportTrace() reads them,
+    // the sequence counts of ThreadState allow it to detect the events that could be torn.
+    struct TraceEvent {
+        std::atomic<uint64_t> begin;
+        std::atomic<uint64_t> end;
+        std::atomic<uint8_t> name;
+    };
+
     struct alignas(CACHELINE_SIZE) ThreadState {    // this causes 40-bytes padding
-        // make sure storage is cache-line aligned
-        WorkQueue workQueue;
+        // make sure storage is cache-line aligned, one queue per lane
+        WorkQueue workQueues[LANE_COUNT];
 
         // these are not accessed by the worker threads
         alignas(CACHELINE_SIZE)     // this causes 56-bytes padding
@@ -335,6 +468,26 @@ private:
         std::thread thread;
         default_random_engine rndGen;
         uint32_t id;
+        int32_t cpu = -1;               // CPU this thread is pinned to, or -1
+        uint16_t nearFirst = 0;         // the threads sharing our last level cache...
+        uint16_t nearCount = 0;         // ...including us
+
+        // statistics, only written by the thread owning this state
+        std::atomic<uint32_t> jobCount = { 0 };
+        std::atomic<uint32_t> stealAttemptCount = { 0 };
+        std::atomic<uint32_t> stealCount = { 0 };
+        std::atomic<uint32_t> wakeUpCount = { 0 };
+        std::atomic<uint64_t> idleTime = { 0 };
+        std::atomic<uint64_t> longestJobTime = { 0 };
+
+        // ring buffer of the last jobs executed while profiling, only (re)allocated by the
+        // thread owning this state, with eventLock held.
+        mutable utils::Mutex eventLock;
+        std::unique_ptr<TraceEvent[]> events;
+        uint32_t eventCapacity = 0;
+        uint32_t profilingGeneration = 0;           // startProfiling() call events belong to
+        std::atomic<uint32_t> eventWriteCount = { 0 };  // number of events started
+        std::atomic<uint32_t> eventCount = { 0 };       // number of events recorded
     };
 
     static_assert(sizeof(ThreadState) % CACHELINE_SIZE == 0,
@@ -342,50 +495,136 @@ private:
 
     static ThreadState& getState() noexcept;
 
+    struct alignas(CACHELINE_SIZE) JobPageHeader {
+        uint32_t page;
+    };
+    static_assert(sizeof(JobPageHeader) == sizeof(Job), "JobPageHeader must fill one Job slot");
+
+    // a page is JOB_PAGE_SIZE jobs followed by their parents, then their continuations
+    static constexpr size_t JOB_PAGE_BYTES = JOB_PAGE_SIZE * sizeof(Job);
+    static constexpr size_t JOB_PAGE_ALLOCATION_BYTES =
+            JOB_PAGE_BYTES + JOB_PAGE_SIZE * (sizeof(uint32_t) + sizeof(std::atomic<uint32_t>));
+
+    // continuation of a job that has finished, this is never a valid job index
+    static constexpr uint32_t JOB_FINISHED = 0xFFFFFFFFu;
+    static_assert(MAX_JOB_PAGE_COUNT << JOB_PAGE_SHIFT <= JOB_FINISHED,
+            "JOB_FINISHED must not be a valid job index");
+
+    Job* getJob(uint32_t index) const noexcept {
+        assert(index && (index >> JOB_PAGE_SHIFT) < MAX_JOB_PAGE_COUNT);
+        return mJobPages[index >> JOB_PAGE_SHIFT] + (index & (JOB_PAGE_SIZE - 1));
+    }
+
+    static uint32_t getJobIndex(Job const* job) noexcept {
+        uintptr_t const p = uintptr_t(job);
+        uintptr_t const base = p & ~uintptr_t(JOB_PAGE_BYTES - 1);
+        uint32_t const page = reinterpret_cast<JobPageHeader const*>(base)->page;
+        return (page << JOB_PAGE_SHIFT) | uint32_t((p - base) / sizeof(Job));
+    }
+
+    // index of the job's parent, 0 if none
+    static uint32_t& getParent(Job const* job) noexcept {
+        uintptr_t const p = uintptr_t(job);
+        uintptr_t const base = p & ~uintptr_t(JOB_PAGE_BYTES - 1);
+        uint32_t* const parents = reinterpret_cast<uint32_t*>(base + JOB_PAGE_BYTES);
+        return parents[(p - base) / sizeof(Job)];
+    }
+
+    // index of the job to run when the job finishes, 0 if none, or JOB_FINISHED
+    static std::atomic<uint32_t>& getContinuation(Job const* job) noexcept {
+        uintptr_t const p = uintptr_t(job);
+        uintptr_t const base = p & ~uintptr_t(JOB_PAGE_BYTES - 1);
+        auto* const continuations = reinterpret_cast<std::atomic<uint32_t>*>(
+                base + JOB_PAGE_BYTES + JOB_PAGE_SIZE * sizeof(uint32_t));
+        return continuations[(p - base) / sizeof(Job)];
+    }
+
+    // free jobs are linked through their (unused) storage
+    static std::atomic<uint32_t>& getNextFreeJob(Job* job) noexcept {
+        return *reinterpret_cast<std::atomic<uint32_t>*>(job->storage);
+    }
+
     void incRef(Job const* job) noexcept;
     void decRef(Job const* job) noexcept;
 
     Job* allocateJob() noexcept;
+    void freeJob(Job* job) noexcept;
+    uint32_t popFreeJob() noexcept;
+    void pushFreeJobs(uint32_t first, Job* last) noexcept;
+    bool addJobPage() noexcept;
     JobSystem::ThreadState* getStateToStealFrom(JobSystem::ThreadState& state) noexcept;
     bool hasJobCompleted(Job const* job) noexcept;
 
     void requestExit() noexcept;
     bool exitRequested() const noexcept;
     bool hasActiveJobs() const noexcept;
+    bool hasActiveJobs(Lane lane) const noexcept;
 
     void loop(ThreadState* state) noexcept;
-    bool execute(JobSystem::ThreadState& state) noexcept;
-    Job* steal(JobSystem::ThreadState& state) noexcept;
+    // executes one job, BACKGROUND jobs are only considered if allowBackground is true and
+    // there are no CRITICAL jobs.
+    bool execute(JobSystem::ThreadState& state, bool allowBackground = true) noexcept;
+    Job* steal(JobSystem::ThreadState& state, Lane lane) noexcept;
     void finish(Job* job) noexcept;
+    void record(ThreadState& state, uint8_t name, uint64_t begin, uint64_t end) noexcept;
 
     void put(WorkQueue& workQueue, Job* job) noexcept {
-        size_t index = job - mJobStorageBase;
-        assert(index >= 0 && index < MAX_JOB_COUNT);
-        workQueue.push(uint16_t(index + 1));
+        workQueue.push(getJobIndex(job));
     }
 
     Job* pop(WorkQueue& workQueue) noexcept {
-        size_t index = workQueue.pop();
-        assert(index <= MAX_JOB_COUNT);
-        return !index ? nullptr : &mJobStorageBase[index - 1];
+        uint32_t index = workQueue.pop();
+        return !index ? nullptr : getJob(index);
     }
 
     Job* steal(WorkQueue& workQueue) noexcept {
-        size_t index = workQueue.steal();
-        assert(index <= MAX_JOB_COUNT);
-        return !index ? nullptr : &mJobStorageBase[index - 1];
+        uint32_t index = workQueue.steal();
+        return !index ? nullptr : getJob(index);
     }
 
-    void wait(std::unique_lock<Mutex>& lock) noexcept;
+    void spill(Lane lane, Job* job) noexcept;
+    Job* unspill(Lane lane) noexcept;
+
+    void wait(std::unique_lock<Mutex>& lock, ThreadState& state) noexcept;
     void wake() noexcept;
 
+    // nanoseconds since the JobSystem was created
+    uint64_t now() const noexcept;
+
+    // only called by the thread owning 'counter'
+    template<typename T>
+    static void increment(std::atomic<T>& counter, T value = 1) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    const char* getJobName(uint8_t name) const noexcept {
+        return name ? mJobNames[name] : "job";
+    }
+
     // these have thread contention, keep them together
     utils::Mutex mWaiterLock;
     utils::Condition mWaiterCondition;
     uint32_t mWaiterCount = 0;
 
-    std::atomic<uint32_t> mActiveJobs = { 0 };
-    utils::Arena<utils::ThreadSafeObjectPoolAllocator<Job>, LockingPolicy::NoLock> mJobPool;
+    std::atomic<uint32_t> mActiveJobs[LANE_COUNT] = {};   // queued jobs, per lane
+    std::atomic<uint64_t> mFreeJobs = { 0 };    // free list head: tag << 32 | index
+    std::atomic<uint32_t> mJobExhaustedCount = { 0 };
+    std::atomic<uint32_t> mWorkQueueFullCount = { 0 };
+    std::atomic<bool> mProfiling = { false };
+
+    // only used when adding a page
+    utils::Mutex mJobPageLock;
+    std::atomic<uint32_t> mJobPageCount = { 0 };
+
+    // jobs that didn't fit in the work queue of the thread that ran them, per lane
+    utils::Mutex mSpilledJobLock;
+    std::vector<uint32_t> mSpilledJobs[LANE_COUNT];
+    std::atomic<uint32_t> mSpilledJobCount[LANE_COUNT] = {};
+
+    // names are only ever added, a name is written before the count is incremented
+    utils::Mutex mJobNameLock;
+    std::atomic<uint32_t> mJobNameCount = { 1 };
+    const char* mJobNames[MAX_JOB_NAME_COUNT] = {};
 
     template <typename T>
     using aligned_vector = std::vector<T, utils::STLAlignedAllocator<T>>;
@@ -400,10 +639,13 @@ private:
     aligned_vector<ThreadState> mThreadStates;          // actual data is stored offline
     std::atomic<bool> mExitRequested = { false };       // this one is almost never written
     std::atomic<uint16_t> mAdoptedThreads = { 0 };      // this one is almost never written
-    Job* const mJobStorageBase;                         // Base for conversion to indices
+    std::unique_ptr<Job*[]> mJobPages{ new Job*[MAX_JOB_PAGE_COUNT]() }; // written before use
     uint16_t mThreadCount = 0;                          // total # of threads in the pool
     uint8_t mParallelSplitCount = 0;                    // # of split allowable in parallel_for
     Job* mMasterJob = nullptr;
+    std::atomic<uint32_t> mEventCapacity = { 0 };       // per thread, set by startProfiling()
+    std::atomic<uint32_t> mProfilingGeneration = { 0 }; // incremented by startProfiling()
+    std::chrono::steady_clock::time_point mEpoch;
 
     static UTILS_DECLARE_TLS(ThreadState *) sThreadState;
 };
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_UTILS_PARALLELALGORITHMS_H
+#define TNT_UTILS_PARALLELALGORITHMS_H
+
+#include <utils/compiler.h>
+#include <utils/JobSystem.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace utils {
+namespace jobs {
+
+/*
+ * Parallel versions of some of the <algorithm> and <numeric> algorithms.
+ *
+ * The input is split in at most MAX_BLOCK_COUNT blocks of at least MIN_BLOCK_SIZE items, each
+ * block is processed by a separate job, and the calling thread waits (executing jobs) until
+ * the result is available. Small inputs are processed on the calling thread.
+ *
+ * The blocks only depend on the size of the input, so the results are deterministic, even for
+ * operations that aren't exactly associative, like floating-point additions.
+ */
+
+namespace details {
+
+static constexpr size_t MIN_BLOCK_SIZE = 4096;
+static constexpr size_t MAX_BLOCK_COUNT = 32;
+
+class Blocks {
+public:
+    explicit Blocks(size_t count) noexcept
+            : mCount(count),
+              mBlockCount(std::min(count / MIN_BLOCK_SIZE, MAX_BLOCK_COUNT)),
+              mBlockSize(mBlockCount ? (count + mBlockCount - 1) / mBlockCount : count) {
+    }
+
+    // when false, the work should just be done on the calling thread
+    bool isParallel() const noexcept { return mBlockCount >= 2; }
+
+    size_t size() const noexcept { return mBlockCount; }
+    size_t begin(size_t block) const noexcept { return std::min(block * mBlockSize, mCount); }
+    size_t end(size_t block) const noexcept { return begin(block + 1); }
+
+private:
+    size_t mCount;
+    size_t mBlockCount;
+    size_t mBlockSize;
+};
+
+// calls functor(i) for all i in [0, count) from multiple jobs, and waits for all of them
+template<typename F>
+void forEach(JobSystem& js, size_t count, F const& functor) noexcept {
+    auto f = [&functor](uint32_t s, uint32_t c) {
+        for (uint32_t i = s; i < s + c; i++) {
+            functor(i);
+        }
+    };
+    auto job = parallel_for(js, nullptr, 0, uint32_t(count), std::cref(f), CountSplitter<1, 8>());
+    js.runAndWait(job);
+}
+
+} // namespace details
+
+/*
+ * Returns init combined with all the items of [first, last) with op, which must be associative.
+ * Like std::reduce(), items can be combined in any order (but always the same for a given
+ * input size).
+ */
+template<typename Iterator, typename T, typename BinaryOp>
+T parallel_reduce(JobSystem& js, Iterator first, Iterator last, T init, BinaryOp op) noexcept {
+    const details::Blocks blocks(size_t(last - first));
+    if (!blocks.isParallel()) {
+        return std::accumulate(first, last, init, op);
+    }
+
+    // no block is empty, so each partial result starts with the block's first item
+    std::vector<T> partials(blocks.size(), init);
+    details::forEach(js, blocks.size(), [&](size_t j) {
+        Iterator it = first + blocks.begin(j);
+        partials[j] = std::accumulate(it + 1, first + blocks.end(j), T(*it), op);
+    });
+
+    return std::accumulate(partials.begin(), partials.end(), init, op);
+}
+
+template<typename Iterator, typename T>
+T parallel_reduce(JobSystem& js, Iterator first, Iterator last, T init) noexcept {
+    return parallel_reduce(js, first, last, init, std::plus<>());
+}
+
+/*
+ * Exclusive prefix scan: out[i] is init combined with first[0] ... first[i - 1] using op,
+ * which must be associative. 'out' can be the same as 'first'. Returns the end of the output.
+ */
+template<typename InputIterator, typename OutputIterator, typename T, typename BinaryOp>
+OutputIterator parallel_exclusive_scan(JobSystem& js, InputIterator first, InputIterator last,
+        OutputIterator out, T init, BinaryOp op) noexcept {
+    const size_t count = size_t(last - first);
+    const details::Blocks blocks(count);
+
+    auto scan = [first, out, &op](size_t begin, size_t end, T acc) {
+        for (size_t i = begin; i < end; i++) {
+            T v = first[i];     // out can alias first
+            out[i] = acc;
+            acc = op(acc, v);
+        }
+    };
+
+    if (!blocks.isParallel()) {
+        scan(0, count, init);
+        return out + count;
+    }
+
+    // first compute the sum of each block...
+    std::vector<T> offsets(blocks.size(), init);
+    details::forEach(js, blocks.size(), [&](size_t j) {
+        InputIterator it = first + blocks.begin(j);
+        offsets[j] = std::accumulate(it + 1, first + blocks.end(j), T(*it), op);
+    });
+
+    // ...turn them into the starting value of each block...
+    T sum = init;
+    for (T& offset : offsets) {
+        T v = offset;
+        offset = sum;
+        sum = op(sum, v);
+    }
+
+    // ...and finally scan the blocks independently
+    details::forEach(js, blocks.size(), [&](size_t j) {
+        scan(blocks.begin(j), blocks.end(j), offsets[j]);
+    });
+    return out + count;
+}
+
+template<typename InputIterator, typename OutputIterator, typename T>
+OutputIterator parallel_exclusive_scan(JobSystem& js, InputIterator first, InputIterator last,
+        OutputIterator out, T init) noexcept {
+    return parallel_exclusive_scan(js, first, last, out, init, std::plus<>());
+}
+
+/*
+ * Stable partition of [first, last): items for which pred() is true are moved before the
+ * others, and the relative order of the items is preserved. Returns the first item of the
+ * second group.
+ *
+ * scratch must point to an area at least as large as [first, last), its content is destroyed.
+ * Items are copied to and from the scratch area, so T should be cheap to copy.
+ */
+template<typename T, typename Predicate>
+T* parallel_partition(JobSystem& js, T* first, T* last, T* scratch, Predicate pred) noexcept {
+    const size_t count = size_t(last - first);
+    const details::Blocks blocks(count);
+
+    if (!blocks.isParallel()) {
+        T* t = first;
+        T* f = scratch;
+        for (size_t i = 0; i < count; i++) {
+            if (pred(first[i])) {
+                *t++ = first[i];
+            } else {
+                *f++ = first[i];
+            }
+        }
+        std::copy(scratch, f, t);
+        return t;
+    }
+
+    // count the items for which pred() is true, in each block
+    std::vector<size_t> offsets(blocks.size());
+    details::forEach(js, blocks.size(), [&](size_t j) {
+        offsets[j] = size_t(std::count_if(first + blocks.begin(j), first + blocks.end(j), pred));
+    });
+
+    size_t trueCount = 0;
+    for (size_t& offset : offsets) {
+        size_t n = offset;
+        offset = trueCount;
+        trueCount += n;
+    }
+
+    // each block knows where its items go, true items are preceded by the true items of the
+    // previous blocks, false items by all the true items and the false items of the
+    // previous blocks.
+    details::forEach(js, blocks.size(), [&](size_t j) {
+        const size_t begin = blocks.begin(j);
+        T* t = scratch + offsets[j];
+        T* f = scratch + trueCount + (begin - offsets[j]);
+        for (size_t i = begin, e = blocks.end(j); i < e; i++) {
+            if (pred(first[i])) {
+                *t++ = first[i];
+            } else {
+                *f++ = first[i];
+            }
+        }
+    });
+
+    details::forEach(js, blocks.size(), [&](size_t j) {
+        std::copy(scratch + blocks.begin(j), scratch + blocks.end(j), first + blocks.begin(j));
+    });
+
+    return first + trueCount;
+}
+
+/*
+ * Sorts [first, last) with comp. Each block is sorted with std::sort(), then the sorted blocks
+ * are merged pairwise, with each level of merges happening in parallel.
+ * Like std::sort(), the sort is not stable.
+ */
+template<typename Iterator, typename Compare>
+void parallel_sort(JobSystem& js, Iterator first, Iterator last, Compare comp) noexcept {
+    const details::Blocks blocks(size_t(last - first));
+    if (!blocks.isParallel()) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    details::forEach(js, blocks.size(), [&](size_t j) {
+        std::sort(first + blocks.begin(j), first + blocks.end(j), comp);
+    });
+
+    for (size_t width = 1; width < blocks.size(); width *= 2) {
+        const size_t mergeCount = (blocks.size() + 2 * width - 1) / (2 * width);
+        details::forEach(js, mergeCount, [&](size_t j) {
+            const size_t lo = 2 * j * width;
+            const size_t mid = std::min(lo + width, blocks.size());
+            const size_t hi = std::min(lo + 2 * width, blocks.size());
+            if (mid < hi) {
+                std::inplace_merge(first + blocks.begin(lo), first + blocks.begin(mid),
+                        first + blocks.begin(hi), comp);
+            }
+        });
+    }
+}
+
+template<typename Iterator>
+void parallel_sort(JobSystem& js, Iterator first, Iterator last) noexcept {
+    parallel_sort(js, first, last, std::less<>());
+}
+
+} // namespace jobs
+} // namespace utils
+
+#endif // TNT_UTILS_PARALLELALGORITHMS_H
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_UTILS_RADIXSORT_H
+#define TNT_UTILS_RADIXSORT_H
+
+#include <utils/compiler.h>
+#include <utils/JobSystem.h>
+
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace utils {
+
+/*
+ * Least-significant-digit radix sort of [first, last), by an unsigned integer key.
+ *
+ * - key(T const&) returns the sorting key of an item.
+ * - scratch must point to an area at least as large as [first, last), its content is destroyed.
+ * - keys are processed 8 bits at a time, but digits that are the same for all keys are skipped,
+ *   so that keys only using a few bits need only a few passes.
+ * - the sort is stable.
+ *
+ * Items are copied to and from the scratch area, so T should be cheap to copy.
+ */
+
+namespace details {
+
+static constexpr size_t RADIX_BITS = 8;
+static constexpr size_t RADIX_SIZE = 1u << RADIX_BITS;
+static constexpr size_t RADIX_MASK = RADIX_SIZE - 1;
+
+template<typename K>
+inline size_t radixDigit(K key, size_t digit) noexcept {
+    return size_t(key >> (digit * RADIX_BITS)) & RADIX_MASK;
+}
+
+// returns whether all keys have the same value for this digit, given the AND and the OR of
+// all the keys.
+template<typename K>
+inline bool isRadixDigitConstant(K andKeys, K orKeys, size_t digit) noexcept {
+    return radixDigit(K(andKeys ^ orKeys), digit) == 0;
+}
+
+} // namespace details
+
+template<typename T, typename KeyFunc>
+void radix_sort(T* first, T* last, T* scratch, KeyFunc key) noexcept {
+    using Key = typename std::decay<decltype(key(*first))>::type;
+    static_assert(std::is_unsigned<Key>::value, "radix_sort() keys must be unsigned integers");
+    constexpr size_t DIGITS = sizeof(Key);
+
+    const size_t count = size_t(last - first);
+    if (count < 2) {
+        return;
+    }
+
+    // the histogram of a digit doesn't depend on the order of the items, so we can compute
+    // them all at once.
+    uint32_t histograms[DIGITS][details::RADIX_SIZE] = {};
+    Key andKeys = ~Key(0);
+    Key orKeys = Key(0);
+    for (size_t i = 0; i < count; i++) {
+        const Key k = key(first[i]);
+        andKeys &= k;
+        orKeys |= k;
+        for (size_t d = 0; d < DIGITS; d++) {
+            histograms[d][details::radixDigit(k, d)]++;
+        }
+    }
+
+    T* src = first;
+    T* dst = scratch;
+    for (size_t d = 0; d < DIGITS; d++) {
+        if (details::isRadixDigitConstant(andKeys, orKeys, d)) {
+            continue;
+        }
+
+        uint32_t offsets[details::RADIX_SIZE];
+        uint32_t sum = 0;
+        for (size_t b = 0; b < details::RADIX_SIZE; b++) {
+            offsets[b] = sum;
+            sum += histograms[d][b];
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            dst[offsets[details::radixDigit(key(src[i]), d)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != first) {
+        std::copy(src, src + count, first);
+    }
+}
+
+namespace jobs {
+
+/*
+ * Parallel version of radix_sort(), the items are split in blocks processed by separate jobs.
+ * Each pass computes the histograms of each block, then each block scatters its items at the
+ * offsets computed from all the histograms, which keeps the sort stable.
+ * Small arrays are sorted on the calling thread with radix_sort().
+ */
+template<typename T, typename KeyFunc>
+void parallel_radix_sort(JobSystem& js, T* first, T* last, T* scratch, KeyFunc key) noexcept {
+    using Key = typename std::decay<decltype(key(*first))>::type;
+    static_assert(std::is_unsigned<Key>::value, "radix_sort() keys must be unsigned integers");
+    constexpr size_t DIGITS = sizeof(Key);
+    constexpr size_t MIN_BLOCK_SIZE = 4096;
+    constexpr size_t MAX_BLOCK_COUNT = 32;
+
+    const size_t count = size_t(last - first);
+    const size_t blockCount = std::min(count / MIN_BLOCK_SIZE, MAX_BLOCK_COUNT);
+    if (blockCount < 2) {
+        radix_sort(first, last, scratch, key);
+        return;
+    }
+    const size_t blockSize = (count + blockCount - 1) / blockCount;
+
+    struct Block {
+        uint32_t histogram[utils::details::RADIX_SIZE];
+        Key andKeys;
+        Key orKeys;
+    };
+    std::vector<Block> blocks(blockCount);
+
+    T* src = first;
+    T* dst = scratch;
+    size_t digit = 0;
+
+    auto run = [&js, blockCount](auto const& functor) {
+        auto job = parallel_for(js, nullptr, 0, uint32_t(blockCount),
+                std::cref(functor), CountSplitter<1, 8>());
+        js.runAndWait(job);
+    };
+
+    // first, find the digits that are the same for all keys
+    auto reduce = [&](uint32_t s, uint32_t c) {
+        for (size_t j = s; j < s + c; j++) {
+            Key andKeys = ~Key(0);
+            Key orKeys = Key(0);
+            for (size_t i = j * blockSize, e = std::min(i + blockSize, count); i < e; i++) {
+                const Key k = key(src[i]);
+                andKeys &= k;
+                orKeys |= k;
+            }
+            blocks[j].andKeys = andKeys;
+            blocks[j].orKeys = orKeys;
+        }
+    };
+    run(reduce);
+
+    Key andKeys = ~Key(0);
+    Key orKeys = Key(0);
+    for (Block const& block : blocks) {
+        andKeys &= block.andKeys;
+        orKeys |= block.orKeys;
+    }
+
+    auto histogram = [&](uint32_t s, uint32_t c) {
+        for (size_t j = s; j < s + c; j++) {
+            uint32_t* const UTILS_RESTRICT h = blocks[j].histogram;
+            std::fill_n(h, utils::details::RADIX_SIZE, 0);
+            for (size_t i = j * blockSize, e = std::min(i + blockSize, count); i < e; i++) {
+                h[utils::details::radixDigit(key(src[i]), digit)]++;
+            }
+        }
+    };
+
+    auto scatter = [&](uint32_t s, uint32_t c) {
+        for (size_t j = s; j < s + c; j++) {
+            // the histogram now contains this block's offsets for each digit value
+            uint32_t* const UTILS_RESTRICT offsets = blocks[j].histogram;
+            for (size_t i = j * blockSize, e = std::min(i + blockSize, count); i < e; i++) {
+                dst[offsets[utils::details::radixDigit(key(src[i]), digit)]++] = src[i];
+            }
+        }
+    };
+
+    for (digit = 0; digit < DIGITS; digit++) {
+        if (utils::details::isRadixDigitConstant(andKeys, orKeys, digit)) {
+            continue;
+        }
+
+        run(histogram);
+
+        // Compute where each block writes each digit value: all items with a smaller digit go
+        // first, then the items with the same digit from the previous blocks.
+        uint32_t sum = 0;
+        for (size_t b = 0; b < utils::details::RADIX_SIZE; b++) {
+            for (Block& block : blocks) {
+                const uint32_t n = block.histogram[b];
+                block.histogram[b] = sum;
+                sum += n;
+            }
+        }
+
+        run(scatter);
+        std::swap(src, dst);
+    }
+
+    if (src != first) {
+        auto copy = [&](uint32_t s, uint32_t c) {
+            const size_t begin = s * blockSize;
+            const size_t end = std::min((s + c) * blockSize, count);
+            std::copy(src + begin, src + end, first + begin);
+        };
+        run(copy);
+    }
+}
+
+} // namespace jobs
+} // namespace utils
+
+#endif // TNT_UTILS_RADIXSORT_H
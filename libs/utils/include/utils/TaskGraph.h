@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_UTILS_TASKGRAPH_H
+#define TNT_UTILS_TASKGRAPH_H
+
+#include <utils/compiler.h>
+#include <utils/JobSystem.h>
+#include <utils/Mutex.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+namespace utils {
+
+/*
+ * A directed acyclic graph of tasks executed by a JobSystem.
+ *
+ * Tasks are added with add(), dependencies are declared with precede() or then(), and tasks
+ * start when they're submitted with run() and all their predecessors have finished. Each task
+ * has a join counter, the last predecessor to finish schedules it, so no thread ever blocks
+ * waiting on a dependency.
+ *
+ * All tasks are children of a single job, whose JobSystem::Job::runningJobCount tracks the
+ * completion of the whole graph.
+ *
+ *  TaskGraph graph(js);
+ *  auto a = graph.add([]{ ... });
+ *  auto b = graph.add([]{ ... });
+ *  auto c = graph.then(a, []{ ... });      // c runs after a
+ *  graph.precede(b, c);                    // ...and after b
+ *  graph.run();                            // submits a, b and c
+ *  ...                                     // do something else
+ *  graph.wait(c);                          // wait for c (and therefore a and b)
+ *
+ * Tasks can be added after the graph has started running, but edges can only be added to
+ * tasks that have not been submitted yet.
+ *
+ * NOTE: All methods must be called from the same thread, which must be owned by the
+ * JobSystem's thread pool, tasks can't modify the graph.
+ */
+class TaskGraph {
+public:
+    using Task = uint32_t;
+
+    explicit TaskGraph(JobSystem& js, JobSystem::Job* parent = nullptr) noexcept;
+
+    // waits for all tasks, see wait()
+    ~TaskGraph();
+
+    TaskGraph(TaskGraph const& rhs) = delete;
+    TaskGraph& operator=(TaskGraph const& rhs) = delete;
+
+    // adds an empty task, which is useful to join several tasks
+    Task add() noexcept {
+        return create({});
+    }
+
+    // adds a task calling func(), it doesn't start until it's submitted with run()
+    template<typename F>
+    Task add(F&& func) noexcept {
+        return create(std::function<void()>(std::forward<F>(func)));
+    }
+
+    // 'after' will only start when 'before' has finished. 'after' must not be submitted yet.
+    void precede(Task before, Task after) noexcept;
+
+    // adds a task calling func() after 'before' has finished
+    template<typename F>
+    Task then(Task before, F&& func) noexcept {
+        Task task = add(std::forward<F>(func));
+        precede(before, task);
+        return task;
+    }
+
+    // names a task in JobSystem traces, it must not be submitted yet
+    void setName(Task task, const char* name) noexcept;
+
+    // submits a task, it starts as soon as all its predecessors have finished
+    void run(Task task) noexcept;
+
+    // submits all tasks that have not been submitted yet
+    void run() noexcept;
+
+    // Waits for a submitted task to finish, the calling thread executes jobs while it waits.
+    void wait(Task task) noexcept;
+
+    // Submits all remaining tasks and waits for all of them, the graph can't be used afterwards.
+    void wait() noexcept;
+
+    size_t getTaskCount() const noexcept { return mNodes.size(); }
+
+private:
+    struct Node {
+        std::function<void()> func;
+        std::vector<Node*> successors;          // protected by mLock
+        JobSystem::Job* job = nullptr;          // retained until waited on
+        std::atomic<uint32_t> pending = { 1 };  // unfinished predecessors + 1 until submitted
+        bool submitted = false;
+        bool done = false;                      // protected by mLock
+    };
+
+    Task create(std::function<void()> func) noexcept;
+    void execute(Node& node) noexcept;
+    void release(Node& node) noexcept;
+
+    JobSystem& mJobSystem;
+    JobSystem::Job* mRoot;
+    std::deque<Node> mNodes;    // a deque because the jobs hold pointers to the nodes
+    Mutex mLock;
+};
+
+} // namespace utils
+
+#endif // TNT_UTILS_TASKGRAPH_H
@@ -19,6 +19,11 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#if defined(__linux__)
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
 #include <algorithm>
 
 #include <utils/Log.h>
@@ -51,6 +56,225 @@ void LinearAllocator::swap(LinearAllocator& rhs) noexcept {
     std::swap(mCurrent, rhs.mCurrent);
 }
 
+// ------------------------------------------------------------------------------------------------
+// HeapArea
+// ------------------------------------------------------------------------------------------------
+
+#if defined(__linux__)
+
+// size of the huge pages we ask for, this is the common size on x86-64 and ARM64
+static constexpr size_t HUGE_PAGE_SIZE = 2u * 1024u * 1024u;
+
+// size of the mapping actually used for an allocation of 'size' bytes
+static size_t getMappingSize(size_t size, MemoryBacking backing) noexcept {
+    const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+    const size_t alignment = any(backing & MemoryBacking::HUGE_PAGES) ? HUGE_PAGE_SIZE : pageSize;
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+#endif
+
+void* HeapArea::allocate(size_t size, MemoryBacking backing) noexcept {
+#if defined(__linux__)
+    if (backing != MemoryBacking::DEFAULT) {
+        const size_t mappingSize = getMappingSize(size, backing);
+        const int populate = any(backing & MemoryBacking::PREFAULT) ? MAP_POPULATE : 0;
+        void* p = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+        if (any(backing & MemoryBacking::HUGE_PAGES)) {
+            // this only succeeds if the system has reserved huge pages
+            p = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | populate, -1, 0);
+        }
+#endif
+        if (p == MAP_FAILED) {
+            // otherwise, fall back to transparent huge pages
+            p = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                return nullptr;
+            }
+            advise(p, mappingSize, backing);
+        }
+        return p;
+    }
+#endif
+    return ::malloc(size);
+}
+
+void HeapArea::deallocate(void* p, size_t size, MemoryBacking backing) noexcept {
+#if defined(__linux__)
+    if (backing != MemoryBacking::DEFAULT) {
+        if (p) {
+            munmap(p, getMappingSize(size, backing));
+        }
+        return;
+    }
+#endif
+    ::free(p);
+}
+
+void HeapArea::advise(void* p, size_t size, MemoryBacking backing) noexcept {
+#if defined(__linux__)
+    // these are only hints, failures are ignored
+#if defined(MADV_HUGEPAGE)
+    if (any(backing & MemoryBacking::HUGE_PAGES)) {
+        madvise(p, size, MADV_HUGEPAGE);
+    }
+#endif
+    if (any(backing & MemoryBacking::PREFAULT)) {
+#if defined(MADV_POPULATE_WRITE)
+        if (madvise(p, size, MADV_POPULATE_WRITE) == 0) {
+            return;
+        }
+#endif
+        // touch every page, this is what MADV_POPULATE_WRITE does (Linux 5.14+)
+        const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+        for (size_t offset = 0; offset < size; offset += pageSize) {
+            static_cast<volatile char*>(p)[offset] = 0;
+        }
+    }
+#endif
+}
+
+// ------------------------------------------------------------------------------------------------
+// ChainedLinearAllocator
+// ------------------------------------------------------------------------------------------------
+
+ChainedLinearAllocator::ChainedLinearAllocator(void* begin, void* end, size_t blockSize,
+        MemoryBacking backing) noexcept
+    : mCurrent(begin), mEnd(end),
+      mCapacity(uintptr_t(end) - uintptr_t(begin)),
+      mBlockSize(blockSize ? blockSize : uintptr_t(end) - uintptr_t(begin)),
+      mBacking(backing),
+      mBlocks{{ begin, end }} {
+}
+
+ChainedLinearAllocator::ChainedLinearAllocator(ChainedLinearAllocator&& rhs) noexcept {
+    // class attributes have been initialized to default values
+    this->swap(rhs);
+}
+
+ChainedLinearAllocator& ChainedLinearAllocator::operator=(ChainedLinearAllocator&& rhs) noexcept {
+    if (this != &rhs) {
+        this->swap(rhs);
+    }
+    return *this;
+}
+
+ChainedLinearAllocator::~ChainedLinearAllocator() noexcept {
+    setMemoryCounter(nullptr);
+    for (size_t i = 1; i < mBlocks.size(); i++) {
+        HeapArea::deallocate(mBlocks[i].begin, mBlocks[i].size(), mBacking);
+    }
+}
+
+void ChainedLinearAllocator::swap(ChainedLinearAllocator& rhs) noexcept {
+    std::swap(mCurrent, rhs.mCurrent);
+    std::swap(mEnd, rhs.mEnd);
+    std::swap(mIndex, rhs.mIndex);
+    std::swap(mBase, rhs.mBase);
+    std::swap(mCapacity, rhs.mCapacity);
+    std::swap(mBlockSize, rhs.mBlockSize);
+    std::swap(mHighWatermark, rhs.mHighWatermark);
+    std::swap(mPeak, rhs.mPeak);
+    std::swap(mPreviousPeak, rhs.mPreviousPeak);
+    std::swap(mCycleCount, rhs.mCycleCount);
+    std::swap(mBacking, rhs.mBacking);
+    std::swap(mCounter, rhs.mCounter);
+    std::swap(mBlocks, rhs.mBlocks);
+}
+
+void ChainedLinearAllocator::setMemoryCounter(MemoryCounter* counter) noexcept {
+    if (mCounter) {
+        mCounter->remove(mCapacity);
+    }
+    mCounter = counter;
+    if (mCounter) {
+        mCounter->add(mCapacity);
+    }
+}
+
+void ChainedLinearAllocator::setBlock(size_t index, size_t base) noexcept {
+    mIndex = index;
+    mBase = base;
+    mCurrent = mBlocks[index].begin;
+    mEnd = mBlocks[index].end;
+}
+
+UTILS_NOINLINE
+void* ChainedLinearAllocator::allocFromNextBlock(
+        size_t size, size_t alignment, size_t extra) noexcept {
+    mHighWatermark = std::max(mHighWatermark, allocated());
+    mPeak = std::max(mPeak, allocated());
+
+    // this is the worst case size needed to satisfy this allocation in an empty block
+    const size_t needed = size + alignment - 1 + extra;
+    const size_t base = mBase + mBlocks[mIndex].size();
+    const size_t next = mIndex + 1;
+    if (next == mBlocks.size() || mBlocks[next].size() < needed) {
+        // no spare block or it's too small, insert a new one
+        const size_t blockSize = std::max(mBlockSize, needed);
+        void* const p = HeapArea::allocate(blockSize, mBacking);
+        if (UTILS_UNLIKELY(!p)) {
+            return nullptr;
+        }
+        mBlocks.insert(mBlocks.begin() + next, { p, pointermath::add(p, blockSize) });
+        mCapacity += blockSize;
+        if (mCounter) {
+            mCounter->add(blockSize);
+        }
+    }
+    setBlock(next, base);
+
+    void* const p = pointermath::align(mCurrent, alignment, extra);
+    mCurrent = pointermath::add(p, size);
+    assert(mCurrent <= mEnd);
+    return p;
+}
+
+void ChainedLinearAllocator::rewind(void* p) UTILS_RESTRICT noexcept {
+    mHighWatermark = std::max(mHighWatermark, allocated());
+    mPeak = std::max(mPeak, allocated());
+
+    // find the block p belongs to, it's usually the current one
+    size_t index = mIndex;
+    size_t base = mBase;
+    while (p < mBlocks[index].begin || p > mBlocks[index].end) {
+        assert(index > 0);
+        index--;
+        base -= mBlocks[index].size();
+    }
+    if (index != mIndex) {
+        setBlock(index, base);
+    }
+    mCurrent = p;
+
+    if (p == mBlocks[0].begin) {
+        trim();
+    }
+}
+
+void ChainedLinearAllocator::trim() noexcept {
+    if (++mCycleCount == TRIM_PERIOD) {
+        mCycleCount = 0;
+        mPreviousPeak = mPeak;
+        mPeak = 0;
+    }
+
+    // we can only get here when the allocator is empty, so all the blocks but the first are
+    // spare, we free the last ones until the capacity would drop below the recent peak.
+    const size_t peak = std::max(mPeak, mPreviousPeak);
+    while (mBlocks.size() > 1 && mCapacity - mBlocks.back().size() >= peak) {
+        mCapacity -= mBlocks.back().size();
+        if (mCounter) {
+            mCounter->remove(mBlocks.back().size());
+        }
+        HeapArea::deallocate(mBlocks.back().begin, mBlocks.back().size(), mBacking);
+        mBlocks.pop_back();
+    }
+}
+
 // ------------------------------------------------------------------------------------------------
 // FreeList
 // ------------------------------------------------------------------------------------------------
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/CpuTopology.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#    include <dirent.h>
+#endif
+
+namespace utils {
+
+static constexpr uint32_t MAX_CAPACITY = 1024;
+
+CpuTopology::CpuTopology(std::vector<Cpu> cpus) noexcept : mCpus(std::move(cpus)) {
+    std::sort(mCpus.begin(), mCpus.end(), [](Cpu const& lhs, Cpu const& rhs) {
+        return lhs.id < rhs.id;
+    });
+}
+
+#if defined(__linux__)
+
+// returns the first line of a file, or an empty string
+static std::string readLine(std::string const& path) noexcept {
+    std::string line;
+    FILE* file = fopen(path.c_str(), "r");
+    if (file) {
+        char buffer[256];
+        if (fgets(buffer, sizeof(buffer), file)) {
+            line = buffer;
+            while (!line.empty() && (line.back() == '\n' || line.back() == ' ')) {
+                line.pop_back();
+            }
+        }
+        fclose(file);
+    }
+    return line;
+}
+
+static uint32_t readUint(std::string const& path, uint32_t defaultValue) noexcept {
+    std::string const line = readLine(path);
+    return line.empty() ? defaultValue : uint32_t(strtoul(line.c_str(), nullptr, 10));
+}
+
+// parses a list of CPUs, e.g. "0-3,8,10-11"
+static std::vector<uint32_t> parseCpuList(std::string const& list) noexcept {
+    std::vector<uint32_t> cpus;
+    char const* p = list.c_str();
+    while (*p) {
+        char* end;
+        uint32_t const first = uint32_t(strtoul(p, &end, 10));
+        if (end == p) {
+            break;
+        }
+        uint32_t last = first;
+        p = end;
+        if (*p == '-') {
+            last = uint32_t(strtoul(p + 1, &end, 10));
+            p = end;
+        }
+        for (uint32_t cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return cpus;
+}
+
+static uint32_t firstCpuOf(std::string const& path, uint32_t defaultValue) noexcept {
+    std::vector<uint32_t> const cpus = parseCpuList(readLine(path));
+    return cpus.empty() ? defaultValue : *std::min_element(cpus.begin(), cpus.end());
+}
+
+CpuTopology CpuTopology::load(const char* root) noexcept {
+    std::string const base(root);
+    std::vector<uint32_t> const online = parseCpuList(readLine(base + "/online"));
+
+    std::vector<Cpu> cpus;
+    cpus.reserve(online.size());
+    uint32_t maxCapacity = 0;
+    for (uint32_t id : online) {
+        std::string const dir = base + "/cpu" + std::to_string(id);
+        Cpu cpu{ id, id, id, 0, 0 };
+
+        cpu.core = firstCpuOf(dir + "/topology/core_cpus_list",
+                firstCpuOf(dir + "/topology/thread_siblings_list", id));
+
+        // the last level cache is the highest level data or unified cache, if there is no
+        // cache information at all, we assume the package shares it.
+        uint32_t const package = readUint(dir + "/topology/physical_package_id", 0);
+        uint32_t level = 0;
+        for (size_t i = 0;; i++) {
+            std::string const index = dir + "/cache/index" + std::to_string(i);
+            uint32_t const l = readUint(index + "/level", 0);
+            if (!l) {
+                break;
+            }
+            if (l > level && readLine(index + "/type") != "Instruction") {
+                level = l;
+                cpu.cacheDomain = firstCpuOf(index + "/shared_cpu_list", id);
+            }
+        }
+        if (!level) {
+            cpu.cacheDomain = package;
+        }
+
+        // the NUMA node appears as a "nodeN" link in the cpu directory
+        if (DIR* d = opendir(dir.c_str())) {
+            while (dirent const* entry = readdir(d)) {
+                unsigned int node;
+                if (sscanf(entry->d_name, "node%u", &node) == 1) {
+                    cpu.node = node;
+                    break;
+                }
+            }
+            closedir(d);
+        }
+
+        // cpu_capacity exists on heterogeneous ARM systems, otherwise the maximum frequency
+        // is a good enough proxy, it's normalized below.
+        cpu.capacity = readUint(dir + "/cpu_capacity",
+                readUint(dir + "/cpufreq/cpuinfo_max_freq", MAX_CAPACITY));
+        maxCapacity = std::max(maxCapacity, cpu.capacity);
+
+        cpus.push_back(cpu);
+    }
+
+    if (cpus.empty()) {
+        // sysfs is not available, assume identical CPUs
+        uint32_t const count = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t id = 0; id < count; id++) {
+            cpus.push_back({ id, id, 0, 0, MAX_CAPACITY });
+        }
+        maxCapacity = MAX_CAPACITY;
+    }
+
+    for (Cpu& cpu : cpus) {
+        cpu.capacity = uint32_t((uint64_t(cpu.capacity) * MAX_CAPACITY) / maxCapacity);
+    }
+    return CpuTopology(std::move(cpus));
+}
+
+#else
+
+CpuTopology CpuTopology::load(const char*) noexcept {
+    std::vector<Cpu> cpus;
+    uint32_t const count = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t id = 0; id < count; id++) {
+        cpus.push_back({ id, id, 0, 0, MAX_CAPACITY });
+    }
+    return CpuTopology(std::move(cpus));
+}
+
+#endif
+
+size_t CpuTopology::getPerformanceCpuCount() const noexcept {
+    uint32_t maxCapacity = 0;
+    for (Cpu const& cpu : mCpus) {
+        maxCapacity = std::max(maxCapacity, cpu.capacity);
+    }
+    return size_t(std::count_if(mCpus.begin(), mCpus.end(), [maxCapacity](Cpu const& cpu) {
+        return cpu.capacity == maxCapacity;
+    }));
+}
+
+std::vector<CpuTopology::Cpu> CpuTopology::selectCpus(
+        AffinityPolicy policy, size_t count) const noexcept {
+    if (policy == AffinityPolicy::NONE || mCpus.empty()) {
+        return {};
+    }
+
+    std::vector<Cpu> candidates(mCpus);
+    if (policy == AffinityPolicy::PERFORMANCE) {
+        uint32_t maxCapacity = 0;
+        for (Cpu const& cpu : candidates) {
+            maxCapacity = std::max(maxCapacity, cpu.capacity);
+        }
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                [maxCapacity](Cpu const& cpu) { return cpu.capacity != maxCapacity; }),
+                candidates.end());
+    }
+
+    // The first CPU of each core is used before its SMT siblings. COMPACT fills the cache
+    // domains one after the other.
+    auto const isSibling = [](Cpu const& cpu) { return uint32_t(cpu.id != cpu.core); };
+    auto const compact = [&](Cpu const& cpu) {
+        return std::make_tuple(isSibling(cpu), cpu.node, cpu.cacheDomain, cpu.id);
+    };
+    std::sort(candidates.begin(), candidates.end(), [&](Cpu const& lhs, Cpu const& rhs) {
+        return compact(lhs) < compact(rhs);
+    });
+
+    if (policy == AffinityPolicy::SPREAD) {
+        // SPREAD takes the first CPU of each domain, then the second one, etc... and
+        // alternates between NUMA nodes, for this we need each CPU's rank in its domain and
+        // each domain's index in its node.
+        std::vector<std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t>> keys;
+        keys.reserve(candidates.size());
+
+        std::vector<std::pair<uint32_t, uint32_t>> domains;     // (node, domain), sorted
+        for (Cpu const& cpu : candidates) {
+            domains.emplace_back(cpu.node, cpu.cacheDomain);
+        }
+        std::sort(domains.begin(), domains.end());
+        domains.erase(std::unique(domains.begin(), domains.end()), domains.end());
+
+        uint32_t rank = 0;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            Cpu const& cpu = candidates[i];
+            bool const sameGroup = i && isSibling(cpu) == isSibling(candidates[i - 1]) &&
+                    cpu.cacheDomain == candidates[i - 1].cacheDomain;
+            rank = sameGroup ? rank + 1 : 0;
+
+            auto const domain = std::lower_bound(domains.begin(), domains.end(),
+                    std::make_pair(cpu.node, cpu.cacheDomain));
+            auto const firstOfNode = std::lower_bound(domains.begin(), domains.end(),
+                    std::make_pair(cpu.node, 0u));
+            uint32_t const domainIndex = uint32_t(domain - firstOfNode);
+
+            keys.emplace_back(isSibling(cpu), rank, domainIndex, cpu.node, uint32_t(i));
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<Cpu> spread;
+        spread.reserve(candidates.size());
+        for (auto const& key : keys) {
+            spread.push_back(candidates[std::get<4>(key)]);
+        }
+        std::swap(candidates, spread);
+    }
+
+    if (candidates.size() > count) {
+        candidates.resize(count);
+    }
+
+    // make the cache domains contiguous
+    std::sort(candidates.begin(), candidates.end(), [](Cpu const& lhs, Cpu const& rhs) {
+        return std::make_tuple(lhs.node, lhs.cacheDomain, lhs.id) <
+               std::make_tuple(rhs.node, rhs.cacheDomain, rhs.id);
+    });
+    return candidates;
+}
+
+} // namespace utils
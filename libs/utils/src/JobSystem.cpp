@@ -23,6 +23,7 @@
 
 #include <utils/JobSystem.h>
 
+#include <algorithm>
 #include <cmath>
 #include <random>
 
@@ -105,12 +106,19 @@ void JobSystem::setThreadAffinityById(size_t id) noexcept {
 #endif
 }
 
-JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreadsCount) noexcept
-    : mJobPool("JobSystem Job pool", MAX_JOB_COUNT * sizeof(Job)),
-      mJobStorageBase(static_cast<Job *>(mJobPool.getAllocator().getCurrent()))
+JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreadsCount,
+        AffinityPolicy affinityPolicy) noexcept
 {
     SYSTRACE_ENABLE();
 
+    mEpoch = std::chrono::steady_clock::now();
+
+    // start with one page of jobs
+    addJobPage();
+
+    CpuTopology const topology = affinityPolicy == AffinityPolicy::NONE ?
+            CpuTopology() : CpuTopology::load();
+
     int threadPoolCount = userThreadCount;
     if (threadPoolCount == 0) {
         // default value, system dependant
@@ -121,6 +129,9 @@ JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreads
             // since we assumed HT, always round-up to an even number of cores (to play it safe)
             hwThreads = (hwThreads + 1) / 2;
         }
+        if (affinityPolicy == AffinityPolicy::PERFORMANCE) {
+            hwThreads = std::min(hwThreads, int(topology.getPerformanceCpuCount()));
+        }
         // make sure we have at least one h/w thread (could be an assert instead)
         hwThreads = std::max(0, hwThreads);
         // one of the thread will be the user thread
@@ -135,6 +146,11 @@ JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreads
     // this is a pity these are not compile-time checks (C++17 supports it apparently)
     assert(mExitRequested.is_lock_free());
     assert(Job().runningJobCount.is_lock_free());
+    assert(mFreeJobs.is_lock_free());
+
+    // The CPUs sharing a cache domain are contiguous, so the workers that share their last
+    // level cache are too.
+    std::vector<CpuTopology::Cpu> const cpus = topology.selectCpus(affinityPolicy, mThreadCount);
 
     std::random_device rd;
     const size_t hardwareThreadCount = mThreadCount;
@@ -146,6 +162,21 @@ JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreads
         state.rndGen = default_random_engine(rd());
         state.id = (uint32_t)i;
         state.js = this;
+        if (i < cpus.size()) {
+            state.cpu = int32_t(cpus[i].id);
+            size_t first = i;
+            while (first > 0 && cpus[first - 1].cacheDomain == cpus[i].cacheDomain &&
+                    cpus[first - 1].node == cpus[i].node) {
+                first--;
+            }
+            size_t last = i + 1;
+            while (last < cpus.size() && cpus[last].cacheDomain == cpus[i].cacheDomain &&
+                    cpus[last].node == cpus[i].node) {
+                last++;
+            }
+            state.nearFirst = uint16_t(first);
+            state.nearCount = uint16_t(last - first);
+        }
         if (i < hardwareThreadCount) {
             // don't start a thread of adoptable thread slots
             state.thread = std::thread(&JobSystem::loop, this, &state);
@@ -163,6 +194,10 @@ JobSystem::~JobSystem() {
             state.thread.join();
         }
     }
+
+    for (size_t i = 0, c = mJobPageCount.load(); i < c; i++) {
+        aligned_free(mJobPages[i]);
+    }
 }
 
 inline void JobSystem::incRef(Job const* job) noexcept {
@@ -186,7 +221,7 @@ void JobSystem::decRef(Job const* job) noexcept {
     assert(c > 0);
     if (c == 1) {
         // This was the last reference, it's safe to destroy the job.
-        mJobPool.destroy(job);
+        freeJob(const_cast<Job*>(job));
     }
 }
 
@@ -208,17 +243,29 @@ inline bool JobSystem::exitRequested() const noexcept {
 }
 
 inline bool JobSystem::hasActiveJobs() const noexcept {
-    return mActiveJobs.load(std::memory_order_relaxed) > 0;
+    return hasActiveJobs(Lane::CRITICAL) || hasActiveJobs(Lane::BACKGROUND);
+}
+
+inline bool JobSystem::hasActiveJobs(Lane lane) const noexcept {
+    return mActiveJobs[size_t(lane)].load(std::memory_order_relaxed) > 0;
 }
 
 inline bool JobSystem::hasJobCompleted(JobSystem::Job const* job) noexcept {
     return job->runningJobCount.load(std::memory_order_relaxed) <= 0;
 }
 
-void JobSystem::wait(std::unique_lock<Mutex>& lock) noexcept {
+void JobSystem::wait(std::unique_lock<Mutex>& lock, ThreadState& state) noexcept {
+    const uint64_t start = now();
     ++mWaiterCount;
     mWaiterCondition.wait(lock);
     --mWaiterCount;
+    increment(state.wakeUpCount);
+    increment(state.idleTime, now() - start);
+}
+
+uint64_t JobSystem::now() const noexcept {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - mEpoch).count());
 }
 
 void JobSystem::wake() noexcept {
@@ -236,7 +283,77 @@ inline JobSystem::ThreadState& JobSystem::getState() noexcept {
 }
 
 JobSystem::Job* JobSystem::allocateJob() noexcept {
-    return mJobPool.make<Job>();
+    uint32_t index = popFreeJob();
+    while (UTILS_UNLIKELY(!index)) {
+        if (UTILS_UNLIKELY(!addJobPage())) {
+            mJobExhaustedCount.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        index = popFreeJob();
+    }
+    return new(getJob(index)) Job();
+}
+
+void JobSystem::freeJob(Job* job) noexcept {
+    job->~Job();
+    pushFreeJobs(getJobIndex(job), job);
+}
+
+uint32_t JobSystem::popFreeJob() noexcept {
+    // The tag in the upper 32-bits of the head changes with each update, which prevents ABA
+    // races, like in AtomicFreeList.
+    uint64_t head = mFreeJobs.load();
+    while (uint32_t(head)) {
+        Job* const job = getJob(uint32_t(head));
+        const uint32_t next = getNextFreeJob(job).load(std::memory_order_relaxed);
+        const uint64_t newHead = (((head >> 32u) + 1u) << 32u) | next;
+        if (mFreeJobs.compare_exchange_weak(head, newHead)) {
+            break;
+        }
+    }
+    return uint32_t(head);
+}
+
+void JobSystem::pushFreeJobs(uint32_t first, Job* last) noexcept {
+    // the jobs from 'first' to 'last' must already be linked together
+    uint64_t head = mFreeJobs.load();
+    uint64_t newHead;
+    do {
+        getNextFreeJob(last).store(uint32_t(head), std::memory_order_relaxed);
+        newHead = (((head >> 32u) + 1u) << 32u) | first;
+    } while (!mFreeJobs.compare_exchange_weak(head, newHead));
+}
+
+UTILS_NOINLINE
+bool JobSystem::addJobPage() noexcept {
+    SYSTRACE_CALL();
+    std::lock_guard<Mutex> lock(mJobPageLock);
+
+    // another thread could have added a page (or freed jobs) while we were waiting for the lock
+    if (uint32_t(mFreeJobs.load())) {
+        return true;
+    }
+
+    const uint32_t page = mJobPageCount.load(std::memory_order_relaxed);
+    if (UTILS_UNLIKELY(page == MAX_JOB_PAGE_COUNT)) {
+        return false;
+    }
+
+    void* const storage = aligned_alloc(JOB_PAGE_ALLOCATION_BYTES, JOB_PAGE_BYTES);
+    if (UTILS_UNLIKELY(!storage)) {
+        return false;
+    }
+    new(storage) JobPageHeader{ page };
+    mJobPages[page] = static_cast<Job*>(storage);
+    mJobPageCount.store(page + 1, std::memory_order_relaxed);
+
+    // slot 0 holds the header
+    const uint32_t base = page << JOB_PAGE_SHIFT;
+    for (uint32_t slot = 1; slot < JOB_PAGE_SIZE - 1; slot++) {
+        getNextFreeJob(getJob(base | slot)).store(base | (slot + 1), std::memory_order_relaxed);
+    }
+    pushFreeJobs(base | 1u, getJob(base | (JOB_PAGE_SIZE - 1)));
+    return true;
 }
 
 inline JobSystem::ThreadState* JobSystem::getStateToStealFrom(JobSystem::ThreadState& state) noexcept {
@@ -252,7 +369,14 @@ inline JobSystem::ThreadState* JobSystem::getStateToStealFrom(JobSystem::ThreadS
     if (threadCount >= 2) {
         do {
             // this is biased, but frankly, we don't care. it's fast.
-            uint16_t index = uint16_t(state.rndGen() % threadCount);
+            const uint32_t r = state.rndGen();
+            uint16_t index;
+            if (state.nearCount >= 2 && (r & 3u)) {
+                // 3 times out of 4, try a thread sharing our last level cache
+                index = uint16_t(state.nearFirst + (r >> 2u) % state.nearCount);
+            } else {
+                index = uint16_t((r >> 2u) % threadCount);
+            }
             assert(index < threadStates.size());
             stateToStealFrom = &threadStates[index];
             // don't steal from our own queue
@@ -261,51 +385,116 @@ inline JobSystem::ThreadState* JobSystem::getStateToStealFrom(JobSystem::ThreadS
     return stateToStealFrom;
 }
 
-JobSystem::Job* JobSystem::steal(JobSystem::ThreadState& state) noexcept {
+JobSystem::Job* JobSystem::steal(JobSystem::ThreadState& state, Lane lane) noexcept {
     HEAVY_SYSTRACE_CALL();
     Job* job = nullptr;
     do {
         ThreadState* const stateToStealFrom = getStateToStealFrom(state);
         if (UTILS_LIKELY(stateToStealFrom)) {
-            job = steal(stateToStealFrom->workQueue);
+            increment(state.stealAttemptCount);
+            job = steal(stateToStealFrom->workQueues[size_t(lane)]);
+            if (job) {
+                increment(state.stealCount);
+            }
+        }
+        if (UTILS_UNLIKELY(!job)) {
+            // the active jobs could be ones that didn't fit in a work queue, taking one of
+            // those is not counted as a steal.
+            job = unspill(lane);
         }
         // nullptr -> nothing to steal in that queue either, if there are active jobs,
         // continue to try stealing one.
-    } while (!job && hasActiveJobs());
+    } while (!job && hasActiveJobs(lane));
     return job;
 }
 
-bool JobSystem::execute(JobSystem::ThreadState& state) noexcept {
+bool JobSystem::execute(JobSystem::ThreadState& state, bool allowBackground) noexcept {
     HEAVY_SYSTRACE_CALL();
 
-    Job* job = pop(state.workQueue);
+    Job* job = pop(state.workQueues[size_t(Lane::CRITICAL)]);
     if (UTILS_UNLIKELY(job == nullptr)) {
         // our queue is empty, try to steal a job
-        job = steal(state);
+        job = steal(state, Lane::CRITICAL);
+    }
+
+    // only consider background jobs when there are no critical jobs at all
+    if (UTILS_UNLIKELY(job == nullptr && allowBackground)) {
+        job = pop(state.workQueues[size_t(Lane::BACKGROUND)]);
+        if (job == nullptr) {
+            job = steal(state, Lane::BACKGROUND);
+        }
     }
 
     if (job) {
         UTILS_UNUSED_IN_RELEASE
-        uint32_t activeJobs = mActiveJobs.fetch_sub(1, std::memory_order_relaxed);
+        uint32_t activeJobs = mActiveJobs[size_t(job->lane)].fetch_sub(1,
+                std::memory_order_relaxed);
         assert(activeJobs); // whoops, we were already at 0
         HEAVY_SYSTRACE_VALUE32("JobSystem::activeJobs", activeJobs - 1);
 
-        if (UTILS_LIKELY(job->function)) {
-            HEAVY_SYSTRACE_NAME("job->function");
-            job->function(job->storage, *this, job);
+        increment(state.jobCount);
+        if (UTILS_UNLIKELY(isProfiling())) {
+            const uint8_t name = job->name;
+            const uint64_t begin = now();
+            if (job->function) {
+                HEAVY_SYSTRACE_NAME(getJobName(name));
+                job->function(job->storage, *this, job);
+            }
+            finish(job);
+            record(state, name, begin, now());
+        } else {
+            if (UTILS_LIKELY(job->function)) {
+                HEAVY_SYSTRACE_NAME(getJobName(job->name));
+                job->function(job->storage, *this, job);
+            }
+            finish(job);
         }
-        finish(job);
     }
     return job != nullptr;
 }
 
+void JobSystem::record(ThreadState& state, uint8_t name, uint64_t begin, uint64_t end) noexcept {
+    if (end - begin > state.longestJobTime.load(std::memory_order_relaxed)) {
+        state.longestJobTime.store(end - begin, std::memory_order_relaxed);
+    }
+
+    // profiling was (re)started since our last event, the previous events are discarded
+    const uint32_t generation = mProfilingGeneration.load(std::memory_order_acquire);
+    if (UTILS_UNLIKELY(state.profilingGeneration != generation)) {
+        std::lock_guard<Mutex> lock(state.eventLock);
+        const uint32_t capacity = mEventCapacity.load(std::memory_order_relaxed);
+        if (state.eventCapacity != capacity) {
+            state.events.reset(capacity ? new TraceEvent[capacity] : nullptr);
+            state.eventCapacity = capacity;
+        }
+        state.eventWriteCount.store(0, std::memory_order_relaxed);
+        state.eventCount.store(0, std::memory_order_relaxed);
+        state.profilingGeneration = generation;
+    }
+
+    if (state.events) {
+        // This is a seqlock: eventWriteCount is incremented before the event is overwritten,
+        // and eventCount after, see exportTrace().
+        const uint32_t count = state.eventCount.load(std::memory_order_relaxed);
+        TraceEvent& event = state.events[count % state.eventCapacity];
+        state.eventWriteCount.store(count + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        event.begin.store(begin, std::memory_order_relaxed);
+        event.end.store(end, std::memory_order_relaxed);
+        event.name.store(name, std::memory_order_relaxed);
+        state.eventCount.store(count + 1, std::memory_order_release);
+    }
+}
+
 void JobSystem::loop(ThreadState* state) noexcept {
     setThreadName("JobSystem::loop");
     setThreadPriority(Priority::DISPLAY);
 
     // set a CPU affinity on each of our JobSystem thread to prevent them from jumping from core
     // to core. On Android, it looks like the affinity needs to be reset from time to time.
-    setThreadAffinityById(state->id);
+    if (state->cpu >= 0) {
+        setThreadAffinityById(size_t(state->cpu));
+    }
 
     // record our work queue to thread-local storage
     sThreadState = state;
@@ -315,8 +504,10 @@ void JobSystem::loop(ThreadState* state) noexcept {
         if (!execute(*state)) {
             std::unique_lock<Mutex> lock(mWaiterLock);
             while (!exitRequested() && !hasActiveJobs()) {
-                wait(lock);
-                setThreadAffinityById(state->id);
+                wait(lock, *state);
+                if (state->cpu >= 0) {
+                    setThreadAffinityById(size_t(state->cpu));
+                }
             }
         }
     } while (!exitRequested());
@@ -329,17 +520,26 @@ void JobSystem::finish(Job* job) noexcept {
     bool notify = false;
 
     // terminate this job and notify its parent
-    Job* const storage = mJobStorageBase;
     do {
         // std::memory_order_release here is needed to synchronize with JobSystem::wait()
         // which needs to "see" all changes that happened before the job terminated.
         auto runningJobCount = job->runningJobCount.fetch_sub(1, std::memory_order_acq_rel);
         assert(runningJobCount > 0);
         if (runningJobCount == 1) {
-            // no more work, destroy this job and notify its parent
+            // no more work, destroy this job, run its continuation and notify its parent
             notify = true;
-            Job* const parent = job->parent == 0x7FFF ? nullptr : &storage[job->parent];
+            const uint32_t parentIndex = getParent(job);
+            Job* const parent = !parentIndex ? nullptr : getJob(parentIndex);
+            // synchronizes with runOnCompletion(), either we see the continuation, or it sees
+            // that the job has finished.
+            const uint32_t continuationIndex =
+                    getContinuation(job).exchange(JOB_FINISHED, std::memory_order_acq_rel);
             decRef(job);
+            if (continuationIndex) {
+                // we wake-up the other threads below
+                Job* continuation = getJob(continuationIndex);
+                run(continuation, DONT_SIGNAL);
+            }
             job = parent;
         } else {
             // there is still work (e.g.: children), we're done.
@@ -353,6 +553,28 @@ void JobSystem::finish(Job* job) noexcept {
     }
 }
 
+void JobSystem::spill(Lane lane, Job* job) noexcept {
+    std::lock_guard<Mutex> lock(mSpilledJobLock);
+    mSpilledJobs[size_t(lane)].push_back(getJobIndex(job));
+    mSpilledJobCount[size_t(lane)].fetch_add(1, std::memory_order_relaxed);
+}
+
+JobSystem::Job* JobSystem::unspill(Lane lane) noexcept {
+    // the count avoids taking the lock in the common case where nothing was spilled
+    if (UTILS_LIKELY(!mSpilledJobCount[size_t(lane)].load(std::memory_order_relaxed))) {
+        return nullptr;
+    }
+    std::lock_guard<Mutex> lock(mSpilledJobLock);
+    std::vector<uint32_t>& spilledJobs = mSpilledJobs[size_t(lane)];
+    if (spilledJobs.empty()) {
+        return nullptr;
+    }
+    const uint32_t index = spilledJobs.back();
+    spilledJobs.pop_back();
+    mSpilledJobCount[size_t(lane)].fetch_sub(1, std::memory_order_relaxed);
+    return getJob(index);
+}
+
 // -----------------------------------------------------------------------------------------------
 // public API...
 
@@ -361,7 +583,7 @@ JobSystem::Job* JobSystem::create(JobSystem::Job* parent, JobFunc func) noexcept
     parent = (parent == nullptr) ? mMasterJob : parent;
     Job* const job = allocateJob();
     if (UTILS_LIKELY(job)) {
-        size_t index = 0x7FFF;
+        uint32_t index = 0;
         if (parent) {
             // add a reference to the parent to make sure it can't be terminated.
             // memory_order_relaxed is safe because no action is taken at this point
@@ -371,11 +593,13 @@ JobSystem::Job* JobSystem::create(JobSystem::Job* parent, JobFunc func) noexcept
             // can't create a child job of a terminated parent
             assert(parentJobCount > 0);
 
-            index = parent - mJobStorageBase;
-            assert(index < MAX_JOB_COUNT);
+            index = getJobIndex(parent);
         }
         job->function = func;
-        job->parent = uint16_t(index);
+        getParent(job) = index;
+        getContinuation(job).store(0, std::memory_order_relaxed);
+        job->lane = parent ? parent->lane : Lane::CRITICAL;
+        job->name = parent ? parent->name : uint8_t(0);
     }
     return job;
 }
@@ -405,12 +629,26 @@ void JobSystem::run(JobSystem::Job*& job, uint32_t flags) noexcept {
 
     ThreadState& state(getState());
 
+    if (flags & BACKGROUND) {
+        job->lane = Lane::BACKGROUND;
+    }
+    const size_t lane = size_t(job->lane);
+    WorkQueue& workQueue = state.workQueues[lane];
+
     // increase the active job count before we add the job to the queue, because otherwise
     // the job could run and finish before the counter is incremented, which would trigger
     // an assert() in execute(). Either way, it's not "wrong", but the assert() is useful.
-    uint32_t activeJobs = mActiveJobs.fetch_add(1, std::memory_order_relaxed);
-
-    put(state.workQueue, job);
+    uint32_t activeJobs = mActiveJobs[lane].fetch_add(1, std::memory_order_relaxed);
+
+    if (UTILS_LIKELY(workQueue.getCount() < WORK_QUEUE_SIZE)) {
+        put(workQueue, job);
+    } else {
+        // There is no room left in our queue, this can only happen if this thread ran
+        // WORK_QUEUE_SIZE jobs that didn't execute yet. Running the job now instead could
+        // recurse without bounds (if it runs more jobs), so it goes to the shared queue.
+        mWorkQueueFullCount.fetch_add(1, std::memory_order_relaxed);
+        spill(job->lane, job);
+    }
 
     HEAVY_SYSTRACE_VALUE32("JobSystem::activeJobs", activeJobs + 1);
 
@@ -438,8 +676,12 @@ void JobSystem::waitAndRelease(Job*& job) noexcept {
     assert(job->refCount.load(std::memory_order_relaxed) >= 1);
 
     ThreadState& state(getState());
+
+    // Background jobs could take a long time, so we don't run them while waiting on a critical
+    // job, unless there are no other threads to run them.
+    const bool allowBackground = job->lane == Lane::BACKGROUND || !mThreadCount;
     do {
-        if (!execute(state)) {
+        if (!execute(state, allowBackground)) {
             // test if job has completed first, to possibly avoid taking the lock
             if (hasJobCompleted(job)) {
                 break;
@@ -455,8 +697,10 @@ void JobSystem::waitAndRelease(Job*& job) noexcept {
             // continue to handle more jobs, as they get added.
 
             std::unique_lock<Mutex> lock(mWaiterLock);
-            if (!hasJobCompleted(job) && !hasActiveJobs() && !exitRequested()) {
-                wait(lock);
+            const bool hasRunnableJobs = allowBackground ?
+                    hasActiveJobs() : hasActiveJobs(Lane::CRITICAL);
+            if (!hasJobCompleted(job) && !hasRunnableJobs && !exitRequested()) {
+                wait(lock, state);
             }
         }
     } while (!hasJobCompleted(job) && !exitRequested());
@@ -473,6 +717,22 @@ void JobSystem::runAndWait(JobSystem::Job*& job) noexcept {
     waitAndRelease(job);
 }
 
+bool JobSystem::runOnCompletion(Job* job, Job*& continuation) noexcept {
+    assert(job);
+    assert(job->refCount.load(std::memory_order_relaxed) >= 1);
+    assert(continuation);
+
+    uint32_t expected = 0;
+    if (getContinuation(job).compare_exchange_strong(expected, getJobIndex(continuation),
+            std::memory_order_acq_rel)) {
+        // the job now belongs to finish()
+        continuation = nullptr;
+        return true;
+    }
+    assert(expected == JOB_FINISHED); // whoops, the job already has a continuation
+    return false;
+}
+
 void JobSystem::adopt() {
     ThreadState* const state = sThreadState;
     if (state) {
@@ -507,9 +767,127 @@ void JobSystem::emancipate() {
     sThreadState = nullptr;
 }
 
+// -----------------------------------------------------------------------------------------------
+// instrumentation...
+
+JobSystem::ThreadStats JobSystem::getThreadStats(size_t thread) const noexcept {
+    assert(thread < mThreadStates.size());
+    ThreadState const& state = mThreadStates[thread];
+    return {
+            state.jobCount.load(std::memory_order_relaxed),
+            state.stealAttemptCount.load(std::memory_order_relaxed),
+            state.stealCount.load(std::memory_order_relaxed),
+            state.wakeUpCount.load(std::memory_order_relaxed),
+            state.idleTime.load(std::memory_order_relaxed),
+            state.longestJobTime.load(std::memory_order_relaxed)
+    };
+}
+
+void JobSystem::resetThreadStats() noexcept {
+    // Threads could be updating their counters, so this is only approximate if jobs are running.
+    for (auto& state : mThreadStates) {
+        state.jobCount.store(0, std::memory_order_relaxed);
+        state.stealAttemptCount.store(0, std::memory_order_relaxed);
+        state.stealCount.store(0, std::memory_order_relaxed);
+        state.wakeUpCount.store(0, std::memory_order_relaxed);
+        state.idleTime.store(0, std::memory_order_relaxed);
+        state.longestJobTime.store(0, std::memory_order_relaxed);
+    }
+}
+
+void JobSystem::setJobName(Job* job, const char* name) noexcept {
+    // names are looked up by address, so the common case of a string literal doesn't lock
+    uint32_t count = mJobNameCount.load(std::memory_order_acquire);
+    for (uint32_t i = 1; i < count; i++) {
+        if (mJobNames[i] == name) {
+            job->name = uint8_t(i);
+            return;
+        }
+    }
+
+    std::lock_guard<Mutex> lock(mJobNameLock);
+    count = mJobNameCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 1; i < count; i++) {
+        if (mJobNames[i] == name) {
+            job->name = uint8_t(i);
+            return;
+        }
+    }
+    if (UTILS_UNLIKELY(count == MAX_JOB_NAME_COUNT)) {
+        return;
+    }
+    mJobNames[count] = name;
+    mJobNameCount.store(count + 1, std::memory_order_release);
+    job->name = uint8_t(count);
+}
+
+void JobSystem::startProfiling(size_t eventCapacity) noexcept {
+    // the threads pick up the new capacity when they record their next event, see record()
+    mEventCapacity.store(uint32_t(eventCapacity), std::memory_order_relaxed);
+    mProfilingGeneration.fetch_add(1, std::memory_order_release);
+    mProfiling.store(true, std::memory_order_release);
+}
+
+void JobSystem::stopProfiling() noexcept {
+    mProfiling.store(false, std::memory_order_release);
+}
+
+void JobSystem::exportTrace(io::ostream& out) const noexcept {
+    // see the "Trace Event Format" documentation, timestamps are in microseconds
+    out << "{\"traceEvents\":[";
+    const char* separator = "";
+    for (auto const& state : mThreadStates) {
+        out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+            << state.id << ",\"args\":{\"name\":\"JobSystem " << state.id << "\"}}";
+        separator = ",";
+    }
+    const uint32_t generation = mProfilingGeneration.load(std::memory_order_acquire);
+    struct Event {
+        uint64_t begin;
+        uint64_t end;
+        uint8_t name;
+    };
+    std::vector<Event> events;
+    for (auto const& state : mThreadStates) {
+        uint32_t first, count, valid;
+        { // the owning thread could be reallocating its events
+            std::lock_guard<Mutex> lock(state.eventLock);
+            if (!state.events || state.profilingGeneration != generation) {
+                continue;
+            }
+            const uint32_t capacity = state.eventCapacity;
+            count = state.eventCount.load(std::memory_order_acquire);
+            first = count > capacity ? count - capacity : 0;
+            events.resize(count - first);
+            for (uint32_t i = first; i < count; i++) {
+                TraceEvent const& event = state.events[i % capacity];
+                events[i - first] = {
+                        event.begin.load(std::memory_order_relaxed),
+                        event.end.load(std::memory_order_relaxed),
+                        event.name.load(std::memory_order_relaxed) };
+            }
+            // the events the thread started to overwrite while we were reading could be torn
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint32_t written = state.eventWriteCount.load(std::memory_order_relaxed);
+            valid = written > capacity ?
+                    std::max(first, std::min(written - capacity, count)) : first;
+        }
+        for (uint32_t i = valid; i < count; i++) {
+            Event const& event = events[i - first];
+            out << ",{\"name\":\"" << getJobName(event.name)
+                << "\",\"cat\":\"job\",\"ph\":\"X\",\"pid\":0,\"tid\":" << state.id
+                << ",\"ts\":" << double(event.begin) * 1e-3
+                << ",\"dur\":" << double(event.end - event.begin) * 1e-3 << "}";
+        }
+    }
+    out << "]}" << io::endl;
+}
+
 io::ostream& operator<<(io::ostream& out, JobSystem const& js) {
     for (auto const& item : js.mThreadStates) {
-        out << size_t(item.id) << ": " << item.workQueue.getCount() << io::endl;
+        out << size_t(item.id) << ": "
+            << item.workQueues[size_t(JobSystem::Lane::CRITICAL)].getCount() << " "
+            << item.workQueues[size_t(JobSystem::Lane::BACKGROUND)].getCount() << io::endl;
     }
     return out;
 }
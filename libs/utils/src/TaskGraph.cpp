@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/TaskGraph.h>
+
+#include <utils/Panic.h>
+
+#include <mutex>
+
+namespace utils {
+
+TaskGraph::TaskGraph(JobSystem& js, JobSystem::Job* parent) noexcept
+        : mJobSystem(js),
+          // The root job is only run by wait(), until then it can't finish, which means
+          // tasks can be added as its children at any time.
+          mRoot(js.createJob(parent)) {
+}
+
+TaskGraph::~TaskGraph() {
+    if (mRoot) {
+        wait();
+    }
+}
+
+TaskGraph::Task TaskGraph::create(std::function<void()> func) noexcept {
+    assert(mRoot);
+    JobSystem& js = mJobSystem;
+    mNodes.emplace_back();
+    Node& node = mNodes.back();
+    node.func = std::move(func);
+    node.job = js.createJob(mRoot, [this, &node](JobSystem&, JobSystem::Job*) {
+        execute(node);
+    });
+    ASSERT_POSTCONDITION(node.job, "TaskGraph: couldn't create a job for this task");
+    // keep a reference so that we can wait on this task even after it's finished
+    js.retain(node.job);
+    return Task(mNodes.size() - 1);
+}
+
+void TaskGraph::precede(Task before, Task after) noexcept {
+    Node& b = mNodes[before];
+    Node& a = mNodes[after];
+    assert(!a.submitted);
+    std::lock_guard<Mutex> lock(mLock);
+    if (!b.done) {
+        b.successors.push_back(&a);
+        a.pending.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void TaskGraph::setName(Task task, const char* name) noexcept {
+    Node& node = mNodes[task];
+    assert(!node.submitted);
+    mJobSystem.setJobName(node.job, name);
+}
+
+void TaskGraph::run(Task task) noexcept {
+    Node& node = mNodes[task];
+    assert(!node.submitted);
+    node.submitted = true;
+    release(node);
+}
+
+void TaskGraph::run() noexcept {
+    for (Node& node : mNodes) {
+        if (!node.submitted) {
+            node.submitted = true;
+            release(node);
+        }
+    }
+}
+
+void TaskGraph::wait(Task task) noexcept {
+    Node& node = mNodes[task];
+    assert(node.submitted);
+    if (node.job) {
+        mJobSystem.waitAndRelease(node.job);
+    }
+}
+
+void TaskGraph::wait() noexcept {
+    assert(mRoot);
+    run();
+
+    // the root job finishes when all its children, i.e. all the tasks, have finished
+    mJobSystem.runAndWait(mRoot);
+
+    for (Node& node : mNodes) {
+        if (node.job) {
+            mJobSystem.release(node.job);
+        }
+    }
+}
+
+void TaskGraph::execute(Node& node) noexcept {
+    if (node.func) {
+        node.func();
+    }
+
+    // from now on, precede() won't add successors to this node
+    std::vector<Node*> successors;
+    {
+        std::lock_guard<Mutex> lock(mLock);
+        node.done = true;
+        std::swap(successors, node.successors);
+    }
+
+    for (Node* successor : successors) {
+        release(*successor);
+    }
+}
+
+void TaskGraph::release(Node& node) noexcept {
+    // the last one to release a node schedules it
+    if (node.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        JobSystem::Job* job = node.job;
+        mJobSystem.run(job);
+    }
+}
+
+} // namespace utils
@@ -85,6 +85,148 @@ TEST(AllocatorTest, LinearAllocator) {
     EXPECT_EQ(uintptr_t(q), uintptr_t(p) + sizeof(float)*4);
 }
 
+TEST(AllocatorTest, ChainedLinearAllocator) {
+    char scratch[1024];
+    void* p = nullptr;
+    void* q = nullptr;
+
+    ChainedLinearAllocator la(scratch, scratch + sizeof(scratch), 4096);
+    EXPECT_EQ(1024, la.getCapacity());
+    EXPECT_EQ(1, la.getBlockCount());
+
+    // check we can allocate the whole first block
+    p = la.alloc(1024, 1, 0);
+    EXPECT_EQ(scratch, p);
+    EXPECT_EQ(1024, la.allocated());
+
+    // check we get a new block when the first one is full
+    p = la.alloc(16, 1, 0);
+    EXPECT_NE(nullptr, p);
+    EXPECT_TRUE(p < (void*)scratch || p >= (void*)(scratch + sizeof(scratch)));
+    EXPECT_EQ(2, la.getBlockCount());
+    EXPECT_EQ(1024 + 4096, la.getCapacity());
+    EXPECT_EQ(1024 + 16, la.allocated());
+
+    // check allocations larger than the block size
+    q = la.alloc(8192, 32, 0);
+    EXPECT_NE(nullptr, q);
+    EXPECT_EQ(0, uintptr_t(q) & 31);
+    EXPECT_EQ(3, la.getBlockCount());
+    EXPECT_GE(la.allocated(), 1024 + 4096 + 8192);
+    EXPECT_EQ(la.allocated(), la.getHighWatermark());
+    memset(q, 0, 8192);
+
+    // check we can rewind across blocks, and that the spare blocks are reused
+    la.rewind(pointermath::add(p, 16));
+    EXPECT_EQ(1024 + 16, la.allocated());
+    EXPECT_EQ(q, la.alloc(8192, 32, 0));
+    EXPECT_EQ(3, la.getBlockCount());
+
+    // check the high watermark survives a reset
+    const size_t highWatermark = la.getHighWatermark();
+    la.reset();
+    EXPECT_EQ(0, la.allocated());
+    EXPECT_EQ(highWatermark, la.getHighWatermark());
+    EXPECT_EQ(scratch, la.alloc(8, 1, 0));
+
+    // check scoped usage with getCurrent()/rewind()
+    void* const current = la.getCurrent();
+    la.alloc(2048, 1, 0);
+    la.rewind(current);
+    EXPECT_EQ(8, la.allocated());
+    EXPECT_EQ(scratch + 8, la.alloc(8, 1, 0));
+
+    // check the allocator can be moved
+    ChainedLinearAllocator other(std::move(la));
+    EXPECT_EQ(16, other.allocated());
+    EXPECT_EQ(3, other.getBlockCount());
+}
+
+TEST(AllocatorTest, ChainedLinearAllocatorTrim) {
+    char scratch[1024];
+    ChainedLinearAllocator la(scratch, scratch + sizeof(scratch), 1024);
+
+    // a large peak...
+    for (size_t i = 0; i < 8; i++) {
+        la.alloc(1024, 1, 0);
+    }
+    EXPECT_EQ(8, la.getBlockCount());
+    la.reset();
+
+    // ...is remembered for a while...
+    for (size_t i = 0; i < 64; i++) {
+        la.alloc(1024, 1, 0);
+        la.alloc(1024, 1, 0);
+        la.reset();
+    }
+    EXPECT_EQ(8, la.getBlockCount());
+
+    // ...but eventually the capacity follows the actual usage
+    for (size_t i = 0; i < 128; i++) {
+        la.alloc(1024, 1, 0);
+        la.alloc(1024, 1, 0);
+        la.reset();
+    }
+    EXPECT_EQ(2, la.getBlockCount());
+    EXPECT_EQ(2048, la.getCapacity());
+    EXPECT_EQ(8 * 1024, la.getHighWatermark());
+}
+
+TEST(AllocatorTest, MemoryCounter) {
+    MemoryCounter counter;
+
+    // check that a tagged arena reports its allocations
+    using TaggedArena = Arena<HeapAllocator, LockingPolicy::NoLock, TrackingPolicy::Tagged>;
+    TaggedArena arena("tagged", 1024);
+    arena.getListener().setCounter(&counter);
+    void* p = arena.alloc(100);
+    void* q = arena.alloc(200);
+    EXPECT_EQ(300, counter.getCurrent());
+    arena.free(p, 100);
+    EXPECT_EQ(200, counter.getCurrent());
+    EXPECT_EQ(300, counter.getPeak());
+
+    // check the peak restarts from the current value
+    counter.resetPeak();
+    EXPECT_EQ(200, counter.getPeak());
+    arena.free(q, 200);
+    EXPECT_EQ(0, counter.getCurrent());
+    EXPECT_EQ(200, counter.getPeak());
+
+    // check that a chained allocator reports its capacity
+    char scratch[1024];
+    {
+        ChainedLinearAllocator la(scratch, scratch + sizeof(scratch), 4096);
+        la.setMemoryCounter(&counter);
+        EXPECT_EQ(1024, counter.getCurrent());
+        la.alloc(2048, 1, 0);
+        EXPECT_EQ(1024 + 4096, counter.getCurrent());
+    }
+    EXPECT_EQ(0, counter.getCurrent());
+    EXPECT_EQ(1024 + 4096, counter.getPeak());
+}
+
+TEST(AllocatorTest, HeapAreaBacking) {
+    const MemoryBacking backings[] = {
+            MemoryBacking::DEFAULT,
+            MemoryBacking::HUGE_PAGES,
+            MemoryBacking::PREFAULT,
+            MemoryBacking::HUGE_PAGES | MemoryBacking::PREFAULT };
+    for (MemoryBacking backing : backings) {
+        // the backings are only hints, so all we can check is that the memory is usable
+        HeapArea area(3 * 1024 * 1024 + 1, backing);
+        ASSERT_NE(nullptr, area.data());
+        EXPECT_EQ(3 * 1024 * 1024 + 1, area.getSize());
+        memset(area.data(), 0x55, area.getSize());
+
+        ChainedLinearAllocator la(area, 1024 * 1024, backing);
+        la.alloc(area.getSize(), 1, 0);
+        char* p = static_cast<char*>(la.alloc(4096, 64, 0));
+        ASSERT_NE(nullptr, p);
+        memset(p, 0xaa, 4096);
+        EXPECT_EQ(2, la.getBlockCount());
+    }
+}
 
 TEST(AllocatorTest, PoolAllocator) {
     char scratch[1024 + 31];
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <utils/CpuTopology.h>
+
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#   include <stdio.h>
+#   include <stdlib.h>
+#   include <sys/stat.h>
+#endif
+
+using namespace utils;
+
+using AffinityPolicy = CpuTopology::AffinityPolicy;
+
+namespace {
+
+/*
+ * 2 NUMA nodes, each with 2 L3 domains of 2 cores with 2 SMT threads. Like on Linux, the
+ * first thread of all cores are numbered first: CPU n and n + 8 are siblings.
+ * The cores of node 1 are slower.
+ */
+CpuTopology makeServer() {
+    std::vector<CpuTopology::Cpu> cpus;
+    for (uint32_t id = 0; id < 16; id++) {
+        uint32_t const core = id % 8;
+        uint32_t const domain = (core / 2) * 2;
+        uint32_t const node = core / 4;
+        cpus.push_back({ id, core, domain, node, node ? 512u : 1024u });
+    }
+    return CpuTopology(cpus);
+}
+
+std::vector<uint32_t> ids(std::vector<CpuTopology::Cpu> const& cpus) {
+    std::vector<uint32_t> result;
+    for (auto const& cpu : cpus) {
+        result.push_back(cpu.id);
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+TEST(CpuTopologyTest, Compact) {
+    CpuTopology topology = makeServer();
+    EXPECT_EQ(std::vector<uint32_t>({ 0, 1, 2 }),
+            ids(topology.selectCpus(AffinityPolicy::COMPACT, 3)));
+    // all the physical cores before the SMT siblings, sorted by cache domain
+    EXPECT_EQ(std::vector<uint32_t>({ 0, 1, 8, 2, 3, 4, 5, 6, 7 }),
+            ids(topology.selectCpus(AffinityPolicy::COMPACT, 9)));
+    EXPECT_EQ(16, topology.selectCpus(AffinityPolicy::COMPACT, 32).size());
+}
+
+TEST(CpuTopologyTest, Spread) {
+    CpuTopology topology = makeServer();
+    // one core per L3 domain, alternating between NUMA nodes, sorted by domain
+    EXPECT_EQ(std::vector<uint32_t>({ 0, 4 }),
+            ids(topology.selectCpus(AffinityPolicy::SPREAD, 2)));
+    EXPECT_EQ(std::vector<uint32_t>({ 0, 2, 4, 6 }),
+            ids(topology.selectCpus(AffinityPolicy::SPREAD, 4)));
+    EXPECT_EQ(std::vector<uint32_t>({ 0, 1, 2, 4, 6 }),
+            ids(topology.selectCpus(AffinityPolicy::SPREAD, 5)));
+}
+
+TEST(CpuTopologyTest, Performance) {
+    CpuTopology topology = makeServer();
+    EXPECT_EQ(8, topology.getPerformanceCpuCount());
+    EXPECT_EQ(std::vector<uint32_t>({ 0, 1, 2, 3 }),
+            ids(topology.selectCpus(AffinityPolicy::PERFORMANCE, 4)));
+    EXPECT_EQ(8, topology.selectCpus(AffinityPolicy::PERFORMANCE, 16).size());
+}
+
+TEST(CpuTopologyTest, None) {
+    CpuTopology topology = makeServer();
+    EXPECT_TRUE(topology.selectCpus(AffinityPolicy::NONE, 4).empty());
+}
+
+#if defined(__linux__)
+
+namespace {
+
+void writeFile(std::string const& path, const char* content) {
+    FILE* file = fopen(path.c_str(), "w");
+    ASSERT_NE(nullptr, file);
+    fputs(content, file);
+    fclose(file);
+}
+
+} // anonymous namespace
+
+TEST(CpuTopologyTest, Sysfs) {
+    // a big.LITTLE system: 2 little cores sharing an L2, 2 big cores with their own L2
+    char root[] = "/tmp/cputopologyXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(root));
+    std::string const base(root);
+    writeFile(base + "/online", "0-3\n");
+    for (int id = 0; id < 4; id++) {
+        std::string const cpu = base + "/cpu" + std::to_string(id);
+        mkdir(cpu.c_str(), 0700);
+        mkdir((cpu + "/topology").c_str(), 0700);
+        mkdir((cpu + "/cache").c_str(), 0700);
+        mkdir((cpu + "/node0").c_str(), 0700);
+        writeFile(cpu + "/topology/core_cpus_list", std::to_string(id).c_str());
+        writeFile(cpu + "/cpu_capacity", id < 2 ? "380\n" : "1024\n");
+        const char* const shared[] = { "0-1", "0-1", "2", "3" };
+        const char* const levels[] = { "1", "1", "2" };
+        const char* const types[] = { "Data", "Instruction", "Unified" };
+        for (int i = 0; i < 3; i++) {
+            std::string const index = cpu + "/cache/index" + std::to_string(i);
+            mkdir(index.c_str(), 0700);
+            writeFile(index + "/level", levels[i]);
+            writeFile(index + "/type", types[i]);
+            writeFile(index + "/shared_cpu_list", i < 2 ? std::to_string(id).c_str() : shared[id]);
+        }
+    }
+
+    CpuTopology topology = CpuTopology::load(root);
+    ASSERT_EQ(4, topology.getCpuCount());
+    auto const& cpus = topology.getCpus();
+    EXPECT_EQ(0, cpus[1].cacheDomain);
+    EXPECT_EQ(2, cpus[2].cacheDomain);
+    EXPECT_EQ(3, cpus[3].cacheDomain);
+    EXPECT_EQ(380, cpus[0].capacity);
+    EXPECT_EQ(1024, cpus[3].capacity);
+    EXPECT_EQ(2, topology.getPerformanceCpuCount());
+    EXPECT_EQ(std::vector<uint32_t>({ 2, 3 }),
+            ids(topology.selectCpus(AffinityPolicy::PERFORMANCE, 4)));
+
+    std::string const cleanup = "rm -rf " + base;
+    EXPECT_EQ(0, system(cleanup.c_str()));
+}
+
+TEST(CpuTopologyTest, ThisSystem) {
+    CpuTopology topology = CpuTopology::load();
+    EXPECT_GE(topology.getCpuCount(), 1);
+    EXPECT_GE(topology.getPerformanceCpuCount(), 1);
+}
+
+#endif
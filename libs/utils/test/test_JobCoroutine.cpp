@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <utils/JobCoroutine.h>
+
+#if UTILS_HAS_COROUTINES
+
+#include <atomic>
+
+using namespace utils;
+
+namespace {
+
+jobs::Task<int> square(JobSystem& js, int value) {
+    co_await jobs::schedule(js);
+    co_return value * value;
+}
+
+jobs::Task<int> sumOfSquares(JobSystem& js, int count) {
+    int sum = 0;
+    for (int i = 1; i <= count; i++) {
+        sum += co_await square(js, i);
+    }
+    co_return sum;
+}
+
+jobs::Task<> runJobs(JobSystem& js, std::atomic_int& calls) {
+    JobSystem::Job* root = js.createJob();
+    for (int i = 0; i < 100; i++) {
+        js.run(jobs::createJob(js, root, [&calls]() { calls++; }));
+    }
+    co_await jobs::completion(js, js.runAndRetain(root));
+    EXPECT_EQ(100, calls.load());
+    calls++;
+}
+
+} // anonymous namespace
+
+TEST(JobCoroutine, Tasks) {
+    JobSystem js(4);
+    js.adopt();
+
+    EXPECT_EQ(385, jobs::sync_wait(js, sumOfSquares(js, 10)));
+
+    std::atomic_int calls = { 0 };
+    jobs::sync_wait(js, runJobs(js, calls));
+    EXPECT_EQ(101, calls.load());
+
+    js.emancipate();
+}
+
+#endif
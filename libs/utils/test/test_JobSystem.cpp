@@ -17,6 +17,7 @@
 #include <gtest/gtest.h>
 
 #include <utils/JobSystem.h>
+#include <utils/sstream.h>
 #include <utils/WorkStealingDequeue.h>
 
 #include <math/vec3.h>
@@ -284,6 +285,180 @@ TEST(JobSystem, JobSystemParallelFor) {
     js.emancipate();
 }
 
+TEST(JobSystem, JobSystemBackgroundLane) {
+    JobSystem js(2);
+    js.adopt();
+
+    // this background job occupies a thread until we release it
+    std::atomic_bool released = { false };
+    std::atomic_int backgroundCalls = { 0 };
+    JobSystem::Job* background = js.runAndRetain(jobs::createJob(js, nullptr,
+            [&released, &backgroundCalls]() {
+        while (!released.load()) {
+            std::this_thread::yield();
+        }
+        backgroundCalls++;
+    }), JobSystem::BACKGROUND);
+
+    // waiting on critical jobs never executes the background job, or this would never return
+    std::atomic_int criticalCalls = { 0 };
+    JobSystem::Job* job = parallel_for(js, nullptr, 0, 1024,
+            [&criticalCalls](uint32_t start, uint32_t count) {
+        criticalCalls += count;
+    }, CountSplitter<16>());
+    js.runAndWait(job);
+    EXPECT_EQ(1024, criticalCalls.load());
+    EXPECT_EQ(0, backgroundCalls.load());
+
+    released = true;
+    js.waitAndRelease(background);
+    EXPECT_EQ(1, backgroundCalls.load());
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemManyJobs) {
+    JobSystem js;
+    js.adopt();
+
+    const size_t initialCapacity = js.getJobCapacity();
+
+    // create more jobs than fit in a single page (or in 16-bits indices), before running any
+    // of them; this also overflows the work queue
+    const auto self = std::this_thread::get_id();
+    std::atomic_bool submitting = { true };
+    std::atomic_int calls = { 0 };
+    std::atomic_int inlineCalls = { 0 };
+    JobSystem::Job* root = js.createJob();
+    for (int i = 0; i < 100000; i++) {
+        JobSystem::Job* job = jobs::createJob(js, root, [&]() {
+            if (submitting && std::this_thread::get_id() == self) {
+                inlineCalls++;
+            }
+            calls++;
+        });
+        ASSERT_NE(nullptr, job);
+        js.run(job, JobSystem::DONT_SIGNAL);
+    }
+    submitting = false;
+    js.runAndWait(root);
+
+    // run() never executes a job itself, even when the work queue is full
+    EXPECT_EQ(0, inlineCalls.load());
+    EXPECT_EQ(100000, calls.load());
+    EXPECT_GT(js.getJobCapacity(), initialCapacity);
+    EXPECT_EQ(0, js.getJobExhaustedCount());
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemRunOnCompletion) {
+    JobSystem js(4);
+    js.adopt();
+
+    // the continuation runs once all the children have run, and nobody waits on the job
+    std::atomic_int calls = { 0 };
+    std::atomic_int continuationCalls = { 0 };
+    JobSystem::Job* done = js.createJob();
+    JobSystem::Job* root = js.createJob();
+    for (int i = 0; i < 100; i++) {
+        js.run(jobs::createJob(js, root, [&calls]() { calls++; }), JobSystem::DONT_SIGNAL);
+    }
+    JobSystem::Job* continuation = jobs::createJob(js, done, [&]() {
+        EXPECT_EQ(100, calls.load());
+        continuationCalls++;
+    });
+    // the continuation can be added before the job runs
+    JobSystem::Job* retained = js.retain(root);
+    EXPECT_TRUE(js.runOnCompletion(retained, continuation));
+    EXPECT_EQ(nullptr, continuation);
+    js.run(root);
+    js.release(retained);
+    js.runAndWait(done);
+    EXPECT_EQ(1, continuationCalls.load());
+
+    // a continuation can't be added to a job that has finished
+    JobSystem::Job* finished = js.runAndRetain(js.createJob());
+    JobSystem::Job* waited = js.retain(finished);
+    js.waitAndRelease(waited);
+    JobSystem::Job* late = js.createJob();
+    EXPECT_FALSE(js.runOnCompletion(finished, late));
+    EXPECT_NE(nullptr, late);
+    js.cancel(late);
+    js.release(finished);
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemStatsAndTrace) {
+    JobSystem js(4);
+    js.adopt();
+    js.startProfiling(64);
+
+    std::atomic_int calls = { 0 };
+    JobSystem::Job* root = js.createJob();
+    js.setJobName(root, "root");
+    for (int i = 0; i < 100; i++) {
+        // children inherit the name of their parent
+        js.run(jobs::createJob(js, root, [&calls]() { calls++; }), JobSystem::DONT_SIGNAL);
+    }
+    js.runAndWait(root);
+    js.stopProfiling();
+    EXPECT_EQ(100, calls.load());
+
+    uint32_t jobCount = 0;
+    for (size_t i = 0; i < js.getThreadCount(); i++) {
+        JobSystem::ThreadStats const stats = js.getThreadStats(i);
+        EXPECT_LE(stats.stealCount, stats.stealAttemptCount);
+        jobCount += stats.jobCount;
+    }
+    EXPECT_EQ(101, jobCount);
+
+    io::sstream trace;
+    js.exportTrace(trace);
+    std::string const json(trace.c_str());
+    EXPECT_EQ(0, json.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"root\""));
+    EXPECT_EQ(std::string::npos, json.find("\"name\":\"job\""));
+
+    js.resetThreadStats();
+    for (size_t i = 0; i < js.getThreadCount(); i++) {
+        EXPECT_EQ(0, js.getThreadStats(i).jobCount);
+    }
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemProfilingWhileRunning) {
+    JobSystem js(4);
+    js.adopt();
+    js.startProfiling(16);
+
+    // profiling can be restarted, and the trace exported, while the jobs are running
+    std::atomic_int calls = { 0 };
+    JobSystem::Job* root = js.createJob();
+    for (int i = 0; i < 10000; i++) {
+        js.run(jobs::createJob(js, root, [&calls]() { calls++; }), JobSystem::DONT_SIGNAL);
+    }
+    root = js.runAndRetain(root);
+    for (int i = 0; i < 10; i++) {
+        js.startProfiling(i % 2 ? 16 : 32);
+        io::sstream trace;
+        js.exportTrace(trace);
+        EXPECT_EQ(0, std::string(trace.c_str()).find("{\"traceEvents\":["));
+    }
+    js.waitAndRelease(root);
+    js.stopProfiling();
+    EXPECT_EQ(10000, calls.load());
+
+    for (size_t i = 0; i < js.getThreadCount(); i++) {
+        JobSystem::ThreadStats const stats = js.getThreadStats(i);
+        EXPECT_LE(stats.stealCount, stats.stealAttemptCount);
+    }
+
+    js.emancipate();
+}
+
 TEST(JobSystem, JobSystemDelegates) {
     JobSystem js;
     js.adopt();
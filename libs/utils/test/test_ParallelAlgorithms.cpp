@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <utils/JobSystem.h>
+#include <utils/ParallelAlgorithms.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace utils;
+
+namespace {
+
+// covers the serial path, and the parallel path with full and partial blocks
+const size_t COUNTS[] = { 0, 1, 1000, 8192, 100000, 150001 };
+
+std::vector<uint32_t> makeValues(size_t count) {
+    std::default_random_engine gen{123};
+    std::uniform_int_distribution<uint32_t> nd(0, 1000);
+    std::vector<uint32_t> values(count);
+    std::generate(values.begin(), values.end(), [&]() { return nd(gen); });
+    return values;
+}
+
+} // anonymous namespace
+
+TEST(ParallelAlgorithmsTest, Reduce) {
+    JobSystem js;
+    js.adopt();
+
+    for (size_t count : COUNTS) {
+        std::vector<uint32_t> values = makeValues(count);
+        auto max = [](uint32_t a, uint32_t b) { return std::max(a, b); };
+        EXPECT_EQ(std::accumulate(values.begin(), values.end(), uint64_t(7)),
+                jobs::parallel_reduce(js, values.begin(), values.end(), uint64_t(7)));
+        EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0u, max),
+                jobs::parallel_reduce(js, values.begin(), values.end(), 0u, max));
+    }
+
+    js.emancipate();
+}
+
+TEST(ParallelAlgorithmsTest, ExclusiveScan) {
+    JobSystem js;
+    js.adopt();
+
+    for (size_t count : COUNTS) {
+        std::vector<uint32_t> values = makeValues(count);
+        std::vector<uint32_t> expected(count);
+        uint32_t sum = 3;
+        for (size_t i = 0; i < count; i++) {
+            expected[i] = sum;
+            sum += values[i];
+        }
+
+        std::vector<uint32_t> result(count);
+        auto end = jobs::parallel_exclusive_scan(js,
+                values.begin(), values.end(), result.begin(), 3u);
+        EXPECT_TRUE(end == result.end());
+        EXPECT_EQ(expected, result);
+
+        // in place
+        jobs::parallel_exclusive_scan(js, values.begin(), values.end(), values.begin(), 3u);
+        EXPECT_EQ(expected, values);
+    }
+
+    js.emancipate();
+}
+
+TEST(ParallelAlgorithmsTest, Partition) {
+    JobSystem js;
+    js.adopt();
+
+    auto isOdd = [](uint32_t v) { return (v & 1u) != 0; };
+    for (size_t count : COUNTS) {
+        std::vector<uint32_t> values = makeValues(count);
+        std::vector<uint32_t> expected(values);
+        auto expectedMiddle = std::stable_partition(expected.begin(), expected.end(), isOdd);
+
+        std::vector<uint32_t> scratch(count);
+        uint32_t* middle = jobs::parallel_partition(js,
+                values.data(), values.data() + count, scratch.data(), isOdd);
+        EXPECT_EQ(expectedMiddle - expected.begin(), middle - values.data());
+        EXPECT_EQ(expected, values);
+    }
+
+    js.emancipate();
+}
+
+TEST(ParallelAlgorithmsTest, Sort) {
+    JobSystem js;
+    js.adopt();
+
+    for (size_t count : COUNTS) {
+        std::vector<uint32_t> values = makeValues(count);
+        std::vector<uint32_t> expected(values);
+        std::sort(expected.begin(), expected.end());
+
+        jobs::parallel_sort(js, values.begin(), values.end());
+        EXPECT_EQ(expected, values);
+
+        jobs::parallel_sort(js, values.begin(), values.end(), std::greater<>());
+        EXPECT_TRUE(std::is_sorted(values.begin(), values.end(), std::greater<>()));
+    }
+
+    js.emancipate();
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <utils/JobSystem.h>
+#include <utils/RadixSort.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace utils;
+
+namespace {
+
+struct Item {
+    uint64_t key;
+    uint32_t index;
+};
+
+std::vector<Item> makeItems(size_t count, uint64_t mask, uint64_t bits) {
+    std::default_random_engine gen{123};
+    std::uniform_int_distribution<uint64_t> nd;
+    std::vector<Item> items(count);
+    for (size_t i = 0; i < count; i++) {
+        items[i] = { (nd(gen) & mask) | bits, uint32_t(i) };
+    }
+    return items;
+}
+
+// radix_sort() is stable, so its result must be exactly that of std::stable_sort()
+void expectSorted(std::vector<Item> items, std::vector<Item> const& result) {
+    std::stable_sort(items.begin(), items.end(),
+            [](Item const& lhs, Item const& rhs) { return lhs.key < rhs.key; });
+    ASSERT_EQ(items.size(), result.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        EXPECT_EQ(items[i].key, result[i].key);
+        EXPECT_EQ(items[i].index, result[i].index);
+    }
+}
+
+auto getKey = [](Item const& item) { return item.key; };
+
+} // anonymous namespace
+
+TEST(RadixSortTest, Small) {
+    for (size_t count : { 0, 1, 2, 3, 17, 1000 }) {
+        std::vector<Item> items = makeItems(count, ~0ull, 0);
+        std::vector<Item> sorted(items);
+        std::vector<Item> scratch(count);
+        radix_sort(sorted.data(), sorted.data() + count, scratch.data(), getKey);
+        expectSorted(items, sorted);
+    }
+}
+
+TEST(RadixSortTest, ConstantDigits) {
+    // with an odd number of varying digits, the result needs to be copied back
+    for (uint64_t mask : { 0ull, 0xFFull, 0xFFFFull, 0x00F0'0000'FF00'00F0ull, ~0ull }) {
+        std::vector<Item> items = makeItems(10000, mask, 0x8000'0000'0000'0001ull);
+        std::vector<Item> sorted(items);
+        std::vector<Item> scratch(items.size());
+        radix_sort(sorted.data(), sorted.data() + sorted.size(), scratch.data(), getKey);
+        expectSorted(items, sorted);
+    }
+}
+
+TEST(RadixSortTest, Parallel) {
+    JobSystem js;
+    js.adopt();
+
+    for (size_t count : { 100, 8192, 100000, 150001 }) {
+        for (uint64_t mask : { 0x7ull, 0xFFFF'FF00ull, ~0ull }) {
+            std::vector<Item> items = makeItems(count, mask, 0);
+            std::vector<Item> sorted(items);
+            std::vector<Item> scratch(count);
+            jobs::parallel_radix_sort(js,
+                    sorted.data(), sorted.data() + count, scratch.data(), getKey);
+            expectSorted(items, sorted);
+        }
+    }
+
+    js.emancipate();
+}
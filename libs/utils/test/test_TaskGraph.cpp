@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <utils/JobSystem.h>
+#include <utils/TaskGraph.h>
+
+#include <atomic>
+
+using namespace utils;
+
+TEST(TaskGraph, Diamond) {
+    JobSystem js(4);
+    js.adopt();
+
+    // a -> (b, c) -> d, each task records the order in which it ran
+    std::atomic_int counter = { 0 };
+    int a = -1, b = -1, c = -1, d = -1;
+    {
+        TaskGraph graph(js);
+        auto ta = graph.add([&]() { a = counter++; });
+        auto tb = graph.then(ta, [&]() { b = counter++; });
+        auto tc = graph.then(ta, [&]() { c = counter++; });
+        auto td = graph.then(tb, [&]() { d = counter++; });
+        graph.precede(tc, td);
+        graph.run();
+        graph.wait(td);
+        EXPECT_EQ(4, counter.load());
+    }
+
+    EXPECT_EQ(0, a);
+    EXPECT_LT(a, b);
+    EXPECT_LT(a, c);
+    EXPECT_GT(d, b);
+    EXPECT_GT(d, c);
+
+    js.emancipate();
+}
+
+TEST(TaskGraph, Join) {
+    JobSystem js(4);
+    js.adopt();
+
+    std::atomic_int sum = { 0 };
+    int result = 0;
+    TaskGraph graph(js);
+    auto join = graph.add();
+    for (int i = 1; i <= 100; i++) {
+        graph.precede(graph.add([&sum, i]() { sum += i; }), join);
+    }
+    graph.then(join, [&]() { result = sum.load(); });
+    graph.wait();
+
+    EXPECT_EQ(102, graph.getTaskCount());
+    EXPECT_EQ(5050, result);
+
+    js.emancipate();
+}
+
+TEST(TaskGraph, AddWhileRunning) {
+    JobSystem js(4);
+    js.adopt();
+
+    std::atomic_int calls = { 0 };
+    TaskGraph graph(js);
+    auto first = graph.add([&]() { calls++; });
+    graph.run(first);
+    graph.wait(first);
+    EXPECT_EQ(1, calls.load());
+
+    // a continuation of a finished task starts right away
+    auto second = graph.then(first, [&]() { calls++; });
+    graph.run(second);
+    graph.wait(second);
+    EXPECT_EQ(2, calls.load());
+
+    // tasks that are never explicitly submitted run in wait()
+    graph.add([&]() { calls++; });
+    graph.wait();
+    EXPECT_EQ(3, calls.load());
+
+    js.emancipate();
+}
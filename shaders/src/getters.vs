@@ -6,14 +6,17 @@ mat4 getLightFromWorldMatrix() {
     return frameUniforms.lightFromWorldMatrix;
 }
 
+// The per-renderable transforms don't include the world origin (IBL rotation, camera at origin),
+// which is applied here. It is a rigid transform, so it doesn't affect the normal matrix scale.
+
 /** @public-api */
 mat4 getWorldFromModelMatrix() {
-    return objectUniforms.worldFromModelMatrix;
+    return frameUniforms.worldFromUserWorldMatrix * objectUniforms.worldFromModelMatrix;
 }
 
 /** @public-api */
 mat3 getWorldFromModelNormalMatrix() {
-    return objectUniforms.worldFromModelNormalMatrix;
+    return mat3(frameUniforms.worldFromUserWorldMatrix) * objectUniforms.worldFromModelNormalMatrix;
 }
 
 //------------------------------------------------------------------------------
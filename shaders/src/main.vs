@@ -37,8 +37,9 @@ void main() {
         // because we ensure the worldFromModelNormalMatrix pre-scales the normal such that
         // all its components are < 1.0. This precents the bitangent to exceed the range of fp16
         // in the fragment shader, where we renormalize after interpolation
-        vertex_worldTangent = objectUniforms.worldFromModelNormalMatrix * vertex_worldTangent;
-        material.worldNormal = objectUniforms.worldFromModelNormalMatrix * material.worldNormal;
+        mat3 normalMatrix = getWorldFromModelNormalMatrix();
+        vertex_worldTangent = normalMatrix * vertex_worldTangent;
+        material.worldNormal = normalMatrix * material.worldNormal;
 
         // Reconstruct the bitangent from the normal and tangent. We don't bother with
         // normalization here since we'll do it after interpolation in the fragment stage
@@ -54,7 +55,7 @@ void main() {
             }
         #endif
 
-        material.worldNormal = objectUniforms.worldFromModelNormalMatrix * material.worldNormal;
+        material.worldNormal = getWorldFromModelNormalMatrix() * material.worldNormal;
 
     #endif // MATERIAL_HAS_ANISOTROPY || MATERIAL_HAS_NORMAL
 #endif // HAS_ATTRIBUTE_TANGENTS
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt/getopt.h>
+
+#include <backend/Platform.h>
+
+#include "private/backend/CommandStreamCapture.h"
+#include "private/backend/Driver.h"
+
+#include <utils/Path.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+using namespace filament::backend;
+
+struct Config {
+    Backend backend = Backend::NOOP;
+    uint32_t repeat = 1;
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+};
+
+static void printUsage(const char* name) {
+    std::string execName(utils::Path(name).getName());
+    std::string usage(
+            "CMDREPLAY plays back a command stream captured with FILAMENT_CAPTURE_COMMANDS\n"
+            "Usage:\n"
+            "    CMDREPLAY [options] <capture file>\n"
+            "\n"
+            "Options:\n"
+            "   --help, -h\n"
+            "       Print this message\n\n"
+            "   --api=[noop|opengl|vulkan], -a\n"
+            "       Backend to play the commands back into (default: noop)\n\n"
+            "   --repeat=[count], -r\n"
+            "       Number of times the capture is played back, each time into a new\n"
+            "       backend (default: 1)\n\n"
+            "   --size=[width]x[height], -s\n"
+            "       Size of the swap chains (default: 1920x1080)\n\n"
+            "   --license\n"
+            "       Print copyright and license information\n\n"
+    );
+
+    const std::string from("CMDREPLAY");
+    for (size_t pos = usage.find(from); pos != std::string::npos; pos = usage.find(from, pos)) {
+        usage.replace(pos, from.length(), execName);
+    }
+    printf("%s", usage.c_str());
+}
+
+static void license() {
+    static const char *license[] = {
+        #include "licenses/licenses.inc"
+        nullptr
+    };
+
+    const char **p = &license[0];
+    while (*p)
+        std::cout << *p++ << std::endl;
+}
+
+static int handleArguments(int argc, char* argv[], Config* config) {
+    static constexpr const char* OPTSTR = "hla:r:s:";
+    static const struct option OPTIONS[] = {
+            { "help",    no_argument,       0, 'h' },
+            { "license", no_argument,       0, 'l' },
+            { "api",     required_argument, 0, 'a' },
+            { "repeat",  required_argument, 0, 'r' },
+            { "size",    required_argument, 0, 's' },
+            { 0, 0, 0, 0 }  // termination of the option list
+    };
+
+    int opt;
+    int optionIndex = 0;
+
+    while ((opt = getopt_long(argc, argv, OPTSTR, OPTIONS, &optionIndex)) >= 0) {
+        std::string arg(optarg ? optarg : "");
+        switch (opt) {
+            default:
+            case 'h':
+                printUsage(argv[0]);
+                exit(0);
+            case 'l':
+                license();
+                exit(0);
+            case 'a':
+                if (arg == "noop") {
+                    config->backend = Backend::NOOP;
+                } else if (arg == "opengl") {
+                    config->backend = Backend::OPENGL;
+                } else if (arg == "vulkan") {
+                    config->backend = Backend::VULKAN;
+                } else {
+                    std::cerr << "Unrecognized backend. Must be 'noop'|'opengl'|'vulkan'."
+                              << std::endl;
+                    exit(1);
+                }
+                break;
+            case 'r':
+                config->repeat = uint32_t(std::max(std::stoi(arg), 1));
+                break;
+            case 's':
+                if (sscanf(arg.c_str(), "%ux%u", &config->width, &config->height) != 2) {
+                    std::cerr << "The size must be [width]x[height], e.g. 1920x1080." << std::endl;
+                    exit(1);
+                }
+                break;
+        }
+    }
+
+    return optind;
+}
+
+int main(int argc, char* argv[]) {
+    Config config;
+    int optionIndex = handleArguments(argc, argv, &config);
+
+    int numArgs = argc - optionIndex;
+    if (numArgs < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CommandStreamReplay replay(argv[optionIndex]);
+    if (!replay.isValid()) {
+        return 1;
+    }
+    replay.setSwapChainSize(config.width, config.height);
+
+    // The capture creates all its resources and doesn't always destroy them, so each pass is
+    // played back into a new driver rather than accumulating them in the same one.
+    using ms = std::chrono::duration<double, std::milli>;
+    std::vector<CommandStreamReplay::FrameStats> stats;
+    bool success = true;
+    for (uint32_t i = 0; i < config.repeat && success; i++) {
+        Backend backend = config.backend;
+        DefaultPlatform* platform = DefaultPlatform::create(&backend);
+        Driver* driver = platform ? platform->createDriver(nullptr) : nullptr;
+        if (!driver) {
+            std::cerr << "Couldn't create the backend." << std::endl;
+            DefaultPlatform::destroy(&platform);
+            return 1;
+        }
+        success = replay.replay(*driver, &stats);
+        driver->terminate();
+        delete driver;
+        DefaultPlatform::destroy(&platform);
+    }
+    if (!success) {
+        std::cerr << "The capture is truncated, it was played back partially." << std::endl;
+    }
+
+    CommandStreamReplay::FrameStats total;
+    printf("%6s %10s %12s %12s\n", "frame", "commands", "decode (ms)", "execute (ms)");
+    for (size_t i = 0; i < stats.size(); i++) {
+        CommandStreamReplay::FrameStats const& frame = stats[i];
+        printf("%6zu %10zu %12.3f %12.3f\n", i, frame.commandCount,
+                ms(frame.decode).count(), ms(frame.execute).count());
+        total.commandCount += frame.commandCount;
+        total.decode += frame.decode;
+        total.execute += frame.execute;
+    }
+    if (!stats.empty()) {
+        printf("%6s %10zu %12.3f %12.3f\n", "total", total.commandCount,
+                ms(total.decode).count(), ms(total.execute).count());
+    }
+
+    return success ? 0 : 1;
+}